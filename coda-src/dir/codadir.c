@@ -107,6 +107,21 @@ int DH_Convert(PDirHandle dh, char *file, VolumeId vol, RealmId realm)
 	return rc;
 }
 
+/* add one entry to a Unix dir made by DH_Convert: called by client */
+int DH_ConvertAdd(PDirHandle dh, char *file, const char *entry,
+		  VolumeId vol, RealmId realm)
+{
+	int rc;
+
+	DH_LockR(dh);
+
+	rc = DIR_ConvertAdd(dh->dh_data, file, entry, vol, realm);
+
+	DH_UnLockR(dh);
+
+	return rc;
+}
+
 /* create new entry: called by client and server */
 int DH_Create (PDirHandle dh, const char *entry, struct ViceFid *vfid)
 {
@@ -200,6 +215,7 @@ void DH_FreeData(PDirHandle dh)
 	if (!dh->dh_data)
 		return;
 
+	DIX_Drop(dh->dh_data);
 	if ( DIR_rvm() ) {
 		rvmlib_rec_free(dh->dh_data);
 	} else {
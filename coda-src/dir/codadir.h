@@ -28,7 +28,10 @@ listed in the file CREDITS.
 /* bytes per page */
 #define DIR_PAGESIZE 2048	
 
-/* maximum pages of a directory */
+/* maximum pages of a directory, the allocation map in the header has one
+   byte per page and entries are addressed with 16 bit blob numbers. With
+   short names a directory holds about 8050 entries, changing this changes
+   the directory format on the wire and in RVM. */
 #define DIR_MAXPAGES  128
 
 /* where is directory data */
@@ -89,6 +92,8 @@ void DH_FreeData(PDirHandle dh);
 PDirHandle DH_New(int in_rvm, PDirHeader vmdata, PDirHeader rvmdata);
 int DH_Length(PDirHandle dh);
 int DH_Convert(PDirHandle dh, char *file, VolumeId vol, RealmId realm);
+int DH_ConvertAdd(PDirHandle dh, char *file, const char *entry,
+		  VolumeId vol, RealmId realm);
 int DH_Create(PDirHandle dh, const char *entry, struct ViceFid *vfid);
 int DH_IsEmpty(PDirHandle dh);
 int DH_Lookup(PDirHandle dh, const char *entry, struct ViceFid *vfid,int flags);
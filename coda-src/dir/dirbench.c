@@ -0,0 +1,345 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ * Directory operation benchmark.
+ *
+ * Fills directories of increasing size and measures create, lookup (hits
+ * and misses), enumerate, conversion to a Unix directory file, and
+ * remove, from 1000 entries up to a full directory. The last size fills
+ * the directory until the format runs out of pages, about 8050 entries;
+ * larger directories need a new directory format. The benchmark runs once with directories in plain memory, like
+ * venus' transient copies, and once with directories in a scratch
+ * recoverable segment, one transaction per operation like the server. The
+ * recoverable run also reports how many bytes each operation logged.
+ * Each run happens in its own process because RVM can only be initialized
+ * once.
+ *
+ * usage: dirbench [-d dir] [-l lookups]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <lwp/lwp.h>
+#include <lwp/lock.h>
+#include <rvm/rvm.h>
+#include <rvm/rds.h>
+#include <rvm/rvm_statistics.h>
+#include <rvmlib.h>
+#include "coda_string.h"
+#include "codadir.h"
+#include "dirbody.h"
+
+#define HEAP_ADDR    ((char *)0x20000000)
+#define HEAP_LEN     (16 * 1024 * 1024)
+#define STATIC_LEN   (64 * 1024)
+#define DATA_HDR_LEN (64 * 1024)
+#define LOG_LEN      (16 * 1024 * 1024)
+
+/* 0 means keep adding entries until the directory is full */
+static const int sizes[] = { 1000, 2000, 4000, 6000, 0 };
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static char *dir = "/tmp";
+static long nlookups = 100000;
+static int in_rvm;
+static rvm_statistics_t stats;
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+static void check(const char *what, int err)
+{
+    if (err == SUCCESS)
+	return;
+    fprintf(stderr, "%s failed, %s\n", what,
+	    err > 0 ? rvm_return((rvm_return_t)err) : "rds error");
+    exit(EXIT_FAILURE);
+}
+
+static void checkdir(const char *what, int err)
+{
+    if (err == 0)
+	return;
+    fprintf(stderr, "%s failed, %s\n", what, strerror(err));
+    exit(EXIT_FAILURE);
+}
+
+/* bytes written to the log so far */
+static unsigned long logged(void)
+{
+    if (!in_rvm)
+	return 0;
+    check("rvm_flush", rvm_flush());
+    check("rvm_statistics", RVM_STATISTICS(&stats));
+    check("rvm_truncate", rvm_truncate());
+    return RVM_OFFSET_TO_LENGTH(stats.log_written) +
+	   RVM_OFFSET_TO_LENGTH(stats.tot_log_written);
+}
+
+static void begin(void)
+{
+    if (in_rvm)
+	rvmlib_begin_transaction(restore);
+}
+
+static void end(void)
+{
+    if (in_rvm)
+	rvmlib_end_transaction(no_flush, NULL);
+}
+
+static void name(char *buf, int i)
+{
+    sprintf(buf, "file%06d", i);
+}
+
+static int count(struct DirEntry *de, void *hook)
+{
+    (*(int *)hook)++;
+    return 0;
+}
+
+static void bench(PDirHandle dh, int size)
+{
+    struct ViceFid me = { 1, 1, 1 }, fid = { 1, 2, 1 };
+    char buf[32], file[MAXPATHLEN];
+    struct timeval start;
+    double create, lookup, miss, enumerate, convert, del;
+    unsigned long log0, log1, log2;
+    int n, i, err, entries, fd;
+
+    snprintf(file, sizeof(file), "%s/dirbench.out", dir);
+
+    begin();
+    DH_Init(dh);
+    checkdir("DH_MakeDir", DH_MakeDir(dh, &me, &me));
+    end();
+
+    log0 = logged();
+    gettimeofday(&start, NULL);
+    for (n = 0; size == 0 || n < size; n++) {
+	name(buf, n);
+	fid.Vnode = 2 * n + 2;
+	begin();
+	err = DH_Create(dh, buf, &fid);
+	end();
+	if (err == EFBIG)
+	    break;
+	checkdir("DH_Create", err);
+    }
+    create = elapsed(&start) / n;
+    log1 = logged();
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nlookups; i++) {
+	name(buf, (i * 7919) % n);
+	checkdir("DH_Lookup", DH_Lookup(dh, buf, &fid, CLU_CASE_SENSITIVE));
+    }
+    lookup = elapsed(&start) / nlookups;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nlookups; i++) {
+	name(buf, n + i);
+	if (DH_Lookup(dh, buf, &fid, CLU_CASE_SENSITIVE) != ENOENT)
+	    checkdir("DH_Lookup", EIO);
+    }
+    miss = elapsed(&start) / nlookups;
+
+    entries = 0;
+    gettimeofday(&start, NULL);
+    DH_EnumerateDir(dh, count, &entries);
+    enumerate = elapsed(&start);
+    if (entries != n + 2)
+	fprintf(stderr, "enumerate found %d entries instead of %d\n",
+		entries, n + 2);
+
+    /* the container file has to exist, like in the venus cache */
+    fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+	perror(file);
+	exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    gettimeofday(&start, NULL);
+    checkdir("DH_Convert", DH_Convert(dh, file, 1, 0));
+    convert = elapsed(&start);
+    unlink(file);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < n; i++) {
+	name(buf, i);
+	begin();
+	checkdir("DH_Delete", DH_Delete(dh, buf));
+	end();
+    }
+    del = elapsed(&start) / n;
+    log2 = logged();
+
+    printf("  %5d entries %3d pages: create %7.2f us, lookup %6.2f us, "
+	   "miss %6.2f us, enumerate %6.2f ms, convert %6.2f ms, "
+	   "remove %7.2f us\n", n, DH_Length(dh) / DIR_PAGESIZE,
+	   create * 1e6, lookup * 1e6, miss * 1e6, enumerate * 1e3,
+	   convert * 1e3, del * 1e6);
+    if (in_rvm)
+	printf("  %5s log bytes per create %lu, per remove %lu\n", "",
+	       (log1 - log0) / n, (log2 - log1) / n);
+
+    begin();
+    DH_FreeData(dh);
+    end();
+}
+
+static void run(int rvm)
+{
+    char logdev[MAXPATHLEN], datadev[MAXPATHLEN];
+    static rvm_perthread_t rvmptt;
+    rvm_options_t *options;
+    struct DirHandle vmdh;
+    PDirHandle dh = &vmdh;
+    char *statics;
+    PROCESS pid;
+    unsigned int i;
+    int err, fd;
+
+    in_rvm = rvm;
+    if (LWP_Init(LWP_VERSION, LWP_NORMAL_PRIORITY, &pid) != LWP_SUCCESS) {
+	fprintf(stderr, "LWP_Init failed\n");
+	exit(EXIT_FAILURE);
+    }
+
+    if (in_rvm) {
+	snprintf(logdev, sizeof(logdev), "%s/dirbench.log", dir);
+	snprintf(datadev, sizeof(datadev), "%s/dirbench.data", dir);
+	unlink(logdev);
+	unlink(datadev);
+
+	fd = open(datadev, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1 || ftruncate(fd, HEAP_LEN + STATIC_LEN + DATA_HDR_LEN)) {
+	    perror(datadev);
+	    exit(EXIT_FAILURE);
+	}
+	close(fd);
+
+	options = rvm_malloc_options();
+	options->log_dev = logdev;
+	options->create_log_file = rvm_true;
+	options->create_log_size = RVM_MK_OFFSET(0, LOG_LEN);
+	options->create_log_mode = 0600;
+	check("rvm_initialize", RVM_INIT(options));
+	rvm_init_statistics(&stats);
+
+	rds_zap_heap(datadev,
+		     RVM_MK_OFFSET(0, HEAP_LEN + STATIC_LEN + DATA_HDR_LEN),
+		     HEAP_ADDR, STATIC_LEN, HEAP_LEN, 16, 64, &err);
+	check("rds_zap_heap", err);
+	rds_load_heap(datadev,
+		      RVM_MK_OFFSET(0, HEAP_LEN + STATIC_LEN + DATA_HDR_LEN),
+		      &statics, &err);
+	check("rds_load_heap", err);
+
+	RvmType = UFS;
+	rvmlib_init_threaddata(&rvmptt);
+
+	/* DIR_MakeDir logs the handle, it has to be recoverable too */
+	dh = (PDirHandle)statics;
+	DIR_Init(DIR_DATA_IN_RVM);
+    } else {
+	RvmType = VM;
+	DIR_Init(DIR_DATA_IN_VM);
+    }
+
+    printf("%s:\n", in_rvm ? "rvm" : "vm");
+    for (i = 0; i < NSIZES; i++)
+	bench(dh, sizes[i]);
+    DH_PrintStats(stdout);
+
+    if (in_rvm) {
+	rvm_terminate();
+	unlink(logdev);
+	unlink(datadev);
+    }
+}
+
+static void spawn(int rvm)
+{
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == -1) {
+	perror("fork");
+	exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+	run(rvm);
+	exit(EXIT_SUCCESS);
+    }
+    if (waitpid(pid, &status, 0) == -1) {
+	perror("waitpid");
+	exit(EXIT_FAILURE);
+    }
+    if (WIFSIGNALED(status)) {
+	fprintf(stderr, "%s run killed by signal %d\n", rvm ? "rvm" : "vm",
+		WTERMSIG(status));
+	exit(EXIT_FAILURE);
+    }
+    if (WEXITSTATUS(status) != EXIT_SUCCESS)
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "d:l:")) != -1) {
+	switch (c) {
+	case 'd': dir = optarg; break;
+	case 'l': nlookups = atol(optarg); break;
+	default:
+	    fprintf(stderr, "usage: %s [-d dir] [-l lookups]\n", argv[0]);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (nlookups <= 0) {
+	fprintf(stderr, "lookups have to be positive\n");
+	exit(EXIT_FAILURE);
+    }
+
+    spawn(0);
+    spawn(1);
+    return 0;
+}
@@ -107,10 +107,13 @@ inline void DIR_check_trans(const char *where, const char *file)
 }
 
 
-static void DIR_SetRange(struct DirHeader *dir)
+/* Only log the bytes we are about to change, setting a range over the
+   whole directory made every create and remove in a large directory log
+   up to 256KB. */
+static void dir_SetRange(void *addr, int len)
 {
 	if (DIR_rvm())
-		rvmlib_set_range((void *)dir, DIR_Length(dir));
+		rvmlib_set_range(addr, len);
 	return;
 }
 
@@ -174,8 +177,10 @@ static int dir_FindBlobs (struct DirHeader **dh, int nblobs)
 			   allocation maps and free up any resources we've got
 			   allocated. */
 			if (!failed) {
-				if ( grown == 0 ) 
-					DIR_SetRange(*dh);
+				if ( grown == 0 ) {
+					dir_SetRange(&(*dh)->dirh_allomap[i], 1);
+					dir_SetRange(pp, sizeof(*pp));
+				}
 				(*dh)->dirh_allomap[i] -= nblobs;
 				pp->freecount -= nblobs;
 				for (k=0; k<nblobs; k++)
@@ -276,6 +281,7 @@ static struct DirHeader *dir_Extend(struct DirHeader *olddir, int in_rvm)
 	memset(((char *)dirh)+ oldsize, 0, newsize - oldsize);
 
 	/* if old dirh exists, free it */
+	DIX_Drop(olddir);
 	if ( in_rvm ) 
 		rvmlib_rec_free(olddir);
 	else
@@ -307,8 +313,11 @@ static void dir_FreeBlobs(struct DirHeader *dhp, int firstblob, int nblobs)
     if (!dhp) 
 	    return;
 
-    dhp->dirh_allomap[page] += nblobs;
     pp = DIR_Page(dhp,page);
+    dir_SetRange(&dhp->dirh_allomap[page], 1);
+    dir_SetRange(pp, sizeof(*pp));
+
+    dhp->dirh_allomap[page] += nblobs;
     pp->freecount += nblobs;
     for (i=0;i<nblobs;i++)
 	    pp->freebitmap[(firstblob+i)>>3] &= ~(1<<((firstblob+i)&7));
@@ -432,6 +441,7 @@ void DH_PrintStats(FILE *fp)
 {
 	fprintf(fp, "Dirstats: get %d, put %d, flush %d\n", 
 		dir_stats.get, dir_stats.put, dir_stats.flush);
+	DIX_PrintStats(fp);
 }
 
 
@@ -498,6 +508,14 @@ int DIR_Length (struct DirHeader *dir)
 */
 
 
+/* Tell the name index the contents changed, even when a create and a
+   delete leave the chain heads and allocation map as they were. */
+static void dir_Touch(struct DirHeader *dir)
+{
+	dir_SetRange(&dir->dirh_ph.generation, sizeof(dir->dirh_ph.generation));
+	dir->dirh_ph.generation++;
+}
+
 /* Create an entry in a directory file.  */
 int DIR_Create (struct DirHeader **dh, const char *entry, DirFid *fid)
 {
@@ -505,14 +523,13 @@ int DIR_Create (struct DirHeader **dh, const char *entry, DirFid *fid)
 	int i;
 	struct DirHeader *dir;
 	struct DirEntry *ep;
+	struct dirindex *ix;
 
 	if ( !dh || !(*dh) ||  !entry || !fid )
 		return EIO;
 
-	if ( DIR_rvm() ) {
+	if ( DIR_rvm() )
 		DIR_intrans();
-		DIR_SetRange(*dh);
-	}
 
 	dir = *dh;
 
@@ -526,6 +543,7 @@ int DIR_Create (struct DirHeader **dh, const char *entry, DirFid *fid)
 	if (ep) {
 		return EEXIST;
 	}
+	ix = DIX_Get(dir, 0);
 
 	blobs = dir_NameBlobs(entry);	/* number of entries required */
 	firstblob = dir_FindBlobs(dh, blobs);
@@ -539,19 +557,27 @@ int DIR_Create (struct DirHeader **dh, const char *entry, DirFid *fid)
 	if (ep == 0) {
 		return EIO;
 	}
+	dir_SetRange(ep, blobs * sizeof(struct DirBlob));
 	ep->flag = FFIRST;
 	fid_Fid2NFid(fid, &ep->fid);
 	strcpy(ep->name,entry);
 
 	/* Now we just have to thread it on the hash table list.     */
 	i = DIR_Hash(entry);
+	dir_SetRange(&dir->dirh_hashTable[i], sizeof(short));
 	ep->next = dir->dirh_hashTable[i];
 	dir->dirh_hashTable[i] = htons(firstblob);
+	dir_Touch(dir);
+
+	if (ix)
+		DIX_Insert(ix, dir, entry, firstblob);
 
+#ifdef DIR_PARANOID
 	if ( !DIR_DirOK(dir)) {
 		fprintf(stderr, "Corrupt directory at %p\n", dir);
 		DIR_Print(dir, stdout);
 	}
+#endif
 
 	return 0;
 }
@@ -567,32 +593,42 @@ int DIR_Delete(struct DirHeader *dir, const char *entry)
 	int nitems, index;
 	struct DirEntry *firstitem;
 	struct DirEntry *preventry;
+	struct dirindex *ix;
     
 	CODA_ASSERT( dir && entry );
 
-	if ( DIR_rvm() ) {
+	if ( DIR_rvm() )
 		DIR_intrans();
-		DIR_SetRange(dir);
-	}
-
 
+	/* We need the previous entry in the chain, so this has to walk
+	   the chain even when there is an index. */
 	firstitem = dir_FindItem(dir, entry, &preventry, &index, CLU_CASE_SENSITIVE);
 	if ( !firstitem ) 
 		return ENOENT;
+	ix = DIX_Get(dir, 0);
 
 	if ( preventry ) {
+		dir_SetRange(&preventry->next, sizeof(short));
 		preventry->next = firstitem->next;
 	} else {
-		dir->dirh_hashTable[DIR_Hash(entry)] = firstitem->next;
+		short *head = &dir->dirh_hashTable[DIR_Hash(entry)];
+		dir_SetRange(head, sizeof(short));
+		*head = firstitem->next;
 	}
 	nitems = dir_NameBlobs(firstitem->name);
 	
 	dir_FreeBlobs(dir, index, nitems);
+	dir_Touch(dir);
+
+	if (ix)
+		DIX_Remove(ix, entry, index);
 
+#ifdef DIR_PARANOID
 	if ( !DIR_DirOK(dir)) {
 		fprintf(stderr, "Corrupt directory at %p\n", dir);
 		DIR_Print(dir, stdout);
 	}
+#endif
 
 	return 0;
 }
@@ -620,7 +656,7 @@ int DIR_MakeDir (struct DirHeader **dir, DirFid *me, DirFid *parent)
 	if ( !dhp )
 		return ENOMEM;
 
-	/* cannot call DIR_SetRange yet, since dir is unitialized */
+	/* cannot use DIR_Length yet, since dir is unitialized */
 	if ( DIR_rvm()) {
 		rvmlib_set_range(dir, sizeof(*dir));
 		rvmlib_set_range(dhp, DIR_PAGESIZE);
@@ -670,6 +706,7 @@ void DIR_Free(struct DirHeader *dir, int in_rvm)
 	if ( !dir ) 
 		return;
 
+	DIX_Drop(dir);
 	if ( DIR_rvm() ) 
 		rvmlib_rec_free(dir);
 	else
@@ -906,6 +943,79 @@ int DIR_Convert (PDirHeader dir, char *file, VolumeId vol, RealmId realm)
 	return 0;
 }
 
+/* Add one entry to a Unix dir written by DIR_Convert, instead of
+   converting the whole directory again. The entry goes into the slack of
+   the last record when it fits, otherwise into a new DIRBLKSIZ block so
+   that entries still never cross a block boundary. Deleted entries are
+   left in place with a zero d_fileno, it is up to the caller to convert
+   the directory again when too many of them pile up. */
+int DIR_ConvertAdd(PDirHeader dir, char *file, const char *entry,
+		   VolumeId vol, RealmId realm)
+{
+	struct DirEntry *ep;
+	struct venus_dirent *vd, nvd;
+	long block[DIRBLKSIZ / sizeof(long)];
+	char *buf = (char *)block;
+	int fd, direntlen, used;
+	int offset, last = 0;
+	off_t len;
+	int rc = 0;
+
+	ep = dir_FindItem(dir, entry, NULL, NULL, CLU_CASE_SENSITIVE);
+	if ( !ep )
+		return ENOENT;
+	memset(&nvd, 0, sizeof(nvd));
+	direntlen = dir_DirEntry2VDirent(ep, &nvd, vol, realm);
+
+	fd = open(file, O_RDWR | O_BINARY);
+	if ( fd < 0 )
+		return errno;
+
+	len = lseek(fd, 0, SEEK_END);
+	if ( len < DIRBLKSIZ || len % DIRBLKSIZ ||
+	     pread(fd, buf, DIRBLKSIZ, len - DIRBLKSIZ) != DIRBLKSIZ ) {
+		rc = EIO;
+		goto Exit;
+	}
+
+	/* find the record that runs up to the end of the file */
+	for (offset = 0; offset < DIRBLKSIZ; offset += vd->d_reclen) {
+		vd = (struct venus_dirent *)(buf + offset);
+		if ( vd->d_reclen == 0 || vd->d_reclen & 3 ) {
+			rc = EIO;
+			goto Exit;
+		}
+		last = offset;
+	}
+	if ( offset != DIRBLKSIZ ) {
+		rc = EIO;
+		goto Exit;
+	}
+
+	/* the final padding entry and deleted entries can be overwritten */
+	vd = (struct venus_dirent *)(buf + last);
+	used = vd->d_fileno ? DIRSIZ(vd) : 0;
+
+	if ( DIRBLKSIZ - (last + used) >= direntlen ) {
+		if ( used )
+			vd->d_reclen = used;
+		offset = last + used;
+	} else {
+		memset(buf, 0, DIRBLKSIZ);
+		offset = 0;
+		len += DIRBLKSIZ;
+	}
+	memcpy(buf + offset, &nvd, direntlen);
+	((struct venus_dirent *)(buf + offset))->d_reclen = DIRBLKSIZ - offset;
+
+	if ( pwrite(fd, buf, DIRBLKSIZ, len - DIRBLKSIZ) != DIRBLKSIZ )
+		rc = EIO;
+
+ Exit:
+	CODA_ASSERT(close(fd) == 0);
+	return rc;
+}
+
 /* Enumerate the contents of a directory: hook is called
    with the direntry in NETWORK order */
 int DIR_EnumerateDir(struct DirHeader *dhp, 
@@ -1095,6 +1205,20 @@ static struct DirEntry *dir_FindItem (struct DirHeader *dir, const char *ename,
 		if (!dir)
 			return NULL;
 
+		/* Large directories have an index, unless we also need
+		   the previous entry in the chain. */
+		if (!preventry) {
+			struct dirindex *ix = DIX_Get(dir, 1);
+			if (ix) {
+				blobno = DIX_Lookup(ix, ename);
+				if (blobno == 0)
+					return NULL;
+				if (index)
+					*index = blobno;
+				return dir_GetBlob(dir, blobno);
+			}
+		}
+
 		i = DIR_Hash(ename);
 		blobno = ntohs(dir->dirh_hashTable[i]);
 
@@ -67,7 +67,11 @@ struct PageHeader {
     int tag;
     char freecount;	/* duplicated info: also in allomap */
     char freebitmap[EPP/8];
-    char padding[32-(5+EPP/8)];
+    char padding[3];
+    /* Only used in the first page. Bumped by every create and delete, it
+       is only compared for equality so it is kept in host byte order. */
+    unsigned int generation;
+    char padding2[32-(8+EPP/8+4)];
 };
 
 /* A directory header object. */
@@ -96,7 +100,20 @@ void DIR_PrintChain(PDirHeader dir, int chain, FILE *f);
 int DIR_Hash (const char *string);
 int DIR_DirOK (PDirHeader pdh);
 int DIR_Convert (PDirHeader dir, char *file, VolumeId vol, RealmId realm);
+int DIR_ConvertAdd(PDirHeader dir, char *file, const char *entry,
+		   VolumeId vol, RealmId realm);
 void DIR_Setpages(PDirHeader, int);
+struct DirEntry *dir_GetBlob(struct DirHeader *dir, long blobno);
+
+/* dirindex.c */
+struct dirindex;
+struct dirindex *DIX_Get(PDirHeader dir, int build);
+int DIX_Lookup(struct dirindex *ix, const char *name);
+void DIX_Insert(struct dirindex *ix, PDirHeader dir, const char *name,
+		int blob);
+void DIX_Remove(struct dirindex *ix, const char *name, int blob);
+void DIX_Drop(PDirHeader dir);
+void DIX_PrintStats(FILE *fp);
 
 #endif /* _DIR_PRIVATE_H_ */
 
@@ -0,0 +1,276 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ * Transient name index for large directories.
+ *
+ * The directory format only has NHASH chains, so a lookup in a directory
+ * with thousands of entries walks chains of 50-60 entries, each one in a
+ * different blob. For directories of DIX_MINPAGES pages or more we keep an
+ * open addressing table from a full 32-bit name hash to the blob number of
+ * the entry in memory. The index never changes the directory itself, it is
+ * only a cache.
+ *
+ * Directories are modified outside of this package (fetched data copied
+ * in, RVM transactions aborted, memory freed and reused), so an index is
+ * only trusted when a snapshot of the generation counter in the directory
+ * header, the hash chain heads and the allocation map still matches the
+ * directory. DIR_Create and DIR_Delete bump the generation, update the
+ * index in place and take a new snapshot. The chain heads and allocation
+ * map catch contents copied in from a directory with the same generation.
+ *
+ * This only makes lookups cheaper, a directory still holds at most
+ * DIR_MAXPAGES pages, roughly 8000 entries with short names.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "coda_string.h"
+#include <netinet/in.h>
+#include "coda_assert.h"
+#include "codadir.h"
+#include "dirbody.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#define DIX_MINPAGES 8	/* smaller directories just walk the chains */
+#define DIX_NINDEX 8	/* number of directories with an index */
+
+struct dixslot {
+	unsigned int ds_hash;
+	short        ds_blob;	/* 0 is an empty slot, -1 a deleted one */
+};
+
+struct dirindex {
+	PDirHeader      dix_dir;
+	unsigned int    dix_generation;
+	unsigned long   dix_used;	/* for LRU replacement */
+	unsigned int    dix_mask;	/* number of slots - 1 */
+	unsigned int    dix_filled;	/* live and deleted slots */
+	struct dixslot *dix_slots;
+	short           dix_heads[NHASH];
+	char            dix_allomap[DIR_MAXPAGES];
+};
+
+static struct dirindex dix_tbl[DIX_NINDEX];
+static unsigned long dix_clock;
+
+static struct dixstats {
+	int builds;
+	int lookups;
+	int drops;
+} dix_stats;
+
+static unsigned int dix_Hash(const char *name)
+{
+	unsigned int h = 2166136261U;
+
+	while (*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void dix_Snapshot(struct dirindex *ix)
+{
+	ix->dix_generation = ix->dix_dir->dirh_ph.generation;
+	memcpy(ix->dix_heads, ix->dix_dir->dirh_hashTable, sizeof(ix->dix_heads));
+	memcpy(ix->dix_allomap, ix->dix_dir->dirh_allomap,
+	       sizeof(ix->dix_allomap));
+}
+
+static int dix_Valid(struct dirindex *ix, PDirHeader dir)
+{
+	return ix->dix_dir == dir &&
+	       ix->dix_generation == dir->dirh_ph.generation &&
+	       memcmp(ix->dix_heads, dir->dirh_hashTable,
+		      sizeof(ix->dix_heads)) == 0 &&
+	       memcmp(ix->dix_allomap, dir->dirh_allomap,
+		      sizeof(ix->dix_allomap)) == 0;
+}
+
+static void dix_Free(struct dirindex *ix)
+{
+	free(ix->dix_slots);
+	memset(ix, 0, sizeof(*ix));
+}
+
+static void dix_Add(struct dirindex *ix, unsigned int hash, int blob)
+{
+	unsigned int i = hash & ix->dix_mask;
+
+	while (ix->dix_slots[i].ds_blob > 0)
+		i = (i + 1) & ix->dix_mask;
+
+	if (ix->dix_slots[i].ds_blob == 0)
+		ix->dix_filled++;
+	ix->dix_slots[i].ds_hash = hash;
+	ix->dix_slots[i].ds_blob = blob;
+}
+
+static int dix_Build(struct dirindex *ix, PDirHeader dir)
+{
+	unsigned int nslots = 1;
+	int pages = DIR_Length(dir) / DIR_PAGESIZE;
+	int i, num;
+	struct DirEntry *ep;
+
+	/* Leave at least half of the slots empty when the directory is full. */
+	while (nslots < 2 * pages * EPP)
+		nslots <<= 1;
+
+	ix->dix_slots = (struct dixslot *)calloc(nslots, sizeof(struct dixslot));
+	if (!ix->dix_slots)
+		return 0;
+	ix->dix_mask = nslots - 1;
+	ix->dix_filled = 0;
+	ix->dix_dir = dir;
+
+	for (i = 0; i < NHASH; i++) {
+		num = ntohs(dir->dirh_hashTable[i]);
+		while (num != 0) {
+			ep = dir_GetBlob(dir, num);
+			if (!ep)
+				break;
+			dix_Add(ix, dix_Hash(ep->name), num);
+			num = ntohs(ep->next);
+		}
+	}
+	dix_Snapshot(ix);
+	dix_stats.builds++;
+	return 1;
+}
+
+/* Return a valid index for the directory. With build set an index is
+   created for large directories that don't have one yet. */
+struct dirindex *DIX_Get(PDirHeader dir, int build)
+{
+	struct dirindex *ix, *victim = &dix_tbl[0];
+	int i;
+
+	if (!dir)
+		return NULL;
+
+	for (i = 0; i < DIX_NINDEX; i++) {
+		ix = &dix_tbl[i];
+		if (ix->dix_dir != dir) {
+			if (ix->dix_used < victim->dix_used)
+				victim = ix;
+			continue;
+		}
+
+		if (dix_Valid(ix, dir)) {
+			ix->dix_used = ++dix_clock;
+			return ix;
+		}
+
+		/* stale, rebuild it in place */
+		dix_Free(ix);
+		dix_stats.drops++;
+		victim = ix;
+		break;
+	}
+
+	if (!build || dir->dirh_allomap[DIX_MINPAGES - 1] == EPP)
+		return NULL;
+
+	if (victim->dix_dir)
+		dix_Free(victim);
+	if (!dix_Build(victim, dir))
+		return NULL;
+	victim->dix_used = ++dix_clock;
+	return victim;
+}
+
+/* Find the first blob of the entry with this name, 0 if there is none. */
+int DIX_Lookup(struct dirindex *ix, const char *name)
+{
+	unsigned int hash = dix_Hash(name);
+	unsigned int i = hash & ix->dix_mask;
+	struct DirEntry *ep;
+
+	dix_stats.lookups++;
+	for (; ix->dix_slots[i].ds_blob != 0; i = (i + 1) & ix->dix_mask) {
+		if (ix->dix_slots[i].ds_blob < 0 || ix->dix_slots[i].ds_hash != hash)
+			continue;
+
+		ep = dir_GetBlob(ix->dix_dir, ix->dix_slots[i].ds_blob);
+		if (ep && strcmp(ep->name, name) == 0)
+			return ix->dix_slots[i].ds_blob;
+	}
+	return 0;
+}
+
+/* An entry was just added to the directory. */
+void DIX_Insert(struct dirindex *ix, PDirHeader dir, const char *name, int blob)
+{
+	/* the index was dropped when the directory had to grow */
+	if (ix->dix_dir != dir)
+		return;
+
+	/* Too many deleted slots, start over on the next lookup. */
+	if (2 * (ix->dix_filled + 1) > ix->dix_mask + 1) {
+		dix_Free(ix);
+		dix_stats.drops++;
+		return;
+	}
+	dix_Add(ix, dix_Hash(name), blob);
+	dix_Snapshot(ix);
+}
+
+void DIX_Remove(struct dirindex *ix, const char *name, int blob)
+{
+	unsigned int hash = dix_Hash(name);
+	unsigned int i = hash & ix->dix_mask;
+
+	for (; ix->dix_slots[i].ds_blob != 0; i = (i + 1) & ix->dix_mask)
+		if (ix->dix_slots[i].ds_blob == blob) {
+			ix->dix_slots[i].ds_blob = -1;
+			break;
+		}
+	dix_Snapshot(ix);
+}
+
+/* The directory is about to be freed or moved. */
+void DIX_Drop(PDirHeader dir)
+{
+	int i;
+
+	for (i = 0; i < DIX_NINDEX; i++)
+		if (dix_tbl[i].dix_dir == dir) {
+			dix_Free(&dix_tbl[i]);
+			dix_stats.drops++;
+		}
+}
+
+void DIX_PrintStats(FILE *fp)
+{
+	fprintf(fp, "Dirindex: builds %d, lookups %d, drops %d\n",
+		dix_stats.builds, dix_stats.lookups, dix_stats.drops);
+}
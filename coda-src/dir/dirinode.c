@@ -89,12 +89,15 @@ void DI_DhToDi(PDCEntry pdce)
 	rvmlib_set_range(pdi, sizeof(*pdi));
 	pdi->di_refcount = DC_Refcount(pdce);
 	
-	/* copy pages to the dir inode */
+	/* copy pages to the dir inode, most operations only touch the
+	   header and one other page so skip what hasn't changed */
 	for ( i=0 ; i<pages ; i++) {
 		if ( pdi->di_pages[i] == NULL ) {
 			pdi->di_pages[i] = rvmlib_rec_malloc(DIR_PAGESIZE);
 			CODA_ASSERT(pdi->di_pages[i]); 
-		}
+		} else if (memcmp(pdi->di_pages[i], DIR_Page(pdh->dh_data, i),
+				  DIR_PAGESIZE) == 0)
+			continue;
 		rvmlib_set_range(pdi->di_pages[i], DIR_PAGESIZE);
 		memcpy(pdi->di_pages[i],DIR_Page(pdh->dh_data,i), DIR_PAGESIZE);
 	}
@@ -17,6 +17,14 @@ listed in the file CREDITS.
 
 /* write various archive formats */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* for copy_file_range */
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdio.h>
@@ -26,6 +34,9 @@ listed in the file CREDITS.
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 #include <lwp/lwp.h>
 #include <coda_assert.h>
@@ -34,6 +45,7 @@ listed in the file CREDITS.
 int archive_type = CPIO_NEWC;
 
 #define BLOCKSIZE 512 /* both tar and cpio tend to use 512 byte blocks */
+#define COPYCHUNK (1024 * 1024) /* data copied between yields */
 
 union tarheaderblock {
     struct {
@@ -209,31 +221,62 @@ int archive_write_entry(FILE *fp, ino_t inode, mode_t mode, uid_t uid,
     return 0;
 }
 
-int archive_write_data(FILE *fp, const char *container)
+static ssize_t copy_chunk(int in, int out, off_t offset, size_t chunk)
 {
-    char buf[4096];
-    int in = open(container, O_RDONLY);
-    int loop = 0;
+    static char buf[64 * 1024];
     ssize_t n;
-    CODA_ASSERT(in != -1);
 
-    while (1) {
-	n = read(in, buf, sizeof(buf));
-	if (n == -1) return EIO;
+#ifdef HAVE_COPY_FILE_RANGE
+    /* lets the file system share or copy the blocks itself */
+    n = copy_file_range(in, NULL, out, &offset, chunk, 0);
+    if (n != -1 || (errno != EXDEV && errno != EINVAL && errno != ENOSYS &&
+		    errno != EOPNOTSUPP))
+	return n;
+#endif
+#ifdef HAVE_SENDFILE
+    if (lseek(out, offset, SEEK_SET) == -1)
+	return -1;
+    n = sendfile(out, in, NULL, chunk);
+    if (n != -1 || (errno != EINVAL && errno != ENOSYS))
+	return n;
+#endif
+    if (chunk > sizeof(buf)) chunk = sizeof(buf);
+    n = read(in, buf, chunk);
+    if (n > 0 && pwrite(out, buf, n, offset) != n)
+	return -1;
+    return n;
+}
 
-	if (n && fwrite(buf, n, 1, fp) != 1)
-	    return ENOSPC;
+/* Copy up to length bytes of the container to offset in the archive
+ * file, without going through stdio. Returns the number of bytes copied
+ * or -1. */
+ssize_t archive_copy_data(int out, off_t offset, const char *container,
+			  size_t length)
+{
+    size_t done = 0, chunk;
+    ssize_t n = 0;
+    int in = open(container, O_RDONLY);
+    if (in == -1) return -1;
 
-	if ((size_t)n < sizeof(buf)) break;
+    while (done < length) {
+	chunk = length - done;
+	if (chunk > COPYCHUNK) chunk = COPYCHUNK;
 
-	/* yield occasionally */
-	if (++loop % 32 == 0) {
-	    IOMGR_Poll();
-	    LWP_DispatchProcess();
-	}
+	n = copy_chunk(in, out, offset + done, chunk);
+	if (n <= 0) break;
+	done += n;
+
+	/* yield between chunks */
+	IOMGR_Poll();
+	LWP_DispatchProcess();
     }
     close(in);
+    return (n == -1) ? -1 : (ssize_t)done;
+}
 
+/* pad the data of the last entry */
+static int write_data_padding(FILE *fp)
+{
     switch (archive_type) {
     case TAR_TAR:
     case TAR_USTAR:
@@ -248,6 +291,34 @@ int archive_write_data(FILE *fp, const char *container)
     return 0;
 }
 
+int archive_write_data(FILE *fp, const char *container)
+{
+    off_t offset;
+    ssize_t n;
+
+    if (fflush(fp))
+	return ENOSPC;
+
+    offset = ftello(fp);
+    n = archive_copy_data(fileno(fp), offset, container, (size_t)-1);
+    if (n == -1) return errno == ENOSPC ? ENOSPC : EIO;
+
+    if (fseeko(fp, offset + n, SEEK_SET))
+	return EIO;
+
+    return write_data_padding(fp);
+}
+
+/* Leave room for the data of the last entry, it is filled in later with
+ * archive_copy_data. */
+int archive_skip_data(FILE *fp, size_t length)
+{
+    if (fseeko(fp, length, SEEK_CUR))
+	return EIO;
+
+    return write_data_padding(fp);
+}
+
 int archive_write_trailer(FILE *fp)
 {
     char zeros[1024];
@@ -32,6 +32,9 @@ int archive_write_entry(FILE *fp, ino_t inode, mode_t mode, uid_t uid,
 			nlink_t nlink, time_t mtime, size_t filesize,
 			const char *name, const char *linkname);
 int archive_write_data(FILE *fp, const char *container);
+int archive_skip_data(FILE *fp, size_t length);
+ssize_t archive_copy_data(int out, off_t offset, const char *container,
+			  size_t length);
 int archive_write_trailer(FILE *fp);
 
 #endif /* _ARCHIVE_H_ */
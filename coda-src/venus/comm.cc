@@ -88,6 +88,7 @@ int sftp_windowsize = UNSET_WS;
 int sftp_sendahead = UNSET_SA;
 int sftp_ackpoint = UNSET_AP;
 int sftp_packetsize = UNSET_PS;
+int sftp_adaptivewindow = 0;
 int rpc2_timeflag = UNSET_ST;
 int mrpc2_timeflag = UNSET_MT;
 
@@ -155,6 +156,7 @@ void CommInit() {
     sei.AckPoint = sftp_ackpoint;
     sei.PacketSize = sftp_packetsize;
     sei.EnforceQuota = 1;
+    sei.AdaptiveWindow = sftp_adaptivewindow;
     sei.Port.Tag = (PortTag)0;
     SFTP_Activate(&sei);
 
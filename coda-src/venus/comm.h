@@ -320,6 +320,7 @@ extern int sftp_windowsize;
 extern int sftp_sendahead;
 extern int sftp_ackpoint;
 extern int sftp_packetsize;
+extern int sftp_adaptivewindow;
 extern int rpc2_timeflag;
 extern int mrpc2_timeflag;
 
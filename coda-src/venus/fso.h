@@ -75,6 +75,9 @@ extern int global_kernfd;
 /* from venus */
 #include "binding.h"
 #include "comm.h"
+#include "fso_dedup.h"
+#include "fso_index.h"
+#include "fso_slru.h"
 #include "hdb.h"
 #include "mariner.h"
 #include "venusrecov.h"
@@ -103,6 +106,9 @@ const int UNSET_MWT = -1;
 const int DFLT_SSF = 4;
 const int UNSET_SSF = -1;
 
+/* Replacement policies. */
+enum FsoReplPolicy { FSO_REPL_PRIORITY, FSO_REPL_SLRU };
+
 const int CPSIZE = 8;
 
 /*  *****  Types  ***** */
@@ -152,12 +158,14 @@ class fsdb {
 
     /* The hash table. */
     rec_ohashtab htab;
+    /*T*/static fidindex *fidx;	/* transient index over htab, used by Find */
 
     /* The free list. */
     rec_olist freelist;
 
     /* The priority queue. */
     /*T*/bstree *prioq;
+    /*T*/static slru *lru;	/* unhoarded objects, FSO_REPL_SLRU only */
     long *LastRef;
     /*T*/long RefCounter;	     /* used to compute short-term priority */
 
@@ -211,6 +219,7 @@ class fsdb {
 
   public:
     fsobj *Find(const VenusFid *);
+    fsobj *FastGet(const VenusFid *);
     /* rcode arg added for local repair */
     int Get(fsobj **fso, VenusFid *fid, uid_t uid, int rights,
 	    const char *comp=NULL, VenusFid *parent=NULL, int *rcode=NULL,
@@ -287,6 +296,11 @@ class CacheFile {
     int  Copy(CacheFile *destination);
     int  Copy(char *destname, int recovering = 0);
 
+    /* Containers with the same contents can share disk blocks, see
+       fso_dedup.h. */
+    int  Share(CacheFile *source);
+    void Unshare(int keepdata = 1);
+
     void IncRef() { refcnt++; } /* creation already does an implicit incref */
     int  DecRef();             /* returns refcnt, unlinks if refcnt becomes 0 */
 
@@ -296,6 +310,14 @@ class CacheFile {
     void SetLength(long);
     void SetValidData(long);
 
+    /* Pieces of a partially fetched file beyond validdata are tracked in a
+       transient range map, they are refetched after a restart. */
+    void SetValidRange(long start, long len);
+    int  HaveRange(long start, long len);
+    long MissingRange(long start, long *len);
+    long ValidBytes();
+    int  SequentialRead(long start, long len);
+
     char *Name()         { return(name); }
     long Length()        { return(length); }
     long ValidData(void) { return(validdata); }
@@ -498,6 +520,7 @@ class fsobj {
     void SetRcRights(int);
     void ClearRcRights();
     int IsValid(int);
+    int FastValid();
     void SetAcRights(uid_t uid, long my_rights, long any_rights);
     void DemoteAcRights(uid_t);
     void PromoteAcRights(uid_t);
@@ -577,6 +600,7 @@ class fsobj {
     void dir_MakeDir();
     int dir_LookupByFid(char *, VenusFid *);
     void dir_Rebuild();
+    int dir_UdcfAdd(const char *);
     int dir_IsEmpty();
     int dir_IsParent(VenusFid *);
     void dir_Zap();
@@ -617,7 +641,8 @@ class fsobj {
 
   public:
     /* The public CFS interface (Vice portion). */
-    int Fetch(uid_t);
+    int Fetch(uid_t, long pos =0, long count =-1);
+    int FetchRange(uid_t, long pos, long count, int readahead =0);
     int GetAttr(uid_t, RPC2_BoundedBS * =0);
     int GetACL(RPC2_BoundedBS *, uid_t);
     int Store(unsigned long, Date_t, uid_t);
@@ -639,6 +664,8 @@ class fsobj {
     int Close(int writep, uid_t uid);
     int Access(int rights, int modes, uid_t);
     int Lookup(fsobj **, VenusFid *, const char *, uid_t, int flags, int GetInconsistent=0);
+    int FastAccess(int rights, int modes, uid_t);
+    int FastLookup(venus_cnode *cp, const char *, uid_t, int flags);
 // These are defined in coda-src/kerndep/coda.h
 // #define CLU_CASE_SENSITIVE	0x01
 // #define CLU_CASE_INSENSITIVE 0x02
@@ -728,6 +755,23 @@ extern int CacheFiles;
 extern int FSO_SWT;
 extern int FSO_MWT;
 extern int FSO_SSF;
+extern int FSO_ReplPolicy;
+extern int FSO_PartialFetchKB;
+
+/* Large files are fetched on demand in pieces of this size. */
+#define FSO_FETCHCHUNK (256 * 1024)
+
+/* Statistics for on-demand fetching of large files. */
+struct RangeStats {
+    unsigned long opens;	/* opens served before all data was present */
+    unsigned long requests;	/* read/mmap intents on partially cached files */
+    unsigned long hits;		/* ... which found their data in the cache */
+    unsigned long fetches;	/* range fetches from the servers */
+    unsigned long bytes;	/* ... and the bytes they transferred */
+    unsigned long readaheads;	/* background read-ahead fetches */
+    unsigned long rabytes;	/* ... and the bytes they transferred */
+};
+extern struct RangeStats FSO_RangeStats;
 
 
 /*  *****  Functions/Procedures  *****  */
@@ -738,10 +782,12 @@ extern int FSO_PriorityFN(bsnode *, bsnode *);
 extern void UpdateCacheStats(CacheStats *c, enum CacheEvent event, unsigned long blocks);
 extern void PrintCacheStats(const char* description, CacheStats *, int);
 extern void VenusToViceStatus(VenusStat *, ViceStatus *);
+extern void UdcfPrint(int);
 
 /* fso_daemon.c */
 void FSOD_Init(void);
 void FSOD_ReclaimFSOs(void);
+void FSOD_ReadAhead(VenusFid *, uid_t, long pos, long count);
 
 /* More locking macros. */
 #define	FSO_HOLD(f)	    { (f)->refcnt++; }
@@ -770,8 +816,11 @@ void FSOD_ReclaimFSOs(void);
 #define	HOARDABLE(f)	((f)->HoardPri > 0)
 #define	FETCHABLE(f)	(!DYING(f) && REACHABLE(f) && !DIRTY(f) && \
 			 (!HAVESTATUS(f) || !ACTIVE(f)) && !f->IsLocalObj())
-/* we are replaceable whenever we are linked into FSDB->prioq */
-#define	REPLACEABLE(f)	((f)->prio_handle.tree() != 0)
+/* we are replaceable whenever we are linked into FSDB->prioq or the SLRU */
+#define	REPLACEABLE(f)	((f)->prio_handle.tree() != 0 || \
+			 FSDB->lru->Member((f)->ix))
+/* unhoarded objects are managed by the SLRU when that policy is active */
+#define	SLRU_MANAGED(f)	(FSO_ReplPolicy == FSO_REPL_SLRU && !HOARDABLE(f))
 #define	GCABLE(f)	(DYING(f) && !DIRTY(f) && !BUSY(f))
 #define	FLUSHABLE(f)	((DYING(f) || REPLACEABLE(f)) && \
                          !DIRTY(f) && !BUSY(f))
@@ -67,6 +67,13 @@ int CacheFiles = 0;
 int FSO_SWT = UNSET_SWT;
 int FSO_MWT = UNSET_MWT;
 int FSO_SSF = UNSET_SSF;
+int FSO_ReplPolicy = FSO_REPL_PRIORITY;
+int FSO_PartialFetchKB = 0;
+struct RangeStats FSO_RangeStats;
+
+/* static class members */
+fidindex *fsdb::fidx;
+slru *fsdb::lru;
 
 
 /* Call with CacheDir the current directory. */
@@ -227,6 +234,20 @@ void FSOInit() {
 			   (!DIRTY(f) && f->mle_bindings == 0));
 	    }
 	}
+
+	/* Rebuild the content index, this also finds the containers that
+	 * were hard linked before we went down. */
+	{
+	    fso_iterator next(NL);
+	    fsobj *f;
+	    while ((f = next()))
+		if (f->IsFile() && HAVEALLDATA(f) && !DIRTY(f) &&
+		    !f->IsLocalObj() && !f->IsFake())
+		    Dedup->Add(f->VenusSHA, &f->cf);
+
+	    eprint("\t%d cache files with known contents (%ld blocks shared)",
+		   Dedup->count(), Dedup->SavedBlocks());
+	}
     }
 
     /* Set new Data version stamps. */
@@ -357,7 +378,19 @@ void fsdb::ResetTransient() {
     blocks = 0;		    /* this will get updated in fsobj::Recover() */
 
     htab.SetHFn(FSO_HashFN);
+
+    /* Rebuild the fid index from the recoverable hash table. */
+    fidx = new fidindex(MaxFiles);
+    {
+	rec_ohashtab_iterator next(htab);
+	rec_olink *o;
+	while ((o = next()))
+	    fidx->Insert(&(strbase(fsobj, o, primary_handle))->fid);
+    }
+
     prioq = new bstree(FSO_PriorityFN);
+    lru = new slru(MaxFiles);
+    Dedup = new dedupstore(MaxFiles);
     RefCounter = 0;
     for (int i = 0; i < MaxFiles; i++)
 	if (LastRef[i] > RefCounter)
@@ -389,12 +422,12 @@ void fsdb::operator delete(void *){
 fsobj *fsdb::Find(const VenusFid *key)
 {
     VenusFid OldFid;
-
-    fso_iterator next(NL, key);
+    const VenusFid *found;
     fsobj *f;
-    while ((f = next()))
-	if (FID_EQ(key, &f->fid))
-	    return f;
+
+    found = fidx->Find(key);
+    if (found)
+	return strbase(fsobj, found, fid);
 
     /* If we were looking for a local fid, do a full search because we may have
      * translated it while the upcall was in transit. */
@@ -419,6 +452,28 @@ fsobj *fsdb::Find(const VenusFid *key)
 }
 
 
+/* Used by the upcall fast path, which runs on the mux thread. Returns the
+ * object only when its cached status can be handed out without locking it
+ * or entering its volume, the caller must not yield while using it. */
+fsobj *fsdb::FastGet(const VenusFid *key)
+{
+    const VenusFid *found = fidx->Find(key);
+    fsobj *f;
+
+    if (!found)
+	return 0;
+
+    f = strbase(fsobj, found, fid);
+    if (!f->FastValid())
+	return 0;
+
+    /* Same bookkeeping as fsdb::Get for a REFERENCE access. */
+    f->Reference();
+    f->ComputePriority();
+    return f;
+}
+
+
 /* MUST NOT be called from within transaction! */
 /* Caller MUST guarantee that the volume is cached and stable! */
 /* Should priority be an implicit argument? -JJK */
@@ -817,8 +872,14 @@ RestartFind:
 		if (!HAVEALLDATA(f)) {
 		    int found = 0;
 
+		    /* a partially fetched file that is open for reading can
+		     * still be completed */
+		    if (HAVEDATA(f) && f->IsFile() && !f->IsLocalObj() &&
+			!f->IsFake() && REACHABLE(f) && !DIRTY(f))
+			found = (f->FetchRange(uid, 0, -1) == 0);
+
 		    /* try the lookaside cache */
-		    if (!f->IsLocalObj() && !f->IsFake()) {
+		    if (!found && !f->IsLocalObj() && !f->IsFake()) {
 			f->PromoteLock();
 			found = f->LookAside();
 			f->DemoteLock();
@@ -1076,6 +1137,7 @@ int fsdb::TranslateFid(VenusFid *OldFid, VenusFid *NewFid)
 		f->print(logFile);
 		CHOKE("fsdb::TranslateFid: old object remove");
 	}
+	fidx->Remove(&f->fid);
 
 	/* An upcall may already be queued with the old local fid. Or we may
 	 * already be reintegrating before the local fid has been passed back
@@ -1100,6 +1162,7 @@ int fsdb::TranslateFid(VenusFid *OldFid, VenusFid *NewFid)
 
 	/* replace f in the hash table */
 	htab.append(&f->fid, &f->primary_handle);
+	fidx->Insert(&f->fid);
 
 	/* Update the Parent. */
 	pFid = f->pfid;
@@ -1245,6 +1308,32 @@ void fsdb::ReclaimFsos(int priority, int count) {
     bstree_iterator next(*prioq);
     bsnode *b, *bnext;
 
+    /* Unhoarded objects on the SLRU lists are less valuable than anything
+     * on the priority queue, go through them first. Their priority isn't
+     * recomputed while they are on the lists, so don't compare it. */
+    slru_iterator lnext(lru);
+    fsobj *f;
+    while (reclaimed < count && (f = lnext())) {
+	if (BUSY(f)) continue;
+
+	MarinerLog("cache::Replace [%s] %s [%d, %d]\n",
+		   (HAVEDATA(f) ? "status/data" : "status"),
+		   f->GetComp(), f->priority, NBLOCKS(f->cf.Length()));
+	UpdateCacheStats((f->IsDir() ? &DirAttrStats : &FileAttrStats),
+			 REPLACE, NBLOCKS(sizeof(fsobj)));
+	if (HAVEDATA(f))
+	    UpdateCacheStats((f->IsDir() ? &DirDataStats : &FileDataStats),
+			     REPLACE, BLOCKS(f));
+
+	f->Kill();
+	f->GC();
+
+	lru->evictions++;
+	reclaimed++;
+    }
+    if (reclaimed == count)
+	return;
+
     bnext = next();
     while ((b = bnext) != NULL) {
 	bnext = next();
@@ -1288,6 +1377,10 @@ void fsdb::FreeFso(fsobj *f) {
 int fsdb::FreeBlockCount() {
     int count = MaxBlocks - blocks;
 
+    /* Blocks shared between containers are only counted once. */
+    if (Dedup)
+	count += (int)Dedup->SavedBlocks();
+
     /* Subtract out blocks belonging to objects currently open for write. */
     if (owriteq->count() > 0) {
 	olist_iterator onext(*owriteq);
@@ -1373,6 +1466,30 @@ int fsdb::GrabFreeBlocks(int priority, int nblocks) {
 /* MUST be called from within transaction! */
 void fsdb::ReclaimBlocks(int priority, int nblocks) {
     int reclaimed = 0;
+
+    /* Start with the unhoarded objects on the SLRU lists, their priority
+     * is stale but they are always worth less than hoarded objects. */
+    slru_iterator lnext(lru);
+    fsobj *f;
+    while (reclaimed < nblocks && (f = lnext())) {
+	int ufs_blocks = NBLOCKS(f->cf.Length());
+	if (ufs_blocks == 0) continue;
+
+	if (BUSY(f) || f->IsLocalObj()) continue;
+
+	MarinerLog("cache::Replace [data] %s [%d, %d]\n",
+		   f->GetComp(), f->priority, ufs_blocks);
+	UpdateCacheStats((f->IsDir() ? &DirDataStats : &FileDataStats),
+			 REPLACE, BLOCKS(f));
+
+	f->DiscardData();
+
+	lru->evictions++;
+	reclaimed += ufs_blocks;
+    }
+    if (reclaimed >= nblocks)
+	return;
+
     bstree_iterator next(*prioq);
     bsnode *b;
     while ((b = next())) {
@@ -1447,6 +1564,15 @@ void fsdb::print(int fd, int SummaryOnly) {
 	     MaxFiles, htab.count(), FreeFileMargin, MaxBlocks, blocks, FreeBlockMargin);
     fdprint(fd, "Counts: fl = %d, prioq = %d, delq = %d, owq = %d\n",
 	     freelist.count(), prioq->count(), delq->count(), owriteq->count());
+    {
+	unsigned long lookups, probes;
+	unsigned int grows;
+	fidx->GetStats(&lookups, &probes, &grows);
+	fdprint(fd, "Index: entries = %u, slots = %u, lookups = %lu, probes = %lu, grows = %u\n",
+		fidx->count(), fidx->size(), lookups, probes, grows);
+    }
+    Dedup->print(fd);
+    UdcfPrint(fd);
 #ifdef	VENUSDEBUG
     {
 	int normal_blocks = 0;
@@ -1494,6 +1620,15 @@ void fsdb::print(int fd, int SummaryOnly) {
     fdprint(fd, "VolumeLevelMisses = %d\n", VolumeLevelMiss);
     fdprint(fd, "recomputes = %d, reorders = %d, matr count = %d\n",
 	     Recomputes, Reorders, matriculation_count);
+    fdprint(fd, "Replacement policy = %s\n",
+	     FSO_ReplPolicy == FSO_REPL_SLRU ? "slru" : "priority");
+    lru->print(fd);
+    fdprint(fd, "Partial fetch: threshold = %d KB, opens = %lu, requests = %lu, hits = %lu\n",
+	    FSO_PartialFetchKB, FSO_RangeStats.opens, FSO_RangeStats.requests,
+	    FSO_RangeStats.hits);
+    fdprint(fd, "\tfetches = %lu (%lu bytes), readaheads = %lu (%lu bytes)\n",
+	    FSO_RangeStats.fetches, FSO_RangeStats.bytes,
+	    FSO_RangeStats.readaheads, FSO_RangeStats.rabytes);
 
     if (!SummaryOnly) {
 	fso_iterator next(NL);
@@ -141,6 +141,7 @@ fsobj::fsobj(VenusFid *key, const char *name) : cf()
 
     /* Insert into hash table. */
     (FSDB->htab).append(&fid, &primary_handle);
+    FSDB->fidx->Insert(&fid);
 }
 
 /* local-repair modification */
@@ -362,6 +363,7 @@ fsobj::~fsobj() {
     /* Remove from the table. */
     if ((FSDB->htab).remove(&fid, &primary_handle) != &primary_handle)
 	{ print(logFile); CHOKE("fsobj::~fsobj: htab remove"); }
+    FSDB->fidx->Remove(&fid);
 
     /* Notify waiters of dead runts. */
     if (!HAVESTATUS(this)) {
@@ -799,6 +801,12 @@ void fsobj::ReplaceStatus(ViceStatus *vstat, vv_t *UpdateSet)
 	SetRcRights(RC_STATUS);
     }
 
+    /* The SHA we have describes the old data */
+    if (stat.DataVersion != vstat->DataVersion) {
+	RVMLIB_REC_OBJECT(VenusSHA);
+	memset(VenusSHA, 0, SHA_DIGEST_LENGTH);
+    }
+
     stat.Length = vstat->Length;
     stat.DataVersion = vstat->DataVersion;
 
@@ -886,6 +894,32 @@ int fsobj::IsValid(int rcrights) {
 }
 
 
+/* Can fsdb::Get hand out this object without fetching anything, and can
+ * the volume be entered without waiting? Only then may the upcall fast path
+ * answer from the cached status. Objects that are fake or in conflict
+ * always take the slow path. */
+int fsobj::FastValid()
+{
+    if (!HAVESTATUS(this) || DYING(this) || IsFake() ||
+	IsLocalObj() || IsToBeRepaired() || IsMTLink())
+	return 0;
+
+    /* A worker holding the object locked may have yielded in the middle of
+     * a mutation or revalidation, the cached status and directory contents
+     * can already be out of date. fsdb::Get would wait for it, so do not
+     * answer for it. */
+    if (writers > 0 || readers > 0)
+	return 0;
+
+    /* See volent::Enter for the VM_OBSERVING case. */
+    if (vol->flags.transition_pending || vol->flags.demotion_pending ||
+	vol->excl_count > 0 || vol->IsResolving() || vol->IsLocalRealm())
+	return 0;
+
+    return STATUSVALID(this);
+}
+
+
 /* Returns {0, EACCES, ENOENT}. */
 int fsobj::CheckAcRights(uid_t uid, long rights, int connected)
 {
@@ -1420,6 +1454,7 @@ void fsobj::Reference() {
 	       FID_(&fid), FSDB->LastRef[ix], FSDB->RefCounter));
 
     FSDB->LastRef[ix] = FSDB->RefCounter++;
+    FSDB->lru->Reference(ix);
 }
 
 /* local-repair modification */
@@ -1476,7 +1511,15 @@ void fsobj::ComputePriority(int Force) {
      * the priority queue and requeueing them the random seed is perturbed
      * to avoid cache pollution by unreferenced low priority objects which
      * happen to have a high random seed */
-    if (Force || priority == -1 || new_priority != priority) {
+    /* Objects on the SLRU lists are ordered by recency alone, their
+     * priority only matters once they move to the priority queue. */
+    int onlru = FSDB->lru->Member(ix);
+    if (onlru && SLRU_MANAGED(this)) {
+	priority = new_priority;
+	return;
+    }
+
+    if (Force || priority == -1 || new_priority != priority || onlru) {
 	FSDB->Reorders++;		    /* transient value; punt set_range */
 
 	DisableReplacement();		/* remove... */
@@ -1517,6 +1560,11 @@ void fsobj::EnableReplacement() {
     LOG(1000,("fsobj::EnableReplacement: (%s), priority = [%d (%d) %d %d]\n",
 	      FID_(&fid), priority, flags.random, HoardPri, FSDB->LastRef[ix]));
 
+    if (SLRU_MANAGED(this)) {
+	FSDB->lru->Insert(ix, this);
+	return;
+    }
+
 #ifdef	VENUSDEBUG
     if (LogLevel >= 10000)
 	FSDB->prioq->print(logFile);
@@ -1551,6 +1599,11 @@ void fsobj::DisableReplacement() {
     LOG(1000,("fsobj::DisableReplacement: (%s), priority = [%d (%d) %d %d]\n",
 	      FID_(&fid), priority, flags.random, HoardPri, FSDB->LastRef[ix]));
 
+    if (FSDB->lru->Member(ix)) {
+	FSDB->lru->Remove(ix);
+	return;
+    }
+
 #ifdef	VENUSDEBUG
     if (LogLevel >= 10000)
 	FSDB->prioq->print(logFile);
@@ -24,6 +24,10 @@ listed in the file CREDITS.
 extern "C" {
 #endif
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <sys/types.h>
 #include <sys/file.h>
 #include <sys/stat.h>
@@ -33,6 +37,11 @@ extern "C" {
 #include <unistd.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
 
 #ifdef __cplusplus
 }
@@ -54,6 +63,103 @@ extern "C" {
 /* always useful to have a page of zero's ready */
 static char zeropage[4096];
 
+/* Pieces of partially fetched files that lie beyond the contiguous prefix
+ * recorded in validdata. This is transient state, kept outside of the
+ * recoverable CacheFile so that its layout does not change. After a restart
+ * only the prefix is trusted and anything beyond it is fetched again. */
+#define CFRANGE_BUCKETS 64
+
+struct cfrange {
+    long start, end;
+};
+
+struct cfranges {
+    struct cfranges *next;
+    CacheFile *cf;
+    struct cfrange *r;		/* sorted, disjoint and non-adjacent */
+    int nranges;
+    int maxranges;
+    long nextread;		/* where the last read ended */
+};
+
+static struct cfranges *rangemap[CFRANGE_BUCKETS];
+
+static struct cfranges **RangeSlot(CacheFile *cf)
+{
+    unsigned long h = (unsigned long)cf;
+    h = (h >> 4) * 2654435761UL;
+    return &rangemap[(h >> 8) % CFRANGE_BUCKETS];
+}
+
+static struct cfranges *GetRanges(CacheFile *cf, int create)
+{
+    struct cfranges **pp = RangeSlot(cf), *e;
+
+    for (e = *pp; e; e = e->next)
+	if (e->cf == cf)
+	    return e;
+
+    if (!create)
+	return NULL;
+
+    e = (struct cfranges *)calloc(1, sizeof(struct cfranges));
+    CODA_ASSERT(e);
+    e->cf = cf;
+    e->nextread = -1;
+    e->next = *pp;
+    *pp = e;
+    return e;
+}
+
+static void DropRanges(CacheFile *cf)
+{
+    struct cfranges **pp, *e;
+
+    for (pp = RangeSlot(cf); (e = *pp) != NULL; pp = &e->next) {
+	if (e->cf != cf) continue;
+	*pp = e->next;
+	free(e->r);
+	free(e);
+	return;
+    }
+}
+
+/* Add [start, end) to the map, merging with overlapping or adjacent ranges */
+static void AddRange(struct cfranges *e, long start, long end)
+{
+    int i, j;
+
+    /* skip ranges that end before the new one starts */
+    for (i = 0; i < e->nranges && e->r[i].end < start; i++)
+	;
+
+    /* merge with all ranges that overlap or touch */
+    for (j = i; j < e->nranges && e->r[j].start <= end; j++) {
+	if (e->r[j].start < start) start = e->r[j].start;
+	if (e->r[j].end > end) end = e->r[j].end;
+    }
+
+    if (j == i) {
+	/* nothing merged, make room for a new entry */
+	if (e->nranges == e->maxranges) {
+	    e->maxranges = e->maxranges ? 2 * e->maxranges : 8;
+	    e->r = (struct cfrange *)
+		realloc(e->r, e->maxranges * sizeof(struct cfrange));
+	    CODA_ASSERT(e->r);
+	}
+	memmove(&e->r[i + 1], &e->r[i],
+		(e->nranges - i) * sizeof(struct cfrange));
+	e->nranges++;
+    } else if (j > i + 1) {
+	/* ranges i..j-1 collapse into entry i */
+	memmove(&e->r[i + 1], &e->r[j],
+		(e->nranges - j) * sizeof(struct cfrange));
+	e->nranges -= j - i - 1;
+    }
+    e->r[i].start = start;
+    e->r[i].end = end;
+}
+
 /*  *****  CacheFile Members  *****  */
 
 /* Pre-allocation routine. */
@@ -140,6 +246,10 @@ void CacheFile::Create(int newlength)
 
     int tfd;
     struct stat tstat;
+
+    /* don't truncate the blocks of a container we share them with */
+    Unshare(0);
+
     if (mkpath(name, V_MODE | 0100)<0)
 	CHOKE("CacheFile::Create: could not make path for %s", name);
     if ((tfd = ::open(name, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, V_MODE)) < 0)
@@ -157,6 +267,7 @@ void CacheFile::Create(int newlength)
     if (::close(tfd) < 0)
 	CHOKE("CacheFile::ResetContainer: close failed (%d)", errno);
 
+    DropRanges(this);
     validdata = 0;
     length = newlength;
     refcnt = 1;
@@ -169,10 +280,17 @@ void CacheFile::Create(int newlength)
  */
 int CacheFile::Copy(CacheFile *destination)
 {
+    destination->Unshare(0);
     Copy(destination->name);
 
     destination->length = length;
     destination->validdata = validdata;
+
+    DropRanges(destination);
+    struct cfranges *e = GetRanges(this, 0);
+    if (e)
+	for (int i = 0; i < e->nranges; i++)
+	    AddRange(GetRanges(destination, 1), e->r[i].start, e->r[i].end);
     return 0;
 }
 
@@ -221,10 +339,118 @@ int CacheFile::Copy(char *destname, int recovering)
 }
 
 
+/*
+ * Replace the container with one that shares the disk blocks of source,
+ * which has the same contents. Returns 1 when the blocks are shared with a
+ * reflink, 0 for a hard link and -1 when neither worked.
+ * MUST be called from within transaction!
+ */
+int CacheFile::Share(CacheFile *source)
+{
+    char tmpname[CACHEFILENAMELEN + 4];
+    int reflinked = 0;
+
+    if (numopens || refcnt != 1)
+	return -1;
+
+    if (mkpath(name, V_MODE | 0100) < 0)
+	return -1;
+    snprintf(tmpname, sizeof(tmpname), "%s.dd", name);
+    ::unlink(tmpname);
+
+#ifdef FICLONE
+    {
+	int sfd = ::open(source->name, O_RDONLY | O_BINARY);
+	int tfd = ::open(tmpname, O_WRONLY | O_CREAT | O_EXCL | O_BINARY,
+			 V_MODE);
+
+	if (sfd >= 0 && tfd >= 0 && ::ioctl(tfd, FICLONE, sfd) == 0) {
+	    ::fchown(tfd, (uid_t)V_UID, (gid_t)V_GID);
+	    reflinked = 1;
+	}
+	if (sfd >= 0) ::close(sfd);
+	if (tfd >= 0) ::close(tfd);
+	if (!reflinked)
+	    ::unlink(tmpname);
+    }
+#endif
+
+    if (!reflinked && ::link(source->name, tmpname) < 0) {
+	LOG(0, ("CacheFile::Share: link %s to %s failed (%d)\n",
+		source->name, name, errno));
+	return -1;
+    }
+
+    if (::rename(tmpname, name) < 0) {
+	LOG(0, ("CacheFile::Share: rename to %s failed (%d)\n", name, errno));
+	::unlink(tmpname);
+	return -1;
+    }
+    /* rename does nothing when both already are links to the same file */
+    ::unlink(tmpname);
+
+    RVMLIB_REC_OBJECT(*this);
+    length = validdata = source->length;
+    DropRanges(this);
+
+    LOG(10, ("CacheFile::Share: %s %s %s\n",
+	     name, reflinked ? "reflinked to" : "linked to", source->name));
+    return reflinked;
+}
+
+
+/*
+ * Called before the contents of the container change. A hard linked
+ * container gets its own copy of the data first (or an empty file when the
+ * data is about to be thrown away), the other links keep the old contents.
+ */
+void CacheFile::Unshare(int keepdata)
+{
+    char tmpname[CACHEFILENAMELEN + 4];
+    struct stat tstat;
+    int tfd, ffd;
+
+    if (Dedup) Dedup->Remove(this);
+
+    if (::stat(name, &tstat) < 0 || tstat.st_nlink <= 1)
+	return;
+
+    LOG(10, ("CacheFile::Unshare: %s, %d links\n", name, tstat.st_nlink));
+
+    snprintf(tmpname, sizeof(tmpname), "%s.dd", name);
+    tfd = ::open(tmpname, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, V_MODE);
+    if (tfd < 0)
+	CHOKE("CacheFile::Unshare: open failed (%d)", errno);
+    ::fchmod(tfd, V_MODE);
+#ifdef __CYGWIN32__
+    ::chown(tmpname, (uid_t)V_UID, (gid_t)V_GID);
+#else
+    ::fchown(tfd, (uid_t)V_UID, (gid_t)V_GID);
+#endif
+
+    if (keepdata) {
+	if ((ffd = ::open(name, O_RDONLY | O_BINARY)) < 0)
+	    CHOKE("CacheFile::Unshare: source open failed (%d)", errno);
+	if (copyfile(ffd, tfd) < 0)
+	    CHOKE("CacheFile::Unshare: copy failed (%d)", errno);
+	::close(ffd);
+    }
+    if (::close(tfd) < 0)
+	CHOKE("CacheFile::Unshare: close failed (%d)", errno);
+
+    if (::rename(tmpname, name) < 0)
+	CHOKE("CacheFile::Unshare: rename failed (%d)", errno);
+
+    if (Dedup) Dedup->unshares++;
+}
+
+
 int CacheFile::DecRef()
 {
     if (--refcnt == 0)
     {
+	if (Dedup) Dedup->Remove(this);
+	DropRanges(this);
 	length = validdata = 0;
 	if (::unlink(name) < 0)
 	    CHOKE("CacheFile::DecRef: unlink failed (%d)", errno);
@@ -251,6 +477,8 @@ void CacheFile::Truncate(long newlen)
 {
     int fd;
 
+    Unshare(newlen != 0);
+
     fd = open(name, O_WRONLY | O_BINARY);
     CODA_ASSERT(fd >= 0 && "fatal error opening container file");
 
@@ -273,6 +501,7 @@ void CacheFile::Truncate(long newlen)
     if (length != newlen) {
 	RVMLIB_REC_OBJECT(*this);
 	length = validdata = newlen;
+	DropRanges(this);
     }
 
     CODA_ASSERT(::ftruncate(fd, length) == 0);
@@ -285,9 +514,12 @@ void CacheFile::SetLength(long newlen)
 {
     LOG(0, ("Cachefile::SetLength %d\n", newlen));
 
+    if (Dedup) Dedup->Remove(this);
+
     if (length != newlen) {
 	RVMLIB_REC_OBJECT(*this);
 	length = validdata = newlen;
+	DropRanges(this);
     }
 }
 
@@ -302,13 +534,139 @@ void CacheFile::SetValidData(long newoffset)
     }
 }
 
+/* MUST be called from within transaction! */
+void CacheFile::SetValidRange(long start, long len)
+{
+    struct cfranges *e;
+    long newvalid = validdata;
+
+    LOG(10, ("Cachefile::SetValidRange %s, %ld+%ld\n", name, start, len));
+
+    if (len <= 0)
+	return;
+
+    if (start <= newvalid) {
+	if (start + len > newvalid)
+	    newvalid = start + len;
+	e = GetRanges(this, 0);
+    } else {
+	e = GetRanges(this, 1);
+	AddRange(e, start, start + len);
+    }
+
+    /* pull ranges that now touch the prefix into it */
+    if (e) {
+	int i;
+	for (i = 0; i < e->nranges && e->r[i].start <= newvalid; i++)
+	    if (e->r[i].end > newvalid)
+		newvalid = e->r[i].end;
+	memmove(&e->r[0], &e->r[i], (e->nranges - i) * sizeof(struct cfrange));
+	e->nranges -= i;
+    }
+
+    if (newvalid > length)
+	newvalid = length;
+
+    if (validdata != newvalid) {
+	RVMLIB_REC_OBJECT(validdata);
+	validdata = newvalid;
+    }
+
+    if (validdata == length)
+	DropRanges(this);
+}
+
+/* Do we have all data in [start, start+len)? */
+int CacheFile::HaveRange(long start, long len)
+{
+    long end = start + len;
+    struct cfranges *e;
+
+    if (end > length) end = length;
+    if (end <= validdata || start >= end) return 1;
+    if (start < validdata) return 0;
+
+    e = GetRanges(this, 0);
+    if (!e) return 0;
+
+    for (int i = 0; i < e->nranges && e->r[i].start <= start; i++)
+	if (e->r[i].end >= end)
+	    return 1;
+    return 0;
+}
+
+/* Find the first hole in [start, start+*len). Returns the offset of the
+ * hole and its size in *len, or -1 if there is nothing missing */
+long CacheFile::MissingRange(long start, long *len)
+{
+    long end = start + *len;
+    struct cfranges *e;
+
+    if (end > length) end = length;
+    if (start < validdata) start = validdata;
+    if (start >= end) return -1;
+
+    e = GetRanges(this, 0);
+    if (e) {
+	for (int i = 0; i < e->nranges && e->r[i].start < end; i++) {
+	    if (e->r[i].end <= start)
+		continue;
+	    if (e->r[i].start > start) {
+		end = e->r[i].start;
+		break;
+	    }
+	    /* start is inside this range, move past it */
+	    start = e->r[i].end;
+	    if (start >= end) return -1;
+	}
+    }
+
+    *len = end - start;
+    return start;
+}
+
+long CacheFile::ValidBytes()
+{
+    struct cfranges *e = GetRanges(this, 0);
+    long bytes = validdata;
+
+    if (e)
+	for (int i = 0; i < e->nranges; i++)
+	    bytes += e->r[i].end - e->r[i].start;
+    return bytes;
+}
+
+/* Remember where a read ended, and whether it continued the previous one */
+int CacheFile::SequentialRead(long start, long len)
+{
+    struct cfranges *e;
+    int sequential;
+
+    if (!IsPartial())
+	return 0;
+
+    e = GetRanges(this, 1);
+    sequential = (start == 0 || start == e->nextread);
+    e->nextread = start + len;
+    return sequential;
+}
+
 void CacheFile::print(int fdes)
 {
-    fdprint(fdes, "[ %s, %d/%d ]\n", name, validdata, length);
+    struct cfranges *e = GetRanges(this, 0);
+
+    fdprint(fdes, "[ %s, %d/%d", name, validdata, length);
+    if (e)
+	for (int i = 0; i < e->nranges; i++)
+	    fdprint(fdes, " %ld-%ld", e->r[i].start, e->r[i].end);
+    fdprint(fdes, " ]\n");
 }
 
 int CacheFile::Open(int flags)
 {
+    if (flags & (O_WRONLY | O_RDWR))
+	Unshare(!(flags & O_TRUNC));
+
     int fd = ::open(name, flags | O_BINARY, V_MODE);
 
     CODA_ASSERT (fd != -1);
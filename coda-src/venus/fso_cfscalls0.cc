@@ -137,6 +137,34 @@ int fsobj::LookAside(void)
        SHA value is obtained initially from fsobj and used for lookaside.
      */
 
+    /* Another container in our cache may already have this content. */
+    CacheFile *source = CacheDedup ? Dedup->Find(VenusSHA, stat.Length) : NULL;
+    if (source && source != &cf) {
+	int shared;
+
+	Recov_BeginTrans();
+	shared = cf.Share(source);
+	if (shared >= 0) {
+	    RVMLIB_REC_OBJECT(data.file);
+	    data.file = &cf;
+	}
+	Recov_EndTrans(CMFP);
+
+	if (shared >= 0) {
+	    Dedup->Add(VenusSHA, &cf, source);
+	    if (shared) Dedup->reflinks++;
+	    else	Dedup->hardlinks++;
+	    Dedup->bytes += stat.Length;
+
+	    LOG(10, ("fsobj::LookAside: (%s) shares data with %s\n",
+		     FID_(&fid), source->Name()));
+
+	    if (cbtemp == cbbreaks)
+		SetRcRights(RC_DATA | RC_STATUS);
+	    return 1;
+	}
+    }
+
     Recov_BeginTrans();
     RVMLIB_REC_OBJECT(flags);
     flags.fetching = 1;
@@ -170,6 +198,9 @@ int fsobj::LookAside(void)
 	cf.SetValidData(cf.Length()); 
     Recov_EndTrans(CMFP);
 
+    if (lka_successful)
+	Dedup->Add(VenusSHA, &cf);
+
     /* If we received any callbacks during the lookaside, the validity of the
      * found data is suspect and we shouldn't set the status to valid */
     if (lka_successful && cbtemp == cbbreaks)
@@ -180,11 +211,17 @@ int fsobj::LookAside(void)
 }
 
 
-int fsobj::Fetch(uid_t uid)
+/* Fetch the object's data. For plain files a count other than -1 only
+ * fetches that many bytes starting at pos, otherwise everything after the
+ * valid prefix of the container file is fetched. */
+int fsobj::Fetch(uid_t uid, long pos, long count)
 {
     int fd = -1;
+    int partial = (count != -1 && IsFile());
+    int fetchop = partial ? ViceFetchPartial_OP : ViceFetch_OP;
 
-    LOG(10, ("fsobj::Fetch: (%s), uid = %d\n", GetComp(), uid));
+    LOG(10, ("fsobj::Fetch: (%s), uid = %d, pos = %ld, count = %ld\n",
+	     GetComp(), uid, pos, count));
 
     CODA_ASSERT(!IsLocalObj() && !IsFake());
 
@@ -222,8 +259,8 @@ int fsobj::Fetch(uid_t uid)
     memset(&dummysed, 0, sizeof(SE_Descriptor));
     SE_Descriptor *sed = &dummysed;
 
-    long offset = IsFile() ? cf.ValidData() : 0;
-    GotThisData = 0;
+    long offset = IsFile() ? (partial ? pos : cf.ValidData()) : 0;
+    GotThisData = offset;
 
     /* C++ 3.0 whines if the following decls moved closer to use  -- Satya */
     {
@@ -298,6 +335,8 @@ int fsobj::Fetch(uid_t uid)
     }
 
     long cbtemp = cbbreaks;
+    unsigned char fetchsha[SHA_DIGEST_LENGTH];
+    memcpy(fetchsha, VenusSHA, SHA_DIGEST_LENGTH);
 
     if (vol->IsReplicated()) {
         mgrpent *m = 0;
@@ -324,26 +363,35 @@ int fsobj::Fetch(uid_t uid)
 
 	    /* Make the RPC call. */
 	    CFSOP_PRELUDE(prel_str, comp, fid);
-	    MULTI_START_MESSAGE(ViceFetch_OP);
-	    code = (int) MRPC_MakeMulti(ViceFetch_OP, ViceFetch_PTR,
+	    MULTI_START_MESSAGE(fetchop);
+	    if (partial)
+		code = (int) MRPC_MakeMulti(ViceFetchPartial_OP,
+				  ViceFetchPartial_PTR,
+				  VSG_MEMBERS, m->rocc.handles,
+				  m->rocc.retcodes, m->rocc.MIp, 0, 0,
+				  MakeViceFid(&fid), &stat.VV, inconok,
+				  statusvar_ptrs, ph, offset, count,
+				  &PiggyBS, sedvar_bufs);
+	    else
+		code = (int) MRPC_MakeMulti(ViceFetch_OP, ViceFetch_PTR,
 				  VSG_MEMBERS, m->rocc.handles,
 				  m->rocc.retcodes, m->rocc.MIp, 0, 0,
 				  MakeViceFid(&fid), &stat.VV, inconok,
 				  statusvar_ptrs, ph, offset, &PiggyBS,
 				  sedvar_bufs);
-	    MULTI_END_MESSAGE(ViceFetch_OP);
+	    MULTI_END_MESSAGE(fetchop);
 
 	    CFSOP_POSTLUDE("fetch::fetch done\n");
 
 	    /* Collate responses from individual servers and decide what to do
 	     * next. */
 	    code = vp->Collate_NonMutating(m, code);
-	    MULTI_RECORD_STATS(ViceFetch_OP);
+	    MULTI_RECORD_STATS(fetchop);
 	    if (code == EASYRESOLVE) { asy_resolve = 1; code = 0; }
 
 	    if (IsFile()) {
 		Recov_BeginTrans();
-		cf.SetValidData(GotThisData);
+		cf.SetValidRange(offset, GotThisData - offset);
 		Recov_EndTrans(CMFP);
 	    }
 
@@ -376,11 +424,14 @@ int fsobj::Fetch(uid_t uid)
 	    ARG_UNMARSHALL(statusvar, status, dh_ix);
 	    {
 		unsigned long bytes = (unsigned long)sedvar_bufs[ph_ix].Value.SmartFTPD.BytesTransferred;
+		unsigned long expected = status.Length;
+		if (partial && (unsigned long)(offset + count) < expected)
+		    expected = offset + count;
 		LOG(10, ("(Multi)ViceFetch: fetched %d bytes\n", bytes));
-		if ((offset + bytes) != status.Length) {
+		if ((offset + bytes) != expected) {
 		    // print(logFile);
 		    LOG(0, ("fsobj::Fetch: bytes mismatch (%d, %d)",
-			    offset + bytes, status.Length));
+			    offset + bytes, expected));
 		    code = ERETRY;
 		}
 	    }
@@ -439,18 +490,23 @@ RepExit:
 
 	/* Make the RPC call. */
 	CFSOP_PRELUDE(prel_str, comp, fid);
-	UNI_START_MESSAGE(ViceFetch_OP);
-	code = (int) ViceFetch(c->connid, MakeViceFid(&fid), &stat.VV, inconok,
-				  &status, 0, offset, &PiggyBS, sed);
-	UNI_END_MESSAGE(ViceFetch_OP);
+	UNI_START_MESSAGE(fetchop);
+	if (partial)
+	    code = (int) ViceFetchPartial(c->connid, MakeViceFid(&fid),
+					  &stat.VV, inconok, &status, 0,
+					  offset, count, &PiggyBS, sed);
+	else
+	    code = (int) ViceFetch(c->connid, MakeViceFid(&fid), &stat.VV,
+				   inconok, &status, 0, offset, &PiggyBS, sed);
+	UNI_END_MESSAGE(fetchop);
 	CFSOP_POSTLUDE("fetch::fetch done\n");
 
 	/* Examine the return code to decide what to do next. */
 	code = vp->Collate(c, code);
-	UNI_RECORD_STATS(ViceFetch_OP);
+	UNI_RECORD_STATS(fetchop);
 	if (IsFile()) {
 	    Recov_BeginTrans();
-	    cf.SetValidData(GotThisData);
+	    cf.SetValidRange(offset, GotThisData - offset);
 	    Recov_EndTrans(CMFP);
 	}
 
@@ -458,11 +514,14 @@ RepExit:
 
 	{
 	    long bytes = sed->Value.SmartFTPD.BytesTransferred;
+	    long expected = (long)status.Length - offset;
+	    if (partial && count < expected)
+		expected = count;
 	    LOG(10, ("ViceFetch: fetched %d bytes\n", bytes));
-	    if (bytes != ((long)status.Length - offset)) {
+	    if (bytes != expected) {
 		//print(logFile);
 		LOG(0, ("fsobj::Fetch: bytes mismatch (%d, %d)",
-		        bytes, (status.Length - offset)));
+		        bytes, expected));
 		code = ERETRY;
 	    }
 	}
@@ -519,7 +578,12 @@ NonRepExit:
 	*/
 	/* when the server responds with EAGAIN, the VersionVector was
 	 * changed, so this should effectively be handled like a failed
-	 * validation, and we can throw away the data */
+	 * validation, and we can throw away the data. Unless someone is
+	 * reading the pieces we already have, then the rest of this version
+	 * is simply no longer available. */
+	if (code == EAGAIN && ACTIVE(this))
+	    code = EIO;
+
 	if (HAVEDATA(this) && (!IsFile() || code == EAGAIN))
 	    DiscardData();
 
@@ -531,10 +595,114 @@ NonRepExit:
 	Demote();
     }
     Recov_EndTrans(CMFP);
+
+    /* Make the contents available to other objects with the same SHA.
+     * The SHA only describes what we fetched when nothing changed since
+     * we got it, the status update clears it when the data version moved.
+     * Otherwise the index gets the hash of what is in the container. */
+    if (code == 0 && IsFile() && HAVEALLDATA(this) && CacheDedup &&
+	!IsZeroSHA(fetchsha))
+    {
+	if (cbtemp == cbbreaks &&
+	    memcmp(VenusSHA, fetchsha, SHA_DIGEST_LENGTH) == 0)
+	    Dedup->Add(VenusSHA, &cf);
+	else {
+	    fd = data.file->Open(O_RDONLY);
+	    if (fd != -1) {
+		if (ComputeViceSHA(fd, fetchsha) == 0)
+		    Dedup->Add(fetchsha, &cf);
+		data.file->Close(fd);
+	    }
+	}
+    }
     return(code);
 }
 
 
+/* Set when a server did not know about ViceFetchPartial. */
+static int NoPartialFetch = 0;
+
+/* Make sure [pos, pos+count) of a plain file is in the container file,
+ * fetching the missing pieces in FSO_FETCHCHUNK aligned units. Unlike
+ * fsdb::Get this also works while the file is open, the pieces that are
+ * already cached are never rewritten. Call with object read-locked. */
+int fsobj::FetchRange(uid_t uid, long pos, long count, int readahead)
+{
+    long start, end, len, hole, before;
+    int code = 0;
+
+    LOG(10, ("fsobj::FetchRange: (%s), %ld+%ld%s\n", GetComp(), pos, count,
+	     readahead ? " (readahead)" : ""));
+
+    if (!IsFile() || IsLocalObj() || IsFake() || !HAVESTATUS(this))
+	return EINVAL;
+
+    if (count < 0 || pos + count > (long)stat.Length)
+	count = (long)stat.Length - pos;
+
+    if (HAVEDATA(this) && cf.HaveRange(pos, count))
+	return 0;
+
+    PromoteLock();
+
+    /* we dropped the lock, things might have changed */
+    if (HAVEDATA(this) && cf.HaveRange(pos, count))
+	goto Exit;
+
+    if (DYING(this) || !REACHABLE(this) || DIRTY(this)) {
+	code = ETIMEDOUT;
+	goto Exit;
+    }
+
+    /* Reserve space for the whole file, just like fsdb::Get does. */
+    if (!HAVEDATA(this)) {
+	code = FSDB->AllocBlocks(VprocSelf()->u.u_priority, BLOCKS(this));
+	if (code) goto Exit;
+    }
+
+    if (NoPartialFetch) {
+	code = Fetch(uid);
+	goto Exit;
+    }
+
+    start = pos - pos % FSO_FETCHCHUNK;
+    end = pos + count;
+    end += (FSO_FETCHCHUNK - end % FSO_FETCHCHUNK) % FSO_FETCHCHUNK;
+    before = HAVEDATA(this) ? cf.ValidBytes() : 0;
+
+    do {
+	len = end - start;
+	hole = HAVEDATA(this) ? cf.MissingRange(start, &len) : start;
+	if (hole == -1)
+	    break;
+	if (hole + len > (long)stat.Length)
+	    len = (long)stat.Length - hole;
+
+	code = Fetch(uid, hole, len);
+
+	if (code == EOPNOTSUPP) {
+	    LOG(0, ("fsobj::FetchRange: server does not support partial fetches\n"));
+	    NoPartialFetch = 1;
+	    code = Fetch(uid);
+	    break;
+	}
+	start = hole + len;
+    } while (code == 0 && start < end && !HAVEALLDATA(this));
+
+    if (readahead) {
+	FSO_RangeStats.readaheads++;
+	FSO_RangeStats.rabytes += cf.ValidBytes() - before;
+    } else {
+	FSO_RangeStats.fetches++;
+	FSO_RangeStats.bytes += cf.ValidBytes() - before;
+    }
+
+Exit:
+    DemoteLock();
+    return code;
+}
+
+
 /*  *****  GetAttr/GetAcl  *****  */
 
 int fsobj::GetAttr(uid_t uid, RPC2_BoundedBS *acl)
@@ -564,9 +732,11 @@ int fsobj::GetAttr(uid_t uid, RPC2_BoundedBS *acl)
     /* Status parameters. */
     ViceStatus status;
 
-    /* SHA value (not always used) */
+    /* SHA value (not always used), only copied to VenusSHA after the
+     * status is updated, which clears VenusSHA when the data changed */
+    unsigned char newsha[SHA_DIGEST_LENGTH];
     RPC2_BoundedBS mysha; 
-    mysha.SeqBody = (RPC2_Byte *)VenusSHA;
+    mysha.SeqBody = (RPC2_Byte *)newsha;
     mysha.MaxSeqLen = SHA_DIGEST_LENGTH;
     mysha.SeqLen = 0; 
 
@@ -936,7 +1106,7 @@ int fsobj::GetAttr(uid_t uid, RPC2_BoundedBS *acl)
 
 	    if (LogLevel >= 10 && mysha.SeqLen == SHA_DIGEST_LENGTH) {
 		char printbuf[2*SHA_DIGEST_LENGTH+1];
-		ViceSHAtoHex(VenusSHA, printbuf, sizeof(printbuf));
+		ViceSHAtoHex(newsha, printbuf, sizeof(printbuf));
 		dprint("mysha(%d, %d) = %s\n.", mysha.MaxSeqLen, mysha.SeqLen,
 		       printbuf);
 	    }
@@ -1003,9 +1173,10 @@ int fsobj::GetAttr(uid_t uid, RPC2_BoundedBS *acl)
 
 	if (IsFile()) {
 	    RVMLIB_REC_OBJECT(VenusSHA);
-	    /* VenusSHA already set by getattr */
-	    if (mysha.SeqLen != SHA_DIGEST_LENGTH)
-		memset(&VenusSHA, 0, SHA_DIGEST_LENGTH);
+	    if (mysha.SeqLen == SHA_DIGEST_LENGTH)
+		memcpy(VenusSHA, newsha, SHA_DIGEST_LENGTH);
+	    else
+		memset(VenusSHA, 0, SHA_DIGEST_LENGTH);
 	}
 	Recov_EndTrans(CMFP);
 
@@ -1134,9 +1305,10 @@ RepExit:
 
 	if (IsFile()) {
 	    RVMLIB_REC_OBJECT(VenusSHA);
-	    /* VenusSHA already was set by getattr */
-	    if (mysha.SeqLen != SHA_DIGEST_LENGTH)
-		memset(&VenusSHA, 0, SHA_DIGEST_LENGTH);
+	    if (mysha.SeqLen == SHA_DIGEST_LENGTH)
+		memcpy(VenusSHA, newsha, SHA_DIGEST_LENGTH);
+	    else
+		memset(VenusSHA, 0, SHA_DIGEST_LENGTH);
 	}
 	Recov_EndTrans(CMFP);
 
@@ -92,6 +92,12 @@ int fsobj::Open(int writep, int truncp, struct venus_cnode *cp, uid_t uid)
     if (writep) {
 	FSO_ASSERT(this, IsFile());
 	Writers++;
+
+	/* The kernel may open the container by name or inode, so it must
+	 * not share its blocks with another container. */
+	if (HAVEDATA(this))
+	    data.file->Unshare(!truncp);
+
 	if (!flags.owrite) {
 	    Recov_BeginTrans();
 	    FSDB->FreeBlocks((int) BLOCKS(this));
@@ -436,6 +442,46 @@ int fsobj::Access(int rights, int modes, uid_t uid)
 }
 
 
+/* Access check for the upcall fast path, called without locks on objects
+ * for which FastValid holds. Only answers from a valid cached rights entry
+ * for this user, returns EWOULDBLOCK when fsobj::Access is needed. The
+ * parent of a file has to pass FastValid as well, so it is not locked by a
+ * worker that is changing its acl. */
+int fsobj::FastAccess(int rights, int modes, uid_t uid)
+{
+    fsobj *dir = this;
+
+    if (vol->IsBackup() || vol->IsReadWriteReplica())
+	if (rights & PRSFS_MUTATE)
+	    return(EROFS);
+
+    /* Files are checked against the mode bits and their parent's acl. */
+    if (!IsDir() || IsMtPt()) {
+	if (!(modes & C_A_C_OK))
+	    if (((modes & C_A_X_OK) && !(stat.Mode & OWNEREXEC)) ||
+		((modes & C_A_W_OK) && !(stat.Mode & OWNERWRITE)) ||
+		((modes & C_A_R_OK) && !(stat.Mode & OWNERREAD)))
+		return EACCES;
+
+	dir = pfso;
+	if (!dir || !FID_EQ(&dir->fid, &pfid) || dir->IsMtPt() ||
+	    !dir->FastValid())
+	    return(EWOULDBLOCK);
+    }
+
+    for (int i = 0; i < CPSIZE; i++) {
+	if (!dir->SpecificUser[i].inuse || dir->SpecificUser[i].uid != uid)
+	    continue;
+
+	if (!dir->SpecificUser[i].valid)
+	    break;
+
+	return (!rights || (rights & dir->SpecificUser[i].rights)) ? 0 : EACCES;
+    }
+    return(EWOULDBLOCK);
+}
+
+
 /* local-repair modification */
 /* inc_fid is an OUT parameter which allows caller to form "fake symlink" if it desires. */
 /* Explicit parameter for TRAVERSE_MTPTS? -JJK */
@@ -576,6 +622,51 @@ done:
     return(code);
 }
 
+/* Name lookup for the upcall fast path, see fsobj::FastAccess. Returns
+ * EWOULDBLOCK whenever fsobj::Lookup would have to fetch, expand the name,
+ * update the target or cover a mount point. */
+int fsobj::FastLookup(venus_cnode *cp, const char *name, uid_t uid, int flags)
+{
+    fsobj *target_fso;
+    VenusFid target_fid;
+    size_t len = strlen(name);
+    int code;
+
+    if (!IsDir() || IsMtPt() || !HAVEALLDATA(this) || !DATAVALID(this))
+	return(EWOULDBLOCK);
+
+    if (STREQ(name, ".") || STREQ(name, "..") ||
+	(len >= 4 && name[len-4] == '@'))
+	return(EWOULDBLOCK);
+
+    code = FastAccess(PRSFS_LOOKUP, C_A_F_OK, uid);
+    if (code) return(code);
+
+    code = dir_Lookup(name, &target_fid, flags & CLU_CASE_MASK);
+    if (code) return(code);
+
+    target_fso = FSDB->FastGet(&target_fid);
+    if (!target_fso)
+	return(EWOULDBLOCK);
+
+    /* fsdb::Get would record the new component name. */
+    if (!target_fso->comp || !STREQ(target_fso->comp, name))
+	return(EWOULDBLOCK);
+
+    if ((flags & CLU_TRAVERSE_MTPT) && target_fso->IsMtPt()) {
+	if (target_fso->flags.ckmtpt || !target_fso->u.root)
+	    return(EWOULDBLOCK);
+
+	target_fso = FSDB->FastGet(&target_fso->u.root->fid);
+	if (!target_fso)
+	    return(EWOULDBLOCK);
+    }
+
+    MAKE_CNODE2(*cp, target_fso->fid, FTTOVT(target_fso->stat.VnodeType));
+    return(0);
+}
+
+
 /* Call with the link contents fetched already. */
 /* Call with object read-locked. */
 int fsobj::Readlink(char *buf, unsigned long len, int *cc, uid_t uid)
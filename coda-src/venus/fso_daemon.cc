@@ -65,12 +65,23 @@ static const int GetDownInterval = 30;
 static const int FlushRefVecInterval = 90;
 static const int FSODaemonStackSize = 32768;
 static time_t LastGetDown = 0;
+#define READAHEAD_QLEN 16
 
 
 /* ***** Private variables  ***** */
 
 static char fsdaemon_sync;
 
+/* pending read-ahead requests */
+static struct readahead {
+    VenusFid fid;
+    uid_t uid;
+    long pos;
+    long count;
+} raq[READAHEAD_QLEN];
+static int raq_head, raq_count;
+static char readahead_sync;
+
 /* ***** Public functions ***** */
 
 /* wake the fso daemon so that it can free up some FSOs */
@@ -80,8 +91,75 @@ void FSOD_ReclaimFSOs(void)
     VprocSignal(&fsdaemon_sync);
 }
 
+/* queue a background fetch of part of a file that is read sequentially */
+void FSOD_ReadAhead(VenusFid *fid, uid_t uid, long pos, long count)
+{
+    int i;
+
+    /* ignore requests that are already queued, and drop new ones when we
+     * can't keep up */
+    for (i = 0; i < raq_count; i++) {
+	struct readahead *ra = &raq[(raq_head + i) % READAHEAD_QLEN];
+	if (FID_EQ(&ra->fid, fid) && ra->pos == pos)
+	    return;
+    }
+    if (raq_count == READAHEAD_QLEN)
+	return;
+
+    struct readahead *ra = &raq[(raq_head + raq_count) % READAHEAD_QLEN];
+    ra->fid = *fid;
+    ra->uid = uid;
+    ra->pos = pos;
+    ra->count = count;
+    raq_count++;
+    VprocSignal(&readahead_sync);
+}
+
 /* ***** Private routines  ***** */
 
+static void ReadAheadDaemon(void)
+{
+    /* Hack!  Vproc must yield before data members become valid! */
+    VprocYield();
+
+    vproc *vp = VprocSelf();
+
+    for (;;) {
+	while (raq_count == 0)
+	    VprocWait(&readahead_sync);
+
+	struct readahead ra = raq[raq_head];
+	raq_head = (raq_head + 1) % READAHEAD_QLEN;
+	raq_count--;
+
+	/* Set up uarea. */
+	vp->u.Init();
+	vp->u.u_uid = ra.uid;
+	vp->u.u_priority = FSDB->StdPri();
+
+	/* This is like the prefetch in hdb::Walk, but only for a range. */
+	for (;;) {
+	    vp->Begin_VFS(&ra.fid, CODA_VGET);
+	    if (vp->u.u_error) break;
+
+	    fsobj *f = 0;
+	    vp->u.u_error = FSDB->Get(&f, &ra.fid, vp->u.u_uid, RC_STATUS);
+	    if (vp->u.u_error == 0)
+		vp->u.u_error = f->FetchRange(vp->u.u_uid, ra.pos, ra.count, 1);
+	    FSDB->Put(&f);
+	    int retry_call = 0;
+	    vp->End_VFS(&retry_call);
+	    if (!retry_call) break;
+	}
+	LOG(10, ("ReadAheadDaemon: %s, %ld+%ld returns %s\n", FID_(&ra.fid),
+		 ra.pos, ra.count, VenusRetStr(vp->u.u_error)));
+
+	/* Bump sequence number. */
+	vp->seq++;
+    }
+}
+
+
 void FSODaemon(void) {
     /* Hack!  Vproc must yield before data members become valid! */
     VprocYield();
@@ -140,6 +218,9 @@ void fsdb::RecomputePriorities(int Force) {
     fso_iterator next(NL);
     fsobj *f;
     while ((f = next())) {
+	/* Recency of objects on the SLRU lists is tracked on reference. */
+	if (lru->Member(f->ix) && SLRU_MANAGED(f))
+	    continue;
 	recomputes++;
 	f->ComputePriority(Force);
     }
@@ -226,4 +307,5 @@ void fsdb::FlushRefVec() {
 
 void FSOD_Init(void) {
     (void)new vproc("FSODaemon", &FSODaemon, VPT_FSODaemon, FSODaemonStackSize);
+    (void)new vproc("ReadAhead", &ReadAheadDaemon, VPT_FSODaemon, FSODaemonStackSize);
 }
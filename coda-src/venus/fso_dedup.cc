@@ -0,0 +1,210 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ *
+ * Implementation of the transient content index over cache containers.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <coda_assert.h>
+#include <lka.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "fso.h"
+#include "fso_dedup.h"
+#include "venus.private.h"
+
+int CacheDedup = 1;
+dedupstore *Dedup;
+
+dedupstore::dedupstore(int nfiles)
+{
+    unsigned int n = 64;
+
+    while (n < (unsigned int)nfiles)
+	n <<= 1;
+
+    shatab = (entry **)calloc(n, sizeof(entry *));
+    cftab = (entry **)calloc(n, sizeof(entry *));
+    CODA_ASSERT(shatab && cftab);
+    mask = n - 1;
+    entries = 0;
+    saved = 0;
+
+    lookups = hits = reflinks = hardlinks = unshares = 0;
+    bytes = 0;
+}
+
+dedupstore::~dedupstore()
+{
+    for (unsigned int i = 0; i <= mask; i++) {
+	entry *e, *next;
+	for (e = cftab[i]; e; e = next) {
+	    next = e->cfnext;
+	    free(e);
+	}
+    }
+    free(shatab);
+    free(cftab);
+}
+
+/* The digest is as good a hash value as any. */
+dedupstore::entry **dedupstore::ShaSlot(const unsigned char *sha)
+{
+    unsigned int h;
+
+    memcpy(&h, sha, sizeof(h));
+    return &shatab[h & mask];
+}
+
+dedupstore::entry **dedupstore::CfSlot(const CacheFile *cf)
+{
+    unsigned long h = (unsigned long)cf;
+    h = (h >> 4) * 2654435761UL;
+    return &cftab[(h >> 8) & mask];
+}
+
+/* Look for a container with all of the data for this digest. */
+CacheFile *dedupstore::Find(const unsigned char *sha, long length)
+{
+    entry *e;
+
+    lookups++;
+    for (e = *ShaSlot(sha); e; e = e->shanext) {
+	if (memcmp(e->sha, sha, SHA_DIGEST_LENGTH) != 0)
+	    continue;
+	if (e->cf->Length() != length || e->cf->ValidData() != length)
+	    continue;
+	hits++;
+	return e->cf;
+    }
+    return NULL;
+}
+
+void dedupstore::Enter(const unsigned char *sha, CacheFile *cf, ino_t group)
+{
+    entry **pp = ShaSlot(sha), *e;
+
+    Remove(cf);
+
+    e = (entry *)malloc(sizeof(entry));
+    CODA_ASSERT(e);
+    e->cf = cf;
+    memcpy(e->sha, sha, SHA_DIGEST_LENGTH);
+    e->group = group;
+    e->blocks = NBLOCKS(cf->Length());
+
+    /* Only the first member of a group takes up space. */
+    for (entry *g = *pp; g; g = g->shanext)
+	if (g->group == group &&
+	    memcmp(g->sha, sha, SHA_DIGEST_LENGTH) == 0) {
+	    saved += e->blocks;
+	    break;
+	}
+
+    e->shanext = *pp;
+    *pp = e;
+    pp = CfSlot(cf);
+    e->cfnext = *pp;
+    *pp = e;
+    entries++;
+}
+
+/* The container holds all data for this digest. */
+void dedupstore::Add(const unsigned char *sha, CacheFile *cf)
+{
+    struct stat tstat;
+
+    if (!CacheDedup || IsZeroSHA((unsigned char *)sha))
+	return;
+
+    /* hard linked containers have the same inode number */
+    if (::stat(cf->Name(), &tstat) < 0)
+	return;
+
+    Enter(sha, cf, tstat.st_ino);
+}
+
+/* The container was just made to share the blocks of source. */
+void dedupstore::Add(const unsigned char *sha, CacheFile *cf,
+		     CacheFile *source)
+{
+    entry *e;
+
+    for (e = *CfSlot(source); e; e = e->cfnext)
+	if (e->cf == source)
+	    break;
+
+    if (!e) {
+	Add(sha, cf);
+	return;
+    }
+    Enter(sha, cf, e->group);
+}
+
+/* The contents of the container are about to change or go away. */
+void dedupstore::Remove(CacheFile *cf)
+{
+    entry **pp, *e;
+
+    for (pp = CfSlot(cf); (e = *pp) != NULL; pp = &e->cfnext)
+	if (e->cf == cf)
+	    break;
+    if (!e)
+	return;
+    *pp = e->cfnext;
+
+    for (pp = ShaSlot(e->sha); *pp != e; pp = &(*pp)->shanext)
+	;
+    *pp = e->shanext;
+
+    for (entry *g = *ShaSlot(e->sha); g; g = g->shanext)
+	if (g->group == e->group &&
+	    memcmp(g->sha, e->sha, SHA_DIGEST_LENGTH) == 0) {
+	    saved -= e->blocks;
+	    break;
+	}
+
+    free(e);
+    entries--;
+}
+
+void dedupstore::print(int fd)
+{
+    fdprint(fd, "Dedup: %s, containers = %u, saved blocks = %ld\n",
+	    CacheDedup ? "on" : "off", entries, saved);
+    fdprint(fd, "\tlookups = %lu, hits = %lu, reflinks = %lu, hardlinks = %lu, unshares = %lu, KB not fetched = %llu\n",
+	    lookups, hits, reflinks, hardlinks, unshares, bytes / 1024);
+}
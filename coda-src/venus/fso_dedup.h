@@ -0,0 +1,100 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ *
+ * Specification of the transient content index over cache containers.
+ *
+ * Containers that hold the complete contents of a plain file with a known
+ * SHA are entered in this index. When the server reports a SHA for a file
+ * we don't have the data for, fsobj::LookAside first looks for a container
+ * with the same contents and shares its disk blocks, with a reflink where
+ * the cache file system supports it and a hard link otherwise. Hard linked
+ * containers are copied before they are written to (CacheFile::Unshare).
+ *
+ * Containers that share blocks are kept in groups, the blocks of every
+ * group member beyond the first are reported as saved and added to the
+ * free space of the cache. The index is rebuilt at startup, hard links
+ * are found again by inode number, reflinks are only tracked until
+ * venus restarts.
+ *
+ */
+
+#ifndef _VENUS_FSO_DEDUP_H_
+#define _VENUS_FSO_DEDUP_H_ 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <coda_hash.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+class CacheFile;
+
+class dedupstore {
+    struct entry {
+	entry *shanext;		/* chain in the SHA table */
+	entry *cfnext;		/* chain in the container table */
+	CacheFile *cf;
+	unsigned char sha[SHA_DIGEST_LENGTH];
+	ino_t group;		/* members of a group share blocks */
+	long blocks;
+    };
+
+    entry **shatab;
+    entry **cftab;
+    unsigned int mask;		/* number of buckets - 1 */
+    unsigned int entries;
+    long saved;			/* blocks shared with another container */
+
+    entry **ShaSlot(const unsigned char *sha);
+    entry **CfSlot(const CacheFile *cf);
+    void Enter(const unsigned char *sha, CacheFile *cf, ino_t group);
+
+  public:
+    /* Statistics. */
+    unsigned long lookups;
+    unsigned long hits;
+    unsigned long reflinks;
+    unsigned long hardlinks;
+    unsigned long unshares;
+    unsigned long long bytes;	/* fetches avoided */
+
+    dedupstore(int nfiles);
+    ~dedupstore();
+
+    CacheFile *Find(const unsigned char *sha, long length);
+    void Add(const unsigned char *sha, CacheFile *cf);
+    void Add(const unsigned char *sha, CacheFile *cf, CacheFile *source);
+    void Remove(CacheFile *cf);
+
+    long SavedBlocks() { return saved; }
+    unsigned int count() { return entries; }
+
+    void print(int fd);
+};
+
+extern int CacheDedup;		/* use the index at all */
+extern dedupstore *Dedup;
+
+#endif /* _VENUS_FSO_DEDUP_H_ */
@@ -59,6 +59,22 @@ extern "C" {
 
 /* *****  FSO Directory Interface  ***** */
 
+/* Work done on the Unix format directory containers. */
+static struct {
+	unsigned long rebuilds;		/* full conversions */
+	unsigned long long rebuilt;	/* bytes written by them */
+	unsigned long adds;		/* entries added in place */
+	unsigned long removes;		/* entries cleared in place */
+	unsigned long long avoided;	/* container bytes not rebuilt */
+} UdcfStats;
+
+void UdcfPrint(int fd)
+{
+	fdprint(fd, "Udir: rebuilds = %lu (%llu KB), in place adds = %lu, removes = %lu, KB not rebuilt = %llu\n",
+		UdcfStats.rebuilds, UdcfStats.rebuilt / 1024, UdcfStats.adds,
+		UdcfStats.removes, UdcfStats.avoided / 1024);
+}
+
 /* Need not be called from within transaction. */
 void fsobj::dir_Rebuild() 
 {
@@ -75,6 +91,38 @@ void fsobj::dir_Rebuild()
 	DH_Convert(&data.dir->dh, data.dir->udcf->Name(), fid.Volume, fid.Realm);
 
 	data.dir->udcfvalid = 1;
+
+	struct stat tstat;
+	data.dir->udcf->Stat(&tstat);
+	UdcfStats.rebuilds++;
+	UdcfStats.rebuilt += tstat.st_size;
+}
+
+/* Add a new entry to a valid Unix format directory in place, so that the
+ * next open doesn't have to convert the whole directory again. Removed
+ * entries stay behind as holes, once the container has grown to twice
+ * the size of the directory we let it be rebuilt instead. */
+/* TRANS */
+int fsobj::dir_UdcfAdd(const char *Name)
+{
+	CacheFile *udcf = data.dir->udcf;
+	struct stat tstat;
+
+	if (!udcf || udcf->Length() > 2 * dir_Length())
+		return EFBIG;
+
+	int rc = DH_ConvertAdd(&data.dir->dh, udcf->Name(), Name,
+			       fid.Volume, fid.Realm);
+	if (rc)
+		return rc;
+
+	udcf->Stat(&tstat);
+	FSDB->ChangeDiskUsage((int) NBLOCKS(tstat.st_size) - NBLOCKS(udcf->Length()));
+	udcf->SetLength((int) tstat.st_size);
+
+	UdcfStats.adds++;
+	UdcfStats.avoided += tstat.st_size;
+	return 0;
 }
 
 
@@ -99,7 +147,8 @@ void fsobj::dir_Create(const char *Name, VenusFid *Fid)
 	}
 	free(entry);
 
-	data.dir->udcfvalid = 0;
+	if (data.dir->udcfvalid && dir_UdcfAdd(Name) != 0)
+		data.dir->udcfvalid = 0;
 
 	int newlength = dir_Length();
 	int delta_blocks = NBLOCKS(newlength) - NBLOCKS(oldlength);
@@ -122,15 +171,17 @@ int fsobj::dir_Length()
  * to unlink any entries that were added during the remove. However because of
  * Coda's session semantics the directory contents isn't changed until the
  * filedescriptor is closed and reopened. This function will clear the fileno
- * and namelen fields for the unlinked directory entry in the container file */
-static void clear_dir_container_entry(CacheFile *cf, const char *name)
+ * and namelen fields for the unlinked directory entry in the container file.
+ * Readers skip such entries, so the container stays valid when the entry
+ * was found. */
+static int clear_dir_container_entry(CacheFile *cf, const char *name)
 {
     char buf[4096];
     struct venus_dirent *vdir;
     int fd, len = strlen(name);
-    int offset = 0, n = 0;
+    int offset = 0, n = 0, found = 0;
 
-    if (!cf) return;
+    if (!cf) return 0;
     fd = cf->Open(O_RDWR);
 
     while (1) {
@@ -147,13 +198,15 @@ static void clear_dir_container_entry(CacheFile *cf, const char *name)
 	    /* found matching entry, write it back with zero'd fileno/namlen */
 	    vdir->d_fileno = vdir->d_namlen = 0;
 	    lseek(fd, offset - n, SEEK_CUR);
-	    write(fd, vdir, sizeof(*vdir) - sizeof(vdir->d_name));
+	    found = write(fd, vdir, sizeof(*vdir) - sizeof(vdir->d_name)) > 0;
 	    break;
 	}
+	if (vdir->d_reclen == 0) break;
 	offset += vdir->d_reclen;
     }
 
     cf->Close(fd);
+    return found;
 }
 
 /* TRANS */
@@ -174,8 +227,12 @@ void fsobj::dir_Delete(const char *Name)
 	}
 	free(entry);
 
-	clear_dir_container_entry(data.dir->udcf, Name);
-	data.dir->udcfvalid = 0;
+	if (clear_dir_container_entry(data.dir->udcf, Name) &&
+	    data.dir->udcfvalid) {
+		UdcfStats.removes++;
+		UdcfStats.avoided += data.dir->udcf->Length();
+	} else
+		data.dir->udcfvalid = 0;
 
 	int newlength = dir_Length();
 	int delta_blocks = NBLOCKS(newlength) - NBLOCKS(oldlength);
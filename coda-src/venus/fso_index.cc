@@ -0,0 +1,162 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ *
+ * Implementation of the transient fid index used by fsdb::Find.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <coda_assert.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "fso_index.h"
+
+#define FIDINDEX_MINSLOTS 64
+
+fidindex::fidindex(int expected)
+{
+    unsigned int n = FIDINDEX_MINSLOTS;
+
+    /* Keep the load factor at or below 1/2. */
+    while (n < 2 * (unsigned int)expected)
+	n <<= 1;
+
+    slots = (slot *)calloc(n, sizeof(slot));
+    CODA_ASSERT(slots);
+    mask = n - 1;
+    entries = 0;
+    lookups = probes = 0;
+    grows = 0;
+}
+
+fidindex::~fidindex()
+{
+    free(slots);
+}
+
+/* Mix all fid components, vnode numbers are mostly small and sequential and
+ * most objects in a cache share a handful of realms and volumes. */
+uint32_t fidindex::Hash(const VenusFid *fid)
+{
+    uint32_t h = fid->Realm;
+    h = h * 0x9e3779b1 + fid->Volume;
+    h = h * 0x9e3779b1 + fid->Vnode;
+    h = h * 0x9e3779b1 + fid->Unique;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    return h;
+}
+
+void fidindex::Place(uint32_t hash, const VenusFid *fid)
+{
+    unsigned int i = hash & mask;
+
+    while (slots[i].fid)
+	i = (i + 1) & mask;
+
+    slots[i].hash = hash;
+    slots[i].fid = fid;
+}
+
+void fidindex::Grow()
+{
+    slot *old = slots;
+    unsigned int oldsize = mask + 1;
+
+    slots = (slot *)calloc(2 * oldsize, sizeof(slot));
+    CODA_ASSERT(slots);
+    mask = 2 * oldsize - 1;
+
+    for (unsigned int i = 0; i < oldsize; i++)
+	if (old[i].fid)
+	    Place(old[i].hash, old[i].fid);
+
+    free(old);
+    grows++;
+}
+
+const VenusFid *fidindex::Find(const VenusFid *key)
+{
+    uint32_t hash = Hash(key);
+    unsigned int i = hash & mask;
+
+    lookups++;
+    for (;; i = (i + 1) & mask) {
+	probes++;
+	if (!slots[i].fid)
+	    return NULL;
+	if (slots[i].hash == hash && FID_EQ(slots[i].fid, key))
+	    return slots[i].fid;
+    }
+}
+
+/* The fid pointer has to stay valid as long as it is in the index, callers
+ * pass the address of the fid embedded in the cached object. */
+void fidindex::Insert(const VenusFid *fid)
+{
+    if (2 * (entries + 1) > mask + 1)
+	Grow();
+
+    Place(Hash(fid), fid);
+    entries++;
+}
+
+/* Remove the slot that refers to this particular fid, using backward shift
+ * deletion so that no tombstones are left behind in the probe sequences. */
+int fidindex::Remove(const VenusFid *fid)
+{
+    uint32_t hash = Hash(fid);
+    unsigned int i = hash & mask, j, home;
+
+    for (;; i = (i + 1) & mask) {
+	if (!slots[i].fid)
+	    return 0;
+	if (slots[i].fid == fid)
+	    break;
+    }
+
+    for (j = (i + 1) & mask; slots[j].fid; j = (j + 1) & mask) {
+	home = slots[j].hash & mask;
+
+	/* Leave the entry if its home slot lies cyclically in (i, j]. */
+	if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+	    continue;
+
+	slots[i] = slots[j];
+	i = j;
+    }
+    slots[i].fid = NULL;
+    entries--;
+    return 1;
+}
@@ -0,0 +1,81 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ *
+ * Specification of the transient fid index used by fsdb::Find.
+ *
+ * The recoverable fsdb hash table has a fixed number of buckets, which makes
+ * lookups in a large cache walk long chains of RVM resident objects. This
+ * index is rebuilt from the recoverable table at startup and kept in sync
+ * with it. It is an open-addressed table with linear probing, each slot
+ * holds the hash value and a pointer to the fid embedded in the object, so
+ * a probe sequence touches consecutive cache lines and only dereferences
+ * the object when the hash matches.
+ *
+ */
+
+#ifndef _VENUS_FSO_INDEX_H_
+#define _VENUS_FSO_INDEX_H_ 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "venusfid.h"
+
+class fidindex {
+    struct slot {
+	uint32_t hash;
+	const VenusFid *fid;	/* NULL if the slot is unused */
+    };
+
+    slot *slots;
+    unsigned int mask;		/* number of slots - 1 */
+    unsigned int entries;
+
+    /* Statistics. */
+    unsigned long lookups;
+    unsigned long probes;
+    unsigned int grows;
+
+    static uint32_t Hash(const VenusFid *);
+    void Grow();
+    void Place(uint32_t, const VenusFid *);
+
+  public:
+    fidindex(int expected);
+    ~fidindex();
+
+    const VenusFid *Find(const VenusFid *key);
+    void Insert(const VenusFid *fid);
+    int Remove(const VenusFid *fid);
+
+    unsigned int count() { return entries; }
+    unsigned int size() { return mask + 1; }
+    void GetStats(unsigned long *l, unsigned long *p, unsigned int *g)
+      { *l = lookups; *p = probes; *g = grows; }
+};
+
+#endif /* _VENUS_FSO_INDEX_H_ */
@@ -0,0 +1,180 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ *
+ * Implementation of the segmented LRU replacement lists.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <coda_assert.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "fso_slru.h"
+#include "venus.private.h"
+
+slru::slru(int nobjs)
+{
+    nodes = (node *)calloc(nobjs, sizeof(node));
+    CODA_ASSERT(nodes);
+    nnodes = nobjs;
+
+    for (int i = 0; i < 3; i++) {
+	head[i] = tail[i] = -1;
+	count[i] = 0;
+    }
+
+    /* Leave at least a fifth of the cache to newly referenced objects. */
+    maxprotected = nobjs - nobjs / 5;
+
+    refs = protected_hits = promotions = demotions = evictions = 0;
+}
+
+slru::~slru()
+{
+    free(nodes);
+}
+
+/* Put an unlinked node at the head of a segment. */
+void slru::Link(int ix, int seg)
+{
+    node *n = &nodes[ix];
+
+    n->seg = seg;
+    n->prev = -1;
+    n->next = head[seg];
+    if (head[seg] != -1)
+	nodes[head[seg]].prev = ix;
+    else
+	tail[seg] = ix;
+    head[seg] = ix;
+    count[seg]++;
+}
+
+void slru::Unlink(int ix)
+{
+    node *n = &nodes[ix];
+    int seg = n->seg;
+
+    if (n->prev != -1)
+	nodes[n->prev].next = n->next;
+    else
+	head[seg] = n->next;
+
+    if (n->next != -1)
+	nodes[n->next].prev = n->prev;
+    else
+	tail[seg] = n->prev;
+
+    count[seg]--;
+    n->seg = SLRU_NONE;
+}
+
+void slru::Insert(int ix, fsobj *f)
+{
+    CODA_ASSERT(ix >= 0 && ix < nnodes);
+    CODA_ASSERT(nodes[ix].seg == SLRU_NONE);
+
+    nodes[ix].obj = f;
+    Link(ix, SLRU_PROBATION);
+}
+
+void slru::Remove(int ix)
+{
+    if (nodes[ix].seg == SLRU_NONE)
+	return;
+
+    Unlink(ix);
+    nodes[ix].obj = NULL;
+}
+
+void slru::Reference(int ix)
+{
+    int seg = nodes[ix].seg;
+
+    if (seg == SLRU_NONE)
+	return;
+
+    refs++;
+    if (seg == SLRU_PROTECTED)
+	protected_hits++;
+    else
+	promotions++;
+
+    Unlink(ix);
+
+    /* Make room in the protected segment. */
+    if (seg == SLRU_PROBATION && count[SLRU_PROTECTED] >= maxprotected) {
+	int victim = tail[SLRU_PROTECTED];
+	Unlink(victim);
+	Link(victim, SLRU_PROBATION);
+	demotions++;
+    }
+
+    Link(ix, SLRU_PROTECTED);
+}
+
+void slru::print(int fd)
+{
+    fdprint(fd, "SLRU: probation = %d, protected = %d (max %d)\n",
+	    count[SLRU_PROBATION], count[SLRU_PROTECTED], maxprotected);
+    fdprint(fd, "\trefs = %lu, protected hits = %lu, promotions = %lu, demotions = %lu, evictions = %lu\n",
+	    refs, protected_hits, promotions, demotions, evictions);
+}
+
+
+slru_iterator::slru_iterator(slru *list)
+{
+    s = list;
+    seg = SLRU_PROBATION;
+    nextix = s->tail[seg];
+}
+
+fsobj *slru_iterator::operator()()
+{
+    int ix;
+
+    /* Our successor was taken off this segment behind our back (e.g. a
+     * child object killed along with its parent), start over at the tail. */
+    if (nextix != -1 && s->nodes[nextix].seg != seg)
+	nextix = s->tail[seg];
+
+    while (nextix == -1) {
+	if (seg == SLRU_PROTECTED)
+	    return NULL;
+	seg = SLRU_PROTECTED;
+	nextix = s->tail[seg];
+    }
+
+    ix = nextix;
+    nextix = s->nodes[ix].prev;
+    return s->nodes[ix].obj;
+}
@@ -0,0 +1,99 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ *
+ * Specification of the segmented LRU replacement lists.
+ *
+ * When the "slru" cache policy is selected, replaceable objects that are not
+ * covered by a hoard binding are kept on two LRU lists instead of the
+ * priority queue.  New objects enter the probationary segment, a second
+ * reference promotes them to the protected segment, and when the protected
+ * segment is full its least recently used object is demoted back.  Victims
+ * are taken from the tail of the probationary segment first.  Every
+ * operation is O(1), so there is no periodic priority recomputation for
+ * these objects.  Hoarded objects stay on the priority queue.
+ *
+ * The list links live in a transient array indexed by fsobj::ix, so the
+ * recoverable layout of the fsobj's is not affected.
+ *
+ */
+
+#ifndef _VENUS_FSO_SLRU_H_
+#define _VENUS_FSO_SLRU_H_ 1
+
+class fsobj;
+
+enum slru_segment { SLRU_NONE = 0, SLRU_PROBATION, SLRU_PROTECTED };
+
+class slru {
+  friend class slru_iterator;
+
+    struct node {
+	int prev;		/* towards the head (most recently used) */
+	int next;		/* towards the tail (least recently used) */
+	fsobj *obj;
+	unsigned char seg;
+    };
+
+    node *nodes;
+    int nnodes;
+    int head[3];
+    int tail[3];
+    int count[3];
+    int maxprotected;
+
+    void Link(int, int);
+    void Unlink(int);
+
+  public:
+    /* Statistics. */
+    unsigned long refs;			/* references to objects on the lists */
+    unsigned long protected_hits;	/* ... which were already protected */
+    unsigned long promotions;
+    unsigned long demotions;
+    unsigned long evictions;
+
+    slru(int nobjs);
+    ~slru();
+
+    void Insert(int ix, fsobj *f);
+    void Remove(int ix);
+    void Reference(int ix);
+    int Member(int ix) { return nodes[ix].seg != SLRU_NONE; }
+
+    int Probation() { return count[SLRU_PROBATION]; }
+    int Protected() { return count[SLRU_PROTECTED]; }
+
+    void print(int fd);
+};
+
+/* Walks the lists in replacement order, least valuable object first. The
+ * successor is looked up before an object is returned, so the caller may
+ * remove the returned object from the lists. */
+class slru_iterator {
+    slru *s;
+    int seg;
+    int nextix;
+
+  public:
+    slru_iterator(slru *);
+    fsobj *operator()();
+};
+
+#endif /* _VENUS_FSO_SLRU_H_ */
@@ -0,0 +1,136 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ * Microbenchmark for the fid index used by fsdb::Find.
+ *
+ * Populates the index with fids that look like those of a real cache (a few
+ * volumes, densely allocated vnodes) and measures lookup latency for hits
+ * and misses, as well as the cost of a remove/insert cycle.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "fso_index.h"
+
+#define NVOLUMES 16
+#define LOOKUPS  1000000
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1e9 +
+	   (now.tv_usec - start->tv_usec) * 1e3;
+}
+
+static void MakeFid(VenusFid *fid, int i)
+{
+    fid->Realm  = 1;
+    fid->Volume = 0x7f000000 + (i % NVOLUMES);
+    fid->Vnode  = 2 * (i / NVOLUMES) + 1;
+    fid->Unique = i + 1;
+}
+
+static void bench(int nobjs)
+{
+    VenusFid *fids = (VenusFid *)malloc(nobjs * sizeof(VenusFid));
+    VenusFid miss;
+    struct timeval start;
+    unsigned long lookups, probes;
+    unsigned int grows;
+    int i, found = 0;
+
+    if (!fids) {
+	perror("malloc");
+	exit(EXIT_FAILURE);
+    }
+
+    /* Start small so the growth path is exercised as well. */
+    fidindex idx(1024);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nobjs; i++) {
+	MakeFid(&fids[i], i);
+	idx.Insert(&fids[i]);
+    }
+    printf("%8d objects: insert %7.1f ns/op", nobjs, elapsed(&start) / nobjs);
+
+    srandom(nobjs);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < LOOKUPS; i++)
+	if (idx.Find(&fids[random() % nobjs]))
+	    found++;
+    printf(", hit %7.1f ns/op", elapsed(&start) / LOOKUPS);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < LOOKUPS; i++) {
+	MakeFid(&miss, nobjs + (random() % nobjs));
+	if (idx.Find(&miss))
+	    found++;
+    }
+    printf(", miss %7.1f ns/op", elapsed(&start) / LOOKUPS);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < LOOKUPS; i++) {
+	VenusFid *f = &fids[random() % nobjs];
+	idx.Remove(f);
+	idx.Insert(f);
+    }
+    printf(", remove+insert %7.1f ns/op\n", elapsed(&start) / LOOKUPS);
+
+    idx.GetStats(&lookups, &probes, &grows);
+    printf("%8s  slots %u, %.2f probes/lookup, %u grows\n", "",
+	   idx.size(), (double)probes / lookups, grows);
+
+    if (found != LOOKUPS || idx.count() != (unsigned int)nobjs) {
+	fprintf(stderr, "index inconsistent: found %d, count %u\n",
+		found, idx.count());
+	exit(EXIT_FAILURE);
+    }
+    free(fids);
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    if (argc > 1) {
+	for (i = 1; i < argc; i++)
+	    bench(atoi(argv[i]));
+    } else {
+	bench(10000);
+	bench(100000);
+	bench(1000000);
+    }
+    return 0;
+}
@@ -52,6 +52,7 @@ extern "C" {
 #include <errno.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <struct.h>
 #include <sys/param.h>
 #include <unistd.h>
@@ -114,8 +115,6 @@ static int MetaNameCtxts = 0;		    /* number of outstanding meta name-ctxts */
 static int MetaExpansions = 0;		    /* number of meta-expansions performed */
 
 
-extern int SearchForNOreFind;
-
 
 /*  *****  HDB Maintenance  ******  */
 
@@ -422,96 +421,306 @@ long hdb::GetDemandWalkTime() {
   return(HDB->TimeOfLastDemandWalk);
 }
 
-/* Ensure status is valid for all cached objects. */
-void hdb::ValidateCacheStatus(vproc *vp, int *interrupt_failures, int *statusBytesFetched) {
-    int validations = 0;
+/*  *****  Hoard walk fetchers  *****  */
 
-    fso_iterator next(NL);
-    fsobj *f, *g;
-    while ((f = next())) {
-        if (STATUSVALID(f)) continue;
+/*
+ * The status validations and data fetches of a walk are handed to a pool of
+ * fetcher vprocs, so objects in different volumes (and on different servers)
+ * are fetched at the same time. The walk hands out requests in priority
+ * order and keeps at most HoardWalkers of them outstanding. When
+ * HoardBandwidth is set, file data is requested no faster than that many
+ * KB per second.
+ */
 
-	/* skip non-cacheable objects */
-	if (!f->vol->IsReplicated())
-	    continue;
+int HoardWalkers = 4;
+int HoardBandwidth = 0;
 
-	/* Set up uarea. */
-	vp->u.Init();
-	vp->u.u_uid = f->HoardVuid;
-	vp->u.u_priority = f->priority;
+enum hoardreq_state { HR_PENDING, HR_RUNNING, HR_DONE, HR_REAPED };
 
-	/* Perform a vget(). */
-	LOG(1, ("hdb::Walk: vget(%s, %d, %d, %d)\n",
-		FID_(&f->fid), f->priority, f->HoardVuid, f->stat.Length));
-	VenusFid tfid = f->fid;
-	for (;;) {
-	    vp->Begin_VFS(&tfid, CODA_VGET);
-	    if (vp->u.u_error) break;
+struct hoardreq {
+    VenusFid fid;
+    fsobj *f;			/* only compared, never dereferenced */
+    uid_t uid;
+    int priority;
+    int length;
+    int error;
+    enum hoardreq_state state;
+};
 
-	    fsobj *tf = 0;
-	    vp->u.u_error = FSDB->Get(&tf, &tfid, vp->u.u_uid, RC_STATUS);
+/* Totals of the last walk. */
+static struct {
+    int validations;
+    int fetches;
+    long long bytes;
+    unsigned long msec;
+} HoardWalkStats;
 
-	    if (tf)
-	        statusBytesFetched += tf->stat.Length;
+static const int HoardFetcherStackSize = 65536;
 
-	    FSDB->Put(&tf);
-	    int retry_call;
-	    vp->End_VFS(&retry_call);
+/* This is like vproc::vget(), RC_DATA gets us the data as well. */
+static void HoardFetch(vproc *vp, struct hoardreq *r, int rights)
+{
+    const char *what = (rights & RC_DATA) ? "prefetch" : "vget";
+
+    vp->u.Init();
+    vp->u.u_uid = r->uid;
+    vp->u.u_priority = r->priority;
+
+    LOG(1, ("hdb::Walk: %s(%s, %d, %d, %d)\n",
+	    what, FID_(&r->fid), r->priority, r->uid, r->length));
+    for (;;) {
+	vp->Begin_VFS(&r->fid, CODA_VGET);
+	if (vp->u.u_error) break;
+
+	fsobj *tf = 0;
+	vp->u.u_error = FSDB->Get(&tf, &r->fid, vp->u.u_uid, rights);
+	FSDB->Put(&tf);
+	int retry_call = 0;
+	vp->End_VFS(&retry_call);
+	if (!retry_call) break;
+    }
+    if (vp->u.u_error == EINCONS)
+	k_Purge(&r->fid, 1);
+    LOG(1, ("hdb::Walk: %s returns %s\n", what, VenusRetStr(vp->u.u_error)));
 
-	    if (!retry_call) break;
+    r->error = vp->u.u_error;
+}
 
-        }
+/* Fetchers have to be VPT_HDBDaemon, fsdb::Get treats hoard walk requests
+ * differently from those of worker threads. */
+class hoardfetcher : public vproc {
+    static hoardfetcher *slots[MAX_HOARD_WALKERS];
 
-	if (vp->u.u_error == EINCONS)
-	    k_Purge(&tfid, 1);
-	LOG(1, ("hdb::Walk: vget returns %s\n", VenusRetStr(vp->u.u_error)));
+    struct hoardreq *req;
+    int rights;
+    int *outstanding;
 
+    hoardfetcher();
+    hoardfetcher(hoardfetcher&);		/* not supported! */
+    int operator=(hoardfetcher&) { abort(); return(0); }	/* not supported! */
+    ~hoardfetcher();
 
-	/* Yield periodically. */
-	validations++;
-	if ((validations & HDB_YIELDMASK) == 0)
-	    VprocYield();
+  protected:
+    virtual void main(void);
 
-	/* Find our fsobj and make sure it's still the same pointer. */
-	g = FSDB->Find(&tfid);
-	if ((g != NULL) && (f != NULL) && (g == f)) {
-	    if (FID_EQ(&g->fid, &f->fid))
-		continue;  /* Everything looks okay -- continue on our merry way */
-        }
+  public:
+    static int Start(struct hoardreq *, int, int *);
+};
 
-	/* Essentially, the else's of the above nested if's */
-	(*interrupt_failures)++;
-	if (g == NULL)
-	{
-	    LOG(0, ("Hoard Walk interrupted -- object missing! <%s>\n", FID_(&tfid)));
+hoardfetcher *hoardfetcher::slots[MAX_HOARD_WALKERS];
+
+
+/* Hand a request to an idle fetcher, returns 0 if all of them are busy. */
+int hoardfetcher::Start(struct hoardreq *r, int rights, int *outstanding)
+{
+    int i, n = HoardWalkers < MAX_HOARD_WALKERS ? HoardWalkers : MAX_HOARD_WALKERS;
+
+    for (i = 0; i < n; i++)
+	if (!slots[i] || slots[i]->idle)
+	    break;
+    if (i == n)
+	return 0;
+
+    if (!slots[i])
+	slots[i] = new hoardfetcher;
+    hoardfetcher *h = slots[i];
+    CODA_ASSERT(h->idle);
+
+    h->req = r;
+    h->rights = rights;
+    h->outstanding = outstanding;
+    r->state = HR_RUNNING;
+    (*outstanding)++;
+
+    h->idle = 0;
+    VprocSignal((char *)h);	/* ignored for new fetchers */
+    return 1;
+}
+
+
+hoardfetcher::hoardfetcher() :
+	vproc("HoardFetcher", NULL, VPT_HDBDaemon, HoardFetcherStackSize)
+{
+    LOG(100, ("hoardfetcher::hoardfetcher(%#x): %-16s : lwpid = %d\n",
+	       this, name, lwpid));
+
+    idle = 1;
+    start_thread();
+}
+
+
+hoardfetcher::hoardfetcher(hoardfetcher& h) : vproc((vproc&)h) {
+    abort();
+}
+
+
+hoardfetcher::~hoardfetcher() {
+    LOG(100, ("hoardfetcher::~hoardfetcher: %-16s : lwpid = %d\n",
+	      name, lwpid));
+}
+
+
+/* See the comment at reintegrator::main about the yield. */
+void hoardfetcher::main(void)
+{
+    VprocYield();
+
+    for (;;) {
+	if (idle) CHOKE("hoardfetcher::main: signalled but not dispatched!");
+
+	HoardFetch(this, req, rights);
+
+	seq++;
+	req->state = HR_DONE;
+	req = NULL;
+	idle = 1;
+	(*outstanding)--;
+	VprocSignal(outstanding);
+
+	/* Wait for new request. */
+	VprocWait((char *)this);
+    }
+}
+
+
+/* Don't ask for more than HoardBandwidth KB/s worth of data. */
+static void HoardThrottle(struct timeval *start, long long bytes)
+{
+    struct timeval now, delay;
+    long long usec, allowed, wait;
+
+    if (HoardBandwidth <= 0)
+	return;
+
+    gettimeofday(&now, NULL);
+    usec = (now.tv_sec - start->tv_sec) * 1000000LL +
+	   (now.tv_usec - start->tv_usec);
+    allowed = (long long)HoardBandwidth * 1024 * usec / 1000000;
+    if (bytes <= allowed)
+	return;
+
+    wait = (bytes - allowed) * 1000000 / ((long long)HoardBandwidth * 1024);
+    delay.tv_sec = wait / 1000000;
+    delay.tv_usec = wait % 1000000;
+    VprocSleep(&delay);
+}
+
+
+static int HoardReqCmp(const void *a, const void *b)
+{
+    const struct hoardreq *ra = (const struct hoardreq *)a;
+    const struct hoardreq *rb = (const struct hoardreq *)b;
+
+    return rb->priority - ra->priority;
+}
+
+
+/*
+ * Run a list of requests, which is in priority order, through the fetchers.
+ * Completed requests are passed to `done' by the walking thread, in the
+ * order in which they complete. When `done' returns non-zero no new
+ * requests are started. Returns the number of requests that were started.
+ */
+int hdb::RunHoardRequests(vproc *vp, struct hoardreq *reqs, int n, int rights,
+			  int (hdb::*done)(struct hoardreq *, void *), void *arg)
+{
+    struct timeval start;
+    long long requested = 0;
+    int i = 0, j, first = 0, outstanding = 0;
+    int limit = HoardWalkers < MAX_HOARD_WALKERS ? HoardWalkers : MAX_HOARD_WALKERS;
+
+    gettimeofday(&start, NULL);
+    for (;;) {
+	if (i < n && (limit <= 0 || outstanding < limit)) {
+	    if (rights & RC_DATA) {
+		HoardThrottle(&start, requested);
+		requested += reqs[i].length;
+	    }
+
+	    if (!hoardfetcher::Start(&reqs[i], rights, &outstanding)) {
+		HoardFetch(vp, &reqs[i], rights);
+		reqs[i].state = HR_DONE;
+	    }
+	    i++;
+
+	    /* Yield periodically. */
+	    if ((i & HDB_YIELDMASK) == 0)
+		VprocYield();
 	}
+	else if (outstanding)
+	    VprocWait(&outstanding);
 	else
-	{
-	    LOG(0, ("Hoard Walk interrupted -- object different! <%s>\n", FID_(&g->fid)));
+	    break;
+
+	for (j = first; j < i; j++) {
+	    if (reqs[j].state != HR_DONE)
+		continue;
+	    reqs[j].state = HR_REAPED;
+	    if ((this->*done)(&reqs[j], arg))
+		n = i;		/* don't start anything else */
 	}
-	LOG(0, ("Number of interrupt failures = %d\n", *interrupt_failures));
+	while (first < i && reqs[first].state == HR_REAPED)
+	    first++;
+    }
+    return i;
+}
 
-	/* 
-	 * Find some interesting info.  My goal is to see if there 
-	 * might be a way we can test for the missing object without 
-	 * having to reFind the object. 
-	 */
-	if (SearchForNOreFind) {
-	    if (!f) 
-		LOG(0, ("HoardWalk f was NULL!"));
-	    else {
-		if (f->state == FsoRunt)
-		    LOG(0, ("HoardWalk f is FsoRunt! tfid=<%s> f->fid=<%s>", 
-			    FID_(&tfid), FID_(&f->fid)));
-		if (f->fid.Volume == 0)
-		    LOG(0, ("HoardWalk vid=0, f->fid=<%s>", FID_(&f->fid)));
-		f->print();
-	    }
-        }
 
-	/* Now do the reset. */
-	next.Reset();  /* f now points to never-never-land. */
+int hdb::StatusDone(struct hoardreq *r, void *arg)
+{
+    int *interrupt_failures = (int *)arg;
+    fsobj *g = FSDB->Find(&r->fid);
+
+    if (g == r->f)
+	return 0;
+
+    /* The object went away (or was replaced) while we were validating. */
+    (*interrupt_failures)++;
+    if (g == NULL)
+    {
+	LOG(0, ("Hoard Walk interrupted -- object missing! <%s>\n", FID_(&r->fid)));
+    }
+    else
+    {
+	LOG(0, ("Hoard Walk interrupted -- object different! <%s>\n", FID_(&g->fid)));
+    }
+    LOG(0, ("Number of interrupt failures = %d\n", *interrupt_failures));
+    return 0;
+}
+
+
+/* Ensure status is valid for all cached objects. */
+void hdb::ValidateCacheStatus(vproc *vp, int *interrupt_failures) {
+    struct hoardreq *reqs;
+    int n = 0;
+
+    /* Take a snapshot, the fetchers change the cache underneath us. */
+    reqs = (struct hoardreq *)malloc((FSDB->htab.count() + 1) * sizeof(*reqs));
+    CODA_ASSERT(reqs);
+
+    fso_iterator next(NL);
+    fsobj *f;
+    while ((f = next())) {
+        if (STATUSVALID(f)) continue;
+
+	/* skip non-cacheable objects */
+	if (!f->vol->IsReplicated())
+	    continue;
+
+	reqs[n].fid = f->fid;
+	reqs[n].f = f;
+	reqs[n].uid = f->HoardVuid;
+	reqs[n].priority = f->priority;
+	reqs[n].length = f->stat.Length;
+	reqs[n].state = HR_PENDING;
+	n++;
     }
+    qsort(reqs, n, sizeof(*reqs), HoardReqCmp);
+
+    HoardWalkStats.validations +=
+	RunHoardRequests(vp, reqs, n, RC_STATUS, &hdb::StatusDone,
+			 interrupt_failures);
+    free(reqs);
 }
 
 void hdb::ListPriorityQueue() {
@@ -601,7 +810,7 @@ void hdb::StatusWalk(vproc *vp, int *TotalBytesToFetch, int *BytesFetched) {
 	enospc_failure = 0;
 
 	/* Ensure status is valid for all cached objects. */
-	ValidateCacheStatus(vp, &interrupt_failures, BytesFetched);
+	ValidateCacheStatus(vp, &interrupt_failures);
 
 	/* Walk the priority queue.  Enter clean-up mode upon ENOSPC failure. */
 	WalkPriorityQueue(vp, &expansions, &enospc_failure);
@@ -669,109 +878,113 @@ void TallyAllHDBentries(dlist *hdb_bindings, int blocks, TallyStatus status) {
   }
 }
 
-void hdb::DataWalk(vproc *vp, int TotalBytesToFetch, int BytesFetched) {
-    MarinerLog("cache::BeginDataWalk [%d]\n",
-	       FSDB->blocks);
-    START_TIMING();
-    int iterations = 0;
-    int prefetches = 0;
-    int s_prefetches = 0;
-    int s_prefetched_blocks = 0;
+/* State of a data walk, for hdb::DataDone. */
+struct datawalk {
+    int TotalBytesToFetch;
+    int BytesFetched;
+    int s_prefetches;
+    int s_prefetched_blocks;
     int enospc_failure;
+};
 
-    for (int iterate = 1; iterate;) {
-	iterations++;
-	iterate = 0;
-	enospc_failure = 0;
-
-	LOG(0, ("DataWalk:  Restarting Iterator!!!!  Reset availability status information.\n"));
-	InitTally();  // Delete old list and start over
-	TallyPrint(PrimaryUser);		   
+int hdb::DataDone(struct hoardreq *r, void *arg)
+{
+    struct datawalk *w = (struct datawalk *)arg;
 
-	bstree_iterator next(*FSDB->prioq, BstDescending);
-	bsnode *b = 0;
-	while ((b = next())) {
-	    fsobj *f = strbase(fsobj, b, prio_handle);
-	    CODA_ASSERT(f != NULL);
-	    int blocks = BLOCKS(f);
+    /* Reacquire reference to object. */
+    fsobj *f = FSDB->Find(&r->fid);
 
-	    if (!HOARDABLE(f)) continue;
+    if (r->error == 0) {
+	w->s_prefetches++;
+	if (f) w->s_prefetched_blocks += (int) BLOCKS(f);
+    }
 
-	    if (DATAVALID(f)) {
-	      LOG(200, ("AVAILABLE:  fid=<%s> comp=%s priority=%d blocks=%d\n", 
-		      FID_(&f->fid), f->comp, f->priority, blocks));
-	      TallyAllHDBentries(f->hdb_bindings, blocks, TSavailable);
-	      continue;
-	    }
+    /* Abandon the walk when a prefetch fails due to ENOSPC. */
+    if (r->error == ENOSPC) {
+	w->enospc_failure = 1;
+	return 1;
+    }
 
-	    /* Set up uarea. */
-	    vp->u.Init();
-	    vp->u.u_uid = f->HoardVuid;
-	    vp->u.u_priority = f->priority;
-	    
-	    /* Prefetch the object.  This is like vproc::vget(), only we want the data. */
-	    LOG(1, ("hdb::Walk: prefetch(%s, %d, %d, %d)\n",
-		    FID_(&f->fid), f->priority, f->HoardVuid, f->stat.Length));
-	    VenusFid tfid = f->fid;
-	    for (;;) {
-	        vp->Begin_VFS(&tfid, CODA_VGET);
-		if (vp->u.u_error) break;
+    if (f == 0 || !REPLACEABLE(f)) {
+	LOG(0, ("hdb::Walk: (%s) !FOUND or !REPLACEABLE after prefetch\n",
+		FID_(&r->fid)));
+	return 0;
+    }
 
-		fsobj *tf = 0;
-		vp->u.u_error = FSDB->Get(&tf, &tfid, vp->u.u_uid, RC_DATA);
-		FSDB->Put(&tf);
-		int retry_call = 0;
-		vp->End_VFS(&retry_call);
-		if (!retry_call) break;
-	    }
-	    if (vp->u.u_error == EINCONS)
-	        k_Purge(&tfid, 1);
-	    LOG(1, ("hdb::Walk: prefetch returns %s\n",
-		    VenusRetStr(vp->u.u_error)));
+    /* Record availability of this object. */
+    int blocks = BLOCKS(f);
+    if (DATAVALID(f)) {
+      LOG(100, ("AVAILABLE (fetched):  fid=<%s> comp=%s priority=%d blocks=%d\n", 
+		FID_(&f->fid), f->comp, f->priority, blocks));
+      TallyAllHDBentries(f->hdb_bindings, blocks, TSavailable);
+      w->BytesFetched += f->stat.Length;
+      HoardWalkStats.bytes += f->stat.Length;
+      HoardWalkProgress(w->BytesFetched, w->TotalBytesToFetch);
+    } else {
+      LOG(100, ("UNAVAILABLE (fetch failed):  fid=<%s> comp=%s priority=%d blocks=%d\n",
+	      FID_(&f->fid), f->comp, f->priority, blocks));
+      TallyAllHDBentries(f->hdb_bindings, blocks, TSunavailable);
+    }
+    return 0;
+}
 
-	    /* Yield periodically. */
-	    prefetches++;
-	    if ((prefetches & HDB_YIELDMASK) == 0)
-	        VprocYield();
+void hdb::DataWalk(vproc *vp, int TotalBytesToFetch, int BytesFetched) {
+    MarinerLog("cache::BeginDataWalk [%d]\n",
+	       FSDB->blocks);
+    START_TIMING();
+    int iterations = 1;
+    int prefetches = 0;
+    struct datawalk w;
+    struct hoardreq *reqs;
+    int n = 0;
+
+    w.TotalBytesToFetch = TotalBytesToFetch;
+    w.BytesFetched = BytesFetched;
+    w.s_prefetches = 0;
+    w.s_prefetched_blocks = 0;
+    w.enospc_failure = 0;
+
+    InitTally();  // Delete old list and start over
+    TallyPrint(PrimaryUser);		   
+
+    /* Collect the objects to fetch up front, in priority order. Fetching
+     * moves objects around on the priority queue, so we can't iterate over
+     * it while the fetchers are running. */
+    reqs = (struct hoardreq *)malloc((FSDB->htab.count() + 1) * sizeof(*reqs));
+    CODA_ASSERT(reqs);
+
+    bstree_iterator next(*FSDB->prioq, BstDescending);
+    bsnode *b = 0;
+    while ((b = next())) {
+	fsobj *f = strbase(fsobj, b, prio_handle);
+	CODA_ASSERT(f != NULL);
+	int blocks = BLOCKS(f);
 
-	    /* Reacquire reference to object. */
-	    f = FSDB->Find(&tfid);
+	if (!HOARDABLE(f)) continue;
 
-	    if (vp->u.u_error == 0) {
-		s_prefetches++;
-		if (f) s_prefetched_blocks += (int) BLOCKS(f);
-	    }
+	if (DATAVALID(f)) {
+	  LOG(200, ("AVAILABLE:  fid=<%s> comp=%s priority=%d blocks=%d\n", 
+		  FID_(&f->fid), f->comp, f->priority, blocks));
+	  TallyAllHDBentries(f->hdb_bindings, blocks, TSavailable);
+	  continue;
+	}
 
-	    /* Abandon the iteration when a prefetch fails due to ENOSPC. */
-	    if (vp->u.u_error == ENOSPC) {
-		enospc_failure = 1;
-		break;
-	    }
+	reqs[n].fid = f->fid;
+	reqs[n].f = f;
+	reqs[n].uid = f->HoardVuid;
+	reqs[n].priority = f->priority;
+	reqs[n].length = f->stat.Length;
+	reqs[n].state = HR_PENDING;
+	n++;
+    }
 
-	    /* Object not on prioq --> iterator no longer valid */
-	    if (f == 0 || !REPLACEABLE(f)) {
-		LOG(0, ("hdb::Walk: (%s) !FOUND or !REPLACEABLE after prefetch\n",
-			FID_(&tfid)));
-		iterate = 1;
-		break;
-	    }
+    prefetches = RunHoardRequests(vp, reqs, n, RC_DATA, &hdb::DataDone, &w);
+    free(reqs);
 
-	    /* Record availability of this object. */
-	    CODA_ASSERT(f != 0);
-	    blocks = BLOCKS(f);
-	    if (DATAVALID(f)) {
-	      LOG(100, ("AVAILABLE (fetched):  fid=<%s> comp=%s priority=%d blocks=%d\n", 
-			FID_(&f->fid), f->comp, f->priority, blocks));
-	      TallyAllHDBentries(f->hdb_bindings, blocks, TSavailable);
-	      BytesFetched += f->stat.Length;
-	      HoardWalkProgress(BytesFetched, TotalBytesToFetch);
-	    } else {
-	      LOG(100, ("UNAVAILABLE (fetch failed):  fid=<%s> comp=%s priority=%d blocks=%d\n",
-		      FID_(&f->fid), f->comp, f->priority, blocks));
-	      TallyAllHDBentries(f->hdb_bindings, blocks, TSunavailable);
-	    }
-	}
-    }
+    HoardWalkStats.fetches += w.s_prefetches;
+    int enospc_failure = w.enospc_failure;
+    int s_prefetches = w.s_prefetches;
+    int s_prefetched_blocks = w.s_prefetched_blocks;
 
     END_TIMING();
     LOG(100, ("hdb::Walk(data): iterations = %d, prefetches = %d, elapsed = %3.1f\n",
@@ -872,6 +1085,10 @@ int hdb::Walk(hdb_walk_msg *m, uid_t local_id) {
     /* NotifyUsersOfHoardWalkBegin(); */
 
     vproc *vp = VprocSelf();
+    struct timeval start, end;
+
+    memset(&HoardWalkStats, 0, sizeof(HoardWalkStats));
+    gettimeofday(&start, NULL);
 
     /* Set the time of the last demand hoard walk */
     if (local_id == V_UID || AuthorizedUser(local_id)) 
@@ -897,6 +1114,16 @@ int hdb::Walk(hdb_walk_msg *m, uid_t local_id) {
     /* Determine the post-walk status. */
     PostWalkStatus();
 
+    gettimeofday(&end, NULL);
+    HoardWalkStats.msec = (end.tv_sec - start.tv_sec) * 1000 +
+			  (end.tv_usec - start.tv_usec) / 1000;
+    LOG(0, ("hdb::Walk: %d validations, %d fetches, %lld KB in %lu msec (%.1f KB/s), %d walkers\n",
+	    HoardWalkStats.validations, HoardWalkStats.fetches,
+	    HoardWalkStats.bytes / 1024, HoardWalkStats.msec,
+	    HoardWalkStats.msec ?
+		HoardWalkStats.bytes / 1.024 / HoardWalkStats.msec : 0.0,
+	    HoardWalkers));
+
     /* NotifyUsersOfHoardWalkEnd(); */
 
     return(0);
@@ -993,6 +1220,10 @@ void hdb::print(int fd, int SummaryOnly) {
 	     MaxHDBEs, htab.count(), freelist.count(),
 	     ValidCount, SuspectCount, IndigentCount, InconsistentCount,
 	     MetaExpansions, MetaNameCtxts);
+    fdprint(fd, "last walk: validations = %d, fetches = %d, KB = %lld, msec = %lu, walkers = %d, bandwidth = %d KB/s\n",
+	    HoardWalkStats.validations, HoardWalkStats.fetches,
+	    HoardWalkStats.bytes / 1024, HoardWalkStats.msec,
+	    HoardWalkers, HoardBandwidth);
 
     if (!SummaryOnly) {
 	hdb_iterator next;
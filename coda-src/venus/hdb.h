@@ -141,6 +141,7 @@ class hdb_key;
 class hdbent;
 class hdb_iterator;
 class namectxt;
+struct hoardreq;
 
 
 /*  *****  Constants  *****  */
@@ -150,6 +151,7 @@ const int HDB_MagicNumber = 5551212;
 const int HDB_NBUCKETS = 2048;
 const int HDBENT_MagicNumber = 8204933;
 const int HDBMaxFreeEntries = 32;
+const int MAX_HOARD_WALKERS = 16;
 
 
 /*  *****  Types  *****  */
@@ -228,7 +230,11 @@ class hdb {
     void ResetUser(uid_t);
 
     /* Helper Routines hdb::Walk */
-    void ValidateCacheStatus(vproc *, int *, int *);
+    int RunHoardRequests(vproc *, struct hoardreq *, int, int,
+			 int (hdb::*)(struct hoardreq *, void *), void *);
+    int StatusDone(struct hoardreq *, void *);
+    int DataDone(struct hoardreq *, void *);
+    void ValidateCacheStatus(vproc *, int *);
     void ListPriorityQueue();
     void WalkPriorityQueue(vproc *, int *, int *);
     int CalculateTotalBytesToFetch();
@@ -397,6 +403,8 @@ class namectxt {
 /*  *****  Variables  *****  */
 
 extern int HDBEs;
+extern int HoardWalkers;
+extern int HoardBandwidth;
 extern int IndigentCount;
 
 
@@ -94,6 +94,7 @@ int   CacheBlocks;
 uid_t PrimaryUser = UNSET_PRIMARYUSER;
 const char *SpoolDir;
 const char *CheckpointFormat;
+const char *CachePolicy;
 const char *VenusPidFile;
 const char *VenusControlFile;
 const char *VenusLogFile;
@@ -291,12 +292,14 @@ static void Usage(char *argv0)
 " -maxworkers <n>\t\t# of worker threads\n"
 " -maxcbservers <n>\t\t# of callback server threads\n"
 " -maxprefetchers <n>\t\t# of threads servicing prefetch ioctl\n"
+" -upcallbatch <n>\t\tmax # of upcalls read per mux pass\n"
 " -retries <n>\t\t\t# of rpc2 retries\n"
 " -timeout <n>\t\t\trpc2 timeout\n"
 " -ws <n>\t\t\tsftp window size\n"
 " -sa <n>\t\t\tsftp send ahead\n"
 " -ap <n>\t\t\tsftp ack point\n"
 " -ps <n>\t\t\tsftp packet size\n"
+" -aw\t\t\t\tsize sftp window from bandwidth and rtt\n"
 " -rvmt <n>\t\t\tRVM type\n"
 " -vld <RVM log>\t\t\tlocation of RVM log\n"
 " -vlds <n>\t\t\tsize of RVM log\n"
@@ -375,6 +378,8 @@ static void ParseCmdline(int argc, char **argv)
 		i++, MaxCBServers = atoi(argv[i]);
 	    else if (STREQ(argv[i], "-maxprefetchers")) /* max number of threads */
 		i++, MaxPrefetchers = atoi(argv[i]);    /* doing prefetch ioctl */
+	    else if (STREQ(argv[i], "-upcallbatch")) /* upcalls read per mux pass */
+		i++, UpcallBatch = atoi(argv[i]);
 	    else if (STREQ(argv[i], "-console"))      /* location of console file */
 		i++, consoleFile = argv[i];
 	    else if (STREQ(argv[i], "-retries"))      /* number of rpc2 retries */
@@ -389,6 +394,8 @@ static void ParseCmdline(int argc, char **argv)
 		i++, sftp_ackpoint = atoi(argv[i]);
 	    else if (STREQ(argv[i], "-ps"))           /* sftp packet size */
 		i++, sftp_packetsize = atoi(argv[i]);
+	    else if (STREQ(argv[i], "-aw"))           /* adaptive sftp window */
+		sftp_adaptivewindow = 1;
 	    else if (STREQ(argv[i], "-init"))        /* brain wipe rvm */
 		InitMetaData = 1;
 	    else if (STREQ(argv[i], "-newinstance")) /* fake a 'reinit' */
@@ -480,6 +487,7 @@ static void DefaultCmdlineParms()
     CODACONF_STR(kernDevice,	    "kerneldevice",  "/dev/cfs0,/dev/coda/0");
     CODACONF_INT(MapPrivate,	    "mapprivate",     0);
     CODACONF_STR(MarinerSocketPath, "marinersocket", "/usr/coda/spool/mariner");
+    CODACONF_INT(UpcallFastPath,    "upcall_fastpath", 1);
     CODACONF_INT(masquerade_port,   "masquerade_port", 0);
     CODACONF_INT(allow_backfetch,   "allow_backfetch", 0);
     CODACONF_STR(venusRoot,	    "mountpoint",     DFLT_VR);
@@ -496,6 +504,7 @@ static void DefaultCmdlineParms()
     CODACONF_INT(default_reintegration_age,  "reintegration_age",  0);
     CODACONF_INT(default_reintegration_time, "reintegration_time", 15);
     default_reintegration_time *= 1000; /* reintegration time is in msec */
+    CODACONF_INT(ReintStreams, "reintegration_streams", 4);
 
 #if defined(__CYGWIN32__)
     CODACONF_STR(CachePrefix, "cache_prefix", "/?" "?/C:/cygwin");
@@ -518,6 +527,7 @@ static void DefaultCmdlineParms()
 	    exit(-1); 
 	}
     }
+    CODACONF_INT(CacheDedup, "cache_dedup", 1);
 
     CODACONF_INT(MLEs, "cml_entries", 0);
     {
@@ -539,6 +549,8 @@ static void DefaultCmdlineParms()
 	    exit(-1); 
 	}
     }
+    CODACONF_INT(HoardWalkers, "hoard_walkers", 4);
+    CODACONF_INT(HoardBandwidth, "hoard_bandwidth", 0);
 
     CODACONF_STR(VenusPidFile, "pid_file", DFLT_PIDFILE);
     if (*VenusPidFile != '/') {
@@ -566,6 +578,12 @@ static void DefaultCmdlineParms()
 	    PiggyValidations = MAX_PIGGY_VALIDATIONS;
     }
 
+    CODACONF_INT(BulkValidations, "bulkvalidate", VICE_MAXVALIDATE);
+    {
+	if (BulkValidations > VICE_MAXVALIDATE)
+	    BulkValidations = VICE_MAXVALIDATE;
+    }
+
     /* Enable special tweaks for running in a VM
      * - Write zeros to container file contents before truncation.
      * - Disable reintegration replay detection. */
@@ -576,6 +594,15 @@ static void DefaultCmdlineParms()
 	detect_reintegration_retry = 0;
     }
 
+    CODACONF_STR(CachePolicy, "cachepolicy", "priority");
+    if (strcmp(CachePolicy, "slru") == 0) FSO_ReplPolicy = FSO_REPL_SLRU;
+    else if (strcmp(CachePolicy, "priority") == 0)
+	FSO_ReplPolicy = FSO_REPL_PRIORITY;
+    else
+	eprint("Unknown cachepolicy '%s', using 'priority'", CachePolicy);
+
+    CODACONF_INT(FSO_PartialFetchKB, "partialfetch", 0);
+
     CODACONF_STR(CheckpointFormat,  "checkpointformat", "newc");
     if (strcmp(CheckpointFormat, "tar") == 0)	archive_type = TAR_TAR;
     if (strcmp(CheckpointFormat, "ustar") == 0) archive_type = TAR_USTAR;
@@ -37,6 +37,17 @@ cacheblocks=100000
 #
 #cachefiles=0
 
+#
+# Should files with the same contents share their cache files.
+#
+# When a server reports a SHA checksum for a file and another cached file
+# has the same contents, the data is not fetched but shared with the other
+# cache file, with a reflink where the cache filesystem supports it or a
+# hard link otherwise. Shared blocks are only counted once against
+# cacheblocks.
+#
+#cache_dedup=1
+
 #
 # How many modification log entries should venus have. If this is not
 # specified or `0' the value is calculated as 'cacheblocks / 6'.
@@ -53,6 +64,17 @@ cacheblocks=100000
 #
 #hoard_entries=0
 
+#
+# Concurrency and bandwidth limit of hoard walks.
+#
+# A hoard walk validates and fetches up to hoard_walkers objects at the same
+# time, in priority order (at most 16, 0 fetches one object at a time).
+# hoard_bandwidth limits the rate at which file data is requested in KB/s,
+# 0 means no limit.
+#
+#hoard_walkers=4
+#hoard_bandwidth=0
+
 #
 # Which file should receive venus's stderr output.
 # (default is /usr/coda/etc/console).
@@ -115,6 +137,24 @@ checkpointdir=/var/lib/coda/spool
 #
 #checkpointformat=newc
 
+#
+# Cache replacement policy, 'priority' orders all cached objects by a
+# combination of recency and hoard priority which is periodically
+# recomputed. 'slru' keeps objects that are not hoarded on segmented LRU
+# lists, which avoids the periodic recomputation for large caches. Hoarded
+# objects are always replaced last.
+#
+#cachepolicy=priority
+
+#
+# Files of at least this many kilobytes that are opened read-only are
+# fetched on demand in pieces, reads are served as soon as the piece they
+# need has arrived and sequential readers get the following pieces fetched
+# in the background. This needs a kernel module that reports read access
+# intents. The default '0' always fetches whole files on open.
+#
+#partialfetch=0
+
 #
 # Where does venus store it's pidfile
 #
@@ -175,6 +215,15 @@ mapprivate=1
 #
 #kerneldevice=/dev/cfs0,/dev/coda/0
 
+#
+# Answer lookup, getattr and access upcalls for cached objects with valid
+# status and access rights directly, without handing them to a worker
+# thread. Set to 0 to send every upcall through a worker. The fraction of
+# upcalls answered this way and the upcall latencies are shown in the
+# worker section of the venus log after 'vutil --stats'.
+#
+#upcall_fastpath=1
+
 #
 # Masquerade port, if non-zero, bind the client to the specified port.
 # When masquerade_port=0, an arbitrary port is used.
@@ -205,6 +254,15 @@ mapprivate=1
 #
 #validateattrs=15
 
+#
+# When a volume has to be revalidated, for instance after a reconnection,
+# the version vectors of all its cached objects are sent to the servers in
+# batches of up to this many objects with a ViceValidateFids call. Several
+# batches are in flight at the same time. The maximum (and default) is 4096,
+# 0 falls back to validating objects with piggybacked ValidateAttrs calls.
+#
+#bulkvalidate=4096
+
 #
 # How many seconds between checks whether the servers are still alive. The
 # default used to be 12 minutes. However masquerading firewalls typically
@@ -287,6 +345,16 @@ mapprivate=1
 #reintegration_age=0
 #reintegration_time=15
 
+#
+# Number of store records whose data is sent to the servers concurrently.
+#
+# While the head of the log is being reintegrated, the file data of stores
+# further down the log is pushed through reintegration handles, each over
+# its own connection. Only stores that do not depend on an earlier record
+# for the same object are sent ahead. Set to 0 to send one store at a time.
+#
+#reintegration_streams=4
+
 #
 # Should the server detect retried reintegration attempts.
 #
@@ -130,7 +130,7 @@ static const char *VFSOpsNameTemplate[NVFSOPS] = {
     "Statfs",
     "Store",
     "Release",
-    "No-Op",
+    "AccessIntent",
     "No-Op",
     "No-Op"
 };
@@ -274,6 +274,7 @@ void VenusPrint(int fd, int argc, const char **argv)
     if (rusagep || allp)  RusagePrint(fd);
     if (recovp || allp)   if (RecovInited) RecovPrint(fd);
     if (vprocp || allp)   PrintVprocs(fd);
+    if (vprocp || allp)   PrintWorkers(fd);
     if (userp || allp)    UserPrint(fd);
     if (connp || allp)    ConnPrint(fd);
     if (volumep || allp)  if (RecovInited && VDB) VDB->print(fd);
@@ -394,6 +395,8 @@ const char *IoctlOpStr(unsigned char nr)
 	case _VIOC_SYNCCACHE:		return("Sync Cache");
 	case _VIOC_REP_CMD:		return("Rep CMD");
 	case _VIOC_UNLOADKERNEL:	return("Unload Kernel");
+	case _VIOC_CACHESTATS:		return("Cache Stats");
+	case _VIOC_OPTIMIZEML:		return("Optimize ML");
 	case _VIOC_EXPANDOBJECT:	return("Expand object");
 	case _VIOC_COLLAPSEOBJECT:	return("Collapse object");
 
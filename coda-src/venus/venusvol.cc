@@ -809,6 +809,19 @@ void vdb::print(int fd, int SummaryOnly)
             volrep_hash.count(), repvol_hash.count(), mlefreelist.count());
     fdprint(fd, "volume callbacks broken = %d, total callbacks broken = %d\n",
 	    vcbbreaks, cbbreaks);
+    {
+	struct ReintStats *rs = &VOL_ReintStats;
+	fdprint(fd, "reintegration: %lu chunks, %lu records, %lu bytes, largest chunk %lu\n",
+		rs->chunks, rs->records, rs->bytes, rs->maxchunk);
+	fdprint(fd, "\t%lu stores, %lu bytes (%lu streamed), %lu msec, %.1f KB/s\n",
+		rs->stores, rs->storebytes, rs->streamed, rs->msec,
+		rs->msec ? (rs->bytes + rs->storebytes) / 1.024 / rs->msec : 0.0);
+    }
+    {
+	struct ValidateStats *vs = &VOL_ValidateStats;
+	fdprint(fd, "bulk validation: %lu volumes, %lu batches, %lu of %lu objects valid, %lu msec\n",
+		vs->volumes, vs->batches, vs->valid, vs->fids, vs->msec);
+    }
     if (!SummaryOnly) {
         repvol_iterator rvnext;
         volrep_iterator vrnext;
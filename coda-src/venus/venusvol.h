@@ -138,6 +138,26 @@ class cmlstats {
     }
 };
 
+/* What a ClientModifyLog::Optimize pass saved. */
+struct cmloptstats {
+    int renames;	/* renames folded into the create or an earlier rename */
+    int modes;		/* chmods folded into the create */
+    int objects;	/* objects created and removed again, with their records */
+    int records;	/* records gone from the log */
+    long bytes;		/* log space freed */
+    float contents;	/* store data that no longer has to be shipped */
+};
+
+struct cmlckpstats {
+    int records;	/* log records written */
+    double bytes;	/* store data in the archive */
+    double deferred;	/* part of it copied after the log was unlocked */
+    double locked;	/* seconds the log was locked */
+    double elapsed;	/* seconds for the whole checkpoint */
+};
+
+class ckpspool;
+
 
 /* Log containing records of partitioned operations performed at the client. */
 /* This type is persistent! */
@@ -163,6 +183,11 @@ class ClientModifyLog {
      */
     long _bytes();
 
+    /* Rewrites done by Optimize. */
+    int FoldRename(cmlent *);
+    int FoldChmod(cmlent *);
+    int DropObject(cmlent *);
+
   public:
     ClientModifyLog() { ResetTransient(); }  /* MUST be called within transaction! */
     ~ClientModifyLog() { CODA_ASSERT(count() == 0); } /* MUST be called within transaction! */
@@ -173,6 +198,7 @@ class ClientModifyLog {
     /* Log optimization routines. */
     cmlent *LengthWriter(VenusFid *);
     cmlent *UtimesWriter(VenusFid *);
+    void Optimize(cmloptstats *);
 
     /* Reintegration routines. */
     void TranslateFid(VenusFid *, VenusFid *);
@@ -186,7 +212,7 @@ class ClientModifyLog {
     void ClearToBeRepaired(); /* must not be called within transaction! */
     void CancelStores();
 
-    int GetReintegrateable(int, unsigned long *, int *);
+    int GetReintegrateable(int, unsigned long *, int *, int);
     cmlent *GetFatHead(int);
 
     /* Call to set/clear flags for whether it's safe to cancel frozen entries */
@@ -194,7 +220,7 @@ class ClientModifyLog {
 
     /* Routines for handling inconsistencies and safeguarding against catastrophe! */
     void MakeUsrSpoolDir(char *);
-    int	CheckPoint(char *);
+    int	CheckPoint(char *, cmlckpstats *);
 
     void AttachFidBindings();
 
@@ -393,11 +419,13 @@ class cmlent {
     int GetReintegrationHandle();
     int ValidateReintegrationHandle();
     int WriteReintegrationHandle(unsigned long *reint_time);
+    int FillReintegrationHandle(unsigned long *reint_time);
     int CloseReintegrationHandle(char *, int, ViceVersionVector *);
+    int IsStreaming();
 
     /* Routines for handling inconsistencies and safeguarding against catastrophe! */
     void abort();
-    int checkpoint(FILE *);
+    int checkpoint(FILE *, ckpspool *);
     void writeops(FILE *);
 
     void getfids(VenusFid fid[3]);
@@ -824,6 +852,8 @@ class repvol : public volent {
     void Reintegrate();
     int IncReintegrate(int);
     int PartialReintegrate(int, unsigned long *reint_time);
+    void StartReintStreams(int *, unsigned long);
+    void WaitReintStreams(int *);
     int IsReintegrating() { return flags.reintegrating; }
     int ReadyToReintegrate();
     int GetReintId();                           /*U*/
@@ -832,9 +862,10 @@ class repvol : public volent {
     int SyncCache(VenusFid *fid = NULL);
 
     void RestoreObj(VenusFid *);
-    int	CheckPointMLEs(uid_t, char *);
+    int	CheckPointMLEs(uid_t, char *, cmlckpstats *);
     int LastMLETime(unsigned long *);
     int PurgeMLEs(uid_t);
+    int OptimizeMLEs(uid_t, cmloptstats *);
     void ResetStats() { CML.ResetHighWater(); }
     int WriteDisconnect(unsigned int age=V_UNSETAGE,
 			unsigned int time=V_UNSETREINTLIMIT);
@@ -908,6 +939,8 @@ class repvol : public volent {
     void SetCallBack();
     int WantCallBack();
     int ValidateFSOs();
+    int BulkValidate(uid_t);
+    int ValidateFids(uid_t, struct ViceValidateRec *, int);
 
     /* ASR routines */
     int AllowASR(uid_t);
@@ -1029,6 +1062,46 @@ extern void VOLD_Init(void);
 /* vol_reintegrate.c */
 extern void Reintegrate(repvol *);
 
+/* Records packed into a single reintegration RPC. The count starts at
+ * REINT_CHUNK and is doubled or halved depending on how long the previous
+ * RPC took compared to REINT_CHUNKTIME. */
+const int REINT_CHUNK = 100;
+const int REINT_MINCHUNK = 25;
+const int REINT_MAXCHUNK = 800;
+const unsigned long REINT_CHUNKTIME = 5000;	/* msec */
+
+/* Upper bound for the reintegration_streams option. */
+const int MAX_REINT_STREAMS = 16;
+extern int ReintStreams;
+
+struct ReintStats {
+    unsigned long chunks;	/* successful reintegration RPCs */
+    unsigned long records;	/* ... and the records they carried */
+    unsigned long bytes;	/* ... and the size of the packed records */
+    unsigned long stores;	/* stores committed through a handle */
+    unsigned long storebytes;	/* data sent with SendReintFragment */
+    unsigned long streamed;	/* ... of which by background streams */
+    unsigned long maxchunk;	/* largest chunk size reached */
+    unsigned long msec;		/* time spent in reintegration RPCs */
+};
+extern struct ReintStats VOL_ReintStats;
+
+/* vol_vcb.c */
+
+/* Batches of ViceValidateFids that may be outstanding at the same time,
+ * each one is sent by its own vproc. */
+const int MAX_VALIDATORS = 4;
+extern int BulkValidations;
+
+struct ValidateStats {
+    unsigned long volumes;	/* volumes validated in bulk */
+    unsigned long batches;	/* ViceValidateFids RPCs */
+    unsigned long fids;		/* objects sent */
+    unsigned long valid;	/* ... that were still valid */
+    unsigned long msec;		/* time spent validating volumes */
+};
+extern struct ValidateStats VOL_ValidateStats;
+
 /* vol_resolve.c */
 extern void Resolve(volent *);
 
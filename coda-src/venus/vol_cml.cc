@@ -40,6 +40,11 @@ extern "C" {
 
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
 
 #include <netinet/in.h>
 
@@ -180,7 +185,8 @@ void ClientModifyLog::CancelPending() {
 	    cmlent *m;
 
 	    while ((m = next())) {
-		if (m->flags.cancellation_pending) {
+		/* a background stream still uses the record */
+		if (m->flags.cancellation_pending && !m->IsStreaming()) {
 		    m->Thaw();
 		
 		    CODA_ASSERT(m->cancel());
@@ -229,6 +235,261 @@ void ClientModifyLog::CancelStores()
     }
 }
 
+
+/* Records that may be visible at the servers already, or that local repair
+ * still needs, are never rewritten. */
+static int Pinned(cmlent *m)
+{
+    return m->IsFrozen() || m->IsToBeRepaired();
+}
+
+/*
+ * Fold a rename within one directory into the record that gave the object
+ * its old name, if that is the directory's last update before the rename.
+ * "create tmp; rename tmp final" becomes "create final".
+ * MUST be called from within a transaction.
+ */
+int ClientModifyLog::FoldRename(cmlent *m)
+{
+    VenusFid *PFid = &m->u.u_rename.SPFid;
+    VenusFid *SFid = &m->u.u_rename.SFid;
+    RPC2_String *namep = NULL;
+    cmlent *c;
+
+    if (!FID_EQ(PFid, &m->u.u_rename.TPFid))
+	return 0;
+
+    /* the rename is bound to the directory twice, skip both bindings */
+    cml_iterator prev(*this, AbortOrder, PFid, m);
+    while ((c = prev()) == m)
+	;
+    if (!c || Pinned(c))
+	return 0;
+
+    switch (c->opcode) {
+    case CML_Create_OP:
+	if (FID_EQ(&c->u.u_create.PFid, PFid) &&
+	    FID_EQ(&c->u.u_create.CFid, SFid))
+	    namep = &c->Name;
+	break;
+
+    case CML_MakeDir_OP:
+	if (FID_EQ(&c->u.u_mkdir.PFid, PFid) &&
+	    FID_EQ(&c->u.u_mkdir.CFid, SFid))
+	    namep = &c->Name;
+	break;
+
+    case CML_SymLink_OP:
+	if (FID_EQ(&c->u.u_symlink.PFid, PFid) &&
+	    FID_EQ(&c->u.u_symlink.CFid, SFid))
+	    namep = &c->NewName;
+	break;
+
+    case CML_Rename_OP:
+	/* also works when the earlier rename moved it here from elsewhere */
+	if (FID_EQ(&c->u.u_rename.TPFid, PFid) &&
+	    FID_EQ(&c->u.u_rename.SFid, SFid))
+	    namep = &c->NewName;
+	break;
+    }
+    if (!namep || !*namep || strcmp((char *)*namep, (char *)m->Name) != 0)
+	return 0;
+
+    LOG(10, ("ClientModifyLog::FoldRename: (%s) %s -> %s\n", FID_(SFid),
+	     (char *)*namep, (char *)m->NewName));
+
+    bytes -= c->bytes();
+    RVMLIB_REC_OBJECT(*namep);
+    Free_RPC2_String(*namep);
+    *namep = Copy_RPC2_String(m->NewName);
+    bytes += c->bytes();
+
+    return m->cancel();
+}
+
+/*
+ * Fold a chmod into the create of the object.  Like LogChmod, stay away
+ * from it when a store or chown comes in between, the server may clear the
+ * setuid bits on those.
+ * MUST be called from within a transaction.
+ */
+int ClientModifyLog::FoldChmod(cmlent *m)
+{
+    VenusFid *Fid = &m->u.u_chmod.Fid;
+    RPC2_Unsigned *modep = NULL;
+    cml_iterator next(*this, CommitOrder, Fid);
+    cmlent *c = next(), *n;
+
+    if (!c || c == m || Pinned(c))
+	return 0;
+
+    switch (c->opcode) {
+    case CML_Create_OP:
+	if (FID_EQ(&c->u.u_create.CFid, Fid))
+	    modep = &c->u.u_create.Mode;
+	break;
+
+    case CML_MakeDir_OP:
+	if (FID_EQ(&c->u.u_mkdir.CFid, Fid))
+	    modep = &c->u.u_mkdir.Mode;
+	break;
+
+    case CML_SymLink_OP:
+	if (FID_EQ(&c->u.u_symlink.CFid, Fid))
+	    modep = &c->u.u_symlink.Mode;
+	break;
+    }
+    if (!modep)
+	return 0;
+
+    while ((n = next()) && n != m)
+	if (n->opcode == CML_Store_OP || n->opcode == CML_Chown_OP)
+	    return 0;
+
+    LOG(10, ("ClientModifyLog::FoldChmod: (%s) %o\n", FID_(Fid),
+	     m->u.u_chmod.Mode));
+
+    RVMLIB_REC_OBJECT(*modep);
+    *modep = m->u.u_chmod.Mode;
+
+    return m->cancel();
+}
+
+/*
+ * Drop an object that was created and removed again while the log was
+ * being built, along with everything else that was logged for it.  This
+ * is the identity cancellation done by LogRemove and LogRmdir, tried again
+ * once the other rewrites have run (and when LogOpts was off while the log
+ * was written).  A directory only goes if nothing in the log still depends
+ * on its children.
+ * MUST be called from within a transaction.
+ */
+int ClientModifyLog::DropObject(cmlent *m)
+{
+    VenusFid *Fid;
+    int isdir = (m->opcode == CML_RemoveDir_OP);
+    cmlent *c;
+
+    if (isdir)
+	Fid = &m->u.u_rmdir.CFid;
+    else if (m->u.u_remove.LinkCount == 1)
+	Fid = &m->u.u_remove.CFid;
+    else
+	return 0;
+
+    {
+	cml_iterator next(*this, CommitOrder, Fid);
+	c = next();
+	if (!c)
+	    return 0;
+	if (isdir ? c->opcode != CML_MakeDir_OP :
+	    (c->opcode != CML_Create_OP && c->opcode != CML_SymLink_OP))
+	    return 0;
+    }
+
+    {
+	cml_iterator next(*this, AbortOrder, Fid);
+	while ((c = next())) {
+	    if (Pinned(c) || c->opcode == CML_Repair_OP)
+		return 0;
+
+	    if (!isdir)
+		continue;
+
+	    switch (c->opcode) {
+	    case CML_Create_OP:
+	    case CML_Remove_OP:
+	    case CML_Link_OP:
+	    case CML_SymLink_OP:
+		return 0;
+
+	    case CML_RemoveDir_OP:
+		if (!FID_EQ(Fid, &c->u.u_rmdir.CFid))
+		    return 0;
+		break;
+
+	    case CML_MakeDir_OP:
+		if (!FID_EQ(Fid, &c->u.u_mkdir.CFid))
+		    return 0;
+		break;
+
+	    case CML_Rename_OP:
+		if (!FID_EQ(Fid, &c->u.u_rename.SFid))
+		    return 0;
+		break;
+	    }
+	}
+    }
+
+    LOG(10, ("ClientModifyLog::DropObject: (%s)\n", FID_(Fid)));
+
+    /* cancelling a record may take other records of the object along */
+    int cancellation;
+    do {
+	cancellation = 0;
+	cml_iterator next(*this, AbortOrder, Fid);
+	while (!cancellation && (c = next()))
+	    cancellation = c->cancel();
+    } while (cancellation);
+
+    return 1;
+}
+
+/*
+ * Rewrite the log into a shorter equivalent one: renames within a
+ * directory are folded into the create (or previous rename) of the object,
+ * chmods into the create, and objects that were created and removed again
+ * disappear from the log together with their subtree.  Records that are
+ * being reintegrated are left alone.  Every rewrite only touches records
+ * at or before the current one, so the log can be scanned once.
+ * MUST NOT be called from within a transaction.
+ */
+void ClientModifyLog::Optimize(cmloptstats *stats)
+{
+    cml_iterator next(*this, CommitOrder);
+    cmlent *m, *n;
+    int records = count();
+    long size = bytes;
+    float contents = cancellations.store_contents_size;
+
+    memset(stats, 0, sizeof(*stats));
+
+    m = next(); n = next();
+    while (m) {
+	if (!Pinned(m) && !m->flags.prepended) {
+	    Recov_BeginTrans();
+	    switch (m->opcode) {
+	    case CML_Rename_OP:
+		if (FoldRename(m))
+		    stats->renames++;
+		break;
+
+	    case CML_Chmod_OP:
+		if (FoldChmod(m))
+		    stats->modes++;
+		break;
+
+	    case CML_Remove_OP:
+	    case CML_RemoveDir_OP:
+		if (DropObject(m))
+		    stats->objects++;
+		break;
+	    }
+	    Recov_EndTrans(MAXFP);
+	}
+	m = n;
+	n = next();
+    }
+
+    stats->records = records - count();
+    stats->bytes = size - bytes;
+    stats->contents = cancellations.store_contents_size - contents;
+
+    LOG(0, ("ClientModifyLog::Optimize: %d records, %ld bytes, %.0f bytes of data saved (%d renames, %d modes, %d objects)\n",
+	    stats->records, stats->bytes, stats->contents, stats->renames,
+	    stats->modes, stats->objects));
+}
+
 /* MUST be called from within a transaction */
 int cmlent::Freeze()
 {
@@ -289,15 +550,17 @@ void cmlent::Thaw()
  * Scan the log for reintegrateable records, subject to the
  * reintegration time limit, and mark them with the given
  * tid. Note the time limit does not apply to ASRs.
+ * At most maxrecs records are marked, and a chunk is also closed when
+ * the estimated time to send it exceeds REINT_CHUNKTIME.
  * The routine returns the number of records marked.
  */
 int ClientModifyLog::GetReintegrateable(int tid, unsigned long *reint_time,
-					int *nrecs)
+					int *nrecs, int maxrecs)
 {
     repvol *vol = strbase(repvol, this, CML);
     cmlent *m;
     cml_iterator next(*this, CommitOrder);
-    unsigned long this_time;
+    unsigned long this_time, chunk_time = 0;
     unsigned long bw; /* bandwidth in bytes/sec */
     int err;
     int done = 1;
@@ -317,6 +580,14 @@ int ClientModifyLog::GetReintegrateable(int tid, unsigned long *reint_time,
 	    break;
 	}
 
+	/* stores that already have data at the servers, or are being
+	 * sent right now, go through PartialReintegrate */
+	if (m->opcode == CML_Store_OP &&
+	    (m->HaveReintegrationHandle() || m->IsStreaming())) {
+	    done = 0;
+	    break;
+	}
+
 	if (m->ReintReady() != 0)
 	    break;
 
@@ -328,6 +599,12 @@ int ClientModifyLog::GetReintegrateable(int tid, unsigned long *reint_time,
 	if (!vol->IsSync() && *nrecs && this_time > *reint_time)
 	    break;
 
+	/* keep a single reintegration RPC reasonably short */
+	if (*nrecs && chunk_time + this_time > REINT_CHUNKTIME) {
+	    done = 0;
+	    break;
+	}
+
 	/*
 	 * freeze the record to prevent cancellation.  Note that
 	 * reintegrating --> frozen, but the converse is not true.
@@ -346,12 +623,13 @@ int ClientModifyLog::GetReintegrateable(int tid, unsigned long *reint_time,
 	 */
 	m->tid = tid;
 	*reint_time -= this_time;
+	chunk_time += this_time;
 
 	/*
-	 * By sending records in blocks of 100 CMLentries, we avoid
+	 * By sending records in blocks of CMLentries, we avoid
 	 * overloading the server. JH
 	 */
-	if (++(*nrecs) == 100) {
+	if (++(*nrecs) == maxrecs) {
 	    done = 0;
 	    break;
 	}
@@ -1580,7 +1858,7 @@ int cmlent::cancel()
     time_t curTime = Vtime();
 
     if (IsToBeRepaired()) {
-	if (log->cancelFrozenEntries && IsFrozen()) {
+	if (log->cancelFrozenEntries && IsFrozen() && !IsStreaming()) {
 	    LOG(0, ("cmlent::cancel: frozen cmlent with local fid, thawing and cancelling\n"));
 	    Thaw();
 	}
@@ -2940,6 +3218,10 @@ int cmlent::WriteReintegrationHandle(unsigned long *reint_time)
 	    RVMLIB_REC_OBJECT(u);
 	    u.u_store.Offset += length;
 	Recov_EndTrans(MAXFP);
+
+	VOL_ReintStats.storebytes += length;
+	if (IsStreaming())
+	    VOL_ReintStats.streamed += length;
     }
 
  Exit:
@@ -2952,6 +3234,33 @@ int cmlent::WriteReintegrationHandle(unsigned long *reint_time)
 }
 
 
+/*
+ * Make sure we have a valid handle and send as much of the file data as the
+ * reintegration time allows.
+ */
+int cmlent::FillReintegrationHandle(unsigned long *reint_time)
+{
+    int code;
+
+    /* 
+     * If we have a handle, check the status.
+     * If this is a new transfer, get a handle from the server.
+     */
+    if (HaveReintegrationHandle()) 
+	 code = ValidateReintegrationHandle();
+    else code = EBADF;
+
+    if (code)
+	code = GetReintegrationHandle();
+
+    /* send some file data to the server */
+    while (code == 0 && !DoneSending())
+	code = WriteReintegrationHandle(reint_time);
+
+    return(code);
+}
+
+
 int cmlent::CloseReintegrationHandle(char *buf, int bufsize, 
 				     ViceVersionVector *UpdateSet)
 {
@@ -3504,7 +3813,7 @@ void RecoverPathName(char *path, VenusFid *fid, ClientModifyLog *CML, cmlent *st
 }
 
 
-int repvol::CheckPointMLEs(uid_t uid, char *ckpdir) 
+int repvol::CheckPointMLEs(uid_t uid, char *ckpdir, cmlckpstats *stats) 
 {
     if (CML.count() == 0)
 	return(ENOENT);
@@ -3515,7 +3824,7 @@ int repvol::CheckPointMLEs(uid_t uid, char *ckpdir)
 	    CHOKE("CheckPointMLEs started while in transaction!");
     }
 
-    int code = CML.CheckPoint(ckpdir);
+    int code = CML.CheckPoint(ckpdir, stats);
     return(code);
 }
 
@@ -3575,6 +3884,23 @@ int repvol::PurgeMLEs(uid_t uid)
 }
 
 
+/* MUST NOT be called from within transaction! */
+int repvol::OptimizeMLEs(uid_t uid, cmloptstats *stats)
+{
+    if (CML.count() == 0)
+	return(ENOENT);
+    if (CML.owner != uid && uid != V_UID)
+	return(EACCES);
+    if (IsReintegrating())
+	return(EBUSY);
+
+    LOG(0, ("repvol::OptimizeMLEs:(%s) (%x.%x)\n", name, realm->Id(), vid));
+
+    CML.Optimize(stats);
+    return(0);
+}
+
+
 int repvol::LastMLETime(unsigned long *time)
 {
     if (CML.count() == 0)
@@ -3631,7 +3957,113 @@ static int WriteLinks(struct DirEntry *de, void *arg)
     return 0;
 }
 
-int cmlent::checkpoint(FILE *fp)
+/*
+ * Store data for a checkpoint in progress. While the log is locked the
+ * containers are cloned, sharing their blocks, and only room for the data
+ * is left in the archive. Once the log is unlocked, the clones are copied
+ * into that room. Containers that can't be cloned are copied right away.
+ */
+struct ckpdata {
+    char *clone;
+    off_t offset;
+    size_t length;
+};
+
+class ckpspool {
+    ckpdata *ents;
+    int count, size;
+
+  public:
+    double bytes;
+    double deferred;
+
+    ckpspool() { ents = NULL; count = size = 0; bytes = deferred = 0; }
+    ~ckpspool();
+
+    int Add(FILE *fp, const char *container, size_t length);
+    int Copy(int fd);
+};
+
+ckpspool::~ckpspool()
+{
+    for (int i = 0; i < count; i++) {
+	::unlink(ents[i].clone);
+	free(ents[i].clone);
+    }
+    free(ents);
+}
+
+int ckpspool::Add(FILE *fp, const char *container, size_t length)
+{
+    char clone[MAXPATHLEN];
+    int cloned = 0;
+
+    bytes += length;
+
+#ifdef FICLONE
+    {
+	static unsigned int seq;
+	snprintf(clone, sizeof(clone), "%s.ck%u", container, seq++);
+
+	int sfd = ::open(container, O_RDONLY | O_BINARY);
+	int tfd = ::open(clone, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, V_MODE);
+
+	if (sfd >= 0 && tfd >= 0 && ::ioctl(tfd, FICLONE, sfd) == 0)
+	    cloned = 1;
+	if (sfd >= 0) ::close(sfd);
+	if (tfd >= 0) {
+	    ::close(tfd);
+	    if (!cloned) ::unlink(clone);
+	}
+    }
+#endif
+
+    if (cloned && count == size) {
+	int newsize = size ? 2 * size : 64;
+	ckpdata *newents = (ckpdata *)realloc(ents, newsize * sizeof(ckpdata));
+	if (newents) {
+	    ents = newents;
+	    size = newsize;
+	}
+    }
+
+    if (!cloned || count == size) {
+	if (cloned) ::unlink(clone);
+	return archive_write_data(fp, container);
+    }
+
+    ents[count].clone = strdup(clone);
+    ents[count].offset = ftello(fp);
+    ents[count].length = length;
+    if (!ents[count].clone) {
+	::unlink(clone);
+	return archive_write_data(fp, container);
+    }
+    count++;
+    deferred += length;
+
+    return archive_skip_data(fp, length);
+}
+
+/* The log is no longer locked, fill in the data we left room for. */
+int ckpspool::Copy(int fd)
+{
+    int code = 0;
+
+    for (int i = 0; i < count; i++) {
+	if (!code &&
+	    archive_copy_data(fd, ents[i].offset, ents[i].clone,
+			      ents[i].length) == -1)
+	    code = (errno == ENOSPC) ? ENOSPC : EIO;
+
+	::unlink(ents[i].clone);
+	free(ents[i].clone);
+    }
+    count = 0;
+    return code;
+}
+
+int cmlent::checkpoint(FILE *fp, ckpspool *spool)
 {
     /* counter to create unique inode numbers in the generated archive file */
     static int inode = 1;
@@ -3676,7 +4108,7 @@ int cmlent::checkpoint(FILE *fp)
 
 	    /* write out file contents */
 	    if (u.u_store.Length) {
-		err = archive_write_data(fp, f->data.file->Name());
+		err = spool->Add(fp, f->data.file->Name(), u.u_store.Length);
 		if (err) return err;
 	    }
 
@@ -3752,7 +4184,7 @@ static void BackupOldFile(const char *name)
 }
 
 /* Returns {0, ENOSPC}. */
-int ClientModifyLog::CheckPoint(char *ckpdir)
+int ClientModifyLog::CheckPoint(char *ckpdir, cmlckpstats *stats)
 {
     repvol *vol = strbase(repvol, this, CML);
     LOG(1, ("ClientModifyLog::CheckPoint: (%s), cdir = %s\n",
@@ -3801,6 +4233,8 @@ int ClientModifyLog::CheckPoint(char *ckpdir)
 	eprint("Couldn't open %s for checkpointing", ckpname);
 	return(ENOENT);
     }
+    /* store data bypasses stdio, the buffer only holds headers */
+    setvbuf(dfp, NULL, _IOFBF, 256 * 1024);
 #ifndef __CYGWIN32__
     ::fchown(fileno(dfp), owner, V_GID);
 #else
@@ -3825,28 +4259,51 @@ int ClientModifyLog::CheckPoint(char *ckpdir)
      * necessary because the thread yields during file write.  If at the time
      * there is another thread doing mutations to the volume causing some of
      * the elements in the CML being iterated to be canceled, venus will
-     * assertion fail.
+     * assertion fail. Store data that could be cloned is only copied
+     * after the lock is released.
      */
+    struct timeval start, unlocked, end;
+    ckpspool spool;
+    int records = 0;
+
+    gettimeofday(&start, NULL);
     ObtainWriteLock(&vol->CML_lock);
     eprint("Checkpointing %s to %s and %s", vol->name, ckpname, lname);
     cml_iterator next(*this, CommitOrder);
     cmlent *m;
     while ((m = next())) {
 	m->writeops(ofp);
+	records++;
 	if (code) continue;
-	code = m->checkpoint(dfp);
+	code = m->checkpoint(dfp, &spool);
     }
+
+    /* Write the trailer block and flush the headers. */
+    if (code == 0)
+	code = archive_write_trailer(dfp);
+    ReleaseWriteLock(&vol->CML_lock);
+    gettimeofday(&unlocked, NULL);
+
+    if (code == 0)
+	code = spool.Copy(fileno(dfp));
+    gettimeofday(&end, NULL);
+
     if (code) {
 	LOG(0, ("checkpointing of %s to %s failed (%d)",
 		vol->name, ckpname, code));
 	eprint("checkpointing of %s to %s failed (%d)",
 	       vol->name, ckpname, code);
     };
-    ReleaseWriteLock(&vol->CML_lock);
 
-    /* Write the trailer block and flush the data. */
-    if (code == 0)
-	code = archive_write_trailer(dfp);
+    if (stats) {
+	stats->records = records;
+	stats->bytes = spool.bytes;
+	stats->deferred = spool.deferred;
+	stats->locked = (unlocked.tv_sec - start.tv_sec) +
+			(unlocked.tv_usec - start.tv_usec) / 1e6;
+	stats->elapsed = (end.tv_sec - start.tv_sec) +
+			 (end.tv_usec - start.tv_usec) / 1e6;
+    }
 
     /* Close the CKP file. */
     fclose(dfp);
@@ -55,10 +55,12 @@ extern "C" {
 #endif
 
 #include <sys/types.h>
+#include <sys/time.h>
 #include <stdio.h>
 #include <struct.h>
 
 #include <rpc2/errors.h>
+#include <cml.h>
 
 #ifdef __cplusplus
 }
@@ -72,6 +74,20 @@ extern "C" {
 #include "vproc.h"
 
 
+/* number of stores whose data may be sent in the background */
+int ReintStreams = 4;
+
+struct ReintStats VOL_ReintStats;
+
+static unsigned long ElapsedMsec(struct timeval *start)
+{
+    struct timeval now;
+    gettimeofday(&now, 0);
+    return (now.tv_sec - start->tv_sec) * 1000 +
+	   (now.tv_usec - start->tv_usec) / 1000;
+}
+
+
 /* must not be called from within a transaction */
 void repvol::Reintegrate()
 {
@@ -112,24 +128,44 @@ void repvol::Reintegrate()
     /* step 1.  scan the log, cancelling stores for open-for-write files. */
     CML.CancelStores();
 
+    /* step 1b. shorten the log where the log-time optimizations couldn't. */
+    if (LogOpts) {
+	cmloptstats optstats;
+	CML.Optimize(&optstats);
+    }
+
     int nrecs, startedrecs, thisTid, code = 0;
     int stop_loop = 0;
+    int streams = 0;	/* background stores in flight */
+    int chunk = REINT_CHUNK;
+    unsigned long msec;
+    struct timeval start;
 
     /* remaining reintegration time (msec) */
     unsigned long reint_time = ReintLimit;
 
     /* We do the actual reintegration steps in a loop, as we reintegrate in
-     * blocks of 100 cmlents. JH */
+     * blocks of cmlents. JH */
     do {
         /* reset invariants */
         thisTid = -GetReintId();
         nrecs = 0;
 
+	/*
+	 * Stores further down the log are sent by background streams while
+	 * we deal with the head of the log. They have to be done before we
+	 * look at the head again, it may be one of theirs.
+	 */
+	WaitReintStreams(&streams);
+	StartReintStreams(&streams, reint_time);
+
 	/*
 	 * step 2. Attempt to do partial reintegration for big stores at
 	 * the head of the CML.
 	 */
+	gettimeofday(&start, 0);
 	code = PartialReintegrate(thisTid, &reint_time);
+	VOL_ReintStats.msec += ElapsedMsec(&start);
 
 	if (code == 0 && IsSync())
 	    continue;
@@ -149,7 +185,8 @@ void repvol::Reintegrate()
          * step 3.
          * scan the log, gathering records that are ready to to reintegrate.
          */
-        stop_loop = CML.GetReintegrateable(thisTid, &reint_time, &nrecs);
+        stop_loop = CML.GetReintegrateable(thisTid, &reint_time, &nrecs,
+					   chunk);
 
         /* nothing to reintegrate? jump out of the loop! */
         if (nrecs == 0) break;
@@ -163,13 +200,33 @@ void repvol::Reintegrate()
         startedrecs = CML.count();
         MarinerLog("reintegrate::%s, %d/%d\n", name, nrecs, startedrecs);
 
+	gettimeofday(&start, 0);
 	code = IncReintegrate(thisTid);
+	msec = ElapsedMsec(&start);
+	VOL_ReintStats.msec += msec;
 
 	/* Log how many entries are left to reintegrate */
 	MarinerLog("reintegrate::%s, 0/%d\n", name, CML.count());
         eprint("Reintegrate: %s, %d/%d records, result = %s", 
                name, nrecs, startedrecs, VenusRetStr(code));
 
+	/*
+	 * Fewer round trips when things go well, shorter volume lock
+	 * times at the servers when they don't.
+	 */
+	if (code == 0) {
+	    VOL_ReintStats.chunks++;
+	    VOL_ReintStats.records += nrecs;
+
+	    if (nrecs == chunk && msec < REINT_CHUNKTIME / 2)
+		chunk = chunk * 2 > REINT_MAXCHUNK ? REINT_MAXCHUNK : chunk * 2;
+	    else if (msec > REINT_CHUNKTIME)
+		chunk = chunk / 2 < REINT_MINCHUNK ? REINT_MINCHUNK : chunk / 2;
+
+	    if ((unsigned long)chunk > VOL_ReintStats.maxchunk)
+		VOL_ReintStats.maxchunk = chunk;
+	}
+
     /*
      * Keep going as long as we managed to reintegrate records without errors,
      * but we don't want to interfere with trickle reintegration so we test
@@ -177,6 +234,8 @@ void repvol::Reintegrate()
      */
     } while (code == 0 && !stop_loop);
 
+    WaitReintStreams(&streams);
+
     flags.reintegrating = 0;
 
     /* we have to clear sync_reintegrateto avoid recursion when exiting the
@@ -373,6 +432,7 @@ CheckResult:
 		/* Commit logged mutations upon successful replay at server. */
 		CML.IncCommit(&UpdateSet, tid);
 		LOG(0, ("volent::IncReintegrate: committed\n"));
+		VOL_ReintStats.bytes += bufsize;
 
 		CML.ClearPending();
 		break;
@@ -449,7 +509,7 @@ extern struct timeval *VprocRetryBeta;
 		 * before boosting this lock to prevent deadlock with mutator threads.
 		 */
 		ReleaseReadLock(&CML_lock);
-		CML.CheckPoint(0);
+		CML.CheckPoint(0, NULL);
 		ObtainReadLock(&CML_lock);
 
 		CML.CancelPending();
@@ -517,26 +577,9 @@ int repvol::PartialReintegrate(int tid, unsigned long *reint_time)
 	if (code != 0) goto CheckResult;
     }
 
-    /* 
-     * If we have a handle, check the status.
-     * If this is a new transfer, get a handle from the server.
-     */
+    /* get (or revalidate) a handle and send some file data to the server */
     {
-	if (m->HaveReintegrationHandle()) 
-	     code = m->ValidateReintegrationHandle();
-	else code = EBADF;
-
-	if (code)
-	    code = m->GetReintegrationHandle();
-
-	if (code) goto CheckResult;
-    }
-
-    /* send some file data to the server */
-    {
-	while (!m->DoneSending() && (code == 0))
-	    code = m->WriteReintegrationHandle(reint_time);
-
+	code = m->FillReintegrationHandle(reint_time);
 	if (code != 0) goto CheckResult;
     }
 
@@ -570,6 +613,7 @@ CheckResult:
 	    /* Commit logged mutations upon successful replay at server. */
 	    CML.IncCommit(&UpdateSet, tid);
 	    LOG(0, ("volent::PartialReintegrate: committed\n"));
+	    VOL_ReintStats.stores++;
 
 	    CML.ClearPending();
 	    code = 0;
@@ -601,7 +645,7 @@ CheckResult:
 
 	/* checkpoint the log */
 	ReleaseReadLock(&CML_lock);
-	CML.CheckPoint(0);
+	CML.CheckPoint(0, NULL);
 	ObtainReadLock(&CML_lock);
 
 	/* cancel, localize, or abort the offending record */
@@ -814,3 +858,215 @@ void reintegrator::main(void)
 	VprocWait((char *)this);
     }
 }
+
+
+/* *****  Reintegration streams  ***** */
+
+/*
+ * A reintegration stream sends the data of a single store record through a
+ * reintegration handle, concurrently with the reintegrator that works on the
+ * head of the log. Each stream uses its own connection, and so its own SFTP
+ * transfer. When the store reaches the head of the log PartialReintegrate
+ * finds the data at the server and only has to close the handle.
+ */
+
+static const int ReintStreamStackSize = 65536;
+static const int ReintStreamPriority = LWP_NORMAL_PRIORITY-2;
+
+class reintstream : public vproc {
+    static reintstream *slots[MAX_REINT_STREAMS];
+    static int FreeSlot();
+
+    cmlent *mle;
+    unsigned long reint_time;
+    int *outstanding;
+
+    reintstream();
+    reintstream(reintstream&);			/* not supported! */
+    int operator=(reintstream&) { abort(); return(0); }	/* not supported! */
+    ~reintstream();
+
+  protected:
+    virtual void main(void);
+
+  public:
+    static int Available();
+    static int Start(cmlent *, unsigned long, int *);
+    static int Busy(cmlent *);
+};
+
+reintstream *reintstream::slots[MAX_REINT_STREAMS];
+
+
+int reintstream::FreeSlot()
+{
+    int i, n = ReintStreams < MAX_REINT_STREAMS ? ReintStreams : MAX_REINT_STREAMS;
+
+    for (i = 0; i < n; i++)
+	if (!slots[i] || slots[i]->idle)
+	    return i;
+    return -1;
+}
+
+
+int reintstream::Available()
+{
+    return FreeSlot() != -1;
+}
+
+
+/* Hand the record to an idle stream, returns 0 if all streams are busy. */
+int reintstream::Start(cmlent *m, unsigned long reint_time, int *outstanding)
+{
+    int i = FreeSlot();
+
+    if (i == -1) return 0;
+
+    if (!slots[i])
+	slots[i] = new reintstream;
+    reintstream *r = slots[i];
+    CODA_ASSERT(r->idle);
+
+    r->u.Init();
+    r->mle = m;
+    r->reint_time = reint_time;
+    r->outstanding = outstanding;
+    (*outstanding)++;
+
+    r->idle = 0;
+    VprocSignal((char *)r);	/* ignored for new streams */
+    return 1;
+}
+
+
+int reintstream::Busy(cmlent *m)
+{
+    for (int i = 0; i < MAX_REINT_STREAMS; i++)
+	if (slots[i] && !slots[i]->idle && slots[i]->mle == m)
+	    return 1;
+    return 0;
+}
+
+
+reintstream::reintstream() :
+	vproc("ReintStream", NULL, VPT_Reintegrator, ReintStreamStackSize,
+	      ReintStreamPriority)
+{
+    LOG(100, ("reintstream::reintstream(%#x): %-16s : lwpid = %d\n",
+	       this, name, lwpid));
+
+    idle = 1;
+    mle = NULL;
+    start_thread();
+}
+
+
+reintstream::reintstream(reintstream& r) : vproc((vproc&)r) {
+    abort();
+}
+
+
+reintstream::~reintstream() {
+    LOG(100, ("reintstream::~reintstream: %-16s : lwpid = %d\n", name, lwpid));
+}
+
+
+/* See the comment at reintegrator::main about the yield. */
+void reintstream::main(void)
+{
+    VprocYield();
+
+    for (;;) {
+	if (idle) CHOKE("reintstream::main: signalled but not dispatched!");
+
+	/* Errors are dealt with when the record reaches the head of the
+	 * log, PartialReintegrate revalidates the handle then. */
+	int code = mle->FillReintegrationHandle(&reint_time);
+	LOG(0, ("reintstream::main: returns %s\n", VenusRetStr(code)));
+
+	seq++;
+	mle = NULL;
+	idle = 1;
+	(*outstanding)--;
+	VprocSignal(outstanding);
+
+	/* Wait for new request. */
+	VprocWait((char *)this);
+    }
+}
+
+
+int cmlent::IsStreaming()
+{
+    return reintstream::Busy(this);
+}
+
+
+/*
+ * Start streams for stores following the head of the log. Only stores for
+ * objects the servers already know about qualify, i.e. the store has to be
+ * the first record in the log for its object and may not use a local fid.
+ * The records are frozen, like the head of the log in GetFatHead.
+ */
+void repvol::StartReintStreams(int *outstanding, unsigned long reint_time)
+{
+    cml_iterator next(CML, CommitOrder);
+    cmlent *m;
+    unsigned long bw;
+    int scanned = 0, err;
+
+    if (ReintStreams <= 0 || !IsReachable())
+	return;
+
+    /* concurrent streams share the time budget */
+    if (!IsSync())
+	reint_time /= (ReintStreams + 1);
+
+    GetBandwidth(&bw);
+
+    /* the head of the log is handled by PartialReintegrate */
+    next();
+
+    while (reintstream::Available() && (m = next()) &&
+	   scanned++ < REINT_MAXCHUNK) {
+	if (m->ReintReady() != 0)
+	    break;
+
+	if (m->opcode != CML_Store_OP || m->IsStreaming())
+	    continue;
+
+	if (m->HaveReintegrationHandle() && m->DoneSending())
+	    continue;
+
+	/* this would be packed into a regular reintegration chunk */
+	if (allow_backfetch && !m->HaveReintegrationHandle() &&
+	    m->ReintTime(bw) <= ReintLimit)
+	    continue;
+
+	if (FID_IsLocalFile(MakeViceFid(&m->u.u_store.Fid)))
+	    continue;
+
+	cml_iterator first(CML, CommitOrder, &m->u.u_store.Fid);
+	if (first() != m)
+	    continue;
+
+	Recov_BeginTrans();
+	err = m->Freeze();
+	Recov_EndTrans(MAXFP);
+	if (err) break;
+
+	reintstream::Start(m, reint_time, outstanding);
+    }
+
+    if (*outstanding)
+	LOG(0, ("repvol::StartReintStreams: (%s) %d streams\n",
+		name, *outstanding));
+}
+
+
+/* must not be called from within a transaction */
+void repvol::WaitReintStreams(int *outstanding)
+{
+    while (*outstanding)
+	VprocWait(outstanding);
+}
@@ -32,6 +32,8 @@ extern "C" {
 #include <struct.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 
 #include <rpc2/rpc2.h>
@@ -58,6 +60,12 @@ extern "C" {
 int vcbbreaks = 0;	/* count of broken volume callbacks */
 char VCBEnabled = 1;	/* use VCBs by default */
 
+int BulkValidations = VICE_MAXVALIDATE;	/* objects per ViceValidateFids */
+struct ValidateStats VOL_ValidateStats;
+
+/* Set when a server did not know about ViceValidateFids. */
+static int NoBulkValidate = 0;
+
 
 int vdb::CallBackBreak(Volid *volid)
 {
@@ -423,6 +431,10 @@ int repvol::ValidateFSOs()
 
     vproc *vp = VprocSelf();
 
+    /* Most objects are usually still valid, check them all at once first.
+     * Whatever is left over is dealt with one by one below. */
+    BulkValidate(vp->u.u_uid);
+
     struct dllist_head *p, *next;
     for(p = fso_list.next; p != &fso_list; p = next) {
 	fsobj *n = NULL, *f = list_entry_plusplus(p, fsobj, vol_handle);
@@ -462,6 +474,348 @@ int repvol::ValidateFSOs()
 }
 
 
+/* *****  Bulk validation  ***** */
+
+/*
+ * A validator sends one batch of ViceValidateFids and applies the result.
+ * Each validator gets its own connections, so up to MAX_VALIDATORS batches
+ * are on the wire at the same time.
+ */
+
+static const int ValidatorStackSize = 65536;
+
+class validator : public vproc {
+    static validator *slots[MAX_VALIDATORS];
+
+    repvol *vol;
+    uid_t uid;
+    struct ViceValidateRec *recs;
+    int count;
+    int *outstanding;
+
+    validator();
+    validator(validator&);			/* not supported! */
+    int operator=(validator&) { abort(); return(0); }	/* not supported! */
+    ~validator();
+
+  protected:
+    virtual void main(void);
+
+  public:
+    static int Start(repvol *, uid_t, struct ViceValidateRec *, int, int *);
+};
+
+validator *validator::slots[MAX_VALIDATORS];
+
+
+/* Hand a batch to an idle validator, returns 0 if all of them are busy. */
+int validator::Start(repvol *vol, uid_t uid, struct ViceValidateRec *recs,
+		     int count, int *outstanding)
+{
+    int i;
+
+    for (i = 0; i < MAX_VALIDATORS; i++)
+	if (!slots[i] || slots[i]->idle)
+	    break;
+    if (i == MAX_VALIDATORS)
+	return 0;
+
+    if (!slots[i])
+	slots[i] = new validator;
+    validator *v = slots[i];
+    CODA_ASSERT(v->idle);
+
+    v->u.Init();
+    v->vol = vol;
+    v->uid = uid;
+    v->recs = recs;
+    v->count = count;
+    v->outstanding = outstanding;
+    (*outstanding)++;
+
+    v->idle = 0;
+    VprocSignal((char *)v);	/* ignored for new validators */
+    return 1;
+}
+
+
+validator::validator() :
+	vproc("Validator", NULL, VPT_VolDaemon, ValidatorStackSize)
+{
+    LOG(100, ("validator::validator(%#x): %-16s : lwpid = %d\n",
+	       this, name, lwpid));
+
+    idle = 1;
+    start_thread();
+}
+
+
+validator::validator(validator& v) : vproc((vproc&)v) {
+    abort();
+}
+
+
+validator::~validator() {
+    LOG(100, ("validator::~validator: %-16s : lwpid = %d\n", name, lwpid));
+}
+
+
+/* See the comment at reintegrator::main about the yield. */
+void validator::main(void)
+{
+    VprocYield();
+
+    for (;;) {
+	if (idle) CHOKE("validator::main: signalled but not dispatched!");
+
+	/* Objects that were not validated are picked up by the caller. */
+	int code = vol->ValidateFids(uid, recs, count);
+	if (code == EOPNOTSUPP) {
+	    LOG(0, ("validator::main: server does not support ViceValidateFids\n"));
+	    NoBulkValidate = 1;
+	}
+
+	seq++;
+	vol = NULL;
+	idle = 1;
+	(*outstanding)--;
+	VprocSignal(outstanding);
+
+	/* Wait for new request. */
+	VprocWait((char *)this);
+    }
+}
+
+
+static void PackValidateRec(fsobj *f, struct ViceValidateRec *r)
+{
+    ViceVersionVector *vv = f->VV();
+    VenusFid fid;
+
+    f->GetFid(&fid);
+    r->Vnode = htonl(fid.Vnode);
+    r->Unique = htonl(fid.Unique);
+    for (int i = 0; i < VSG_MEMBERS; i++)
+	r->Versions[i] = htonl((&vv->Versions.Site0)[i]);
+    r->StoreHost = htonl(vv->StoreId.Host);
+    r->StoreUniquifier = htonl(vv->StoreId.Uniquifier);
+    r->Flags = htonl(vv->Flags);
+}
+
+
+static int ValidateRecCmp(const void *a, const void *b)
+{
+    unsigned long va = ntohl(((const struct ViceValidateRec *)a)->Vnode);
+    unsigned long vb = ntohl(((const struct ViceValidateRec *)b)->Vnode);
+
+    return va < vb ? -1 : va > vb ? 1 : 0;
+}
+
+
+/*
+ * Validate a batch of objects with ViceValidateFids. Objects that are still
+ * valid get their status (and data) marked valid again, the server has
+ * reinstated their callbacks. Nothing happens to the others.
+ */
+int repvol::ValidateFids(uid_t uid, struct ViceValidateRec *recs, int count)
+{
+    mgrpent *m = 0;
+    int code, i, nvalid = 0;
+    long cbtemp = cbbreaks;
+    unsigned char VFlags[VICE_MAXVALIDATE / 8];
+
+    LOG(100, ("repvol::ValidateFids: %s, %d fids\n", name, count));
+
+    /* Set up the SE descriptor. */
+    SE_Descriptor sed;
+    memset(&sed, 0, sizeof(SE_Descriptor));
+    sed.Tag = SMARTFTP;
+    struct SFTP_Descriptor *sei = &sed.Value.SmartFTPD;
+    sei->TransmissionDirection = CLIENTTOSERVER;
+    sei->hashmark = 0;
+    sei->SeekOffset = 0;
+    sei->ByteQuota = -1;
+    sei->Tag = FILEINVM;
+    sei->FileInfo.ByAddr.vmfile.SeqLen = count * sizeof(struct ViceValidateRec);
+    sei->FileInfo.ByAddr.vmfile.SeqBody = (RPC2_ByteSeq)recs;
+
+    RPC2_CountedBS PiggyBS;
+    PiggyBS.SeqLen = 0;
+    PiggyBS.SeqBody = 0;
+
+    RPC2_BoundedBS VFlagBS;
+    VFlagBS.MaxSeqLen = (count + 7) / 8;
+    VFlagBS.SeqLen = 0;
+    VFlagBS.SeqBody = (RPC2_ByteSeq)VFlags;
+
+    /* Acquire an Mgroup. */
+    code = GetMgrp(&m, uid);
+    if (code != 0) goto Exit;
+
+    {
+	/* Make multiple copies of the IN/OUT and OUT parameters. */
+	ARG_MARSHALL_BS(IN_OUT_MODE, RPC2_BoundedBS, VFlagvar, VFlagBS,
+			VSG_MEMBERS, VICE_MAXVALIDATE / 8);
+	ARG_MARSHALL(IN_OUT_MODE, SE_Descriptor, sedvar, sed, VSG_MEMBERS);
+
+	/* Make the RPC call. */
+	MarinerLog("fetch::ValidateFids %s [%d]\n", name, count);
+	MULTI_START_MESSAGE(ViceValidateFids_OP);
+	code = (int) MRPC_MakeMulti(ViceValidateFids_OP, ViceValidateFids_PTR,
+				    VSG_MEMBERS, m->rocc.handles,
+				    m->rocc.retcodes, m->rocc.MIp, 0, 0,
+				    vid, count, VFlagvar_ptrs, &PiggyBS,
+				    sedvar_bufs);
+	MULTI_END_MESSAGE(ViceValidateFids_OP);
+	MarinerLog("fetch::validatefids done\n");
+
+	/* Collate responses from individual servers and decide what to do next. */
+	code = Collate_NonMutating(m, code);
+	MULTI_RECORD_STATS(ViceValidateFids_OP);
+
+	if (code == EASYRESOLVE) code = 0;
+	if (code != 0 && code != ERETRY) goto Exit;
+
+	/* An object is only valid if all servers agree. */
+	int numVFlags = 0;
+	for (i = 0; i < VSG_MEMBERS; i++) {
+	    if (m->rocc.hosts[i].s_addr == 0)
+		continue;
+	    if (numVFlags == 0) {
+		ARG_UNMARSHALL_BS(VFlagvar, VFlagBS, i);
+		numVFlags = (int)VFlagBS.SeqLen;
+	    } else {
+		for (int j = 0; j < numVFlags; j++)
+		    VFlags[j] &= VFlagvar_bufs[i].SeqBody[j];
+	    }
+	}
+
+	VOL_ValidateStats.batches++;
+	VOL_ValidateStats.fids += count;
+
+	/* callbacks broken during validation make any positive return
+	 * codes suspect. */
+	if (cbtemp != cbbreaks)
+	    goto Exit;
+
+	for (i = 0; i < count && i / 8 < numVFlags; i++) {
+	    struct ViceValidateRec r;
+	    VenusFid fid;
+	    fsobj *f;
+
+	    if (!(VFlags[i / 8] & (1 << (i % 8))))
+		continue;
+
+	    fid.Realm = realm->Id();
+	    fid.Volume = vid;
+	    fid.Vnode = ntohl(recs[i].Vnode);
+	    fid.Unique = ntohl(recs[i].Unique);
+
+	    /* It may have been flushed or changed while we were out. */
+	    f = FSDB->Find(&fid);
+	    if (!f || !HAVESTATUS(f) || STATUSVALID(f) || DYING(f))
+		continue;
+	    PackValidateRec(f, &r);
+	    if (memcmp(&r, &recs[i], sizeof(r)) != 0)
+		continue;
+
+	    if (!HAVEALLDATA(f))
+		f->SetRcRights(RC_STATUS);
+	    else
+		f->SetRcRights(RC_STATUS | RC_DATA);
+
+	    /* the access rights cached for this object are still good */
+	    if (f->IsDir()) {
+		f->PromoteAcRights(ANYUSER_UID);
+		f->PromoteAcRights(uid);
+	    }
+	    nvalid++;
+	}
+	VOL_ValidateStats.valid += nvalid;
+    }
+
+Exit:
+    if (m) m->Put();
+    LOG(10, ("repvol::ValidateFids: %s, %d of %d valid, returns %s\n",
+	     name, nvalid, count, VenusRetStr(code)));
+    return(code);
+}
+
+
+/*
+ * Validate the status of all cached objects of the volume that need it
+ * with ViceValidateFids, in batches of BulkValidations objects sorted by
+ * vnode. Returns the number of objects sent.
+ */
+int repvol::BulkValidate(uid_t uid)
+{
+    struct ViceValidateRec *recs;
+    struct timeval start, end;
+    int n = 0, max = 0, outstanding = 0, batch, i;
+
+    if (BulkValidations <= 0 || NoBulkValidate || !IsReachable())
+	return 0;
+
+    batch = BulkValidations < VICE_MAXVALIDATE ?
+	BulkValidations : VICE_MAXVALIDATE;
+
+    /* Same candidates as the ones fsobj::GetAttr piggybacks. */
+    struct dllist_head *p;
+    list_for_each(p, fso_list) {
+	fsobj *f = list_entry_plusplus(p, fsobj, vol_handle);
+	if (HAVESTATUS(f) && !STATUSVALID(f) && !DYING(f) &&
+	    !f->IsLocalObj() && !BUSY(f) && !DIRTY(f))
+	    max++;
+    }
+    /* a few objects are cheaper to validate the old way */
+    if (max <= PiggyValidations)
+	return 0;
+
+    recs = (struct ViceValidateRec *)malloc(max * sizeof(*recs));
+    if (!recs)
+	return 0;
+
+    list_for_each(p, fso_list) {
+	fsobj *f = list_entry_plusplus(p, fsobj, vol_handle);
+	if (n < max && HAVESTATUS(f) && !STATUSVALID(f) && !DYING(f) &&
+	    !f->IsLocalObj() && !BUSY(f) && !DIRTY(f))
+	    PackValidateRec(f, &recs[n++]);
+    }
+    qsort(recs, n, sizeof(*recs), ValidateRecCmp);
+
+    gettimeofday(&start, 0);
+
+    for (i = 0; i < n && !NoBulkValidate; ) {
+	int count = (n - i < batch) ? n - i : batch;
+
+	if (!validator::Start(this, uid, &recs[i], count, &outstanding)) {
+	    /* the validators may be busy with another volume */
+	    if (outstanding) {
+		VprocWait(&outstanding);
+		continue;
+	    }
+	    if (ValidateFids(uid, &recs[i], count) == EOPNOTSUPP)
+		NoBulkValidate = 1;
+	}
+	i += count;
+    }
+    while (outstanding)
+	VprocWait(&outstanding);
+
+    gettimeofday(&end, 0);
+    unsigned long msec = (end.tv_sec - start.tv_sec) * 1000 +
+			 (end.tv_usec - start.tv_usec) / 1000;
+    VOL_ValidateStats.volumes++;
+    VOL_ValidateStats.msec += msec;
+
+    LOG(0, ("repvol::BulkValidate: %s, %d objects in %d batches, %lu msec\n",
+	    name, n, (n + batch - 1) / batch, msec));
+
+    free(recs);
+    return n;
+}
+
+
 void repvol::PackVS(int nstamps, RPC2_CountedBS *BS)
 {
     BS->SeqLen = 0;
@@ -531,7 +531,7 @@ static int VolModeMap[NVFSOPS] = {
     VM_OBSERVING,	    /* CODA_STATFS */
     /*VM_UNSET*/-1,	    /* CODA_STORE */
     /*VM_UNSET*/-1,	    /* CODA_RELEASE */
-    VM_MUTATING,	    /* UNUSED */
+    VM_OBSERVING,	    /* CODA_ACCESS_INTENT */
     VM_MUTATING,	    /* UNUSED */
     VM_MUTATING,	    /* UNUSED */
 };
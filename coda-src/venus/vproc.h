@@ -243,6 +243,8 @@ class vproc : public olink {
     void symlink(struct venus_cnode *, char *, struct coda_vattr *, char *);
     void readlink(struct venus_cnode *, struct coda_string *);
     void fsync(struct venus_cnode *);
+    void access_intent(struct venus_cnode *, int type, size_t pos,
+		       size_t count);
     void inactive(struct venus_cnode *);
     void fid(struct venus_cnode *, struct cfid	**);
 
@@ -664,6 +664,7 @@ OI_FreeLocks:
 	case _VIOC_GETSERVERSTATS:
 	case _VIOC_CHECKPOINTML:
 	case _VIOC_PURGEML:
+	case _VIOC_OPTIMIZEML:
 	case _VIOC_WD:
 	case _VIOC_ENABLEASR:
 	case _VIOC_DISABLEASR: 
@@ -679,8 +680,8 @@ OI_FreeLocks:
 	    volent *v = 0;
 	    if ((u.u_error = VDB->Get(&v, MakeVolid(fid)))) break;
 
-	    int volmode = ((nr == _VIOC_PURGEML || nr == _VIOC_REP_CMD) ?
-			   VM_MUTATING : VM_OBSERVING);
+	    int volmode = ((nr == _VIOC_PURGEML || nr == _VIOC_OPTIMIZEML ||
+			    nr == _VIOC_REP_CMD) ? VM_MUTATING : VM_OBSERVING);
 	    int entered = 0;
 	    if ((u.u_error = v->Enter(volmode, u.u_uid)) != 0)
 		goto V_FreeLocks;
@@ -955,9 +956,20 @@ OI_FreeLocks:
 		case _VIOC_CHECKPOINTML:
 		    {
 		    char *ckpdir = (data->in_size == 0 ? 0 : (char *) data->in);
+		    cmlckpstats stats;
                     u.u_error = EOPNOTSUPP;
                     if (v->IsReplicated())
-                        u.u_error = ((repvol *)v)->CheckPointMLEs(u.u_uid, ckpdir);
+                        u.u_error = ((repvol *)v)->CheckPointMLEs(u.u_uid, ckpdir, &stats);
+		    if (u.u_error) break;
+
+		    memset(data->out, 0, CFS_PIOBUFSIZE);
+		    snprintf((char *)data->out, CFS_PIOBUFSIZE - 1,
+			     "%d records, %.1f MB of store data (%.1f MB copied after the log was unlocked)\n"
+			     "took %.2f s, log locked for %.2f s\n",
+			     stats.records, stats.bytes / (1024 * 1024),
+			     stats.deferred / (1024 * 1024), stats.elapsed,
+			     stats.locked);
+		    data->out_size = strlen(data->out) + 1;
 		    break;
 		    }
 
@@ -968,6 +980,33 @@ OI_FreeLocks:
                         u.u_error = ((repvol *)v)->PurgeMLEs(u.u_uid);
 		    break;
 		    }
+		case _VIOC_OPTIMIZEML:
+		    {
+		    cmloptstats stats;
+		    int records = 0;
+		    long bytes = 0;
+
+                    u.u_error = EOPNOTSUPP;
+                    if (!v->IsReplicated())
+			break;
+
+		    repvol *vp = (repvol *)v;
+		    records = vp->GetCML()->count();
+		    bytes = vp->GetCML()->logBytes();
+		    u.u_error = vp->OptimizeMLEs(u.u_uid, &stats);
+		    if (u.u_error) break;
+
+		    memset(data->out, 0, CFS_PIOBUFSIZE);
+		    snprintf((char *)data->out, CFS_PIOBUFSIZE - 1,
+			"Records: %d -> %d, log bytes: %ld -> %ld\n"
+			"Renames folded: %d, modes folded: %d, objects dropped: %d\n"
+			"Store data no longer sent: %.0f bytes\n",
+			records, records - stats.records,
+			bytes, bytes - stats.bytes,
+			stats.renames, stats.modes, stats.objects, stats.contents);
+		    data->out_size = strlen(data->out) + 1;
+		    break;
+		    }
 		case _VIOC_WD:
 		    {
 		    /* 
@@ -1373,8 +1412,31 @@ OI_FreeLocks:
 	case _VIOC_SYNCCACHE_ALL:
 	case _VIOC_UNLOADKERNEL:
 	case _VIOC_LOOKASIDE:
+	case _VIOC_CACHESTATS:
 	    {
 	    switch(nr) {
+                case _VIOC_CACHESTATS:
+	            {
+		      /* partial fetch statistics (cfs cachestats) */
+		      struct RangeStats *rs = &FSO_RangeStats;
+		      memset(data->out, 0, CFS_PIOBUFSIZE);
+		      snprintf((char *)data->out, CFS_PIOBUFSIZE - 1,
+			"Partial fetch threshold: %d KB%s\n"
+			"Opens before data was present: %lu\n"
+			"Read requests on partial files: %lu, hits %lu (%.1f%%)\n"
+			"Range fetches: %lu, %lu bytes\n"
+			"Read-ahead fetches: %lu, %lu bytes\n",
+			FSO_PartialFetchKB,
+			FSO_PartialFetchKB == 0 ? " (disabled)" :
+			  kernel_access_intents ? "" :
+			  " (kernel does not send access intents)",
+			rs->opens, rs->requests, rs->hits,
+			rs->requests ? 100.0 * rs->hits / rs->requests : 0.0,
+			rs->fetches, rs->bytes, rs->readaheads, rs->rabytes);
+		      data->out_size = strlen(data->out) + 1;
+		      break;
+	            }
+
                 case _VIOC_LOOKASIDE:
 	            {
 		      /* cache lookaside command (cfs lka) */
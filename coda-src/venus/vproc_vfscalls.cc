@@ -177,6 +177,12 @@ void vproc::open(struct venus_cnode *cp, int flags)
     int exclp =  (flags & C_O_EXCL)  != 0;
     int createp =  (flags & C_O_CREAT)  != 0;
 
+    /* Large files that are only read can be opened before all of their
+     * data is here when the kernel tells us which parts it is about to
+     * read (see vproc::access_intent). */
+    int partialp = readp && !writep && !truncp && FSO_PartialFetchKB > 0 &&
+		   kernel_access_intents;
+
     fsobj *f = 0;
 
     for (;;) {
@@ -184,9 +190,26 @@ void vproc::open(struct venus_cnode *cp, int flags)
 	if (u.u_error) break;
 
 	/* Get the object. */
-	u.u_error = FSDB->Get(&f, &cp->c_fid, u.u_uid, RC_DATA);
+	u.u_error = FSDB->Get(&f, &cp->c_fid, u.u_uid,
+			      partialp ? RC_STATUS : RC_DATA);
 	if (u.u_error) goto FreeLocks;
 
+	if (partialp && (!HAVEALLDATA(f) || DYING(f))) {
+	    if (f->IsFile() && !f->IsFake() && !f->IsLocalObj() &&
+		REACHABLE(f) && !DIRTY(f) && !DYING(f) &&
+		f->stat.Length >= (unsigned long)FSO_PartialFetchKB * 1024)
+	    {
+		/* Only get the first piece, the rest follows on demand */
+		u.u_error = f->FetchRange(u.u_uid, 0, FSO_FETCHCHUNK);
+		if (u.u_error == 0)
+		    FSO_RangeStats.opens++;
+	    } else {
+		FSDB->Put(&f);
+		u.u_error = FSDB->Get(&f, &cp->c_fid, u.u_uid, RC_DATA);
+	    }
+	    if (u.u_error) goto FreeLocks;
+	}
+
 	if (exclp) { 
 		u.u_error = EEXIST; 
 		goto FreeLocks; 
@@ -275,6 +298,61 @@ Exit:
 }
 
 
+/* The kernel is about to access part of a file. Files that were opened
+ * before all of their data was fetched get the missing pieces here, and
+ * sequential readers start fetching the following pieces in the background.
+ * Fully cached files need nothing. */
+void vproc::access_intent(struct venus_cnode *cp, int type, size_t pos,
+			  size_t count)
+{
+    LOG(1, ("vproc::access_intent: fid = %s, type = %d, %lu+%lu\n",
+	    FID_(&cp->c_fid), type, (unsigned long)pos, (unsigned long)count));
+
+    fsobj *f = 0;
+    long start = (long)pos, len = (long)count;
+
+    if (type != CODA_ACCESS_TYPE_READ && type != CODA_ACCESS_TYPE_MMAP)
+	return;
+
+    Begin_VFS(&cp->c_fid, CODA_ACCESS_INTENT);
+    if (u.u_error) return;
+
+    u.u_error = FSDB->Get(&f, &cp->c_fid, u.u_uid, RC_STATUS);
+    if (u.u_error) goto FreeLocks;
+
+    if (!f->IsFile() || HAVEALLDATA(f))
+	goto FreeLocks;
+
+    FSO_RangeStats.requests++;
+
+    /* mapped files can be accessed anywhere, get everything */
+    if (type == CODA_ACCESS_TYPE_MMAP) {
+	start = 0;
+	len = -1;
+    }
+
+    if (HAVEDATA(f) && f->cf.HaveRange(start, len))
+	FSO_RangeStats.hits++;
+    else {
+	u.u_error = f->FetchRange(u.u_uid, start, len);
+	if (u.u_error) goto FreeLocks;
+    }
+
+    if (type == CODA_ACCESS_TYPE_READ && !HAVEALLDATA(f) &&
+	f->cf.SequentialRead(start, len))
+    {
+	long next = start + len;
+	next += (FSO_FETCHCHUNK - next % FSO_FETCHCHUNK) % FSO_FETCHCHUNK;
+	if (!f->cf.HaveRange(next, 2 * FSO_FETCHCHUNK))
+	    FSOD_ReadAhead(&f->fid, u.u_uid, next, 2 * FSO_FETCHCHUNK);
+    }
+
+FreeLocks:
+    FSDB->Put(&f);
+    End_VFS(NULL);
+}
+
+
 void vproc::ioctl(struct venus_cnode *cp, unsigned char nr,
 		   struct ViceIoctl *data, int flags) 
 {
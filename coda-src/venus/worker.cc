@@ -48,6 +48,7 @@ extern "C" {
 #include <unistd.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #ifdef  __FreeBSD__
 #include <sys/param.h>
@@ -70,6 +71,8 @@ extern "C" {
 #endif
 
 #include <vice.h>
+/* from libal */
+#include <prs.h>
 
 #ifdef __CYGWIN__
 #include <windows.h>
@@ -112,6 +115,11 @@ time_t worker::lastresign;
 olist worker::FreeMsgs;
 olist worker::QueuedMsgs;
 olist worker::ActiveMsgs;
+worker **worker::IdleWorkers;
+int worker::nidle;
+unsigned long worker::upcalls;
+unsigned long worker::batches;
+int worker::maxbatch;
 
 int msgent::allocs = 0;
 int msgent::deallocs = 0;
@@ -120,10 +128,26 @@ const int WorkerStackSize = 131072;
 
 int MaxWorkers = UNSET_MAXWORKERS;
 int MaxPrefetchers = UNSET_MAXWORKERS;
+int UpcallBatch = UNSET_MAXWORKERS;
+/* answer lookup/getattr/access for valid cached objects from the mux */
+int UpcallFastPath = 1;
 int KernelFD = -1;	/* subsystem is uninitialized until fd is not -1 */
 int kernel_version = 0;
+/* set once the kernel module tells us about reads before they happen */
+int kernel_access_intents = 0;
 static int Mounted = 0;
 
+/* Upcall latency, from reading the upcall to writing the reply, in
+ * buckets of < 10us, < 100us, < 1ms, < 10ms, < 100ms, < 1s and more. */
+#define UPCALL_BUCKETS 7
+struct upcallstat {
+    unsigned long count;
+    unsigned long fast;		/* answered by the fast path */
+    double total;		/* usec */
+    unsigned long buckets[UPCALL_BUCKETS];
+};
+static struct upcallstat UpcallStats[CODA_NCALLS];
+
 /* Only for the crazy people among us.
  * Many things can and will go wrong when venus reattaches to a previously
  * mounted mountpoint. But it does help during development ;) --JH */
@@ -216,6 +240,7 @@ void ReadUpcallMsg(int fd, size_t size)
     }
 
     m->return_fd = fd;
+    gettimeofday(&m->arrival, NULL);
     DispatchWorker(m);
 }
 
@@ -765,6 +790,9 @@ void WorkerInit()
             exit(-1);
         }
 
+    if (UpcallBatch == UNSET_MAXWORKERS || UpcallBatch < 1)
+        UpcallBatch = DFLT_UPCALLBATCH;
+
 #ifdef __CYGWIN32__
     int sd[2];
     if (socketpair(AF_LOCAL, SOCK_STREAM, 0, sd)) {
@@ -817,6 +845,12 @@ void WorkerInit()
     worker::nworkers = 0;
     worker::nprefetchers = 0;
     worker::lastresign = Vtime();
+
+    /* There can never be more idle workers than MaxWorkers. */
+    worker::IdleWorkers = new worker *[MaxWorkers];
+    worker::nidle = 0;
+    worker::upcalls = worker::batches = 0;
+    worker::maxbatch = 0;
 }
 
 
@@ -847,18 +881,24 @@ worker *FindWorker(u_long seq) {
 }
 
 
+/* Idle workers park themselves on the IdleWorkers stack in AwaitRequest, so
+ * finding one does not require a walk over the whole vproc table. The most
+ * recently resigned worker is handed out first, its stack is still warm. */
 worker *GetIdleWorker() {
-    worker_iterator next;
     worker *w;
-    while ((w = next()))
-	if (w->idle) return(w);
 
-    /* No idle workers; can we create a new one? */
-    if (worker::nworkers < MaxWorkers) {
-	return(new worker);
-    }
+    /* No idle workers; can we create a new one? A new worker runs until it
+     * blocks in AwaitRequest, at which point it has pushed itself on the
+     * idle stack, unless it already picked up a queued message. */
+    if (worker::nidle == 0 && worker::nworkers < MaxWorkers)
+	(void)new worker;
 
-    return(0);
+    if (worker::nidle == 0)
+	return(0);
+
+    w = worker::IdleWorkers[--worker::nidle];
+    CODA_ASSERT(w->idle);
+    return(w);
 }
 
 int IsAPrefetch(msgent *m) {
@@ -871,6 +911,107 @@ int IsAPrefetch(msgent *m) {
     return (_IOC_NR(in->coda_ioctl.cmd) == _VIOCPREFETCH);
 }
 
+static void RecordUpcall(int opcode, struct timeval *arrival, int fast)
+{
+    struct upcallstat *st;
+    struct timeval now;
+    long usec, limit;
+    int i;
+
+    if (opcode < 0 || opcode >= CODA_NCALLS)
+	return;
+    st = &UpcallStats[opcode];
+
+    gettimeofday(&now, NULL);
+    usec = (now.tv_sec - arrival->tv_sec) * 1000000L +
+	   (now.tv_usec - arrival->tv_usec);
+    if (usec < 0) usec = 0;
+
+    for (i = 0, limit = 10; i < UPCALL_BUCKETS - 1 && usec >= limit; i++)
+	limit *= 10;
+
+    st->count++;
+    st->total += usec;
+    st->buckets[i]++;
+    if (fast)
+	st->fast++;
+}
+
+/* Answer lookup, getattr and access upcalls for cached objects with valid
+ * status right here on the mux thread, without handing them to a worker,
+ * entering the volume or locking the objects. Returns the size of the reply
+ * in the message buffer, or 0 if a worker has to handle the upcall. Nothing
+ * in here may yield. */
+static int FastUpcall(union inputArgs *in, union outputArgs *out)
+{
+    uid_t uid = in->ih.uid;
+    struct venus_cnode target;
+    VenusFid fid;
+    fsobj *f;
+    int code;
+
+    switch (in->ih.opcode) {
+    case CODA_GETATTR:
+	KernelToVenusFid(&fid, &in->coda_getattr.Fid);
+	f = FSDB->FastGet(&fid);
+	if (!f)
+	    return 0;
+
+	va_init(&out->coda_getattr.attr);
+	f->GetVattr(&out->coda_getattr.attr);
+	out->oh.result = 0;
+	return sizeof(struct coda_getattr_out);
+
+    case CODA_ACCESS:
+	{
+	/* Same translation as the access maps in vproc::access. */
+	int mode = in->coda_access.flags, modes = C_A_F_OK, rights;
+	if (mode & R_OK) modes |= C_A_R_OK;
+	if (mode & W_OK) modes |= C_A_W_OK;
+	if (mode & X_OK) modes |= C_A_X_OK;
+
+	KernelToVenusFid(&fid, &in->coda_access.Fid);
+	f = FSDB->FastGet(&fid);
+	if (!f)
+	    return 0;
+
+	if (f->IsDir())
+	    rights = (modes & C_A_W_OK ? PRSFS_INSERT | PRSFS_DELETE : 0) |
+		     (modes & (C_A_R_OK | C_A_X_OK) ? PRSFS_LOOKUP : 0);
+	else
+	    rights = (modes & C_A_W_OK ? PRSFS_WRITE : 0) |
+		     (modes & (C_A_R_OK | C_A_X_OK) ? PRSFS_READ : 0);
+
+	code = f->FastAccess(rights, modes, uid);
+	if (code == EWOULDBLOCK)
+	    return 0;
+
+	out->oh.result = code;
+	return sizeof(struct coda_out_hdr);
+	}
+
+    case CODA_LOOKUP:
+	KernelToVenusFid(&fid, &in->coda_lookup.Fid);
+	f = FSDB->FastGet(&fid);
+	if (!f)
+	    return 0;
+
+	code = f->FastLookup(&target, (char *)in + (intptr_t)in->coda_lookup.name,
+			     uid, in->coda_lookup.flags | CLU_TRAVERSE_MTPT);
+	if (code == EWOULDBLOCK)
+	    return 0;
+
+	out->oh.result = code;
+	if (code)
+	    return sizeof(struct coda_out_hdr);
+
+	out->coda_lookup.Fid = *VenusToKernelFid(&target.c_fid);
+	out->coda_lookup.vtype = target.c_type;
+	return sizeof(struct coda_lookup_out);
+    }
+    return 0;
+}
+
 void DispatchWorker(msgent *m) {
     /* We filter out signals (i.e., interrupts) before passing messages on to workers. */
     union inputArgs *in = (union inputArgs *)m->msg_buf;
@@ -916,6 +1057,26 @@ void DispatchWorker(msgent *m) {
 	}
     }
 
+    /* Cached answers don't need a worker. */
+    if (UpcallFastPath) {
+	int opcode = (int) in->ih.opcode;
+	size_t size = FastUpcall(in, (union outputArgs *)m->msg_buf);
+
+	if (size) {
+	    LOG(1, ("DispatchWorker: fast %s : returns %s\n", VenusOpStr(opcode),
+		    VenusRetStr(((union outputArgs *)m->msg_buf)->oh.result)));
+
+	    ssize_t cc = WriteDowncallMsg(m->return_fd, m->msg_buf, size);
+	    /* ESRCH, the caller was interrupted, see worker::Return */
+	    if (cc != (ssize_t)size && errno != ESRCH)
+		CHOKE("DispatchWorker: errno (%d) from WriteDowncallMsg", errno);
+
+	    RecordUpcall(opcode, &m->arrival, 1);
+	    worker::FreeMsgs.append(m);
+	    return;
+	}
+    }
+
     /* Try to find an idle worker to handle this message. */
     worker *w = GetIdleWorker();
     if (w) {
@@ -935,6 +1096,7 @@ void DispatchWorker(msgent *m) {
 void WorkerMux(fd_set *mask)
 {
     size_t size = VC_MAXMSGSIZE;
+    int n = 0;
 
 #ifdef __CYGWIN32__
     /* CYGWIN uses a stream oriented socket for kernel messages, there are no
@@ -944,9 +1106,29 @@ void WorkerMux(fd_set *mask)
     len = read(worker::muxfd, (char *)&msg_size, sizeof(msg_size));
     CODA_ASSERT(len == sizeof(msg_size));
     size = msg_size;
-#endif
 
     ReadUpcallMsg(worker::muxfd, size);
+    n++;
+#else
+    /* Drain up to UpcallBatch queued upcalls before returning to the select
+     * loop. The dispatched workers only start running once the mux blocks
+     * again, so a burst of upcalls costs one scheduler pass instead of one
+     * pass per message. */
+    struct pollfd pfd;
+    pfd.fd = worker::muxfd;
+    pfd.events = POLLIN;
+
+    do {
+	ReadUpcallMsg(worker::muxfd, size);
+	n++;
+    } while (n < UpcallBatch && worker::muxfd != -1 &&
+	     poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN));
+#endif
+
+    worker::upcalls += n;
+    worker::batches++;
+    if (n > worker::maxbatch)
+	worker::maxbatch = n;
 }
 
 time_t GetWorkerIdleTime() {
@@ -972,8 +1154,33 @@ void PrintWorkers(FILE *fp) {
 
 
 void PrintWorkers(int fd) {
-    fdprint(fd, "%#08x : %-16s : muxfd = %d, nworkers = %d\n",
-	     &worker::tbl, "Workers", worker::muxfd, worker::nworkers);
+    fdprint(fd, "%#08x : %-16s : muxfd = %d, nworkers = %d, nidle = %d\n",
+	     &worker::tbl, "Workers", worker::muxfd, worker::nworkers,
+	     worker::nidle);
+    fdprint(fd, "\tupcalls = %lu, batches = %lu, maxbatch = %d (limit %d)\n",
+	     worker::upcalls, worker::batches, worker::maxbatch, UpcallBatch);
+
+    unsigned long total = 0, fast = 0;
+    for (int i = 0; i < CODA_NCALLS; i++) {
+	total += UpcallStats[i].count;
+	fast += UpcallStats[i].fast;
+    }
+    fdprint(fd, "\tfast path %s, %lu of %lu upcalls answered (%.1f%%)\n",
+	    UpcallFastPath ? "on" : "off", fast, total,
+	    total ? 100.0 * fast / total : 0.0);
+
+    fdprint(fd, "\t%-12s %8s %8s %8s %7s %7s %7s %7s %7s %7s %7s\n",
+	    "opcode", "count", "fast", "avg us", "<10us", "<100us", "<1ms",
+	    "<10ms", "<100ms", "<1s", "more");
+    for (int i = 0; i < CODA_NCALLS; i++) {
+	struct upcallstat *st = &UpcallStats[i];
+	if (!st->count)
+	    continue;
+	fdprint(fd, "\t%-12s %8lu %8lu %8.0f %7lu %7lu %7lu %7lu %7lu %7lu %7lu\n",
+		VenusOpStr(i), st->count, st->fast, st->total / st->count,
+		st->buckets[0], st->buckets[1], st->buckets[2], st->buckets[3],
+		st->buckets[4], st->buckets[5], st->buckets[6]);
+    }
 
     worker_iterator next;
     worker *w;
@@ -1052,6 +1259,7 @@ void worker::AwaitRequest() {
 	return;
     }
 
+    IdleWorkers[nidle++] = this;
     VprocWait((char *)this);
 }
 
@@ -1080,6 +1288,8 @@ void worker::Resign(msgent *msg, int size) {
 	Return(msg, size);
     }
 
+    RecordUpcall(opcode, &msg->arrival, 0);
+
     ActiveMsgs.remove(msg);
     FreeMsgs.append(msg);
     msg = NULL;
@@ -1517,6 +1727,23 @@ void worker::main(void)
 		break;
 		}
 
+	    case CODA_ACCESS_INTENT:
+		{
+		LOG(100, ("CODA_ACCESS_INTENT: u.u_pid = %d u.u_pgid = %d\n", u.u_pid, u.u_pgid));
+		kernel_access_intents = 1;
+		MAKE_CNODE(vtarget, in->coda_access_intent.VFid, 0);
+		access_intent(&vtarget, in->coda_access_intent.type,
+			      in->coda_access_intent.pos,
+			      in->coda_access_intent.count);
+
+		/* The kernel doesn't wait for a reply to the finish
+		 * notifications, it already dropped the upcall */
+		if (in->coda_access_intent.type == CODA_ACCESS_TYPE_READ_FINISH ||
+		    in->coda_access_intent.type == CODA_ACCESS_TYPE_WRITE_FINISH)
+		    returned = 1;
+		break;
+		}
+
 	    default:	 /* Toned this down a bit, used to be a choke -- DCS */
 		{	/* But make sure someone sees it! */
 		eprint("worker::main Got a bogus opcode %d", in->ih.opcode);
@@ -31,6 +31,7 @@ extern "C" {
 #endif
 
 #include <sys/types.h>
+#include <sys/time.h>
 
 #ifdef __cplusplus
 }
@@ -57,6 +58,7 @@ void ReadUpcallMsg(int fd, size_t size);
 const int DFLT_MAXWORKERS = 20;
 const int UNSET_MAXWORKERS = -1;
 const int DFLT_MAXPREFETCHERS = 1;
+const int DFLT_UPCALLBATCH = 16;
 
 class msgent : public olink {
   friend msgent *FindMsg(olist&, u_long);
@@ -76,6 +78,7 @@ class msgent : public olink {
 
     char msg_buf[VC_MAXMSGSIZE];
     int return_fd;
+    struct timeval arrival;	/* when the upcall was read */
 
   public:
     msgent();
@@ -116,6 +119,11 @@ class worker : public vproc {
     static olist FreeMsgs;
     static olist QueuedMsgs;
     static olist ActiveMsgs;
+    static worker **IdleWorkers;    /* stack of workers blocked in AwaitRequest */
+    static int nidle;
+    static unsigned long upcalls;   /* upcalls read from the kernel */
+    static unsigned long batches;   /* WorkerMux passes that read upcalls */
+    static int maxbatch;            /* largest number of upcalls in one pass */
 
     unsigned returned : 1;
     msgent *msg;			/* For communication with the kernel */
@@ -147,7 +155,10 @@ class worker_iterator : public vproc_iterator {
 
 extern int MaxWorkers;
 extern int MaxPrefetchers;
+extern int UpcallBatch;
+extern int UpcallFastPath;
 extern int KernelFD;
+extern int kernel_access_intents;
 
 
 extern msgent *FindMsg(olist&, u_long);
@@ -0,0 +1,270 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ * Worker thread pool benchmark.
+ *
+ * Measures the hash offload of the worker pool, the part of
+ * ViceGetAttrPlusSHA on files without a cached checksum that can run on
+ * other cores. No RPCs are made. A number of LWPs, like the server LWPs,
+ * repeatedly open a container file and hash it through the worker pool.
+ * The run is repeated without a pool, where all hashing happens in the
+ * LWPs, and with a growing number of worker threads up to the number of
+ * cores. Every run happens in its own process because the pool can only
+ * be started once.
+ *
+ * Other read-only requests still run on the single LWP thread, so this
+ * is an upper bound for what the pool gains on a real server.
+ *
+ * usage: hashbench [-d dir] [-s filesize] [-l lwps] [-t seconds]
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lwp/lwp.h>
+#include <util.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "workpool.h"
+
+#define STACKSIZE (256 * 1024)	/* hashing without a pool uses the LWP stack */
+
+static const char *dir = "/tmp";
+static char file[MAXPATHLEN];
+static long filesize = 1024 * 1024;
+static int nlwps = 10;
+static int seconds = 2;
+
+static unsigned char expected[SHA_DIGEST_LENGTH];
+static int stop, running;
+static unsigned long ops;
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+static void hash(struct wp_sha *s)
+{
+    s->fd = open(file, O_RDONLY);
+    if (s->fd == -1) {
+	perror(file);
+	exit(EXIT_FAILURE);
+    }
+    if (WP_Run(WP_ComputeSHA, s) == -1)
+	WP_ComputeSHA(s);
+    close(s->fd);
+
+    if (s->err) {
+	fprintf(stderr, "%s: %s\n", file, strerror(s->err));
+	exit(EXIT_FAILURE);
+    }
+}
+
+static void client(void *arg)
+{
+    struct wp_sha s;
+
+    while (!stop) {
+	hash(&s);
+	if (memcmp(s.sha, expected, SHA_DIGEST_LENGTH) != 0) {
+	    fprintf(stderr, "checksum mismatch\n");
+	    exit(EXIT_FAILURE);
+	}
+	ops++;
+	/* let the other clients queue their work, and the timer expire */
+	IOMGR_Poll();
+	LWP_DispatchProcess();
+    }
+    running--;
+    LWP_NoYieldSignal(&running);
+}
+
+static void run(int nthreads, double *base)
+{
+    struct timeval start, tv;
+    PROCESS pid;
+    double t, rate;
+    int i;
+
+    if (LWP_Init(LWP_VERSION, LWP_NORMAL_PRIORITY, &pid) != LWP_SUCCESS ||
+	IOMGR_Initialize() != LWP_SUCCESS) {
+	fprintf(stderr, "LWP_Init failed\n");
+	exit(EXIT_FAILURE);
+    }
+    if (WP_Init(nthreads) != 0 || WP_Threads() != nthreads) {
+	fprintf(stderr, "WP_Init failed\n");
+	exit(EXIT_FAILURE);
+    }
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nlwps; i++) {
+	if (LWP_CreateProcess(client, STACKSIZE, LWP_NORMAL_PRIORITY, NULL,
+			      "client", &pid) != LWP_SUCCESS) {
+	    fprintf(stderr, "LWP_CreateProcess failed\n");
+	    exit(EXIT_FAILURE);
+	}
+	running++;
+    }
+
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    IOMGR_Select(0, NULL, NULL, NULL, &tv);
+    stop = 1;
+    while (running)
+	LWP_WaitProcess(&running);
+    t = elapsed(&start);
+
+    rate = ops / t;
+    if (*base == 0)
+	*base = rate;
+    printf("  %2d threads: %8.1f hashes/s, %7.1f MB/s, speedup %5.2f\n",
+	   nthreads, rate, rate * filesize / (1024 * 1024), rate / *base);
+    WP_PrintStats(stdout);
+}
+
+/* results are written to a pipe, the base rate is set by the first run */
+static void spawn(int nthreads)
+{
+    static double base;
+    int status, fds[2];
+    pid_t pid;
+
+    fflush(stdout);
+    if (pipe(fds) == -1) {
+	perror("pipe");
+	exit(EXIT_FAILURE);
+    }
+    pid = fork();
+    if (pid == -1) {
+	perror("fork");
+	exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+	close(fds[0]);
+	run(nthreads, &base);
+	if (write(fds[1], &base, sizeof(base)) != sizeof(base))
+	    exit(EXIT_FAILURE);
+	fflush(stdout);
+	exit(EXIT_SUCCESS);
+    }
+    close(fds[1]);
+    if (read(fds[0], &base, sizeof(base)) != sizeof(base))
+	base = 0;
+    close(fds[0]);
+    if (waitpid(pid, &status, 0) == -1) {
+	perror("waitpid");
+	exit(EXIT_FAILURE);
+    }
+    if (WIFSIGNALED(status)) {
+	fprintf(stderr, "%d thread run killed by signal %d\n", nthreads,
+		WTERMSIG(status));
+	exit(EXIT_FAILURE);
+    }
+    if (WEXITSTATUS(status) != EXIT_SUCCESS)
+	exit(EXIT_FAILURE);
+}
+
+static void makefile(void)
+{
+    struct wp_sha s;
+    char buf[4096];
+    long done;
+    unsigned int i;
+    int fd;
+
+    snprintf(file, sizeof(file), "%s/hashbench.data", dir);
+    fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+	perror(file);
+	exit(EXIT_FAILURE);
+    }
+    for (done = 0; done < filesize; done += sizeof(buf)) {
+	for (i = 0; i < sizeof(buf); i++)
+	    buf[i] = (char)(done + i * 7);
+	if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+	    perror(file);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    close(fd);
+    filesize = done;
+
+    /* checksum every run has to come up with */
+    hash(&s);
+    memcpy(expected, s.sha, SHA_DIGEST_LENGTH);
+}
+
+int main(int argc, char **argv)
+{
+    int c, n, ncpu;
+
+    while ((c = getopt(argc, argv, "d:s:l:t:")) != -1) {
+	switch (c) {
+	case 'd': dir = optarg; break;
+	case 's': filesize = atol(optarg); break;
+	case 'l': nlwps = atoi(optarg); break;
+	case 't': seconds = atoi(optarg); break;
+	default:
+	    fprintf(stderr, "usage: %s [-d dir] [-s filesize] [-l lwps] "
+		    "[-t seconds]\n", argv[0]);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (filesize <= 0 || nlwps <= 0 || seconds <= 0) {
+	fprintf(stderr, "filesize, lwps and seconds have to be positive\n");
+	exit(EXIT_FAILURE);
+    }
+
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1)
+	ncpu = 1;
+
+    makefile();
+    printf("%d lwps hashing a %ld byte file, %d cores:\n", nlwps, filesize,
+	   ncpu);
+
+    spawn(0);
+    for (n = 1; n < ncpu; n *= 2)
+	spawn(n);
+    spawn(ncpu);
+
+    unlink(file);
+    return 0;
+}
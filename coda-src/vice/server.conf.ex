@@ -70,6 +70,14 @@
 #rvmtruncate=0
 rvmtruncate=5
 
+#
+# How long (in microseconds) a committing transaction waits for other
+# server threads to commit, so that they can share one log write and sync.
+# The objects a mutation changed stay locked, and the client gets no reply,
+# until its commit is on disk.
+#
+#rvm_groupcommit=0
+
 #
 # Specify the number of rpc2 buffers to keep in a circular log, this can be
 # useful for debugging.
@@ -102,6 +110,22 @@ allow_sha=1
 #
 #lwps=10
 
+#
+# The number of operating system threads that compute SHA checksums for
+# ViceGetAttrPlusSHA, so that hashing can use more than one core. All
+# other work, including the rest of the read-only requests, is still
+# done one request at a time by the lwps above. The default of 0 does
+# all work in the lwps.
+#
+#worker_threads=0
+
+#
+# Send fetched file data to clients straight from a memory mapping of the
+# container file, instead of first copying it into the packet buffers.
+# Set to 0 to read files into the packets like older servers did.
+#
+#mapfiles=1
+
 #
 # Let the server check if it has previously seen a reintegration log
 # entry In this case it will return VLOGSTALE, the can client drop the
@@ -119,6 +143,17 @@ allow_sha=1
 #check_reintegration_retry=1
 #
 
+#
+# The vnode caches hold 'large' directory vnodes and 'small' file
+# vnodes. With large_mb or small_mb set, a cache grows in steps of
+# 'large' or 'small' entries instead of evicting vnodes, until it uses
+# that many megabytes. Evictions are reported in the server statistics.
+# The default of 0 keeps the caches at a fixed size.
+#
+#large_mb=0
+#small_mb=0
+
+#adaptivewindow=0
 #authenticate=1
 #cbwait=240
 #chk=30
@@ -127,6 +162,7 @@ allow_sha=1
 #forcesalvage=1
 #large=500
 #nodebarrenize=0
+#packetsize=1084
 #pollandyield=1
 #pathtiming=1
 #resolution=1
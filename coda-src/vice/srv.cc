@@ -119,6 +119,7 @@ extern void rpc2_simplifyHost(RPC2_HostIdent *, RPC2_PortIdent *);
 #include <coda_getservbyname.h>
 #include "coppend.h"
 #include "daemonizer.h"
+#include "workpool.h"
 
 
 /* *****  Exported variables  ***** */
@@ -158,6 +159,8 @@ struct hgram SpoolVMLogRecord_hg, PutObjects_Transaction_hg, PutObjects_Transact
 
 int large = 0;	  // default 500, control size of lru cache for large vnodes 
 int small = 0;	  // default 500, control size of lru cache for small vnodes
+static int large_mb = 0;  // MB the large vnode cache may grow to, 0 is fixed
+static int small_mb = 0;  // MB the small vnode cache may grow to, 0 is fixed
 
 extern char *SmonHost;
 extern int SmonPort; 
@@ -181,11 +184,15 @@ static const char *srvhost;	// default NULL
 static int trace = 0;		// default 0 
 static int SrvWindowSize = 0;	// default 32
 static int SrvSendAhead = 0;	// default 8
+static int SrvPacketSize = 0;	// default 0, use the sftp default
+static int SrvAdaptiveWindow = 0; // default 0
+static int SrvMapFiles = 1;	// default 1
 static int timeout = 0;		// default 60, formerly 15, 30, then 60
 static int retrycnt = 0;	// default 5, formerly 4, 20, then 6
 static int debuglevel = 0;	// Command line set only.
 static int auth_lwps = 0;	// default 5
 static int server_lwps = 0;	// default 10
+static int worker_threads = 0;	// default 0, no worker thread pool
        int stack = 0;		// default 96
 static int cbwait = 0;		// default 240
 static int chk = 0;		// default 30
@@ -206,6 +213,7 @@ struct camlib_recoverable_segment *camlibRecoverableSegment;
 /*static */const char *_Rvm_Data_Device;
 /*static */rvm_offset_t _Rvm_DataLength;
 /*static */int _Rvm_Truncate = 0;	// default 0 
+static int _Rvm_GroupCommit = 0;	// default 0 (usec)
 /*static */char *cam_log_file;
 /*static */int camlog_fd;
 /*static */char camlog_record[SIZEOF_LARGEDISKVNODE + 8 + sizeof(VolumeDiskData)];
@@ -451,6 +459,9 @@ int main(int argc, char *argv[])
     /* set optimal window size and send ahead parameters */
     sei.WindowSize = SrvWindowSize;
     sei.AckPoint = sei.SendAhead = SrvSendAhead;
+    if (SrvPacketSize) sei.PacketSize = SrvPacketSize;
+    sei.AdaptiveWindow = SrvAdaptiveWindow;
+    sei.MapFiles = SrvMapFiles;
     sei.EnforceQuota = 1;
 
     s = coda_getservbyname("codasrv-se", "udp");
@@ -497,7 +508,7 @@ int main(int argc, char *argv[])
 
     InitCallBack();
     CheckVRDB();
-    VInitVolumePackage(large,small, ForceSalvage);
+    VInitVolumePackage(large,small, ForceSalvage, large_mb, small_mb);
 
 
     InitCopPendingTable();
@@ -514,6 +525,8 @@ int main(int argc, char *argv[])
     CODA_ASSERT(RPC2_Export(&server) == RPC2_SUCCESS);
     ClearCounters();
 
+    CODA_ASSERT(WP_Init(worker_threads) == 0);
+
     CODA_ASSERT(LWP_CreateProcess(CallBackCheckLWP, stack*1024, LWP_NORMAL_PRIORITY,
 				  (void *)&cbwait, "CheckCallBack", &serverPid) == LWP_SUCCESS);
 
@@ -952,6 +965,7 @@ void PrintCounters(FILE *fp)
     SLog(0, "GetAttr %d", Counters[GETATTR]);
     SLog(0, "GetAcl %d", Counters[GETACL]);
     SLog(0, "Fetch %d", Counters[FETCH]);
+    SLog(0, "FetchPartial %d", Counters[FETCHPARTIAL]);
     SLog(0, "SetAttr %d", Counters[SETATTR]);
     SLog(0, "SetAcl %d", Counters[SETACL]);
     SLog(0, "Store %d", Counters[STORE]);
@@ -989,6 +1003,7 @@ void PrintCounters(FILE *fp)
 
     SLog(0, "GetAttrPlusSHA %d", Counters[GETATTRPLUSSHA]);
     SLog(0, "ValidateAttrsPlusSHA %d", Counters[VALIDATEATTRSPLUSSHA]);
+    SLog(0, "ValidateFids %d", Counters[VALIDATEFIDS]);
 
     seconds = Counters[FETCHTIME]/1000;
     if(seconds <= 0)
@@ -1000,6 +1015,9 @@ void PrintCounters(FILE *fp)
 	   SIZE1 / 1024, Counters[FETCHD1], SIZE2 / 1024,
 	   Counters[FETCHD2], SIZE3 / 1024, Counters[FETCHD3], SIZE4 / 1024,
 	   Counters[FETCHD4], SIZE4 / 1024, Counters[FETCHD5]);
+    SLog(0, "Fetch CPU time = %d ms, %.0f us per MB", Counters[FETCHCPU],
+	   Counters[FETCHDATA] ? Counters[FETCHCPU] * 1000.0 /
+	   ((double)Counters[FETCHDATA] / (1024 * 1024)) : 0.0);
     seconds = Counters[STORETIME]/1000;
     if(seconds <= 0)
 	seconds = 1;
@@ -1013,6 +1031,7 @@ void PrintCounters(FILE *fp)
     VPrintCacheStats();
     DP_PrintStats(fp);
     DH_PrintStats(fp);
+    WP_PrintStats(fp);
     SLog(0, "RPC Total bytes:     sent = %u, received = %u",
 	   rpc2_Sent.Bytes + rpc2_MSent.Bytes + sftp_Sent.Bytes + sftp_MSent.Bytes,
 	   rpc2_Recvd.Bytes + rpc2_MRecvd.Bytes + sftp_Recvd.Bytes + sftp_MRecvd.Bytes);
@@ -1049,8 +1068,9 @@ void PrintCounters(FILE *fp)
     SLog(0, "RPC2 HW:  Freeze %d, Hold %d", rpc2_FreezeHWMark, rpc2_HoldHWMark);
     SLog(0, "SFTP:	datas %d, datar %d, acks %d, ackr %d, retries %d, duplicates %d",
 	   sftp_datas, sftp_datar, sftp_acks, sftp_ackr, sftp_retries, sftp_duplicates);
-    SLog(0, "SFTP:  timeouts %d, windowfulls %d, bogus %d, didpiggy %d",
-	   sftp_timeouts, sftp_windowfulls, sftp_bogus, sftp_didpiggy);
+    SLog(0, "SFTP:  timeouts %d, windowfulls %d, bogus %d, didpiggy %d, mapped %d",
+	   sftp_timeouts, sftp_windowfulls, sftp_bogus, sftp_didpiggy,
+	   sftp_mapped);
     SLog(0, "Total CB entries= %d, blocks = %d; and total file entries = %d, blocks = %d",
 	   CBEs, CBEBlocks, FEs, FEBlocks);
     /*    ProcSize = sbrk(0) >> 10;*/
@@ -1071,6 +1091,16 @@ void PrintCounters(FILE *fp)
 	rvm_statistics_t rvmstats;
 	rvm_init_statistics(&rvmstats);
 	RVM_STATISTICS(&rvmstats);
+
+	/* every flush commit is entered in the latency histogram, the ones
+	   that piggybacked didn't force the log themselves */
+	unsigned long commits = 0, forces;
+	for (int i = 0; i < commit_times_len; i++)
+	    commits += rvmstats.commit_times[i];
+	forces = commits - rvmstats.n_piggyback_commit;
+	SLog(0, "RVM flush commits = %lu, log forces = %lu, %.1f commits per force",
+	     commits, forces, forces ? (double)commits / forces : 0.0);
+
 	rvm_print_statistics(&rvmstats, fp);
 	rvm_free_statistics(&rvmstats);
     }
@@ -1279,6 +1309,8 @@ static int ReadConfigFile(void)
 
     CODACONF_INT(large, "large", 500);
     CODACONF_INT(small, "small", 500);
+    CODACONF_INT(large_mb, "large_mb", 0);
+    CODACONF_INT(small_mb, "small_mb", 0);
 
     CODACONF_STR(vicedir, "vicedir", "/vice");
     vice_dir_init(vicedir);
@@ -1286,11 +1318,15 @@ static int ReadConfigFile(void)
     CODACONF_INT(trace,		"trace",	0);
     CODACONF_INT(SrvWindowSize,	"windowsize",	32);
     CODACONF_INT(SrvSendAhead,	"sendahead",	8);
+    CODACONF_INT(SrvPacketSize,	"packetsize",	0);
+    CODACONF_INT(SrvAdaptiveWindow, "adaptivewindow", 0);
+    CODACONF_INT(SrvMapFiles, "mapfiles", 1);
     CODACONF_INT(timeout,	"timeout",	60);
     CODACONF_INT(retrycnt,	"retrycnt",	5);
     CODACONF_INT(auth_lwps,	"auth_lwps",	5);
     CODACONF_INT(server_lwps,	"lwps",		10);
     if (server_lwps > MAXLWP) server_lwps = MAXLWP;
+    CODACONF_INT(worker_threads, "worker_threads", 0);
 
     CODACONF_INT(stack,		    "stack",	    96);
     CODACONF_INT(cbwait,	    "cbwait",	    240);
@@ -1301,6 +1337,7 @@ static int ReadConfigFile(void)
 
     /* Rvm parameters */
     CODACONF_INT(_Rvm_Truncate, "rvmtruncate", 0);
+    CODACONF_INT(_Rvm_GroupCommit, "rvm_groupcommit", 0);
 
     if (RvmType == UNSET) {
         CODACONF_STR(_Rvm_Log_Device,  "rvm_log", "");
@@ -1666,6 +1703,11 @@ static void InitializeServerRVM(const char *name)
 	    SLog(0, "Setting Rvm Truncate threshhold to %d.\n", _Rvm_Truncate);
 	    options->truncate = _Rvm_Truncate;
 	}
+	if (_Rvm_GroupCommit > 0) {
+	    SLog(0, "Setting Rvm group commit window to %d usec.\n",
+		 _Rvm_GroupCommit);
+	    options->group_commit = _Rvm_GroupCommit;
+	}
 
 	err = RVM_INIT(options);		/* Start rvm */
 	free(tmp);
@@ -57,11 +57,13 @@ extern "C" {
 
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <signal.h>
 #include "coda_string.h"
 #include <inodeops.h>
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <util.h>
 #include <rvmlib.h>
@@ -106,6 +108,7 @@ extern "C" {
 #include <cvnode.h>
 #include <operations.h>
 #include "coppend.h"
+#include "workpool.h"
 
 #ifdef _TIMECALLS_
 #include "timecalls.h"
@@ -134,6 +137,7 @@ static int GetFsoAndParent(ViceFid *Fid, dlist *vlist, Volume **volptr,
 			   vle **v, vle **av, int lock, int vollock,
 			   int ignoreIncon);
 static int GrabFsObj(ViceFid *, Volume **, Vnode **, int, int, int);
+static long long LWPCPUTime(void);
 static int NormalVCmp(int, VnodeType, void *, void *);
 static int StoreVCmp(int, VnodeType, void *, void *);
 
@@ -185,6 +189,19 @@ long FS_ViceFetch(RPC2_Handle RPCid, ViceFid *Fid, ViceVersionVector *VV,
 		  RPC2_Unsigned InconOK, ViceStatus *Status,
 		  RPC2_Unsigned PrimaryHost, RPC2_Unsigned Offset,
 		  RPC2_CountedBS *PiggyBS, SE_Descriptor *BD)
+{
+    return FS_ViceFetchPartial(RPCid, Fid, VV, InconOK, Status, PrimaryHost,
+			       Offset, (RPC2_Unsigned)-1, PiggyBS, BD);
+}
+
+/*
+  ViceFetchPartial: Fetch at most Count bytes of a file starting at Offset
+*/
+long FS_ViceFetchPartial(RPC2_Handle RPCid, ViceFid *Fid,
+			 ViceVersionVector *VV, RPC2_Unsigned InconOK,
+			 ViceStatus *Status, RPC2_Unsigned PrimaryHost,
+			 RPC2_Unsigned Offset, RPC2_Unsigned Count,
+			 RPC2_CountedBS *PiggyBS, SE_Descriptor *BD)
 {
     int errorCode = 0;		/* return code to caller */
     Volume *volptr = 0;		/* pointer to the volume */
@@ -196,9 +213,13 @@ long FS_ViceFetch(RPC2_Handle RPCid, ViceFid *Fid, ViceVersionVector *VV,
     dlist *vlist = new dlist((CFN)VLECmp);
     vle *v;
     vle *av;
+    RPC2_Integer sent = 0;	/* bytes sent by the bulk transfer */
+    long long cpu;
 
 START_TIMING(Fetch_Total);
-    SLog(1, "ViceFetch: Fid = %s, Repair = %d", FID_(Fid), InconOK);
+    cpu = LWPCPUTime();
+    SLog(1, "ViceFetch: Fid = %s, Repair = %d, Offset = %u, Count = %d",
+	 FID_(Fid), InconOK, Offset, (int)Count);
 
   
     /* Validate parameters. */
@@ -225,7 +246,7 @@ START_TIMING(Fetch_Total);
     {
 	if (!ReplicatedOp || PrimaryHost == ThisHostAddr)
 	    if ((errorCode = FetchBulkTransfer(RPCid, client, volptr, v->vptr,
-					      Offset, VV)))
+					      Offset, Count, VV, &sent)))
 		goto FreeLocks;
 	PerformFetch(client, volptr, v->vptr);
 
@@ -245,6 +266,9 @@ FreeLocks:
 
     SLog(2, "ViceFetch returns %s", ViceErrorMsg(errorCode));
 END_TIMING(Fetch_Total);
+    cpu = LWPCPUTime() - cpu;
+    SLog(2, "Fetch_Total: cpu = %lld us, %.0f us per MB", cpu,
+	 sent ? cpu / ((double)sent / (1024 * 1024)) : 0.0);
     return(errorCode);
 }
 
@@ -352,7 +376,13 @@ START_TIMING(GetAttr_Total);
 	      FID_(Fid), v->vptr->disk.node.inodeNumber);
 	if (fd == -1) goto FreeLocks;
 
-	ComputeViceSHA(fd, VnSHA(v->vptr));
+	/* hash on a worker thread, other requests are served meanwhile */
+	struct wp_sha sha;
+	sha.fd = fd;
+	if (WP_Run(WP_ComputeSHA, &sha) == -1)
+	    ComputeViceSHA(fd, VnSHA(v->vptr));
+	else if (!sha.err)
+	    memcpy(VnSHA(v->vptr), sha.sha, SHA_DIGEST_LENGTH);
 	close(fd);
     }
 
@@ -513,6 +543,181 @@ END_TIMING(ViceValidateAttrs_Total);
     return(errorCode);
 }
 
+/* Vnode order for FS_ViceValidateFids. */
+struct validate_order {
+    VnodeId vnode;
+    int ix;
+};
+
+static int ValidateOrderCmp(const void *a, const void *b)
+{
+    const struct validate_order *oa = (const struct validate_order *)a;
+    const struct validate_order *ob = (const struct validate_order *)b;
+
+    if (oa->vnode != ob->vnode)
+	return oa->vnode < ob->vnode ? -1 : 1;
+    return oa->ix - ob->ix;
+}
+
+const int Yield_ValidateFids_Period = 64;
+const int Yield_ValidateFids_Mask = Yield_ValidateFids_Period - 1;
+
+/*
+  ViceValidateFids: Validate the status of a large set of objects
+
+  Unlike ViceValidateAttrs this does not lock all objects at once, every
+  vnode is only held while its version vector is compared. Like
+  ViceValidateAttrs it does not need any access rights, the client only
+  learns whether its copy is current.
+*/
+long FS_ViceValidateFids(RPC2_Handle RPCid, VolumeId Vid, RPC2_Unsigned Count,
+			 RPC2_BoundedBS *VFlagBS, RPC2_CountedBS *PiggyBS,
+			 SE_Descriptor *BD)
+{
+    long errorCode = 0;		/* return code to caller */
+    VolumeId VSGVolnum = Vid;
+    Volume *volptr = 0;		/* pointer to the volume */
+    ClientEntry *client = 0;	/* pointer to the client data */
+    int ReplicatedOp;
+    struct ViceValidateRec *recs = NULL;
+    struct validate_order *order = NULL;
+    unsigned int i, nvalid = 0;
+    struct timeval start, end;
+
+START_TIMING(ViceValidateFids_Total);
+    SLog(1, "ViceValidateFids: Vid = %x, %d fids", Vid, Count);
+    gettimeofday(&start, NULL);
+
+    VFlagBS->SeqLen = 0;
+
+    if (Count > VICE_MAXVALIDATE || VFlagBS->MaxSeqLen < (Count + 7) / 8) {
+	SLog(0, "ViceValidateFids: bad count %d, MaxSeqLen %d",
+	     Count, VFlagBS->MaxSeqLen);
+	errorCode = EINVAL;
+	goto Exit;
+    }
+    memset(VFlagBS->SeqBody, 0, VFlagBS->MaxSeqLen);
+
+    /* Validate parameters. */
+    {
+	if ((errorCode = ValidateParms(RPCid, &client, &ReplicatedOp, &Vid,
+				       PiggyBS, NULL)))
+	    goto Exit;
+    }
+
+    /* Fetch the records from the client. */
+    if (Count) {
+	recs = (struct ViceValidateRec *)malloc(Count * sizeof(*recs));
+	order = (struct validate_order *)malloc(Count * sizeof(*order));
+	if (!recs || !order) {
+	    errorCode = ENOMEM;
+	    goto Exit;
+	}
+
+	SE_Descriptor sid;
+	memset(&sid, 0, sizeof(SE_Descriptor));
+	sid.Tag = SMARTFTP;
+	sid.Value.SmartFTPD.TransmissionDirection = CLIENTTOSERVER;
+	sid.Value.SmartFTPD.SeekOffset = 0;
+	sid.Value.SmartFTPD.hashmark = (SrvDebugLevel > 2 ? '#' : '\0');
+	sid.Value.SmartFTPD.ByteQuota = -1;
+	sid.Value.SmartFTPD.Tag = FILEINVM;
+	sid.Value.SmartFTPD.FileInfo.ByAddr.vmfile.MaxSeqLen = Count * sizeof(*recs);
+	sid.Value.SmartFTPD.FileInfo.ByAddr.vmfile.SeqLen = 0;
+	sid.Value.SmartFTPD.FileInfo.ByAddr.vmfile.SeqBody = (RPC2_ByteSeq)recs;
+
+	if ((errorCode = RPC2_InitSideEffect(RPCid, &sid)) <= RPC2_ELIMIT) {
+	    SLog(0, "ViceValidateFids: Init_SE failed (%d)", errorCode);
+	    goto Exit;
+	}
+
+	if ((errorCode = RPC2_CheckSideEffect(RPCid, &sid, SE_AWAITLOCALSTATUS)) <= RPC2_ELIMIT) {
+	    SLog(0, "ViceValidateFids: Check_SE failed (%d)", errorCode);
+	    if (errorCode == RPC2_SEFAIL1) errorCode = EIO;
+	    goto Exit;
+	}
+	errorCode = 0;
+
+	if (sid.Value.SmartFTPD.BytesTransferred != (long)(Count * sizeof(*recs))) {
+	    SLog(0, "ViceValidateFids: got %d bytes, expected %d",
+		 sid.Value.SmartFTPD.BytesTransferred, Count * sizeof(*recs));
+	    errorCode = EINVAL;
+	    goto Exit;
+	}
+    }
+
+    if ((errorCode = GetVolObj(Vid, &volptr, VOL_NO_LOCK, 0, 0))) {
+	SLog(0, "ViceValidateFids: GetVolObj error %s",
+	     ViceErrorMsg((int)errorCode));
+	goto Exit;
+    }
+
+    /* Walk the vnodes in index order. */
+    for (i = 0; i < Count; i++) {
+	order[i].vnode = ntohl(recs[i].Vnode);
+	order[i].ix = i;
+    }
+    qsort(order, Count, sizeof(*order), ValidateOrderCmp);
+
+    for (i = 0; i < Count; i++) {
+	struct ViceValidateRec *r = &recs[order[i].ix];
+	ViceVersionVector VV;
+	ViceFid Fid;
+	Error fileCode = 0;
+	Vnode *vptr;
+	int j;
+
+	if (i && !(i & Yield_ValidateFids_Mask))
+	    PollAndYield();
+
+	Fid.Volume = Vid;
+	Fid.Vnode = order[i].vnode;
+	Fid.Unique = ntohl(r->Unique);
+	if (Fid.Vnode == 0 || Fid.Unique == 0)
+	    continue;
+
+	for (j = 0; j < VSG_MEMBERS; j++)
+	    (&VV.Versions.Site0)[j] = ntohl(r->Versions[j]);
+	VV.StoreId.Host = ntohl(r->StoreHost);
+	VV.StoreId.Uniquifier = ntohl(r->StoreUniquifier);
+	VV.Flags = ntohl(r->Flags);
+
+	vptr = VGetVnode(&fileCode, volptr, Fid.Vnode, Fid.Unique, READ_LOCK,
+			 0, 0);
+	if (fileCode) {
+	    SLog(1, "ViceValidateFids: %s failed (%s)", FID_(&Fid),
+		 ViceErrorMsg((int)fileCode));
+	    continue;
+	}
+
+	if (vptr->disk.uniquifier == Fid.Unique &&
+	    VV_Cmp(&VV, &vptr->disk.versionvector) == VV_EQ &&
+	    CodaAddCallBack(client->VenusId, &Fid, VSGVolnum) == CallBackSet) {
+	    VFlagBS->SeqBody[order[i].ix / 8] |= 1 << (order[i].ix % 8);
+	    nvalid++;
+	    SLog(8, "ViceValidateFids: %s ok", FID_(&Fid));
+	}
+
+	VPutVnode(&fileCode, vptr);
+	CODA_ASSERT(fileCode == 0);
+    }
+    VFlagBS->SeqLen = (Count + 7) / 8;
+
+    PutVolObj(&volptr, VOL_NO_LOCK);
+
+Exit:
+    if (recs) free(recs);
+    if (order) free(order);
+
+    gettimeofday(&end, NULL);
+    SLog(2, "ViceValidateFids returns %s, %d of %d valid, %ld ms",
+	 ViceErrorMsg((int)errorCode), nvalid, Count,
+	 (end.tv_sec - start.tv_sec) * 1000 +
+	 (end.tv_usec - start.tv_usec) / 1000);
+END_TIMING(ViceValidateFids_Total);
+    return(errorCode);
+}
+
 /*
   ViceGetACL: Fetch the acl of a directory
 */
@@ -3418,9 +3623,27 @@ void PerformFetch(ClientEntry *client, Volume *volptr, Vnode *vptr) {
 }
 
 
+/* CPU time used by the thread running the LWPs, in microseconds. Other
+   LWPs run while a fetch waits for the network, so per fetch this is an
+   upper bound. */
+static long long LWPCPUTime(void)
+{
+    struct rusage ru;
+
+#ifdef RUSAGE_THREAD
+    getrusage(RUSAGE_THREAD, &ru);
+#else
+    getrusage(RUSAGE_SELF, &ru);
+#endif
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL +
+	   ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+
 int FetchBulkTransfer(RPC2_Handle RPCid, ClientEntry *client, 
 		      Volume *volptr, Vnode *vptr, RPC2_Unsigned Offset,
-		      ViceVersionVector *VV)
+		      RPC2_Unsigned Count, ViceVersionVector *VV,
+		      RPC2_Integer *sent)
 {
     int errorCode = 0;
     ViceFid Fid;
@@ -3434,9 +3657,11 @@ int FetchBulkTransfer(RPC2_Handle RPCid, ClientEntry *client,
     int fd = -1;
 
     {
-	/* When we are continueing a trickle/interrupted fetch, the version
-	 * vector must be the same */
-	if (Offset && VV && (VV_Cmp(VV, &vptr->disk.versionvector) != VV_EQ))
+	/* When we are continueing a trickle/interrupted fetch, or the client
+	 * is fetching a piece of the file, the version vector must be the
+	 * same */
+	if ((Offset || Count != (RPC2_Unsigned)-1) && VV &&
+	    (VV_Cmp(VV, &vptr->disk.versionvector) != VV_EQ))
 	{
 		SLog(1, "FetchBulkTransfer: Attempting resumed fetch on updated object");
 		/* now what errorcode can we use for this case?? */
@@ -3459,7 +3684,10 @@ int FetchBulkTransfer(RPC2_Handle RPCid, ClientEntry *client,
     /* Do the bulk transfer. */
     {
 	struct timeval StartTime, StopTime;
+	static long long CPURemainder;
+	long long CPUStart, CPU;
 	TM_GetTimeOfDay(&StartTime, 0);
+	CPUStart = LWPCPUTime();
 
 	SE_Descriptor sid;
 	memset(&sid, 0, sizeof(SE_Descriptor));
@@ -3468,9 +3696,22 @@ int FetchBulkTransfer(RPC2_Handle RPCid, ClientEntry *client,
 	sid.Value.SmartFTPD.SeekOffset = Offset;
 	sid.Value.SmartFTPD.hashmark = (SrvDebugLevel > 2 ? '#' : '\0');
 	sid.Value.SmartFTPD.ByteQuota = -1;
+	/* only send the requested piece, directories always go in one go */
+	if (Count && Count != (RPC2_Unsigned)-1 && vptr->disk.type != vDirectory &&
+	    (RPC2_Integer)Offset <= Length && Count < (RPC2_Unsigned)(Length - Offset))
+	    sid.Value.SmartFTPD.ByteQuota = Count;
 	if (vptr->disk.type != vDirectory) {
 	    if (vptr->disk.node.inodeNumber) {
 		fd = iopen(V_device(volptr), vptr->disk.node.inodeNumber, O_RDONLY);
+
+#ifdef HAVE_POSIX_FADVISE
+		/* let the kernel start reading what sftp is about to send */
+		if (fd != -1 && (RPC2_Integer)Offset < Length)
+		    posix_fadvise(fd, Offset,
+				  sid.Value.SmartFTPD.ByteQuota != -1 ?
+				  sid.Value.SmartFTPD.ByteQuota :
+				  Length - Offset, POSIX_FADV_WILLNEED);
+#endif
 		sid.Value.SmartFTPD.Tag = FILEBYFD;
 		sid.Value.SmartFTPD.FileInfo.ByFD.fd = fd;
 	    } else {
@@ -3527,8 +3768,10 @@ int FetchBulkTransfer(RPC2_Handle RPCid, ClientEntry *client,
 	}
 
 	/* compensate Length for the data we skipped because of the requested
-	 * Offset */
+	 * Offset and the part we did not send */
 	Length -= Offset;
+	if (sid.Value.SmartFTPD.ByteQuota != -1)
+	    Length = sid.Value.SmartFTPD.ByteQuota;
 
 	RPC2_Integer len = sid.Value.SmartFTPD.BytesTransferred;
 	if (len != Length) {
@@ -3541,10 +3784,15 @@ int FetchBulkTransfer(RPC2_Handle RPCid, ClientEntry *client,
 	}
 
 	TM_GetTimeOfDay(&StopTime, 0);
+	CPU = LWPCPUTime() - CPUStart;
 
 	Counters[FETCHDATAOP]++;
 	Counters[FETCHTIME] += (int) (((StopTime.tv_sec - StartTime.tv_sec) * 1000) +
 	  ((StopTime.tv_usec - StartTime.tv_usec) / 1000));
+	/* don't lose the sub-millisecond part of small fetches */
+	CPURemainder += CPU;
+	Counters[FETCHCPU] += (int)(CPURemainder / 1000);
+	CPURemainder %= 1000;
 	Counters[FETCHDATA] += (int) Length;
 	if (Length < SIZE1)
 	    Counters[FETCHD1]++;
@@ -3557,8 +3805,10 @@ int FetchBulkTransfer(RPC2_Handle RPCid, ClientEntry *client,
 	else
 	    Counters[FETCHD5]++;
 
-	SLog(2, "FetchBulkTransfer: transferred %d bytes %s",
-	     Length, FID_(&Fid));
+	SLog(2, "FetchBulkTransfer: transferred %d bytes %s, cpu %lld us, "
+	     "%.0f us/MB", Length, FID_(&Fid), CPU,
+	     Length ? CPU / ((double)Length / (1024 * 1024)) : 0.0);
+	if (sent) *sent = Length;
     }
 
 Exit:
@@ -4506,15 +4756,18 @@ START_TIMING(PutObjects_Transaction);
 				 v->vptr->disk.node.dirNode = NULL;
 			    else v->vptr->disk.node.inodeNumber = 0;
 			}
+			/* Keep the vnode locked until the transaction is on
+			   disk, nobody should see uncommitted changes while
+			   the commit waits for the log to be forced. */
 			if (errorCode == 0)
-			    VPutVnode(&fileCode, v->vptr);
-			else
+			    VWriteVnode(&fileCode, v->vptr);
+			else {
 			    VFlushVnode(&fileCode, v->vptr);
+			    v->vptr = 0;
+			}
 
 			CODA_ASSERT(fileCode == 0);
 		    }
-
-		    v->vptr = 0;
 		}
 	}
 
@@ -4532,6 +4785,16 @@ START_TIMING(PutObjects_Transaction);
 	PutVolObj(&volptr, LockLevel);
 	rvmlib_end_transaction(flush, &(status));
 	CODA_ASSERT(status == 0);
+
+	if (vlist) {
+	    dlist_iterator next(*vlist);
+	    vle *v;
+	    while ((v = (vle *)next()))
+		if (v->vptr) {
+		    VReleaseVnode(v->vptr);
+		    v->vptr = 0;
+		}
+	}
     } else {
 /*  NO transaction */
 	if (vlist) {
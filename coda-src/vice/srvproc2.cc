@@ -771,8 +771,8 @@ static void SetViceStats(ViceStatistics *stats)
     stats->CurrentConnections = CurrentConnections;
     stats->TotalViceCalls = Counters[TOTAL];
 
-    stats->TotalFetches = Counters[GETATTRPLUSSHA]+Counters[GETATTR]+Counters[GETACL]+Counters[FETCH];
-    stats->FetchDatas = Counters[FETCH];
+    stats->TotalFetches = Counters[GETATTRPLUSSHA]+Counters[GETATTR]+Counters[GETACL]+Counters[FETCH]+Counters[FETCHPARTIAL];
+    stats->FetchDatas = Counters[FETCH]+Counters[FETCHPARTIAL];
     stats->FetchedBytes = Counters[FETCHDATA];
     seconds = Counters[FETCHTIME]/1000;
     if(seconds <= 0) seconds = 1;
@@ -91,7 +91,10 @@ int VCBEs = 0;          /* number of CBEs that are for volumes */
 
 /* *****  Private constants  ***** */
 
-const int VHASH = 256;
+/* The file entry hash table starts with CBHASH_INIT buckets and doubles
+ * whenever there are more than CBHASH_LOAD file entries per bucket. */
+#define CBHASH_INIT 1024
+#define CBHASH_LOAD 2
 
 /* *****  Private types  ***** */
 
@@ -133,13 +136,16 @@ struct CBStat {
 
 /* *****  Private variables  ***** */
 
-static	struct FileEntry *hashTable[VHASH]; /* File entry hash table */
+static struct FileEntry **hashTable = 0;   /* File entry hash table */
+static unsigned int hashMask = 0;	    /* number of buckets - 1 */
+static int hashGrows = 0;		    /* times the table was resized */
 static struct CallBackEntry *CBEFree =	0;  /* first free CBE */
 static struct FileEntry *FEFree = 0;	    /* first free file entry */
 
 /* *****  Private routines  ***** */
 
-static long VHash(ViceFid *);
+static unsigned int VHash(ViceFid *);
+static void GrowHashTable();
 static void GetFEBlock();
 static struct FileEntry *GetFE();
 static void FreeFE(struct FileEntry *);
@@ -154,9 +160,43 @@ static void SDeleteCallBack(HostTable *, struct FileEntry *);
 
 /* *****  File Entries  ***** */
 
-static long VHash(ViceFid *afid) {
-    long i = ((afid->Volume + afid->Vnode) % VHASH);
-    return((i < 0) ? i + VHASH : i);
+/* Mix all fid components, vnode numbers are small and dense and a single
+ * volume often holds most of the callbacks. */
+static unsigned int VHash(ViceFid *afid) {
+    unsigned int h = afid->Volume;
+    h = h * 0x9e3779b1 + afid->Vnode;
+    h = h * 0x9e3779b1 + afid->Unique;
+    h ^= h >> 16;
+    return(h & hashMask);
+}
+
+
+/* Double the number of buckets. File entries are only relinked, so
+ * pointers held across a yield (e.g. in BreakCallBack) stay valid. */
+static void GrowHashTable()
+{
+	struct FileEntry **oldTable = hashTable;
+	unsigned int oldSize = hashMask + 1;
+
+	struct FileEntry **newTable = (struct FileEntry **)
+		calloc(2 * oldSize, sizeof(struct FileEntry *));
+	if (!newTable)
+		return;	    /* keep going with longer chains */
+
+	hashTable = newTable;
+	hashMask = 2 * oldSize - 1;
+
+	for (unsigned int i = 0; i < oldSize; i++) {
+		struct FileEntry *nf = 0;
+		for (struct FileEntry *tf = oldTable[i]; tf; tf = nf) {
+			nf = tf->next;
+			unsigned int bucket = VHash(&tf->theFid);
+			tf->next = hashTable[bucket];
+			hashTable[bucket] = tf;
+		}
+	}
+	free(oldTable);
+	hashGrows++;
 }
 
 
@@ -218,7 +258,7 @@ static struct FileEntry *FindEntry(ViceFid *afid)
 
 static void DeleteFileStruct(struct FileEntry *af) 
 {
-	long bucket = VHash(&af->theFid);
+	unsigned int bucket = VHash(&af->theFid);
 	struct FileEntry **lf = &hashTable[bucket];
 	for (struct FileEntry *tf = hashTable[bucket]; tf; tf = tf->next) {
 		if (tf == af) {
@@ -261,6 +301,8 @@ static struct CallBackEntry *GetCBE() {
 
 /* Return an entry to the free list. */
 static void FreeCBE(struct CallBackEntry *entry) {
+    if (entry->conn)
+	entry->conn->CallBacks--;
     entry->next = CBEFree;
     CBEFree = entry;
     CBEs--;
@@ -268,8 +310,10 @@ static void FreeCBE(struct CallBackEntry *entry) {
     
 
 int InitCallBack() {
-    for (int i = 0; i < VHASH; i++)
-	hashTable[i] = 0;
+    hashTable = (struct FileEntry **)
+	calloc(CBHASH_INIT, sizeof(struct FileEntry *));
+    CODA_ASSERT(hashTable);
+    hashMask = CBHASH_INIT - 1;
 
     return(0);
 }
@@ -293,8 +337,11 @@ CallBackStatus AddCallBack(HostTable *client, ViceFid *afid)
 	tf->users = 0;
 	tf->callBacks = 0;
 
+	if (FEs > CBHASH_LOAD * (int)(hashMask + 1))
+	    GrowHashTable();
+
 	/* Insert it into the hash table. */
-	long bucket = VHash(afid);
+	unsigned int bucket = VHash(afid);
 	tf->next = hashTable[bucket];
 	hashTable[bucket] = tf;
 
@@ -320,6 +367,7 @@ CallBackStatus AddCallBack(HostTable *client, ViceFid *afid)
     tc->next = tf->callBacks;
     tf->callBacks = tc;
     tc->conn = client;
+    client->CallBacks++;
 
     return(CallBackSet);
 }
@@ -502,6 +550,7 @@ static void SDeleteCallBack(HostTable *client, struct FileEntry *af)
 	nc = tc->next;
 	if (tc->conn == client) {
 	    if (busy) {
+		client->CallBacks--;
 		tc->conn = 0;
 	    }
 	    else {
@@ -532,7 +581,9 @@ void DeleteVenus(HostTable *client)
     SLog(1, "DeleteVenus for venus %s.%d",
 	 inet_ntoa(client->host), ntohs(client->port));
 
-    for (int i = 0; i < VHASH; i++) {
+    /* Stop as soon as all of the client's callbacks are gone, most clients
+     * only hold callbacks on a small part of the table. */
+    for (unsigned int i = 0; i <= hashMask && client->CallBacks > 0; i++) {
 	    struct FileEntry *nf = 0;
 	    for (struct FileEntry *tf = hashTable[i]; tf; tf = nf) {
 		    /* Pull this out before it gets zapped */
@@ -554,8 +605,11 @@ void DeleteFile(ViceFid *afid)
     if(tf) {
 	if (CheckLock(&tf->cblock)) {
 	    /* Mark them all as dead if a delete callback is occurring. */
-	    for(struct CallBackEntry *tc = tf->callBacks; tc; tc = tc->next)
+	    for(struct CallBackEntry *tc = tf->callBacks; tc; tc = tc->next) {
+		if (tc->conn)
+		    tc->conn->CallBacks--;
 		tc->conn = 0;
+	    }
 	}
 	else {
 	    /* Do it all ourselves. */
@@ -675,6 +729,7 @@ void PrintCallBackState(FILE *fp)
 	int allocatedFEs = 0;
 	int allocatedCBEs = 0;
 	int numVolumes = 0;
+	int usedBuckets = 0, longestChain = 0;
 	struct CBStat *CBStats, *CBSEnt;   // will sort at end 
 	struct hgram CBGram, VCBGram;
 	
@@ -682,8 +737,10 @@ void PrintCallBackState(FILE *fp)
 	CBStats = (struct CBStat *) malloc(MaxVols * sizeof(struct CBStat));
 	memset((char *)CBStats, 0, (int)sizeof(struct CBStat) * MaxVols);
 
-	for (int i = 0; i < VHASH; i++) {
+	for (unsigned int i = 0; i <= hashMask; i++) {
 	    struct FileEntry *tfe = hashTable[i];
+	    int chain = 0;
+	    if (tfe) usedBuckets++;
 	    while (tfe) {
 		char aVE = (tfe->theFid.Vnode == 0 && tfe->theFid.Unique == 0);
 		allocatedFEs++;
@@ -716,12 +773,35 @@ void PrintCallBackState(FILE *fp)
 		    CBSEnt->CBEs += countcbe;
 		    if (aVE) CBSEnt->VCBEs += countcbe;
 		}
+		chain++;
 		tfe = tfe->next;
 	    }
+	    if (chain > longestChain) longestChain = chain;
 	}
 	fprintf(fp, "\tFrom lists: %d CBEs allocated and %d FEs allocated\n",
 		allocatedCBEs, allocatedFEs);
 
+	/* Everything the callback state costs, averaged over the active
+	 * callbacks. */
+	size_t tableBytes = (hashMask + 1) * sizeof(struct FileEntry *);
+	size_t feBytes = (size_t)FEBlocks * sizeof(struct FEBlock);
+	size_t cbeBytes = (size_t)CBEBlocks * sizeof(struct CBEBlock);
+	size_t totalBytes = tableBytes + feBytes + cbeBytes;
+
+	fprintf(fp, "Hash table:\n");
+	fprintf(fp, "\t%u buckets (%d resizes), %d in use, average chain %.2f, longest %d\n",
+		hashMask + 1, hashGrows, usedBuckets,
+		usedBuckets ? (double)allocatedFEs / usedBuckets : 0.0,
+		longestChain);
+	fprintf(fp, "Memory:\n");
+	fprintf(fp, "\ttable %lu, FEs %lu, CBEs %lu, total %lu bytes\n",
+		(unsigned long)tableBytes, (unsigned long)feBytes,
+		(unsigned long)cbeBytes, (unsigned long)totalBytes);
+	if (CBEs)
+	    fprintf(fp, "\t%.1f bytes per active callback (%d bytes per CBE, %d per FE)\n",
+		    (double)totalBytes / CBEs, (int)sizeof(struct CallBackEntry),
+		    (int)sizeof(struct FileEntry));
+
 	// summary statstics. number of callbacks per volume depends on 
 	// number of clients and number of objects in the volume. number
 	// of volume callbacks is only 100 because of the small number of
@@ -788,7 +868,7 @@ static void GetCallBacks(VolumeId vid, FILE *fp)
     }
 
     /* print file callbacks for all fids in the volume */
-    for (int j = 0; j < VHASH; j++) {
+    for (unsigned int j = 0; j <= hashMask; j++) {
 	struct FileEntry *nf = 0;
 	for (struct FileEntry *tf = hashTable[j]; tf; tf = nf) {
 	    nf = tf->next;
@@ -0,0 +1,241 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ *
+ * Implementation of the server worker thread pool.
+ *
+ * Queued work is picked up by the worker threads. When a worker is done
+ * it writes the address of the work item to a pipe. The reaper LWP waits
+ * for the pipe in IOMGR_Select and wakes up the LWP that queued the work,
+ * worker threads never call into the LWP package themselves.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lwp/lwp.h>
+#include <util.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "workpool.h"
+
+struct wp_work {
+    void (*fn)(void *);
+    void *arg;
+    int done;
+    struct timeval queued;
+    struct wp_work *next;
+};
+
+static pthread_mutex_t wp_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wp_cond = PTHREAD_COND_INITIALIZER;
+static struct wp_work *wp_head, *wp_tail;	/* protected by wp_mutex */
+static int wp_threads;
+static int wp_pipe[2] = { -1, -1 };
+
+/* Statistics, protected by wp_mutex. */
+static unsigned long wp_runs;
+static unsigned long wp_queued, wp_maxqueued;
+static double wp_waittime, wp_runtime;		/* seconds */
+
+static double wp_elapsed(struct timeval *start, struct timeval *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+	   (end->tv_usec - start->tv_usec) / 1e6;
+}
+
+static void *wp_worker(void *arg)
+{
+    struct wp_work *w;
+    struct timeval start, end;
+
+    for (;;) {
+	pthread_mutex_lock(&wp_mutex);
+	while (!wp_head)
+	    pthread_cond_wait(&wp_cond, &wp_mutex);
+	w = wp_head;
+	wp_head = w->next;
+	if (!wp_head)
+	    wp_tail = NULL;
+	wp_queued--;
+	pthread_mutex_unlock(&wp_mutex);
+
+	gettimeofday(&start, NULL);
+	w->fn(w->arg);
+	gettimeofday(&end, NULL);
+
+	pthread_mutex_lock(&wp_mutex);
+	wp_runs++;
+	wp_waittime += wp_elapsed(&w->queued, &start);
+	wp_runtime += wp_elapsed(&start, &end);
+	pthread_mutex_unlock(&wp_mutex);
+
+	/* a pointer is less than PIPE_BUF, the write is atomic */
+	while (write(wp_pipe[1], &w, sizeof(w)) != sizeof(w))
+	    if (errno != EINTR)
+		abort();
+    }
+    return NULL;
+}
+
+/* Wake up the LWPs whose work is done. */
+static void wp_reaper(void *arg)
+{
+    struct wp_work *w;
+    fd_set rfds;
+
+    for (;;) {
+	FD_ZERO(&rfds);
+	FD_SET(wp_pipe[0], &rfds);
+	if (IOMGR_Select(wp_pipe[0] + 1, &rfds, NULL, NULL, NULL) <= 0)
+	    continue;
+
+	while (read(wp_pipe[0], &w, sizeof(w)) == sizeof(w)) {
+	    w->done = 1;
+	    LWP_NoYieldSignal(w);
+	}
+    }
+}
+
+int WP_Init(int nthreads)
+{
+    pthread_attr_t attr;
+    pthread_t tid;
+    sigset_t all, old;
+    PROCESS pid;
+    int i;
+
+    if (nthreads <= 0)
+	return 0;
+
+    if (pipe(wp_pipe) < 0) {
+	SLog(0, "WP_Init: pipe failed, %s", strerror(errno));
+	return -1;
+    }
+    fcntl(wp_pipe[0], F_SETFL, O_NONBLOCK);
+
+    if (LWP_CreateProcess(wp_reaper, 16 * 1024, LWP_NORMAL_PRIORITY, NULL,
+			  "WorkPoolReaper", &pid) != LWP_SUCCESS) {
+	SLog(0, "WP_Init: couldn't create reaper LWP");
+	return -1;
+    }
+
+    /* signals are handled by the LWP side of the server */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (i = 0; i < nthreads; i++) {
+	if (pthread_create(&tid, &attr, wp_worker, NULL) != 0) {
+	    SLog(0, "WP_Init: only started %d of %d worker threads",
+		 i, nthreads);
+	    break;
+	}
+    }
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    wp_threads = i;
+    SLog(0, "Started %d worker threads", wp_threads);
+    return 0;
+}
+
+int WP_Threads(void)
+{
+    return wp_threads;
+}
+
+int WP_Run(void (*fn)(void *), void *arg)
+{
+    struct wp_work w;
+
+    if (!wp_threads)
+	return -1;
+
+    w.fn = fn;
+    w.arg = arg;
+    w.done = 0;
+    w.next = NULL;
+    gettimeofday(&w.queued, NULL);
+
+    pthread_mutex_lock(&wp_mutex);
+    if (wp_tail)
+	wp_tail->next = &w;
+    else
+	wp_head = &w;
+    wp_tail = &w;
+    if (++wp_queued > wp_maxqueued)
+	wp_maxqueued = wp_queued;
+    pthread_cond_signal(&wp_cond);
+    pthread_mutex_unlock(&wp_mutex);
+
+    /* The reaper can't run before we wait, LWPs don't preempt. */
+    while (!w.done)
+	LWP_WaitProcess(&w);
+
+    return 0;
+}
+
+void WP_PrintStats(FILE *fp)
+{
+    if (!wp_threads)
+	return;
+
+    pthread_mutex_lock(&wp_mutex);
+    fprintf(fp, "Worker threads: %d, runs %lu, longest queue %lu, "
+	    "avg wait %.1f us, avg run %.1f us\n", wp_threads, wp_runs,
+	    wp_maxqueued, wp_runs ? wp_waittime * 1e6 / wp_runs : 0.0,
+	    wp_runs ? wp_runtime * 1e6 / wp_runs : 0.0);
+    pthread_mutex_unlock(&wp_mutex);
+}
+
+#define WP_CHUNK (64 * 1024)
+
+void WP_ComputeSHA(void *arg)
+{
+    struct wp_sha *s = (struct wp_sha *)arg;
+    unsigned char buf[WP_CHUNK];
+    SHA_CTX cx;
+    ssize_t n;
+
+    SHA1_Init(&cx);
+    while ((n = read(s->fd, buf, sizeof(buf))) > 0)
+	SHA1_Update(&cx, buf, n);
+    SHA1_Final(s->sha, &cx);
+    s->err = (n < 0) ? errno : 0;
+}
@@ -0,0 +1,75 @@
+/* BLURB gpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ *
+ * Specification of the server worker thread pool.
+ *
+ * All server LWPs share a single kernel thread, so a server only uses one
+ * core. Read-only operations can hand self-contained work, currently the
+ * hashing of container files, to a pool of OS threads. The calling LWP
+ * sleeps until the work is done and the other LWPs keep serving requests,
+ * still one at a time, so the locking of volumes and vnodes is unchanged.
+ * The requests themselves, GetAttr, ValidateAttrs, GetACL and the rest,
+ * are still handled on the single LWP thread.
+ *
+ * Work functions run outside of the LWP package. They may only use the
+ * arguments they are given and plain system calls; no LWP, IOMGR, RVM,
+ * RPC2 or logging calls.
+ *
+ */
+
+#ifndef _VICE_WORKPOOL_H_
+#define _VICE_WORKPOOL_H_ 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <coda_hash.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Start nthreads worker threads, 0 leaves all work on the calling LWP.
+   Has to be called after LWP_Init and IOMGR_Initialize. */
+extern int WP_Init(int nthreads);
+
+/* Number of worker threads, 0 without a pool. */
+extern int WP_Threads(void);
+
+/* Run fn(arg) on a worker thread, the calling LWP waits until it is done.
+   Returns -1 without running fn when there is no pool. */
+extern int WP_Run(void (*fn)(void *), void *arg);
+
+extern void WP_PrintStats(FILE *fp);
+
+/* Work functions for WP_Run, they also work when called directly. */
+
+/* SHA checksum of an open file, read from the current offset */
+struct wp_sha {
+    int fd;
+    int err;		/* 0 or errno */
+    unsigned char sha[SHA_DIGEST_LENGTH];
+};
+extern void WP_ComputeSHA(void *arg);
+
+#endif /* _VICE_WORKPOOL_H_ */
@@ -59,7 +59,8 @@ extern int CheckSymlinkSemantics(ClientEntry *, Vnode **, Vnode **, char *, Volu
 				   void *, void *, Rights *, Rights *, int =1);
 extern void PerformFetch(ClientEntry *, Volume *, Vnode *);
 extern int FetchBulkTransfer(RPC2_Handle, ClientEntry *, Volume *, Vnode *,
-			     RPC2_Unsigned Offset, ViceVersionVector *VV);
+			     RPC2_Unsigned Offset, RPC2_Unsigned Count,
+			     ViceVersionVector *VV, RPC2_Integer *sent =NULL);
 extern void PerformGetAttr(ClientEntry *, Volume *, Vnode *);
 extern void PerformGetACL(ClientEntry *, Volume *, Vnode *, RPC2_BoundedBS *, RPC2_String);
 extern void PerformStore(ClientEntry *, VolumeId, Volume *, Vnode *,
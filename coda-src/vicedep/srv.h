@@ -121,6 +121,7 @@ typedef struct HostTable {
     time_t		LastCall;	/* time of last call from host	*/
     time_t		ActiveCall;	/* time of any call but gettime	*/
     struct Lock		lock;		/* lock used for client sync	*/
+    int			CallBacks;	/* callbacks held by this host	*/
 }   HostTable;
 
 
@@ -145,7 +146,7 @@ typedef struct ClientEntry {
 #define MAXMSGLN 128
 
 /* first srvOPARRAYSIZE reserved for Vice operations */
-#define MAXCNTRS (srvOPARRAYSIZE+17)
+#define MAXCNTRS (srvOPARRAYSIZE+18)
 #define TOTAL 0
 
 #define DISCONNECT ViceDisconnectFS_OP
@@ -153,6 +154,7 @@ typedef struct ClientEntry {
 #define GETATTRPLUSSHA ViceGetAttrPlusSHA_OP
 #define GETACL ViceGetACL_OP
 #define FETCH ViceFetch_OP
+#define FETCHPARTIAL ViceFetchPartial_OP
 #define SETATTR ViceSetAttr_OP
 #define SETACL ViceSetACL_OP
 #define STORE ViceStore_OP
@@ -183,6 +185,7 @@ typedef struct ClientEntry {
 #define NEWCONNECTFS ViceNewConnectFS_OP
 #define GETVOLVS ViceGetVolVS_OP
 #define VALIDATEVOLS ViceValidateVols_OP
+#define VALIDATEFIDS ViceValidateFids_OP
 
 #define FETCHDATAOP (srvOPARRAYSIZE+1)
 #define FETCHDATA (srvOPARRAYSIZE+2)
@@ -200,6 +203,7 @@ typedef struct ClientEntry {
 #define STORED4 (srvOPARRAYSIZE+14)
 #define STORED5 (srvOPARRAYSIZE+15)
 #define STORETIME (srvOPARRAYSIZE+16)
+#define FETCHCPU (srvOPARRAYSIZE+17)
 #define SIZE1 1024
 #define SIZE2 SIZE1*8
 #define SIZE3 SIZE2*8
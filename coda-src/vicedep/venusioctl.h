@@ -215,6 +215,9 @@ extern "C" {
 
 #define _VIOC_UNLOADKERNEL       (CFS_IOCTL_BASE + 53) /* Unload kernel module, only Win9x so far */
 
+#define _VIOC_CACHESTATS         (CFS_IOCTL_BASE + 54) /* Report partial fetch statistics */
+#define _VIOC_OPTIMIZEML         (CFS_IOCTL_BASE + 55) /* Shorten the CML before reintegration */
+
 /* we really can't/shouldn't go beyond 255 (CFS_IOCTL_BASE + 63) because the nr
  * component in an ioctl is only an 8-bit value.
  * The following ioctls probably ended up either clobbering the ioctl number,
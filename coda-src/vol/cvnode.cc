@@ -73,10 +73,11 @@ extern "C" {
 
 /* VnoceCalssInfo for small and large separately */
 struct VnodeClassInfo VnodeClassInfo_Array[nVNODECLASSES];
-/* Change hashindex below if you change this constant */
-#define VNODE_HASH_TABLE_SIZE 256
 /* the VnodeHashTable: shared among small and large */
-static Vnode *VnodeHashTable[VNODE_HASH_TABLE_SIZE];
+#define VNODE_HASH_INIT 256
+static Vnode **VnodeHashTable;
+static unsigned int VnodeHashMask;	/* number of buckets - 1 */
+static int VnodeHashGrows;		/* times the table was resized */
 
 
 extern int large, small;
@@ -86,6 +87,9 @@ extern void VBumpVolumeUsage(Volume *vp);
 
 static Vnode *VAllocVnodeCommon(Error *ec, Volume *vp, VnodeType type,
 				  VnodeId vnode, Unique_t unique);
+static Vnode *VnodeLookup(Volume *vp, VnodeId vnode, Unique_t unq,
+			  bit32 hash);
+static Vnode *VnodeReplace(VnodeClass vclass);
 static void moveHash(Vnode *vnp, bit32 newHash);
 static void StickOnLruChain(Vnode *vnp, struct VnodeClassInfo *vcp);
 
@@ -101,60 +105,81 @@ static void StickOnLruChain(Vnode *vnp, struct VnodeClassInfo *vcp);
  */
 
 
-/* Vnode hash table.  Find hash chain by taking lower bits of
- * (volume_hash_offset + vnode).
- * This distributes the root inodes of the volumes over the
- * hash table entries and also distributes the vnodes of
- * volumes reasonably fairly.  The volume_hash_offset field
- * for each volume is established as the volume comes on line
- * by using the VOLUME_HASH_OFFSET macro.  This distributes the
- * volumes fairly among the cache entries, both when servicing
- * a small number of volumes and when servicing a large number.
+/* Vnode hash table.  Find hash chain by taking the lower bits of a
+ * hash that mixes the volume id, vnode number and uniquifier.  The
+ * table is doubled whenever there are more cached vnodes than
+ * buckets, so chains stay short however large the cache is set or
+ * grows.  A vnode keeps its full hash value, the table can be
+ * resized without looking at the volumes.
  */
 
-
-/* VolumeHashOffset -- returns a new value to be stored in the
- * volumeHashOffset of a Volume structure.  Called when a
- * volume is initialized.  Sets the volumeHashOffset so that
- * vnode cache entries are distributed reasonably between
- * volumes (the root vnodes of the volumes will hash to
- * different values, and spacing is maintained between volumes
- * when there are not many volumes represented), and spread
- * equally amongst vnodes within a single volume.
- */
-int VolumeHashOffset()
+/* Vnode numbers are small and dense and a single volume often holds
+   most of the cached vnodes, mix all fid components. */
+static bit32 VnodeHash(Volume *vp, VnodeId vnode, Unique_t unq)
 {
-	static int nextVolumeHashOffset = 0;
-	/* hashindex Must be power of two in size */
-#   define hashShift 3
-#   define hashMask ((1<<hashShift)-1)
-	static byte hashindex[1<<hashShift] = {0,128,64,192,32,160,96,224};
-	int offset;
-
-	LogMsg(9, VolDebugLevel, stdout,  "Entering VolumeHashOffset()");
-	offset = hashindex[nextVolumeHashOffset&hashMask]
-		+ (nextVolumeHashOffset>>hashShift);
-	nextVolumeHashOffset++;
-	return offset;
+	bit32 h = V_id(vp);
+	h = h * 0x9e3779b1 + vnode;
+	h = h * 0x9e3779b1 + unq;
+	h ^= h >> 16;
+	return h;
 }
 
-#define VNODE_HASH(volumeptr,vnodenumber, unq)\
-    ((volumeptr->vnodeHashOffset + vnodenumber+unq)&(VNODE_HASH_TABLE_SIZE-1))
+/* Make sure there are at least as many buckets as cached vnodes.
+   Vnodes are only relinked, so pointers to them stay valid. */
+static void GrowVnodeHash(void)
+{
+	unsigned int nvnodes = VnodeClassInfo_Array[vLarge].cacheSize +
+			       VnodeClassInfo_Array[vSmall].cacheSize;
+	unsigned int oldSize = VnodeHashTable ? VnodeHashMask + 1 : 0;
+	unsigned int size = oldSize ? oldSize : VNODE_HASH_INIT;
+	Vnode **oldTable = VnodeHashTable, **newTable;
+
+	while (size < nvnodes)
+		size <<= 1;
+	if (size == oldSize)
+		return;
+
+	newTable = (Vnode **)calloc(size, sizeof(Vnode *));
+	if (!newTable && oldTable)
+		return;	    /* keep going with longer chains */
+	CODA_ASSERT(newTable);
+
+	VnodeHashTable = newTable;
+	VnodeHashMask = size - 1;
+
+	for (unsigned int i = 0; i < oldSize; i++) {
+		Vnode *vnp, *next;
+		for (vnp = oldTable[i]; vnp; vnp = next) {
+			next = vnp->hashNext;
+			Vnode **bucket = &VnodeHashTable[vnp->hashValue & VnodeHashMask];
+			vnp->hashNext = *bucket;
+			*bucket = vnp;
+		}
+	}
+	free(oldTable);
+	if (oldTable)
+		VnodeHashGrows++;
+	SLog(1, "GrowVnodeHash: %u buckets for %u vnodes", size, nvnodes);
+}
 
 /*
    Not normally called by general client; called by volume.c
-   set up the VnodeClassIfno structure and LRU lists.
+   set up the VnodeClassIfno structure and LRU lists. With a budget
+   (in MB) the cache grows beyond nVnodes instead of evicting vnodes
+   until it uses that much memory.
 */
-void VInitVnodes(VnodeClass vclass, int nVnodes)
+void VInitVnodes(VnodeClass vclass, int nVnodes, int budget)
 {
 	byte *va;
 	struct VnodeClassInfo *vcp = &VnodeClassInfo_Array[vclass];
 
-	SLog(9,  "Entering VInitVnodes(vclass = %d, vnodes = %d)",
-	     vclass, nVnodes);
+	SLog(9,  "Entering VInitVnodes(vclass = %d, vnodes = %d, budget = %d)",
+	     vclass, nVnodes, budget);
 
 	/* shouldn't these be set to 0? ***/
 	vcp->allocs = vcp->gets = vcp->reads = vcp->writes = 0;
+	vcp->hits = vcp->evictions = 0;
+	vcp->budget = budget;
 	vcp->cacheSize = nVnodes;
 	switch(vclass) {
 	case vSmall:
@@ -182,7 +207,7 @@ void VInitVnodes(VnodeClass vclass, int nVnodes)
 		vnp->changed = 0;
 		vnp->volumePtr = NULL;
 		vnp->cacheCheck = 0;
-		vnp->hashIndex = 0;
+		vnp->hashValue = 0;
 		if (vcp->lruHead == NULL)
 			vcp->lruHead = vnp->lruNext = vnp->lruPrev = vnp;
 		else {
@@ -194,8 +219,11 @@ void VInitVnodes(VnodeClass vclass, int nVnodes)
 		}
 		va += vcp->residentSize;
 	}
+	GrowVnodeHash();
 }
 
+/* The new vnodes go to the tail of the LRU chain, so they are used
+   before any cached vnode is evicted. */
 static void GrowVnLRUCache(VnodeClass vclass, int nVnodes)
 {
 	byte *va;
@@ -212,15 +240,72 @@ static void GrowVnLRUCache(VnodeClass vclass, int nVnodes)
 		vnp->changed = 0;
 		vnp->volumePtr = NULL;
 		vnp->cacheCheck = 0;
-		vnp->hashIndex = 0;
+		vnp->hashValue = 0;
 		CODA_ASSERT(vcp->lruHead != NULL);
 		vnp->lruNext = vcp->lruHead;
 		vnp->lruPrev = vcp->lruHead->lruPrev;
 		vcp->lruHead->lruPrev = vnp;
 		vnp->lruPrev->lruNext = vnp;
-		vcp->lruHead = vnp;
 		va += vcp->residentSize;
 	}
+	GrowVnodeHash();
+}
+
+/* Pick the vnode to reuse for an object that is not in the cache, the
+   least recently used one. The cache grows when it is down to its last
+   vnode, or when the class is still under its budget and the vnode
+   holds a cached object. */
+static Vnode *VnodeReplace(VnodeClass vclass)
+{
+	struct VnodeClassInfo *vcp = &VnodeClassInfo_Array[vclass];
+	int slab = (vclass == vSmall) ? small : large;
+	Vnode *vnp = vcp->lruHead->lruPrev;
+
+	if (slab <= 0)
+		slab = 1;
+
+	if (vnp == vcp->lruHead) {
+		SLog(0, "VnodeReplace: Only 1 entry left in lru cache - growing cache");
+		GrowVnLRUCache(vclass, slab);
+	} else if (vnp->volumePtr && vcp->budget &&
+		   (double)(vcp->cacheSize + slab) * vcp->residentSize <=
+		   vcp->budget * 1048576.0) {
+		SLog(1, "VnodeReplace: growing %s vnode cache to %d entries",
+		     vclass == vSmall ? "small" : "large", vcp->cacheSize + slab);
+		GrowVnLRUCache(vclass, slab);
+	}
+
+	return vcp->lruHead->lruPrev;
+}
+
+/* Find a cached vnode, hash is VnodeHash(vp, vnode, unq). */
+static Vnode *VnodeLookup(Volume *vp, VnodeId vnode, Unique_t unq, bit32 hash)
+{
+	Vnode *vnp;
+
+	for (vnp = VnodeHashTable[hash & VnodeHashMask];
+	     vnp && (vnp->vnodeNumber != vnode ||
+		     vnp->volumePtr != vp ||
+		     vnp->disk.uniquifier != unq ||
+		     vnp->volumePtr->cacheCheck != vnp->cacheCheck);
+	     vnp = vnp->hashNext)
+		;
+	return vnp;
+}
+
+void VPrintVnodeHashStats(void)
+{
+	unsigned int used = 0, longest = 0;
+
+	for (unsigned int i = 0; i <= VnodeHashMask && VnodeHashTable; i++) {
+		unsigned int len = 0;
+		for (Vnode *vnp = VnodeHashTable[i]; vnp; vnp = vnp->hashNext)
+			len++;
+		if (len) used++;
+		if (len > longest) longest = len;
+	}
+	VLog(0, "Vnode hash table, %u buckets (%u used), %d grows, longest chain %u",
+	     VnodeHashMask + 1, used, VnodeHashGrows, longest);
 }
 
 
@@ -375,7 +460,7 @@ static Vnode *VAllocVnodeCommon(Error *ec, Volume *vp, VnodeType type,
 	VnodeClass vclass = vnodeTypeToClass(type);
 	struct VnodeClassInfo *vcp = &VnodeClassInfo_Array[vclass];
 	vindex vol_index(V_id(vp), vclass, V_device(vp), vcp->diskSize);
-	int newHash = VNODE_HASH(vp, vnode, unique);
+	bit32 newHash = VnodeHash(vp, vnode, unique);
 	Vnode *vnp = NULL;
 
 	/* Grow vnode array if necessary. */
@@ -398,13 +483,7 @@ static Vnode *VAllocVnodeCommon(Error *ec, Volume *vp, VnodeType type,
 	}
 
 	/* Check that object does not already exist in VM. */
-	for (vnp = VnodeHashTable[newHash];
-	     vnp && (vnp->vnodeNumber != vnode ||
-		     vnp->volumePtr != vp ||
-		     vnp->disk.uniquifier != unique ||
-		     vnp->volumePtr->cacheCheck != vnp->cacheCheck);
-	     vnp = vnp->hashNext)
-		;
+	vnp = VnodeLookup(vp, vnode, unique, newHash);
 	if (vnp != NULL) {
 		LogMsg(0, VolDebugLevel, stdout,  "VAllocVnode: object (%08x.%x.%x) found in VM",
 		       V_id(vp), vnode, unique);
@@ -413,11 +492,7 @@ static Vnode *VAllocVnodeCommon(Error *ec, Volume *vp, VnodeType type,
 	}
 
 	/* Get vnode off LRU chain and move it to the new hash bucket. */
-	if (vcp->lruHead->lruPrev == vcp->lruHead) {
-		LogMsg(0, VolDebugLevel, stdout,  "VAllocVnode: LRU cache has only one entry - growing cache dynamically");
-		GrowVnLRUCache(vclass, vclass == vSmall ? small : large);
-	}
-	vnp = vcp->lruHead->lruPrev;
+	vnp = VnodeReplace(vclass);
 	moveHash(vnp, newHash);
 
 	/* Initialize the VM copy of the vnode. */
@@ -471,7 +546,7 @@ Vnode *VGetVnode(Error *ec, Volume *vp, VnodeId vnodeNumber,
 
 {
 	Vnode *vnp;
-	int newHash;
+	bit32 newHash;
 	VnodeClass vclass;
 	struct VnodeClassInfo *vcp;
 	ProgramType *pt;
@@ -506,17 +581,13 @@ Vnode *VGetVnode(Error *ec, Volume *vp, VnodeId vnodeNumber,
 	}
 
 	/* See whether the vnode is in the cache. */
-	newHash = VNODE_HASH(vp, vnodeNumber, unq);
-	SLog(19, "VGetVnode: newHash = %d, vp = %p, vnodeNumber = %x Unique = %x",
+	newHash = VnodeHash(vp, vnodeNumber, unq);
+	SLog(19, "VGetVnode: newHash = %x, vp = %p, vnodeNumber = %x Unique = %x",
 	     newHash, vp, vnodeNumber, unq);
-	for (vnp = VnodeHashTable[newHash];
-	     vnp && (vnp->vnodeNumber!=vnodeNumber ||
-		     vnp->volumePtr!=vp ||
-		     vnp->disk.uniquifier != unq ||
-		     vnp->volumePtr->cacheCheck!=vnp->cacheCheck);
-	     vnp = vnp->hashNext
-	     );
+	vnp = VnodeLookup(vp, vnodeNumber, unq, newHash);
 	vcp->gets++;
+	if (vnp)
+		vcp->hits++;
 
 	if (vnp == NULL) {
 		int     n;
@@ -524,11 +595,7 @@ Vnode *VGetVnode(Error *ec, Volume *vp, VnodeId vnodeNumber,
 		   one from the LRU chain */
 		SLog(1,  "VGetVnode: going to rvm for vnode %08x.%x", V_id(vp), vnodeNumber);
 		vcp->reads++;
-		if (vcp->lruHead == vcp->lruHead->lruPrev) {
-			SLog(0,  "VGetVode: Only 1 entry left in lru cache - growing cache");
-			GrowVnLRUCache(vclass, vclass == vSmall ? small : large);
-		}
-		vnp = vcp->lruHead->lruPrev;
+		vnp = VnodeReplace(vclass);
 		if ( vnp->dh ) {
 			SLog(0, "VGetVnode: DROPPING dh of vn %x un %x"
 			     "total count %d, dh_refc: %d\n",
@@ -649,14 +716,15 @@ Vnode *VGetVnode(Error *ec, Volume *vp, VnodeId vnodeNumber,
 
 
 
-/* Write vnode back to recoverable storage if dirty */
-void VPutVnode(Error *ec,Vnode *vnp)
+/* Write vnode back to recoverable storage if dirty, but keep it locked
+   until VReleaseVnode, i.e. until the transaction has committed */
+void VWriteVnode(Error *ec, Vnode *vnp)
 {
 	int writeLocked;
 	VnodeClass vclass;
 	struct VnodeClassInfo *vcp;
 
-	SLog(9, "Entering VPutVnode for vnode %x", vnp->vnodeNumber);
+	SLog(9, "Entering VWriteVnode for vnode %x", vnp->vnodeNumber);
 	*ec = 0;
 	CODA_ASSERT (vnp->nUsers != 0);
 	vclass = vnodeIdToClass(vnp->vnodeNumber);
@@ -722,6 +790,14 @@ void VPutVnode(Error *ec,Vnode *vnp)
 			CODA_ASSERT(0);
 		}
 	}
+}
+
+/* Unlock a vnode written by VWriteVnode */
+void VReleaseVnode(Vnode *vnp)
+{
+	int writeLocked = WriteLocked(&vnp->lock);
+	VnodeClass vclass = vnodeIdToClass(vnp->vnodeNumber);
+	struct VnodeClassInfo *vcp = &VnodeClassInfo_Array[vclass];
 
 	/* Do not look at disk portion of vnode after this point; it may
 	   have been deleted above; also clear the DirHandle (this could
@@ -736,6 +812,13 @@ void VPutVnode(Error *ec,Vnode *vnp)
 	else
 		ReleaseReadLock(&vnp->lock);
 }
+
+/* Write vnode back to recoverable storage if dirty */
+void VPutVnode(Error *ec,Vnode *vnp)
+{
+	VWriteVnode(ec, vnp);
+	VReleaseVnode(vnp);
+}
 /*
  * put back a vnode but dont write it to RVM - 
  * simulate an abort with release lock 
@@ -801,30 +884,31 @@ void VFlushVnode(Error *ec, Vnode *vnp)
     ReleaseWriteLock(&vnp->lock);
 }
 
-/* Move the vnode, vnp, to the new hash table given by the
-   hash table index, newHash */
+/* Move the vnode, vnp, to the hash chain for the hash value
+   newHash, evicting the object it held. Vnodes that never held an
+   object are not on any chain. */
 static void moveHash(Vnode *vnp, bit32 newHash)
 {
-	Vnode *tvnp;
-	/* Remove it from the old hash chain */
+	Vnode **pp;
 
 	LogMsg(9, VolDebugLevel, stdout, "Entering moveHash(vnode %x)", vnp->vnodeNumber);
-	tvnp = VnodeHashTable[vnp->hashIndex];
-	if (tvnp == vnp) {
-		SLog(9,  "moveHash: setting VnodeHashTable[%d] = %p",
-		     vnp->hashIndex, vnp->hashNext);
-		VnodeHashTable[vnp->hashIndex] = vnp->hashNext;
-	} else {
-		while (tvnp && tvnp->hashNext != vnp)
-			tvnp = tvnp->hashNext;
-		if (tvnp)
-			tvnp->hashNext = vnp->hashNext;
+	/* Remove it from the old hash chain */
+	if (vnp->volumePtr) {
+		if (vnp->vnodeNumber)
+			VnodeClassInfo_Array[vnodeIdToClass(vnp->vnodeNumber)].evictions++;
+		pp = &VnodeHashTable[vnp->hashValue & VnodeHashMask];
+		while (*pp && *pp != vnp)
+			pp = &(*pp)->hashNext;
+		if (*pp)
+			*pp = vnp->hashNext;
 	}
 	/* Add it to the new hash chain */
-	vnp->hashNext = VnodeHashTable[newHash];
-	SLog(9, "moveHash: setting VnodeHashTable[%d] = %p", newHash, vnp);
-	VnodeHashTable[newHash] = vnp;
-	vnp->hashIndex = newHash;
+	pp = &VnodeHashTable[newHash & VnodeHashMask];
+	vnp->hashNext = *pp;
+	SLog(9, "moveHash: setting VnodeHashTable[%d] = %p",
+	     newHash & VnodeHashMask, vnp);
+	*pp = vnp;
+	vnp->hashValue = newHash;
 }
 
 static void StickOnLruChain(Vnode *vnp, struct VnodeClassInfo *vcp)
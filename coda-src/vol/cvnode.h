@@ -82,6 +82,10 @@ struct VnodeClassInfo {
     int gets,reads;		/* Number of VGetVnodes and corresponding
     				   reads */
     int writes;			/* Number of vnode writes */
+    int hits;			/* VGetVnodes found in the cache */
+    int evictions;		/* cached vnodes reused for another one */
+    int budget;			/* MB the cache may grow to before it
+				   evicts vnodes, 0 for a fixed size */
 };
 
 extern struct VnodeClassInfo VnodeClassInfo_Array[nVNODECLASSES];
@@ -156,7 +160,8 @@ typedef struct Vnode {
     struct	Vnode *lruPrev;	/* More recently used vnode than this one */
 				/* The lruNext, lruPrev fields are not
 				   meaningful if the vnode is in use */
-    bit16	hashIndex;	/* Hash table index */
+    bit32	hashValue;	/* Hash of (volume, vnode, uniquifier), the
+				   chain is hashValue & mask */
     unsigned short changed:1;	/* 1 if the vnode has been changed */
     unsigned short delete_me:1;	/* 1 if the vnode should be deleted; in
     				 this case, changed must also be 1 */
@@ -197,10 +202,11 @@ typedef struct Vnode {
 #define VnSHA(vnp)		((vnp)->SHA)
 
 PDirHandle SetDirHandle(struct Vnode *);
-extern int VolumeHashOffset();
-extern void VInitVnodes(VnodeClass, int);
+extern void VInitVnodes(VnodeClass, int, int =0);
 extern Vnode *VGetVnode(Error *, Volume *, VnodeId, Unique_t, int, int, int =0);
 extern void VPutVnode(Error *ec, Vnode *vnp);
+extern void VWriteVnode(Error *ec, Vnode *vnp);
+extern void VReleaseVnode(Vnode *vnp);
 extern void VFlushVnode(Error *, Vnode *);
 extern int VAllocFid(Volume *vp, VnodeType type,
 		      ViceFidRange *Range, int stride =1, int ix =0);
@@ -221,6 +227,8 @@ void VN_CopyOnWrite(struct Vnode *vptr);
 void VN_VN2Fid(struct Vnode *, struct Volume *, struct ViceFid *);
 void VN_VN2PFid(struct Vnode *, struct Volume *, struct ViceFid *);
 
+void VPrintVnodeHashStats(void);
+
 /* make this debugging print routine visible everywhere (Satya 5/04) */
 void PrintVnodeDiskObject(FILE *, VnodeDiskObject *, VnodeId);
 
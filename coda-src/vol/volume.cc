@@ -110,13 +110,19 @@ const char *Server_FQDN[N_SERVERIDS];	/* DNS host name (with optional port) */
 /* something like "codaserverN.foo.bar:2432" */
 
 /*
-  VolumeHashTable: Hash table used to store pointers to the Volume structure
+  VolumeHashTable: Hash table used to store pointers to the Volume structure.
+  It starts out with VOLUME_HASH_INIT buckets and is doubled whenever there
+  are more attached volumes than buckets.
  */
 #define VOLUME_BITMAP_GROWSIZE	16	/* bytes, => 128vnodes */
 					/* Must be a multiple of 4 (1 word) !!*/
-#define VOLUME_HASH_TABLE_SIZE 128	/* Must be a power of 2!! */
-#define VOLUME_HASH(volumeId) (volumeId&(VOLUME_HASH_TABLE_SIZE-1))
-static Volume *VolumeHashTable[VOLUME_HASH_TABLE_SIZE];
+#define VOLUME_HASH_INIT 128		/* Must be a power of 2!! */
+#define VOLUME_HASH(volumeId) (VolumeHash(volumeId) & VolumeHashMask)
+static Volume *VolumeHashInit[VOLUME_HASH_INIT];
+static Volume **VolumeHashTable = VolumeHashInit;
+static unsigned int VolumeHashMask = VOLUME_HASH_INIT - 1;
+static int VolumeHashGrows = 0;
+static int nAttachedVolumes = 0;	/* volumes in the hash table */
 
 extern void dump_storage(int level, const char *s);
 extern void VBumpVolumeUsage(Volume *vp);
@@ -138,7 +144,10 @@ static int VolumeCacheCheck = 0;  /* Incremented everytime a volume
 				     on-line the vnode will be
 				     invalidated */
 
-static int VolumeCacheSize = 50, VolumeGets = 0, VolumeReplacements = 0;
+/* The volume header cache starts with VOLUME_CACHE_INIT headers and grows
+   to keep a header for every attached volume. */
+#define VOLUME_CACHE_INIT 50
+static int VolumeCacheSize = 0, VolumeGets = 0, VolumeReplacements = 0;
 
 static void WriteVolumeHeader(Error *ec, Volume *vp);
 static Volume *attach2(Error *ec, char *path, struct VolumeHeader *header,
@@ -152,6 +161,15 @@ static void ReleaseVolumeHeader(struct volHeader *hd);
 void FreeVolumeHeader(Volume *vp);
 static void AddVolumeToHashTable(Volume *vp, int hashid);
 void DeleteVolumeFromHashTable(Volume *vp);
+static void GrowVolumeHeaders(void);
+
+/* Volume ids of a server are mostly consecutive, mix them anyway so
+   replicated volume groups don't line up. */
+static inline unsigned int VolumeHash(VolumeId volumeId)
+{
+    unsigned int h = volumeId * 0x9e3779b1;
+    return h ^ (h >> 16);
+}
 
 
 /* InitVolUtil has a problem right now - 
@@ -221,7 +239,8 @@ int VInitVolUtil(ProgramType pt)
 }
 
 /* one time initialization for file server only */
-void VInitVolumePackage(int nLargeVnodes, int nSmallVnodes, int DoSalvage)
+void VInitVolumePackage(int nLargeVnodes, int nSmallVnodes, int DoSalvage,
+			int largeBudget, int smallBudget)
 {
     struct timeval tv;
     struct timezone tz;
@@ -243,16 +262,13 @@ void VInitVolumePackage(int nLargeVnodes, int nSmallVnodes, int DoSalvage)
     /* Don't grab the lock yet in case we run the salvager */
     /* NOTE: no concurrency is allowed until we grab the lock! */
 
-    InitLRU(VolumeCacheSize);
+    InitLRU(VOLUME_CACHE_INIT);
 
     /* Setup (volume id -> VolumeList index) hash table */
     InitVolTable(HASHTABLESIZE);
-
-    /* Initialize the volume hash tables */
-    memset((void *)VolumeHashTable, 0, sizeof(VolumeHashTable));
     
-    VInitVnodes(vLarge, nLargeVnodes);
-    VInitVnodes(vSmall, nSmallVnodes);
+    VInitVnodes(vLarge, nLargeVnodes, largeBudget);
+    VInitVnodes(vSmall, nSmallVnodes, smallBudget);
 
     
     /* check VLDB */
@@ -642,7 +658,7 @@ retry:
 	*offset += n;
     }
 
-    for (i=0; i<VOLUME_HASH_TABLE_SIZE; i++) {
+    for (i=0; i<=VolumeHashMask; i++) {
 	Volume *vp, *tvp;
         Error error;
 	vp = VolumeHashTable[i];
@@ -696,7 +712,7 @@ void VShutdown() {
 
     VLog(0, "VShutdown:  shutting down on-line volumes...");
 
-    for (i=0; i<VOLUME_HASH_TABLE_SIZE; i++) {
+    for (i=0; i<=(int)VolumeHashMask; i++) {
         Volume *vp, *p;
 	p = VolumeHashTable[i];
 	while (p) {
@@ -926,6 +942,7 @@ static Volume *attach2(Error *ec, char *name,
 	vp->nReintegrators = 0;	
 	vp->reintegrators = NULL;	
 
+	GrowVolumeHeaders();
 	GetVolumeHeader(vp);    /* get a VolHeader from LRU list */
 
 	/* get the volume index and the VolumeDiskInfo from
@@ -1041,6 +1058,7 @@ Volume *VGetVolume(Error *ec, VolumeId volumeId)
 	    break;
 	}
 	VolumeGets++;
+	vp->nGets++;
 	VLog(19, "VGetVolume: nUsers == %d", vp->nUsers);
 	if (vp->nUsers == 0) {
 
@@ -1069,6 +1087,7 @@ Volume *VGetVolume(Error *ec, VolumeId volumeId)
 
 	    if (!headerExists) {
 		VolumeReplacements++;
+		vp->nHeaderReads++;
 		ExtractVolDiskInfo(ec, vp->vol_index, &V_disk(vp));
 
 		if (*ec) {
@@ -1448,7 +1467,7 @@ void PrintVolumesInHashTable()
 {
 	if (VolDebugLevel < 50)
 		return;
-	for (int i = 0; i < VOLUME_HASH_TABLE_SIZE; i++){
+	for (unsigned int i = 0; i <= VolumeHashMask; i++){
 		printf("PrintVolumesInHashTable: Lookint at index %d\n", i);
 		Volume *vp = VolumeHashTable[i];
 		while(vp){
@@ -1708,10 +1727,52 @@ void InitLRU(int howMany)
 {
 	struct volHeader *hp;
 	hp = (struct volHeader *)(calloc(howMany, sizeof(struct volHeader)));
+	CODA_ASSERT(hp != NULL);
+	VolumeCacheSize += howMany;
 	while (howMany--)
 		ReleaseVolumeHeader(hp++);
 }
 
+/* Put an unused header at the tail of the LRU chain, so it is taken
+   before a header that still holds the data of another volume. */
+static void UnusedVolumeHeader(struct volHeader *hd)
+{
+	if (hd->next) {
+		if (hd->next == hd)
+			return;
+		if (volumeLRU == hd)
+			volumeLRU = hd->next;
+		hd->prev->next = hd->next;
+		hd->next->prev = hd->prev;
+	}
+	hd->prev = volumeLRU->prev;
+	hd->next = volumeLRU;
+	hd->prev->next = hd->next->prev = hd;
+}
+
+/* Make sure there is a header for every attached volume and the one
+   about to be attached, so headers are only replaced when memory runs
+   out. Headers are never freed. */
+static void GrowVolumeHeaders(void)
+{
+	struct volHeader *hp;
+	int howMany;
+
+	if (!volumeLRU || VolumeCacheSize > nAttachedVolumes)
+		return;
+
+	howMany = VolumeCacheSize;
+	hp = (struct volHeader *)(calloc(howMany, sizeof(struct volHeader)));
+	if (!hp)
+		return;	    /* keep replacing headers */
+
+	VLog(1, "GrowVolumeHeaders: %d headers for %d volumes",
+	     VolumeCacheSize + howMany, nAttachedVolumes);
+	VolumeCacheSize += howMany;
+	while (howMany--)
+		UnusedVolumeHeader(hp++);
+}
+
 /* Get a volume header from the LRU list:
    -  update an old one if necessary
    -  do not fill in the new data yet
@@ -1805,7 +1866,10 @@ void FreeVolumeHeader(Volume *vp)
     if (!hd)
 	return;
 
-    ReleaseVolumeHeader(hd);
+    if (volumeLRU)
+	UnusedVolumeHeader(hd);
+    else
+	ReleaseVolumeHeader(hd);
     hd->back = 0;
     vp->header = 0;
 }
@@ -1814,13 +1878,41 @@ void FreeVolumeHeader(Volume *vp)
 /***************************************************/
 /* Routines to add volume to hash chain, delete it */
 /***************************************************/
+
+/* Double the number of buckets. Volumes are only relinked, the initial
+   table is static and never freed. */
+static void GrowVolumeHashTable(void)
+{
+    Volume **oldTable = VolumeHashTable;
+    unsigned int oldSize = VolumeHashMask + 1;
+    Volume **newTable = (Volume **)calloc(2 * oldSize, sizeof(Volume *));
+    if (!newTable)
+	return;	    /* keep going with longer chains */
+
+    VolumeHashTable = newTable;
+    VolumeHashMask = 2 * oldSize - 1;
+
+    for (unsigned int i = 0; i < oldSize; i++) {
+	Volume *vp, *next;
+	for (vp = oldTable[i]; vp; vp = next) {
+	    next = vp->hashNext;
+	    unsigned int hash = VOLUME_HASH(vp->hashid);
+	    vp->hashNext = VolumeHashTable[hash];
+	    VolumeHashTable[hash] = vp;
+	}
+    }
+    if (oldTable != VolumeHashInit)
+	free(oldTable);
+    VolumeHashGrows++;
+}
+
 /*
   AddVolumeToHashTable: Add the volume (*vp) to the hash table
   As used, hashid is always the id of the volume.
 */
 static void AddVolumeToHashTable(Volume *vp, int hashid)
 {
-    int hash = VOLUME_HASH(hashid);
+    unsigned int hash;
     Volume *vptr;
     VLog(9, "Entering AddVolumeToHashTable for volume %x, hashid %u",
 					V_id(vp), hashid);
@@ -1831,6 +1923,10 @@ static void AddVolumeToHashTable(Volume *vp, int hashid)
 	CODA_ASSERT(0);
     }
 
+    if (nAttachedVolumes >= (int)(VolumeHashMask + 1))
+	GrowVolumeHashTable();
+
+    hash = VOLUME_HASH(hashid);
     vptr = VolumeHashTable[hash];	/* Check the bucket for duplicates. */
     while (vptr) {
 	if (vptr->hashid == vp->hashid) {
@@ -1842,7 +1938,7 @@ static void AddVolumeToHashTable(Volume *vp, int hashid)
     vp->hashid = hashid;
     vp->hashNext = VolumeHashTable[hash];
     VolumeHashTable[hash] = vp;
-    vp->vnodeHashOffset = VolumeHashOffset();
+    nAttachedVolumes++;
 }    
 
 /*
@@ -1873,21 +1969,54 @@ void DeleteVolumeFromHashTable(Volume *vp)
 	VLog(29, "DeleteVolumeHashTable: Deleting volume %x from hashtable", vp->hashid);
     }
     vp->hashid = 0;
+    nAttachedVolumes--;
 }
 
 void VPrintCacheStats(FILE *fp)
 {
     struct VnodeClassInfo *vcp;
     vcp = &VnodeClassInfo_Array[vLarge];
-    VLog(0, "Large vnode cache, %d entries, %d allocs, "
-	 "%d gets (%d reads), %d writes",
-	 vcp->cacheSize, vcp->allocs, vcp->gets, vcp->reads, vcp->writes);
+    VLog(0, "Large vnode cache, %d entries (%d KB, budget %d MB), %d allocs, "
+	 "%d gets (%d hits, %d reads), %d evictions, %d writes",
+	 vcp->cacheSize, (int)((double)vcp->cacheSize * vcp->residentSize / 1024),
+	 vcp->budget, vcp->allocs, vcp->gets, vcp->hits, vcp->reads,
+	 vcp->evictions, vcp->writes);
     vcp = &VnodeClassInfo_Array[vSmall];
-    VLog(0, "Small vnode cache,%d entries, %d allocs, "
-	 "%d gets (%d reads), %d writes",
-	 vcp->cacheSize, vcp->allocs, vcp->gets, vcp->reads, vcp->writes);
+    VLog(0, "Small vnode cache, %d entries (%d KB, budget %d MB), %d allocs, "
+	 "%d gets (%d hits, %d reads), %d evictions, %d writes",
+	 vcp->cacheSize, (int)((double)vcp->cacheSize * vcp->residentSize / 1024),
+	 vcp->budget, vcp->allocs, vcp->gets, vcp->hits, vcp->reads,
+	 vcp->evictions, vcp->writes);
+    VPrintVnodeHashStats();
     VLog(0,"Volume header cache, %d entries, %d gets, %d replacements",
 	 VolumeCacheSize, VolumeGets, VolumeReplacements);
+
+    /* the busiest volumes, in order */
+#define NBUSIEST 5
+    Volume *busiest[NBUSIEST] = { NULL, };
+    unsigned int used = 0, longest = 0;
+    for (unsigned int i = 0; i <= VolumeHashMask; i++) {
+	unsigned int len = 0;
+	for (Volume *vp = VolumeHashTable[i]; vp; vp = vp->hashNext) {
+	    len++;
+	    for (int j = 0; j < NBUSIEST; j++) {
+		if (busiest[j] && busiest[j]->nGets >= vp->nGets)
+		    continue;
+		memmove(&busiest[j + 1], &busiest[j],
+			(NBUSIEST - j - 1) * sizeof(Volume *));
+		busiest[j] = vp;
+		break;
+	    }
+	}
+	if (len) used++;
+	if (len > longest) longest = len;
+    }
+    VLog(0, "Volume hash table, %d volumes, %u buckets (%u used), %d grows, "
+	 "longest chain %u", nAttachedVolumes, VolumeHashMask + 1, used,
+	 VolumeHashGrows, longest);
+    for (int j = 0; j < NBUSIEST && busiest[j]; j++)
+	VLog(0, "\tvolume %x, %u gets, %u header reads", busiest[j]->hashid,
+	     busiest[j]->nGets, busiest[j]->nHeaderReads);
 }
 
 void SetVolDebugLevel(int level) {
@@ -267,9 +267,6 @@ struct Volume {
 			   	   If the volume is shutdown gracefully, the
 				   uniquifier should be rewritten with the
 				   value nextVnodeVersion*/
-    bit16	vnodeHashOffset;/* Computed by HashOffset function in cvnode.h.
-				   Assigned to the volume when initialized. 
-				   Added to vnode number for hash table index */
     byte	shuttingDown;	/* This volume is going to be detached */
     byte	goingOffline;	/* This volume is going offline */
     bit16	cacheCheck;	/* Online sequence number to be used
@@ -293,6 +290,8 @@ struct Volume {
 				   record reintegrated for each client. Could
 				   be moved to recoverable store if necessary.
 				*/
+    unsigned int nGets;		/* VGetVolume calls since attach */
+    unsigned int nHeaderReads;	/* times the header had to be reread */
 };
 typedef struct Volume Volume;
 
@@ -375,7 +374,8 @@ extern const char *VSalvageMessage; /* Common message used when the volume goes
 				       off line */
 extern int VolDebugLevel;	/* Controls level of debugging information */
 extern int AllowResolution;	/* global flag to turn on dir. resolution */
-extern void VInitVolumePackage(int nLargeVnodes, int nSmallVnodes, int DoSalvage);
+extern void VInitVolumePackage(int nLargeVnodes, int nSmallVnodes, int DoSalvage,
+			       int largeBudget =0, int smallBudget =0);
 extern int VInitVolUtil(ProgramType pt);
 extern void VInitServerList(const char *host);
 extern int VConnectFS();
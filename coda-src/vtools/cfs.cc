@@ -103,6 +103,7 @@ struct command {
 
 /* One handler routine for each opcode */
 static void BeginRepair(int, char**, int);
+static void CacheStats(int, char**, int);
 static void CheckServers(int, char**, int);
 static void CheckPointML(int, char**, int);
 static void CheckVolumes(int, char**, int);
@@ -130,6 +131,7 @@ static void ListVolume(int, char **, int);
 static void LookAside(int, char **, int);
 static void LsMount(int, char**, int);
 static void MkMount(int, char**, int);
+static void OptimizeML(int, char**, int);
 static void PurgeML(int, char**, int);
 static void Redir(int, char**, int);
 static void ReplayClosure(int, char**, int);
@@ -169,6 +171,11 @@ struct command cmdarray[] =
            "Expose replicas of inc. objects",
            NULL
         },
+        {"cachestats", "cst", CacheStats,
+            "cfs cachestats",
+            "Show partial fetch and read-ahead statistics",
+            NULL
+        },
         {"checkservers", "cs", CheckServers, 
             "cfs checkservers <servernames>",
             "Check up/down status of servers",
@@ -300,6 +307,11 @@ struct command cmdarray[] =
             "Make mount point",
             NULL
         },
+        {"optimizeml", "oml", OptimizeML, 
+            "cfs optimizeml <dir> [<dir> <dir> ...]",
+            "Shorten volume modify log",
+            NULL
+        },
         {"purgeml", NULL, PurgeML, 
             "cfs purgeml <dir>",
             "Purge volume modify log (DANGEROUS)",
@@ -617,10 +629,12 @@ static void CheckPointML(int argc, char* argv[], int opslot)
     /* Do the checkpoint */
     vio.in_size = (ckpdir ? (int) strlen(ckpdir) + 1 : 0);
     vio.in = ckpdir;
-    vio.out_size = 0;
-    vio.out = 0;
+    vio.out_size = CFS_PIOBUFSIZE;
+    vio.out = piobuf;
+    memset(piobuf, 0, CFS_PIOBUFSIZE);
     rc = pioctl(codadir, _VICEIOCTL(_VIOC_CHECKPOINTML), &vio, 1);
     if (rc < 0) { PERROR("VIOC_CHECKPOINTML"); exit(-1); }
+    printf("%s", piobuf);
 }
 
 
@@ -1932,6 +1946,28 @@ static void ListVolume(int argc, char *argv[], int opslot)
     }
 }
 
+static void CacheStats(int argc, char *argv[], int opslot)
+{
+    int rc;
+    struct ViceIoctl vio;
+
+    if (argc != 2) {
+	printf("Usage: %s\n", cmdarray[opslot].usetxt);
+	exit(-1);
+    }
+
+    memset(piobuf, 0, CFS_PIOBUFSIZE);
+    vio.in = NULL;
+    vio.in_size = 0;
+    vio.out = piobuf;
+    vio.out_size = CFS_PIOBUFSIZE;
+
+    rc = pioctl(NULL, _VICEIOCTL(_VIOC_CACHESTATS), &vio, 0);
+    if (rc < 0) { PERROR("VIOC_CACHESTATS"); exit(-1); }
+
+    printf("%s", piobuf);
+}
+
 static void LookAside(int argc, char *argv[], int opslot)
 {
     int i, rc, spaceleft;
@@ -2089,6 +2125,33 @@ static void MkMount (int argc, char *argv[], int opslot)
     if (rc < 0) { PERROR(dir); exit(-1); }
 }
 
+static void OptimizeML(int argc, char *argv[], int opslot)
+{
+    int i, rc;
+    struct ViceIoctl vio;
+
+    if (argc < 3) {
+	printf("Usage: %s\n", cmdarray[opslot].usetxt);
+	exit(-1);
+    }
+
+    for (i = 2; i < argc; i++) {
+	memset(piobuf, 0, CFS_PIOBUFSIZE);
+	vio.in = NULL;
+	vio.in_size = 0;
+	vio.out = piobuf;
+	vio.out_size = CFS_PIOBUFSIZE;
+
+	if (argc > 3) printf("  %s:\n", argv[i]);
+
+	rc = pioctl(argv[i], _VICEIOCTL(_VIOC_OPTIMIZEML), &vio, 1);
+	if (rc < 0) { PERROR("VIOC_OPTIMIZEML"); continue; }
+
+	printf("%s", piobuf);
+    }
+}
+
+
 static void PurgeML(int argc, char *argv[], int opslot)
 {
     int  rc;
@@ -37,10 +37,16 @@ Pittsburgh, PA.
 
 */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <signal.h>
 #include <errno.h>
 #include <sys/file.h>
@@ -48,6 +54,13 @@ Pittsburgh, PA.
 #include <fcntl.h>
 #include <assert.h>
 
+#if defined(HAVE_EPOLL_CREATE1) && defined(HAVE_TIMERFD_CREATE)
+#define IOMGR_EPOLL 1
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
 #include <lwp/lwp.h>
 #include <lwp/timer.h>
 #include "lwp.private.h"
@@ -87,7 +100,12 @@ struct IoRequest {
     fd_set		rwritefds;
     fd_set		rexceptfds;
 
-    struct TM_Elem	timeout;
+    /* Absolute expiration time, tv_sec is -1 when waiting forever */
+    struct timeval	expiration;
+    int			heapix;		/* index in timeouts, -1 if none */
+
+    /* Pending requests are on fdRequests or sleepRequests */
+    struct IoRequest   *next, *prev;
 
     /* Result of select call */
     int			result;
@@ -122,11 +140,57 @@ static char *sigRock[NSOFTSIG];
 
 static struct IoRequest *iorFreeList = 0;
 
-static struct TM_Elem *Requests;	/* List of requests */
+/* Pending requests. Those that wait for descriptors are kept apart from
+ * plain sleeps so that only the former have to be looked at when merging
+ * descriptor masks or handing out results. Finite timeouts are also in a
+ * binary heap ordered by expiration time, which keeps adding and expiring
+ * requests cheap with many sleeping LWPs. */
+static struct IoRequest fdRequests = { .next = &fdRequests, .prev = &fdRequests };
+static struct IoRequest sleepRequests = { .next = &sleepRequests, .prev = &sleepRequests };
+static int nRequests;
+static struct IoRequest **timeouts;
+static int ntimeouts, maxtimeouts;
+
+#define FOR_ALL_REQUESTS(req, list, body) \
+    { \
+	struct IoRequest *req, *_next_; \
+	for (req = (list)->next; req != (list); req = _next_) { \
+	    _next_ = req->next; \
+	    body \
+	} \
+    }
+
 static struct timeval iomgr_timeout;	/* global so signal handler can zap it */
 
 #define FreeRequest(x) ((x)->free = iorFreeList, iorFreeList = (x))
 
+#ifdef IOMGR_EPOLL
+/* epoll backend. The descriptors of all pending requests stay registered
+ * with an epoll instance, the per descriptor waiter counts are updated as
+ * requests come and go and only descriptors whose counts changed are passed
+ * to epoll_ctl before the next wait. Timeouts are handled by a timerfd so
+ * they keep the microsecond resolution of select. Setting LWP_IOMGR=select
+ * in the environment selects the old select backend. */
+#define EPOLL_BATCH 64
+
+static int epfd = -1;			/* -1 when select is used */
+static int tmfd = -1;
+static struct fdstate {
+    unsigned short nread, nwrite, nexcept;	/* waiters on the descriptor */
+    unsigned char dirty;			/* on dirtyfds */
+    unsigned char always;			/* can't be polled, always ready */
+    unsigned int events;			/* registered with epoll */
+} fdstate[FD_SETSIZE];
+static int dirtyfds[FD_SETSIZE];
+static int ndirty;
+static int nalways;			/* registered unpollable fds */
+
+static int EpollInit();
+static void EpollFinal();
+static void EpollSync();
+static int EpollCheckDescriptors(struct timeval *timeout, int PollingCheck);
+#endif
+
 /* function & procedure declarations */
 static struct IoRequest *NewRequest();
 static int IOMGR_CheckSignals ();
@@ -134,8 +198,10 @@ static int IOMGR_CheckTimeouts ();
 static int IOMGR_CheckDescriptors(int PollingCheck);
 static void IOMGR(void *unused);
 static int SignalIO (fd_set *readfds, fd_set *writefds, fd_set *exceptfds);
-static int SignalTimeout(struct timeval *timeout);
 static int SignalSignals ();
+static void Interest(struct IoRequest *req, int delta);
+static void AddRequest(struct IoRequest *req);
+static void RemoveRequest(struct IoRequest *req);
 
 
 static struct IoRequest *NewRequest()
@@ -151,7 +217,133 @@ static struct IoRequest *NewRequest()
     return request;
 }
 
-#define Purge(list) FOR_ALL_ELTS(req, list, { free(req->BackPointer); })
+#define Purge(list) FOR_ALL_REQUESTS(req, list, { free(req); })
+
+/* t1 > t2 */
+static int later(struct timeval *t1, struct timeval *t2)
+{
+    return t1->tv_sec > t2->tv_sec ||
+	(t1->tv_sec == t2->tv_sec && t1->tv_usec > t2->tv_usec);
+}
+
+static void HeapSet(int i, struct IoRequest *req)
+{
+    timeouts[i] = req;
+    req->heapix = i;
+}
+
+static void HeapUp(int i)
+{
+    struct IoRequest *req = timeouts[i];
+    int parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!later(&timeouts[parent]->expiration, &req->expiration))
+	    break;
+	HeapSet(i, timeouts[parent]);
+	i = parent;
+    }
+    HeapSet(i, req);
+}
+
+static void HeapDown(int i)
+{
+    struct IoRequest *req = timeouts[i];
+    int child;
+
+    for (;;) {
+	child = 2 * i + 1;
+	if (child >= ntimeouts)
+	    break;
+	if (child + 1 < ntimeouts &&
+	    later(&timeouts[child]->expiration, &timeouts[child + 1]->expiration))
+	    child++;
+	if (!later(&req->expiration, &timeouts[child]->expiration))
+	    break;
+	HeapSet(i, timeouts[child]);
+	i = child;
+    }
+    HeapSet(i, req);
+}
+
+static void HeapInsert(struct IoRequest *req)
+{
+    if (ntimeouts == maxtimeouts) {
+	maxtimeouts = maxtimeouts ? 2 * maxtimeouts : 64;
+	timeouts = (struct IoRequest **)
+	    realloc(timeouts, maxtimeouts * sizeof(struct IoRequest *));
+	assert(timeouts);
+    }
+    HeapSet(ntimeouts++, req);
+    HeapUp(ntimeouts - 1);
+}
+
+static void HeapRemove(struct IoRequest *req)
+{
+    int i = req->heapix;
+
+    req->heapix = -1;
+    if (--ntimeouts == i)
+	return;
+
+    HeapSet(i, timeouts[ntimeouts]);
+    HeapDown(i);
+    HeapUp(timeouts[i]->heapix);
+}
+
+/* Track which descriptors have waiters, only needed for epoll. */
+static void Interest(struct IoRequest *req, int delta)
+{
+#ifdef IOMGR_EPOLL
+    int i, changed;
+
+    if (epfd == -1)
+	return;
+
+    for (i = 0; i < req->nfds; i++) {
+	changed = 0;
+	if (FD_ISSET(i, &req->readfds))   { fdstate[i].nread += delta; changed = 1; }
+	if (FD_ISSET(i, &req->writefds))  { fdstate[i].nwrite += delta; changed = 1; }
+	if (FD_ISSET(i, &req->exceptfds)) { fdstate[i].nexcept += delta; changed = 1; }
+	if (changed && !fdstate[i].dirty) {
+	    fdstate[i].dirty = 1;
+	    dirtyfds[ndirty++] = i;
+	}
+    }
+#endif
+}
+
+static void AddRequest(struct IoRequest *req)
+{
+    struct IoRequest *list = req->nfds ? &fdRequests : &sleepRequests;
+
+    req->prev = list->prev;
+    req->next = list;
+    list->prev->next = req;
+    list->prev = req;
+    nRequests++;
+
+    req->heapix = -1;
+    if (req->expiration.tv_sec != -1)
+	HeapInsert(req);
+
+    Interest(req, 1);
+}
+
+/* Must be called before the descriptor masks of the request are cleared. */
+static void RemoveRequest(struct IoRequest *req)
+{
+    Interest(req, -1);
+
+    req->prev->next = req->next;
+    req->next->prev = req->prev;
+    req->next = req->prev = req;
+    nRequests--;
+
+    if (req->heapix != -1)
+	HeapRemove(req);
+}
 
 /*
  *    The IOMGR module manages three types of IO for the LWPs in the process: 
@@ -176,18 +368,19 @@ static int IOMGR_CheckSignals() {
 static int IOMGR_CheckTimeouts()
 {
     int woke_someone = FALSE;
+    struct timeval now;
 
-    TM_Rescan(Requests);
-    for (;;) {
-	struct IoRequest *req;
-	struct TM_Elem *expired = TM_GetExpired(Requests);
-	if (expired == NULL) break;
+    if (ntimeouts == 0)
+	return(FALSE);
+
+    FT_GetTimeOfDay(&now, 0);
+    while (ntimeouts && !later(&timeouts[0]->expiration, &now)) {
+	struct IoRequest *req = timeouts[0];
 
 	woke_someone = TRUE;
-	req = (struct IoRequest *) expired -> BackPointer;
+	RemoveRequest(req);
 	req->nfds = 0;
 	req->result = 0;	/* no fds ready */
-	TM_Remove(Requests, &req->timeout);
 	LWP_QSignal(req->pid);
 	req->pid->iomgrRequest = 0;
     }
@@ -203,24 +396,48 @@ static int IOMGR_CheckDescriptors(int PollingCheck)
 {
     int result, nfds, rf, wf, ef;
     fd_set readfds, writefds, exceptfds;
-    struct TM_Elem *earliest;
     struct timeval timeout, tmp_timeout;
 
-    earliest = TM_GetEarliest(Requests);
-    if (earliest == NULL) 
+    if (nRequests == 0)
 	    return(0);
 
+    /* Time until the earliest timeout, or -1 to wait forever. */
+    if (PollingCheck) {
+	    timeout.tv_sec = 0;
+	    timeout.tv_usec = 0;
+    } else if (ntimeouts == 0) {
+	    timeout.tv_sec = -1;
+	    timeout.tv_usec = -1;
+    } else {
+	    FT_GetTimeOfDay(&timeout, 0);
+	    tmp_timeout = timeouts[0]->expiration;
+	    if (!later(&tmp_timeout, &timeout)) {
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 0;
+	    } else {
+		if (tmp_timeout.tv_usec < timeout.tv_usec) {
+		    tmp_timeout.tv_usec += 1000000;
+		    tmp_timeout.tv_sec--;
+		}
+		timeout.tv_sec = tmp_timeout.tv_sec - timeout.tv_sec;
+		timeout.tv_usec = tmp_timeout.tv_usec - timeout.tv_usec;
+	    }
+    }
+
+#ifdef IOMGR_EPOLL
+    if (epfd != -1)
+	return EpollCheckDescriptors(&timeout, PollingCheck);
+#endif
+
     /* Merge active descriptors. */
     rf = wf = ef = 0; /* set whenever a fd in a fd_set is set */
     nfds = 0;
     FD_ZERO(&readfds);
     FD_ZERO(&writefds);
     FD_ZERO(&exceptfds);
-    FOR_ALL_ELTS(r, Requests,
+    FOR_ALL_REQUESTS(req, &fdRequests,
     {
 	int i;
-	struct IoRequest *req;
-	req = (struct IoRequest *) r -> BackPointer;
 
 	for (i = 0; i < req->nfds; i++) {
 	    if (FD_ISSET(i, &req->readfds))   { FD_SET(i, &readfds);   rf = 1; }
@@ -230,13 +447,6 @@ static int IOMGR_CheckDescriptors(int PollingCheck)
 	if (req->nfds > nfds) nfds = req->nfds;
     });
 
-    /* Set timeout for select syscall. */
-    if (PollingCheck) {
-	    timeout.tv_sec = 0;
-	    timeout.tv_usec = 0;
-    }    else
-	    timeout = earliest->TimeLeft;
-
     iomgr_timeout = timeout;
     if (timeout.tv_sec == -1 && timeout.tv_usec == -1) {
 	    /* infinite, sort of */
@@ -248,8 +458,8 @@ static int IOMGR_CheckDescriptors(int PollingCheck)
        this, the signal */
     /* handler will set iomgr_timeout to zero, causing the select to
        return immediately. */
-    /* The timer package won't return a zero timeval because all of
-       those guys were handled above. */
+    /* A zero timeval only happens when the earliest timeout expired
+       since IOMGR_CheckTimeouts, it is picked up on the next pass. */
     /* I'm assuming that the kernel masks signals while it's picking
        up the parameters to select. */
     /* This may a bad assumption! -DN */
@@ -271,7 +481,7 @@ static int IOMGR_CheckDescriptors(int PollingCheck)
 
     /* Linux adheres to Posix standard for select and sets
        iomgr_timeout to 0; this needs to be reset before we proceed,
-       otherwise SignalTimeout never gets called.  Since Linux select
+       otherwise IOMGR_CheckTimeouts never gets called.  Since Linux select
        changes the timeout, we must not pass iomgr_timeout.  if we
        did, the changes the signal handler may make to this variable
        will always be lost, since select resets the variable upon
@@ -311,12 +521,201 @@ static int IOMGR_CheckDescriptors(int PollingCheck)
     if (iomgr_timeout.tv_sec != 0 || iomgr_timeout.tv_usec != 0)
 	/* Real timeout only if signal handler hasn't set
            iomgr_timeout to zero. */
-	return(SignalTimeout(&timeout));
+	return(IOMGR_CheckTimeouts());
 
     return(0);
 }
 
 
+#ifdef IOMGR_EPOLL
+static int EpollInit()
+{
+    struct epoll_event ev;
+
+    memset(fdstate, 0, sizeof(fdstate));
+    ndirty = nalways = 0;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1)
+	goto fail;
+
+    tmfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tmfd == -1)
+	goto fail;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = tmfd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, tmfd, &ev) == -1)
+	goto fail;
+
+    lwpdebug(0, "IOMGR using epoll");
+    return 0;
+
+fail:
+    lwpdebug(0, "IOMGR falling back to select, errno %d", errno);
+    EpollFinal();
+    return -1;
+}
+
+static void EpollFinal()
+{
+    if (tmfd != -1) close(tmfd);
+    if (epfd != -1) close(epfd);
+    tmfd = epfd = -1;
+}
+
+/* Bring the epoll registrations in line with the waiter counts. */
+static void EpollSync()
+{
+    struct epoll_event ev;
+    struct fdstate *f;
+    int i, fd, rc;
+    unsigned int events;
+
+    for (i = 0; i < ndirty; i++) {
+	fd = dirtyfds[i];
+	f = &fdstate[fd];
+	f->dirty = 0;
+
+	events = (f->nread ? EPOLLIN : 0) | (f->nwrite ? EPOLLOUT : 0) |
+		 (f->nexcept ? EPOLLPRI : 0);
+	if (events == f->events)
+	    continue;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
+
+	if (!events) {
+	    /* the descriptor may already have been closed */
+	    if (!f->always)
+		epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+	    else
+		nalways--;
+	    f->always = 0;
+	    f->events = 0;
+	    continue;
+	}
+
+	if (f->always) {
+	    f->events = events;
+	    continue;
+	}
+
+	if (f->events) {
+	    rc = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+	    /* closed and reopened behind our back */
+	    if (rc == -1 && errno == ENOENT)
+		rc = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+	} else {
+	    rc = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+	    if (rc == -1 && errno == EEXIST)
+		rc = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+	}
+
+	if (rc == -1) {
+	    /* Regular files can't be polled, select reports them as always
+	     * ready. A bad descriptor is treated the same way so that the
+	     * waiter gets to see the error. */
+	    lwpdebug(0, "epoll_ctl fd %d returns error: %d\n", fd, errno);
+	    f->always = 1;
+	    nalways++;
+	}
+	f->events = events;
+    }
+    ndirty = 0;
+}
+
+static int EpollCheckDescriptors(struct timeval *tp, int PollingCheck)
+{
+    struct epoll_event events[EPOLL_BATCH];
+    struct itimerspec its;
+    struct timeval timeout = *tp;
+    fd_set readfds, writefds, exceptfds;
+    int i, n, fd, ready = 0, timedout = 0;
+    uint64_t ticks;
+
+    EpollSync();
+
+    if (nalways) {
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+    }
+
+    /* Same as for select, a signal that arrives after this check interrupts
+     * the epoll_wait below. */
+    if (anySigsDelivered)
+	return(-1);
+
+    if (timeout.tv_sec != 0 || timeout.tv_usec != 0) {
+	/* this is a non polling wait,
+	   ignore cont_sw_threshold flag in dispatcher */
+	last_context_switch.tv_sec = 0;
+	last_context_switch.tv_usec = 0;
+
+	/* a zero it_value disarms the timer, i.e. waits forever */
+	memset(&its, 0, sizeof(its));
+	if (timeout.tv_sec != -1 || timeout.tv_usec != -1) {
+	    its.it_value.tv_sec = timeout.tv_sec;
+	    its.it_value.tv_nsec = timeout.tv_usec * 1000;
+	}
+	timerfd_settime(tmfd, 0, &its, NULL);
+    }
+
+    n = epoll_wait(epfd, events, EPOLL_BATCH,
+		   (timeout.tv_sec == 0 && timeout.tv_usec == 0) ? 0 : -1);
+    if (n < 0) {
+	lwpdebug(-1, "epoll_wait returns error: %d\n", errno);
+	assert(errno == EINTR);
+	return(0);
+    }
+
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+    FD_ZERO(&exceptfds);
+
+    for (i = 0; i < n; i++) {
+	fd = events[i].data.fd;
+	if (fd == tmfd) {
+	    if (read(tmfd, &ticks, sizeof(ticks)) > 0 && !PollingCheck)
+		timedout = 1;
+	    continue;
+	}
+	if (fdstate[fd].nread &&
+	    (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+	    FD_SET(fd, &readfds);
+	    ready = 1;
+	}
+	if (fdstate[fd].nwrite &&
+	    (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+	    FD_SET(fd, &writefds);
+	    ready = 1;
+	}
+	if (fdstate[fd].nexcept && (events[i].events & EPOLLPRI)) {
+	    FD_SET(fd, &exceptfds);
+	    ready = 1;
+	}
+    }
+
+    if (nalways) {
+	for (fd = 0; fd < FD_SETSIZE; fd++) {
+	    if (!fdstate[fd].always) continue;
+	    if (fdstate[fd].nread)  { FD_SET(fd, &readfds);  ready = 1; }
+	    if (fdstate[fd].nwrite) { FD_SET(fd, &writefds); ready = 1; }
+	}
+    }
+
+    if (ready)
+	return(SignalIO(&readfds, &writefds, &exceptfds));
+
+    if (timedout)
+	return(IOMGR_CheckTimeouts());
+
+    return(0);
+}
+#endif /* IOMGR_EPOLL */
+
 /* The IOMGR process */
 
 /* Important invariant: process->iomgrRequest is null iff request not
@@ -372,13 +771,11 @@ static int SignalIO(fd_set *readfds, fd_set *writefds,
     int woke_someone = FALSE;
 
     /* Look at everyone who's bit mask was affected */
-    FOR_ALL_ELTS(r, Requests,
+    FOR_ALL_REQUESTS(req, &fdRequests,
     {
 	int i;
 	int wakethisone = 0;
-	struct IoRequest *req;
 	PROCESS pid;
-	req = (struct IoRequest *) r -> BackPointer;
 
 	for (i = 0; i < req->nfds; i++) {
 	    if (FD_ISSET(i, readfds) && FD_ISSET(i, &req->readfds)) {
@@ -398,7 +795,7 @@ static int SignalIO(fd_set *readfds, fd_set *writefds,
 	    }
 	}
 	if (wakethisone) {
-	    TM_Remove(Requests, &req->timeout);
+	    RemoveRequest(req);
 	    LWP_QSignal(pid=req->pid);
 	    pid->iomgrRequest = 0;
 	    woke_someone = TRUE;
@@ -408,29 +805,6 @@ static int SignalIO(fd_set *readfds, fd_set *writefds,
     return(woke_someone);
 }
 
-static int SignalTimeout(struct timeval *timeout)
-{
-    int woke_someone = FALSE;
-
-    /* Find everyone who has specified timeout */
-    FOR_ALL_ELTS(r, Requests, {
-	struct IoRequest *req;
-	PROCESS pid;
-	req = (struct IoRequest *) r->BackPointer;
-	if (TM_eql(&r->TimeLeft, timeout)) {
-	    woke_someone = TRUE;
-	    req->nfds = 0;
-	    req->result = 0;
-	    TM_Remove(Requests, &req->timeout);
-	    LWP_QSignal(pid=req->pid);
-	    pid->iomgrRequest = 0;
-	} else
-	    break;
-    })
-
-    return(woke_someone);
-}
-
 /*****************************************************\
 *						      *
 *  Signal handling routine (not to be confused with   *
@@ -512,14 +886,21 @@ int IOMGR_Initialize()
     /* If already initialized, just return */
     if (IOMGR_Id != NULL) return LWP_SUCCESS;
 
-    /* Initialize request lists */
-    if (TM_Init(&Requests) < 0) return -1;
+    nRequests = ntimeouts = 0;
 
     /* Initialize signal handling stuff. */
     sigsHandled = 0;
     anySigsDelivered = TRUE; /* A soft signal may have happened before
 	IOMGR_Initialize:  so force a check for signals regardless */
 
+#ifdef IOMGR_EPOLL
+    {
+	char *backend = getenv("LWP_IOMGR");
+	if (!backend || strcmp(backend, "select") != 0)
+	    EpollInit();
+    }
+#endif
+
     return LWP_CreateProcess(IOMGR, STACK_SIZE, 0, 0, "IO MANAGER", &IOMGR_Id);
 }
 
@@ -528,8 +909,14 @@ int IOMGR_Finalize()
 
     int status;
 
-    Purge(Requests)
-    TM_Final(&Requests);
+    Purge(&fdRequests)
+    Purge(&sleepRequests)
+    fdRequests.next = fdRequests.prev = &fdRequests;
+    sleepRequests.next = sleepRequests.prev = &sleepRequests;
+    nRequests = ntimeouts = 0;
+#ifdef IOMGR_EPOLL
+    EpollFinal();
+#endif
     status = LWP_DestroyProcess(IOMGR_Id);
     IOMGR_Id = NULL;
     return status;
@@ -589,36 +976,40 @@ int IOMGR_Select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
     for (i = 0; i < nfds; i++) {
 	if (readfds && FD_ISSET(i, readfds)) {
 	    FD_SET(i, &request->readfds);
-	    request->nfds = i;
+	    request->nfds = i + 1;
 	}
 	if (writefds  && FD_ISSET(i, writefds)) {
 	    FD_SET(i, &request->writefds);
-	    request->nfds = i;
+	    request->nfds = i + 1;
 	}
 	if (exceptfds && FD_ISSET(i, exceptfds)) {
 	    FD_SET(i, &request->exceptfds);
-	    request->nfds = i;
+	    request->nfds = i + 1;
 	}
     }
-    request->nfds++;
 
     FD_ZERO(&request->rreadfds);
     FD_ZERO(&request->rwritefds);
     FD_ZERO(&request->rexceptfds);
 
-    if (timeout == NULL) {
-	    request->timeout.TotalTime.tv_sec = -1;
-	    request->timeout.TotalTime.tv_usec = -1;
-    } else
-	    request->timeout.TotalTime = *timeout;
-
-    request->timeout.BackPointer = (char *) request;
+    if (timeout == NULL || timeout->tv_sec < 0 || timeout->tv_usec < 0) {
+	    request->expiration.tv_sec = -1;
+	    request->expiration.tv_usec = -1;
+    } else {
+	    FT_GetTimeOfDay(&request->expiration, 0);
+	    request->expiration.tv_sec += timeout->tv_sec;
+	    request->expiration.tv_usec += timeout->tv_usec;
+	    while (request->expiration.tv_usec >= 1000000) {
+		request->expiration.tv_sec++;
+		request->expiration.tv_usec -= 1000000;
+	    }
+    }
 
     /* Insert my PID in case of IOMGR_Cancel */
     request->pid = lwp_cpptr;
     request->result = 0;
     lwp_cpptr -> iomgrRequest = request;
-    TM_Insert(Requests, &request->timeout);
+    AddRequest(request);
 
     /* Wait for action */
     LWP_QWait();
@@ -647,12 +1038,12 @@ int IOMGR_Cancel(PROCESS pid)
 	if ((request = pid->iomgrRequest) == 0) 
 		return -1;
 
+	RemoveRequest(request);
 	request->nfds = 0;
 	FD_ZERO(&request->readfds);
 	FD_ZERO(&request->writefds);
 	FD_ZERO(&request->exceptfds);
 	request->result = -2;
-	TM_Remove(Requests, &request->timeout);
 	LWP_QSignal(request->pid);
 	pid->iomgrRequest = 0;
 
@@ -0,0 +1,222 @@
+/* BLURB gpl
+
+			Coda File System
+			    Release 6
+
+	    Copyright (c) 1987-2016 Carnegie Mellon University
+		    Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the terms of the GNU General Public Licence Version 2, as shown in the
+file  LICENSE.  The  technical and financial  contributors to Coda are
+listed in the file CREDITS.
+
+			Additional copyrights
+#*/
+
+/*
+ * IOMGR wakeup latency benchmark.
+ *
+ * Starts a large number of LWPs that sleep for random intervals in
+ * IOMGR_Select and measures how late they are woken up. At the same time
+ * one LWP waits for a pipe that another LWP writes to every few
+ * milliseconds, which measures descriptor wakeup latency while all the
+ * sleepers are queued. The benchmark runs once for each IOMGR backend, the
+ * backend is picked with the LWP_IOMGR environment variable.
+ *
+ * The average lateness varies a lot from run to run, by more than the
+ * difference between the backends. Compare the CPU time and several runs,
+ * not a single average.
+ *
+ * usage: iomgrbench [-n sleepers] [-t seconds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <assert.h>
+
+#include <lwp/lwp.h>
+
+#define STACK_SIZE  (32 * 1024)
+#define MAX_SLEEP   2000000	/* usec */
+#define PING_PERIOD 5000	/* usec */
+
+struct latency {
+    unsigned long count;
+    double total;
+    long max;
+    unsigned long buckets[4];	/* < 100us, < 1ms, < 10ms, more */
+};
+
+static int done, running;
+static int pipefds[2];
+static struct timeval pingsent;
+static struct latency sleeps, pings;
+
+static long usec(struct timeval *t)
+{
+    return t->tv_sec * 1000000L + t->tv_usec;
+}
+
+static void record(struct latency *l, long late)
+{
+    if (late < 0) late = 0;
+    l->count++;
+    l->total += late;
+    if (late > l->max) l->max = late;
+    l->buckets[late < 100 ? 0 : late < 1000 ? 1 : late < 10000 ? 2 : 3]++;
+}
+
+static void print(const char *what, struct latency *l)
+{
+    printf("  %-7s %8lu wakeups, late avg %6.0f us, max %6ld us, "
+	   "<100us %4.1f%%, <1ms %4.1f%%, <10ms %4.1f%%\n", what, l->count,
+	   l->count ? l->total / l->count : 0.0, l->max,
+	   l->count ? 100.0 * l->buckets[0] / l->count : 0.0,
+	   l->count ? 100.0 * (l->buckets[0] + l->buckets[1]) / l->count : 0.0,
+	   l->count ? 100.0 * (l->count - l->buckets[3]) / l->count : 0.0);
+}
+
+static void Sleeper(void *arg)
+{
+    struct timeval tv, t0, t1;
+    long want;
+
+    running++;
+    while (!done) {
+	want = 1000 + random() % (MAX_SLEEP - 1000);
+	tv.tv_sec = want / 1000000;
+	tv.tv_usec = want % 1000000;
+	gettimeofday(&t0, NULL);
+	IOMGR_Select(0, NULL, NULL, NULL, &tv);
+	gettimeofday(&t1, NULL);
+	record(&sleeps, usec(&t1) - usec(&t0) - want);
+    }
+    running--;
+}
+
+static void Reader(void *arg)
+{
+    struct timeval t1;
+    fd_set rfds;
+    char c;
+
+    running++;
+    while (!done) {
+	FD_ZERO(&rfds);
+	FD_SET(pipefds[0], &rfds);
+	if (IOMGR_Select(pipefds[0] + 1, &rfds, NULL, NULL, NULL) != 1)
+	    continue;
+	gettimeofday(&t1, NULL);
+	assert(read(pipefds[0], &c, 1) == 1);
+	record(&pings, usec(&t1) - usec(&pingsent));
+    }
+    running--;
+}
+
+static void Writer(void *arg)
+{
+    struct timeval tv;
+
+    running++;
+    while (!done) {
+	tv.tv_sec = 0;
+	tv.tv_usec = PING_PERIOD;
+	IOMGR_Select(0, NULL, NULL, NULL, &tv);
+	gettimeofday(&pingsent, NULL);
+	assert(write(pipefds[1], "x", 1) == 1);
+    }
+    /* make sure the reader sees we're done */
+    assert(write(pipefds[1], "x", 1) == 1);
+    running--;
+}
+
+static void run(const char *backend, int nsleepers, int seconds)
+{
+    struct rusage ru;
+    struct timeval tv;
+    PROCESS pid;
+    int i;
+
+    setenv("LWP_IOMGR", backend, 1);
+    srandom(1);
+
+    assert(LWP_Init(LWP_VERSION, LWP_NORMAL_PRIORITY, &pid) == LWP_SUCCESS);
+    assert(IOMGR_Initialize() == LWP_SUCCESS);
+    assert(pipe(pipefds) == 0);
+
+    for (i = 0; i < nsleepers; i++)
+	assert(LWP_CreateProcess(Sleeper, STACK_SIZE, LWP_NORMAL_PRIORITY,
+				 NULL, "sleeper", &pid) == LWP_SUCCESS);
+    assert(LWP_CreateProcess(Reader, STACK_SIZE, LWP_NORMAL_PRIORITY,
+			     NULL, "reader", &pid) == LWP_SUCCESS);
+    assert(LWP_CreateProcess(Writer, STACK_SIZE, LWP_NORMAL_PRIORITY,
+			     NULL, "writer", &pid) == LWP_SUCCESS);
+
+    /* let everyone settle before we start measuring */
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    IOMGR_Select(0, NULL, NULL, NULL, &tv);
+    memset(&sleeps, 0, sizeof(sleeps));
+    memset(&pings, 0, sizeof(pings));
+
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    IOMGR_Select(0, NULL, NULL, NULL, &tv);
+    done = 1;
+    getrusage(RUSAGE_SELF, &ru);
+
+    printf("%s backend, %d sleepers, %d seconds, cpu user %.2fs sys %.2fs\n",
+	   backend, nsleepers, seconds,
+	   ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6,
+	   ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6);
+    print("sleep", &sleeps);
+    print("pipe", &pings);
+
+    while (running) {
+	tv.tv_sec = 0;
+	tv.tv_usec = 100000;
+	IOMGR_Select(0, NULL, NULL, NULL, &tv);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const char *backends[] = { "select", "epoll" };
+    int nsleepers = 10000, seconds = 10;
+    int c, i, status;
+    pid_t child;
+
+    while ((c = getopt(argc, argv, "n:t:")) != -1) {
+	switch (c) {
+	case 'n': nsleepers = atoi(optarg); break;
+	case 't': seconds = atoi(optarg); break;
+	default:
+	    fprintf(stderr, "usage: %s [-n sleepers] [-t seconds]\n", argv[0]);
+	    exit(1);
+	}
+    }
+
+    /* LWP can't be torn down and initialized again, use a process for
+     * each run. */
+    for (i = 0; i < 2; i++) {
+	fflush(stdout);
+	child = fork();
+	assert(child != -1);
+	if (child == 0) {
+	    run(backends[i], nsleepers, seconds);
+	    exit(0);
+	}
+	if (waitpid(child, &status, 0) == -1 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != 0) {
+	    fprintf(stderr, "%s run failed\n", backends[i]);
+	    exit(1);
+	}
+    }
+    return 0;
+}
@@ -62,6 +62,7 @@ static int globalInitDone = 0;
 static void subtract (struct timeval *t1, struct timeval *t2, struct timeval *t3);
 static void add (struct timeval *t1, struct timeval *t2);
 static bool blocking (struct TM_Elem *t);
+static int later (struct timeval *t1, struct timeval *t2);
 
 
 
@@ -91,6 +92,13 @@ static void add(struct timeval *t1, struct timeval *t2)
     }
 }
 
+/* t1 > t2 */
+static int later(struct timeval *t1, struct timeval *t2)
+{
+    return t1->tv_sec > t2->tv_sec ||
+	(t1->tv_sec == t2->tv_sec && t1->tv_usec > t2->tv_usec);
+}
+
 /* t1 == t2 */
 int TM_eql(struct timeval *t1, struct timeval *t2)
 {
@@ -168,17 +176,16 @@ void TM_Insert(struct TM_Elem *tlistPtr, struct TM_Elem *elem)
     /* Finite timeout, set expiration time */
     FT_GetTimeOfDay(&elem->expiration, 0);
     add(&elem->expiration, &elem->TimeLeft);
-    next = NULL;
-    FOR_ALL_ELTS(p, tlistPtr, {
-	if (blocking(p) || !(elem->TimeLeft.tv_sec > p->TimeLeft.tv_sec ||
-	    (elem->TimeLeft.tv_sec == p->TimeLeft.tv_sec && elem->TimeLeft.tv_usec >= p->TimeLeft.tv_usec))
-	    ) {
-		next = p;	/* Save ptr to element that will be after this one */
-		break;
-	}
-     })
 
-    if (next == NULL) next = tlistPtr;
+    /* Keep finite timeouts sorted by expiration time, ahead of the blocking
+     * ones. TimeLeft of the queued elements may be stale, so compare the
+     * expiration times. New timeouts tend to expire after the ones already
+     * queued, so search backwards from the tail. */
+    next = tlistPtr;
+    while (next->Prev != tlistPtr && blocking(next->Prev))
+	next = next->Prev;
+    while (next->Prev != tlistPtr && later(&next->Prev->expiration, &elem->expiration))
+	next = next->Prev;
 
     /* insque((struct qelem *)elem, (struct qelem *)(next->Prev)); */
     elem->Prev = next->Prev;
@@ -228,10 +235,12 @@ int TM_Rescan(struct TM_Elem *tlist)
 
 struct TM_Elem *TM_GetExpired(struct TM_Elem *tlist)
 {
+    /* The list is sorted, so stop at the first unexpired element. */
     FOR_ALL_ELTS(e, tlist, {
-	if (!blocking(e) &&
-	    (0 > e->TimeLeft.tv_sec || (0 == e->TimeLeft.tv_sec && 0 >= e->TimeLeft.tv_usec)))
-		return e;
+	if (blocking(e) ||
+	    !(0 > e->TimeLeft.tv_sec || (0 == e->TimeLeft.tv_sec && 0 >= e->TimeLeft.tv_usec)))
+		return NULL;
+	return e;
     })
     return NULL;
 }
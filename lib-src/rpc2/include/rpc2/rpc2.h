@@ -428,6 +428,10 @@ typedef struct RPC2_PacketBuffer {
 	char   oldhostandport[84]; /* padding to keep the userspace interface
 				      mostly identical (on a 32-bit machine..)*/
 	struct timeval		RecvStamp;
+
+	/* set on outgoing packets whose body is not copied into Body, the
+	 * body is sent from here instead (i.e. from a mapped file) */
+	void *BodyRef;
     } Prefix;
 
 /*
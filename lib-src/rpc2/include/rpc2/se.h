@@ -181,6 +181,12 @@ typedef struct SFTPI
 			Caveat user: packet starvation can cause mysterious
 			RPC2_SEFAIL2s */
     RPC2_PortIdent Port;	/* initialization required on server side */
+    long AdaptiveWindow;	/* TRUE ==> size the send window to twice the
+			   bandwidth-delay product measured for the peer,
+			   WindowSize (at most MAXOPACKETS) caps it */
+    long MapFiles;	/* TRUE ==> send file data straight from a mapping
+			   of the file instead of reading it into packets;
+			   files must not be truncated during a transfer */
     } SFTP_Initializer;
 
 
@@ -19,6 +19,7 @@ Coda are listed in the file CREDITS.
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <stdint.h>
 
 /* RFC2460 - Internet Protocol, Version 6 (IPv6) Specification
@@ -181,6 +182,13 @@ ssize_t secure_sendto(int s, const void *buf, size_t len, int flags,
 		      /* to/tolen only used to send non-encrypted packets */
 		      const struct sockaddr *to, socklen_t tolen,
 		      struct security_association *sa);
+ssize_t secure_sendtov(int s, const struct iovec *iov, int iovcnt, int flags,
+		       const struct sockaddr *to, socklen_t tolen,
+		       struct security_association *sa);
+/* build the datagram without sending it, out is MAXPACKETSIZE bytes and is
+ * only used when sa encrypts or authenticates */
+ssize_t secure_encodev(const struct iovec *iov, int iovcnt, uint8_t *out,
+		       struct security_association *sa);
 
 ssize_t secure_recvfrom(int s, void *buf, size_t len, int flags,
 			struct sockaddr *peer, socklen_t *peerlen, /*untrusted*/
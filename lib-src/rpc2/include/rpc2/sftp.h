@@ -70,6 +70,11 @@ Pittsburgh, PA.
 #define SFTP_MINWINDOWSIZE	2
 #define SFTP_MINSENDAHEAD	1
 
+/* largest packet we will agree to use, it still fits in a LARGEPACKET
+ * buffer with room for the security layer header and trailer. Only useful
+ * on networks with jumbo frames, otherwise it is sent as 3 IP fragments */
+#define SFTP_JUMBOPACKETSIZE	4096
+
 #define	SFTP_DebugLevel	RPC2_DebugLevel
 
 /* Packet Format:
@@ -166,7 +171,10 @@ Pittsburgh, PA.
 
 /* Per-connection information: accessible via RPC2_GetSEPointer() and RPC2_SetSEPointer() */
 #define SFTPMAGIC	4902057
-#define MAXOPACKETS	64	/* Maximum no of outstanding packets; multiple of 32 */
+#define MAXOPACKETS	256	/* Maximum no of outstanding packets; power of 2 */
+/* Only the first 64 bits of the selective ack mask fit in the packet header,
+ * acks for larger windows carry the remaining bits in their body. Peers that
+ * only handle 64 packets never agree to a larger window. */
 #define BITMASKWIDTH	(MAXOPACKETS / 32)	/* No of elements in integer array */
 
 struct SFTP_Parms
@@ -215,6 +223,9 @@ struct SFTP_Entry		/* per-connection data structure */
 				   transfer */
     off_t fd_offset;		/* For FILEBYFD transfers, we save the offset
 				   within the file after each read/write */
+    char *map_addr;		/* source side: mapping of the file when
+				   SFTP_MapFiles is set, or NULL */
+    size_t map_size;		/* length of the mapping */
     struct SL_Entry *Sleeper;	/* SL_Entry of LWP sleeping on this connection,
 				   or NULL */
     uint32_t PacketSize;	/* Amount of  data in each packet */
@@ -301,6 +312,14 @@ struct SFTP_Entry		/* per-connection data structure */
      * received.
      */
     struct security_association *sa;
+
+    /* Adaptive send window (source side, only when SFTP_AdaptiveWindow is
+     * set). The window follows the bandwidth-delay product of the peer,
+     * computed from the RTT and bandwidth estimates in its host entry.
+     * WindowSize remains the upper bound agreed upon with the peer. */
+    uint32_t CongWindow;	/* current limit on outstanding packets */
+    uint32_t MaxCongWindow;	/* largest window reached on this connection */
+    uint32_t WindowCuts;	/* how often the window was reduced */
 };
 
 
@@ -308,6 +327,8 @@ extern long SFTP_DebugLevel;
 
 int sftp_XmitPacket(struct SFTP_Entry *sentry, RPC2_PacketBuffer *pb,
 		    int confirm);
+int sftp_XmitPackets(struct SFTP_Entry *sentry, RPC2_PacketBuffer *pbs[],
+		     int count, int confirm);
 void sftp_Timer(void);
 void sftp_ExaminePacket(RPC2_PacketBuffer *pb);
 
@@ -401,15 +422,18 @@ off_t sftp_ExtractFileFromPacket(struct SFTP_Entry *sEntry, RPC2_PacketBuffer *w
 int sftp_AddPiggy(RPC2_PacketBuffer **whichP, char *dPtr, off_t dSize, unsigned int maxSize);
 void sftp_SetError(struct SFTP_Entry *s, enum SFState e);
 int sftp_MorePackets(void);
+void sftp_StartWindow(struct SFTP_Entry *sEntry);
 
 
 extern long sftp_datas, sftp_datar, sftp_acks, sftp_ackr, sftp_busy,
 	sftp_triggers, sftp_starts, sftp_retries, sftp_timeouts,
 	sftp_windowfulls, sftp_duplicates, sftp_bogus, sftp_ackslost, sftp_didpiggy,
-	sftp_starved, sftp_rttupdates;
+	sftp_starved, sftp_rttupdates, sftp_mapped;
 
 extern long sftp_PacketsInUse;
 extern long SFTP_MaxPackets;
+extern long SFTP_AdaptiveWindow;
+extern long SFTP_MapFiles;
 
 /* SFTP's version of RPC2_AllocBuffer and RPC2_FreeBuffer */
 
@@ -49,7 +49,13 @@ int rpc2_DelayedSend(int s, struct RPC2_addrinfo *addr, RPC2_PacketBuffer *pb,
     /* hopefully the connection entry (and security association) are not
      * destroyed during the delay period */
     de->sa = pb->Prefix.sa;
-    memcpy(&de[1], &pb->Header, de->len);
+    if (pb->Prefix.BodyRef) {
+	memcpy(&de[1], &pb->Header, sizeof(struct RPC2_PacketHeader));
+	memcpy((char *)&de[1] + sizeof(struct RPC2_PacketHeader),
+	       pb->Prefix.BodyRef,
+	       de->len - sizeof(struct RPC2_PacketHeader));
+    } else
+	memcpy(&de[1], &pb->Header, de->len);
 
     /* enqueue */
     sl->data = de;
@@ -36,6 +36,10 @@ Pittsburgh, PA.
 
 */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* for sendmmsg */
+#endif
+
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -109,16 +113,16 @@ static long FailPacket(int (*predicate)(), RPC2_PacketBuffer *pb,
     return drop;
 }
 
-void rpc2_XmitPacket(RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr,
-		     int confirm)
+/* Common part of rpc2_XmitPacket and rpc2_XmitPackets. Picks the socket,
+ * does the accounting and runs the packet past the failure emulation and
+ * delay hooks. Returns the socket to send on, or -1 when the packet has
+ * already been dropped or queued for later. */
+static int XmitPrepare(RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr)
 {
-    static int log_limit = 0;
-    int whichSocket, n, flags = 0;
+    int whichSocket;
     struct timeval tv;
     int rc;
 
-    say(1, RPC2_DebugLevel, "rpc2_XmitPacket()\n");
-
 #ifdef RPC2DEBUG
     if (RPC2_DebugLevel > 9)
 	{
@@ -140,7 +144,7 @@ void rpc2_XmitPacket(RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr,
 	whichSocket = rpc2_v4RequestSocket;
 
     if (whichSocket == -1)
-	return; // RPC2_NOCONNECTION
+	return -1; // RPC2_NOCONNECTION
 
     TR_XMIT();
 
@@ -150,22 +154,21 @@ void rpc2_XmitPacket(RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr,
     rpc2_Sent.Bytes += pb->Prefix.LengthOfPacket;
 
     if (FailPacket(Fail_SendPredicate, pb, addr, whichSocket))
-	return;
+	return -1;
 
     rc = LUA_fail_delay(addr, pb, 1, &tv);
     if (rc == -1) { /* drop */
 	say(9, RPC2_DebugLevel, "Dropping outgoing packet\n");
-	return;
+	return -1;
     }
-    if (rc && rpc2_DelayedSend(whichSocket, addr, pb, &tv)) return; /* delay */
-
-    if (confirm)
-	flags = msg_confirm;
+    if (rc && rpc2_DelayedSend(whichSocket, addr, pb, &tv))
+	return -1; /* delay */
 
-    n = secure_sendto(whichSocket, &pb->Header,
-		      pb->Prefix.LengthOfPacket, flags,
-		      addr->ai_addr, addr->ai_addrlen, pb->Prefix.sa);
+    return whichSocket;
+}
 
+static void XmitError(int whichSocket, ssize_t n, RPC2_PacketBuffer *pb)
+{
     if (n == -1 && errno == EAGAIN)
     {
 	/* operation failed probably because the send buffer was full. we could
@@ -186,6 +189,11 @@ void rpc2_XmitPacket(RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr,
 	sprintf(msg, "Xmit_Packet socket %d", whichSocket);
 	perror(msg);
     }
+}
+
+static void XmitLogLong(RPC2_PacketBuffer *pb)
+{
+    static int log_limit = 0;
 
     /* Log outgoing packets that are larger than the IPv6 MTU
      * (- ipv6 hdr, ipv6 fragment hdr, udp hdr, secure spi/seq/iv/icv)
@@ -204,6 +212,172 @@ void rpc2_XmitPacket(RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr,
     }
 }
 
+/* Describe the transmitted part of a packet, the body may live outside of
+ * the packet buffer. Returns the number of iovecs used, at most 2. */
+static int XmitIov(RPC2_PacketBuffer *pb, struct iovec *iov)
+{
+    iov[0].iov_base = &pb->Header;
+    iov[0].iov_len = pb->Prefix.LengthOfPacket;
+    if (!pb->Prefix.BodyRef)
+	return 1;
+
+    iov[0].iov_len = sizeof(struct RPC2_PacketHeader);
+    iov[1].iov_base = pb->Prefix.BodyRef;
+    iov[1].iov_len = pb->Prefix.LengthOfPacket -
+		     sizeof(struct RPC2_PacketHeader);
+    return 2;
+}
+
+void rpc2_XmitPacket(RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr,
+		     int confirm)
+{
+    struct iovec iov[2];
+    int whichSocket, n, iovcnt, flags = 0;
+
+    say(1, RPC2_DebugLevel, "rpc2_XmitPacket()\n");
+
+    whichSocket = XmitPrepare(pb, addr);
+    if (whichSocket == -1)
+	return;
+
+    if (confirm)
+	flags = msg_confirm;
+
+    iovcnt = XmitIov(pb, iov);
+    n = secure_sendtov(whichSocket, iov, iovcnt, flags,
+		       addr->ai_addr, addr->ai_addrlen, pb->Prefix.sa);
+
+    XmitError(whichSocket, n, pb);
+    XmitLogLong(pb);
+}
+
+#ifdef HAVE_SENDMMSG
+struct XmitBatch {
+    int socket;
+    int count;
+    struct mmsghdr msgs[RPC2_MAXXMITBATCH];
+    struct iovec iovs[2 * RPC2_MAXXMITBATCH];
+    RPC2_PacketBuffer *pbs[RPC2_MAXXMITBATCH];
+};
+
+/* Encrypted datagrams of the current batch. All LWPs share a single kernel
+ * thread and a batch is always flushed before rpc2_XmitPackets returns. */
+static uint8_t xmit_bufs[RPC2_MAXXMITBATCH][MAXPACKETSIZE];
+
+static void XmitFlush(struct XmitBatch *b, int flags)
+{
+    int sent, n;
+
+    for (sent = 0; sent < b->count; sent += n) {
+	n = sendmmsg(b->socket, &b->msgs[sent], b->count - sent, flags);
+#ifdef __linux__
+	/* see secure_sendtov, an earlier ICMP error is reported on the
+	 * next send to any destination */
+	if (n == -1 && errno == ECONNREFUSED)
+	    n = sendmmsg(b->socket, &b->msgs[sent], b->count - sent, 0);
+#endif
+	if (n <= 0) {
+	    /* consider the rest of the batch lost on the network */
+	    XmitError(b->socket, -1, b->pbs[sent]);
+	    break;
+	}
+    }
+    for (n = 0; n < b->count; n++)
+	XmitLogLong(b->pbs[n]);
+    b->count = 0;
+}
+
+/* Add a packet to the batch, encrypting or authenticating it with the same
+ * logic secure_sendtov uses */
+static void XmitQueue(struct XmitBatch *b, int whichSocket,
+		      RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr,
+		      int flags)
+{
+    struct security_association *sa = pb->Prefix.sa;
+    struct mmsghdr *m;
+    struct iovec *iov;
+    ssize_t n;
+
+    if (b->count && b->socket != whichSocket)
+	XmitFlush(b, flags);
+
+    m = &b->msgs[b->count];
+    iov = &b->iovs[2 * b->count];
+    memset(m, 0, sizeof(*m));
+    m->msg_hdr.msg_iov = iov;
+    m->msg_hdr.msg_iovlen = XmitIov(pb, iov);
+
+    n = secure_encodev(iov, m->msg_hdr.msg_iovlen, xmit_bufs[b->count], sa);
+    if (n < 0) {
+	XmitError(whichSocket, n, pb);
+	return;
+    }
+
+    if (sa && (sa->encrypt || sa->authenticate)) {
+	iov[0].iov_base = xmit_bufs[b->count];
+	iov[0].iov_len = n;
+	m->msg_hdr.msg_iovlen = 1;
+	m->msg_hdr.msg_name = &sa->peer;
+	m->msg_hdr.msg_namelen = sa->peerlen;
+    } else {
+	m->msg_hdr.msg_name = addr->ai_addr;
+	m->msg_hdr.msg_namelen = addr->ai_addrlen;
+    }
+
+    b->socket = whichSocket;
+    b->pbs[b->count++] = pb;
+
+    if (b->count == RPC2_MAXXMITBATCH)
+	XmitFlush(b, flags);
+}
+#endif
+
+/* Send a series of packets to the same destination. Where available the
+ * packets are encrypted into separate buffers and handed to the kernel with
+ * a single sendmmsg call, otherwise they go through secure_sendtov one
+ * packet at a time, just like rpc2_XmitPacket. */
+void rpc2_XmitPackets(RPC2_PacketBuffer *pbs[], int count,
+		      struct RPC2_addrinfo *addr, int confirm)
+{
+    int i, whichSocket, flags = 0;
+#ifdef HAVE_SENDMMSG
+    struct XmitBatch batch;
+    batch.count = 0;
+#else
+    struct iovec iov[2];
+    int n, iovcnt;
+#endif
+
+    say(1, RPC2_DebugLevel, "rpc2_XmitPackets(%d)\n", count);
+
+    if (confirm)
+	flags = msg_confirm;
+
+    for (i = 0; i < count; i++)
+    {
+	RPC2_PacketBuffer *pb = pbs[i];
+
+	whichSocket = XmitPrepare(pb, addr);
+	if (whichSocket == -1)
+	    continue;
+
+#ifdef HAVE_SENDMMSG
+	XmitQueue(&batch, whichSocket, pb, addr, flags);
+#else
+	iovcnt = XmitIov(pb, iov);
+	n = secure_sendtov(whichSocket, iov, iovcnt, flags,
+			   addr->ai_addr, addr->ai_addrlen, pb->Prefix.sa);
+	XmitError(whichSocket, n, pb);
+	XmitLogLong(pb);
+#endif
+    }
+
+#ifdef HAVE_SENDMMSG
+    if (batch.count)
+	XmitFlush(&batch, flags);
+#endif
+}
+
 struct security_association *rpc2_GetSA(uint32_t spi)
 {
     struct CEntry *ce= __rpc2_GetConn((RPC2_Handle)spi);
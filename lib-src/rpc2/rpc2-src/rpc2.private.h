@@ -495,6 +495,9 @@ long rpc2_CreateIPSocket(int af, int *svar, struct RPC2_addrinfo *addr, short *P
 long rpc2_SendReliably(), rpc2_MSendPacketsReliably();
 void rpc2_XmitPacket(RPC2_PacketBuffer *pb, struct RPC2_addrinfo *addr,
 		     int confirm);
+#define RPC2_MAXXMITBATCH 64	/* max packets per sendmmsg call */
+void rpc2_XmitPackets(RPC2_PacketBuffer *pbs[], int count,
+		      struct RPC2_addrinfo *addr, int confirm);
 void rpc2_InitPacket();
 int rpc2_MorePackets(void);
 long rpc2_RecvPacket(long whichSocket, RPC2_PacketBuffer *whichBuff);
@@ -347,6 +347,7 @@ long rpc2_AllocBuffer(IN long MinBodySize, OUT RPC2_PacketBuffer **BuffPtr,
 	assert(*BuffPtr);
 	assert((*BuffPtr)->Prefix.MagicNumber == OBJ_PACKETBUFFER);
 	(*BuffPtr)->Prefix.sa = NULL;
+	(*BuffPtr)->Prefix.BodyRef = NULL;
 
 	memset(&(*BuffPtr)->Header, 0, sizeof(struct RPC2_PacketHeader));
 	(*BuffPtr)->Header.BodyLength = MinBodySize;
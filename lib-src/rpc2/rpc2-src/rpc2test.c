@@ -581,8 +581,10 @@ static void ClientBody(void *arg)
 		    }
 		else
 		    if (VerboseFlag)
-			fprintf(stderr, "%ld bytes transferred\n",
-				sed.Value.SmartFTPD.BytesTransferred);
+			fprintf(stderr, "%ld bytes transferred in %ld msecs (%.2f MB/s)\n",
+				sed.Value.SmartFTPD.BytesTransferred, rpctime,
+				rpctime ? sed.Value.SmartFTPD.BytesTransferred /
+				    (rpctime * 1000.0) : 0.0);
 
 		break;
 		}
@@ -613,8 +615,10 @@ static void ClientBody(void *arg)
 		}
 		else
 		    if (VerboseFlag)
-			fprintf(stderr, "%ld bytes transferred\n",
-				sed.Value.SmartFTPD.BytesTransferred);
+			fprintf(stderr, "%ld bytes transferred in %ld msecs (%.2f MB/s)\n",
+				sed.Value.SmartFTPD.BytesTransferred, rpctime,
+				rpctime ? sed.Value.SmartFTPD.BytesTransferred /
+				    (rpctime * 1000.0) : 0.0);
 		break;
 	    }
 
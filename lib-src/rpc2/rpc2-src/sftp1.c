@@ -127,6 +127,8 @@ void SFTP_SetDefaults(initPtr)
     initPtr->MaxPackets = -1;
     initPtr->Port.Tag = RPC2_PORTBYINETNUMBER;
     initPtr->Port.Value.InetPortNumber = htons(0);
+    initPtr->AdaptiveWindow = FALSE;
+    initPtr->MapFiles = FALSE;
     }
 
 
@@ -149,8 +151,14 @@ void SFTP_Activate(initPtr)
 	SFTP_DoPiggy = initPtr->DoPiggy;
 	SFTP_DupThreshold = initPtr->DupThreshold;
 	SFTP_MaxPackets = initPtr->MaxPackets;
+	SFTP_AdaptiveWindow = initPtr->AdaptiveWindow;
+	SFTP_MapFiles = initPtr->MapFiles;
 	}
     assert(SFTP_SendAhead <= 16);	/* 'cause of readv() bogosity */
+    if (SFTP_WindowSize > MAXOPACKETS)
+	SFTP_WindowSize = MAXOPACKETS;
+    if (SFTP_PacketSize > SFTP_JUMBOPACKETSIZE)
+	SFTP_PacketSize = SFTP_JUMBOPACKETSIZE;
 
     /* Enlarge table by one */
     SE_DefCount++;
@@ -289,14 +297,15 @@ long SFTP_MakeRPC1(IN ConnHandle, INOUT SDesc, INOUT RequestPtr)
 	se->SendMostRecent = se->SendLastContig;
 	se->SendWorriedLimit = se->SendLastContig;
 	se->SendAckLimit = se->SendLastContig;
-	memset(se->SendTheseBits, 0, BITMASKWIDTH*sizeof(long));
+	memset(se->SendTheseBits, 0, sizeof(int)*BITMASKWIDTH);
 	se->ReadAheadCount = 0;
+	sftp_StartWindow(se);
 	rc = sftp_InitIO(se);
 	}
     else
 	{
 	se->RecvMostRecent = se->RecvLastContig;
-	memset(se->RecvTheseBits, 0, BITMASKWIDTH*sizeof(long));
+	memset(se->RecvTheseBits, 0, sizeof(int)*BITMASKWIDTH);
 	rc = sftp_InitIO(se);
 	}
     if (rc < 0)
@@ -782,6 +791,7 @@ static long PutFile(struct SFTP_Entry *sEntry)
     sEntry->RequestTime = ce ? ce->RequestTime : 0;
 
     memset(sEntry->SendTheseBits, 0, sizeof(int)*BITMASKWIDTH);
+    sftp_StartWindow(sEntry);
 
     if (sftp_SendStrategy(sEntry) < 0)
 	{QUIT(sEntry, SE_FAILURE, RPC2_SEFAIL2);}
@@ -1079,10 +1089,16 @@ int sftp_ExtractParmsFromPacket(struct SFTP_Entry *sEntry,
 
     if (sEntry->WindowSize < SFTP_MINWINDOWSIZE)
 	sEntry->WindowSize = SFTP_MINWINDOWSIZE;
+    if (sEntry->WindowSize > MAXOPACKETS)
+	sEntry->WindowSize = MAXOPACKETS;
     if (sEntry->SendAhead < SFTP_MINSENDAHEAD)
         sEntry->SendAhead = SFTP_MINSENDAHEAD;
     if (sEntry->PacketSize < SFTP_MINPACKETSIZE)
 	sEntry->PacketSize = SFTP_MINPACKETSIZE;
+    /* Large packets are only used when both sides were configured for them,
+     * but never go beyond what fits in our packet buffers */
+    if (sEntry->PacketSize > SFTP_JUMBOPACKETSIZE)
+	sEntry->PacketSize = SFTP_JUMBOPACKETSIZE;
 
     say(9, SFTP_DebugLevel, "GotParms: %d %d %d %d %d\n", sEntry->WindowSize, sEntry->SendAhead, sEntry->AckPoint, sEntry->PacketSize, sEntry->DupThreshold);
 
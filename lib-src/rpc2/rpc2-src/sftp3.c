@@ -59,6 +59,9 @@ Pittsburgh, PA.
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "rpc2.private.h"
 #include <rpc2/se.h>
 #include <rpc2/sftp.h>
@@ -72,6 +75,8 @@ long SFTP_AckPoint;
 long SFTP_DoPiggy;
 long SFTP_DupThreshold;
 long SFTP_MaxPackets;
+long SFTP_AdaptiveWindow;
+long SFTP_MapFiles;
 
 /* long SFTP_DebugLevel; */	/* defined to RPC2_DebugLevel for now */
 long sftp_PacketsInUse;
@@ -79,7 +84,7 @@ long sftp_PacketsInUse;
 long sftp_datas, sftp_datar, sftp_acks, sftp_ackr, sftp_busy,
 	sftp_triggers, sftp_starts, sftp_retries, sftp_timeouts,
 	sftp_windowfulls, sftp_duplicates, sftp_bogus, sftp_ackslost, sftp_didpiggy,
-	sftp_starved, sftp_rttupdates;
+	sftp_starved, sftp_rttupdates, sftp_mapped;
 struct sftpStats sftp_Sent, sftp_MSent;
 struct sftpStats sftp_Recvd, sftp_MRecvd;
 
@@ -88,9 +93,13 @@ static int ResendWorried(struct SFTP_Entry *sEntry);
 static int SendSendAhead(struct SFTP_Entry *sEntry);
 static int SendFirstUnacked(struct SFTP_Entry *sEntry);
 static int WinIsOpen(struct SFTP_Entry *sEntry);
+static uint32_t SendWindow(struct SFTP_Entry *sEntry);
+static void UpdateWindow(struct SFTP_Entry *sEntry);
 static void sftp_SendAck(struct SFTP_Entry *sEntry);
 static int sftp_vfwritev(struct SFTP_Entry *se, struct iovec *iovarray, long howMany);
 static int sftp_vfreadv(struct SFTP_Entry *se, struct iovec iovarray[], long howMany);
+static void sftp_vfmap(struct SFTP_Entry *se);
+static int sftp_vfmapv(struct SFTP_Entry *se, struct iovec iovarray[], long howMany);
 
 /* sftp5.c */
 void B_ShiftLeft(unsigned int *bMask, int bShift);
@@ -192,6 +201,9 @@ int sftp_InitIO(struct SFTP_Entry *sEntry)
 	(void)lseek(sEntry->openfd, sEntry->fd_offset, SEEK_SET);
     }
 
+    if (!IsSink(sEntry) && SFTP_MapFiles)
+	sftp_vfmap(sEntry);
+
     return(0);
 }
 
@@ -470,15 +482,19 @@ static void sftp_SendAck(struct SFTP_Entry *sEntry)
 	Returns 0 if normal, -1 if fatal error of some kind occurred.  */
 {
     RPC2_PacketBuffer *pb;
-    long i, shiftlen;
+    long i, shiftlen, bodylen = 0;
     unsigned int btemp[BITMASKWIDTH], now;
     int confirm = 1;
     
     sftp_acks++;
     sftp_Sent.Acks++;
 
-    SFTP_AllocBuffer(0, &pb);
-    sftp_InitPacket(pb, sEntry, 0);
+    /* the header only holds 64 bits of the selective ack mask */
+    if (sEntry->WindowSize > 64)
+	bodylen = sizeof(int) * (BITMASKWIDTH - 2);
+
+    SFTP_AllocBuffer(bodylen, &pb);
+    sftp_InitPacket(pb, sEntry, bodylen);
     pb->Header.SeqNumber = ++(sEntry->CtrlSeqNumber);
     pb->Header.Opcode = SFTP_ACK;
     pb->Header.GotEmAll = sEntry->RecvLastContig;
@@ -610,6 +626,8 @@ int sftp_AckArrived(RPC2_PacketBuffer *pBuff, struct SFTP_Entry *sEntry)
     /* grab the timestamp because we're going to send more data. */
     sEntry->TimeEcho = pBuff->Header.TimeStamp;
 
+    UpdateWindow(sEntry);
+
     /* Update counters to match other side */
     sEntry->SendLastContig = pBuff->Header.GotEmAll;
     B_CopyFromPacket(pBuff, sEntry->SendTheseBits);
@@ -820,10 +838,10 @@ static int ResendWorried(struct SFTP_Entry *sEntry)
        Side effects: flag settings on resent packets
        Returns 0 if normal, -1 if fatal error of some kind occurred.  */
 {
-    RPC2_PacketBuffer *pb;
+    RPC2_PacketBuffer *pb, *xmit[MAXOPACKETS];
     long i;
     unsigned long now;
-    int acked = 0;
+    int acked = 0, nxmit = 0;
 
     /* Now send them out */
     for (i = sEntry->SendLastContig+1; i <= sEntry->SendWorriedLimit; i++)
@@ -871,10 +889,13 @@ static int ResendWorried(struct SFTP_Entry *sEntry)
 		    (unsigned long)ntohl(pb->Header.SeqNumber),
 		    (unsigned long)ntohl(pb->Header.TimeStamp),
 		    (unsigned long)ntohl(pb->Header.TimeEcho));
-	    sftp_XmitPacket(sEntry, pb, 0);
+	    xmit[nxmit++] = pb;
 	}
     }
 
+    if (nxmit)
+	sftp_XmitPackets(sEntry, xmit, nxmit, 0);
+
     return(0);
 }
 
@@ -934,7 +955,7 @@ static int SendSendAhead(struct SFTP_Entry *sEntry)
        ReadAheadCount if something gets sent Returns 0 if normal, -1
        if fatal error of some kind occurred.  */
 {
-    RPC2_PacketBuffer *pb;
+    RPC2_PacketBuffer *pb, *xmit[MAXOPACKETS];
     long i, j;
     unsigned long now;
     int dont_ackme;
@@ -987,13 +1008,16 @@ static int SendSendAhead(struct SFTP_Entry *sEntry)
 	    htonl(sEntry->TimeEcho) : htonl(0);
 #endif
 
-	sftp_XmitPacket(sEntry, pb, 1);
 	say(/*9*/4, SFTP_DebugLevel, "S-%lu [%lu] {%lu}\n",
 		(unsigned long)ntohl(pb->Header.SeqNumber), 
 		(unsigned long)ntohl(pb->Header.TimeStamp),
 		(unsigned long)ntohl(pb->Header.TimeEcho));
+	xmit[i] = pb;
 	}
 
+    /* the whole send-ahead set goes out in one go */
+    sftp_XmitPackets(sEntry, xmit, sEntry->ReadAheadCount, 1);
+
     sEntry->ReadAheadCount = 0;  /* we have eaten all of them */
     return(0);
 }
@@ -1011,17 +1035,21 @@ int sftp_ReadStrategy(struct SFTP_Entry *sEntry)
     RPC2_PacketBuffer *pb;
     struct iovec iovarray[MAXOPACKETS];
     long i, byteswanted, bytesread, j;
-    int bodylength;
+    int bodylength, mapped;
 
     if (sEntry->HitEOF) return(0);
     if (!WinIsOpen(sEntry)) return(0);
 
+    /* Packets that get the old style encryption need their own copy */
+    mapped = sEntry->map_addr &&
+	!(!sEntry->sa->encrypt && sEntry->PInfo.SecurityLevel == RPC2_SECURE);
+
     /* Be optimistic: assume you won't hit EOF */
     bodylength = sEntry->PacketSize - sizeof(struct RPC2_PacketHeader);
     byteswanted = sEntry->SendAhead * bodylength; /* what we expect normally */
     for (i = 1; i < 1 + sEntry->SendAhead; i++)
 	{
-	SFTP_AllocBuffer(bodylength, &pb);
+	SFTP_AllocBuffer(mapped ? 0 : bodylength, &pb);
 	sftp_InitPacket(pb, sEntry, bodylength);	/* BodyLength set */
 	pb->Header.Flags = 0;
 	pb->Header.SEFlags = SFTP_MOREDATA;		/* tentative assumption */
@@ -1036,7 +1064,15 @@ int sftp_ReadStrategy(struct SFTP_Entry *sEntry)
 	}
 
     /* Read in one fell swoop */
-    bytesread = sftp_vfreadv(sEntry, iovarray, sEntry->SendAhead);
+    if (mapped) {
+	bytesread = sftp_vfmapv(sEntry, iovarray, sEntry->SendAhead);
+	for (i = 1; i < 1 + sEntry->SendAhead; i++) {
+	    j = PBUFF((sEntry->SendMostRecent + i));
+	    sEntry->ThesePackets[j]->Prefix.BodyRef = iovarray[i-1].iov_base;
+	}
+	sftp_mapped += sEntry->SendAhead;
+    } else
+	bytesread = sftp_vfreadv(sEntry, iovarray, sEntry->SendAhead);
     if (bytesread < 0) {
 	BOGOSITY(sEntry, 0);
 	perror("sftp_vfreadv");
@@ -1230,7 +1266,7 @@ int sftp_SendTrigger(struct SFTP_Entry *sEntry)
 
 static int WinIsOpen(struct SFTP_Entry *sEntry)
 {
-    if ((sEntry->SendAhead + sEntry->SendMostRecent - sEntry->SendLastContig) > sEntry->WindowSize)
+    if ((sEntry->SendAhead + sEntry->SendMostRecent - sEntry->SendLastContig) > SendWindow(sEntry))
 	return(FALSE);
     if ((SFTP_MaxPackets > 0) && (sftp_PacketsInUse + sEntry->SendAhead > SFTP_MaxPackets))
 	{
@@ -1260,6 +1296,71 @@ void sftp_InitPacket(RPC2_PacketBuffer *pb, struct SFTP_Entry *sfe,
 }
 
 
+/*----------------------- Adaptive send window ----------------------*/
+
+/* Size the send window to the bandwidth-delay product of the connection,
+ * using the RTT and outgoing bandwidth estimates rpc2 keeps for the peer.
+ * Like TCP BBR we keep twice the BDP in flight, so that the estimates can
+ * grow when the path allows it, plus the next send-ahead burst. Losses are
+ * not used as a signal, they show up as a longer RTT or a lower bandwidth. */
+static void SizeWindow(struct SFTP_Entry *sEntry)
+{
+    unsigned long rtt = 0, bw = 0;
+    uint64_t bdp;
+    uint32_t win;
+
+    RPC2_GetRTT(sEntry->LocalHandle, &rtt, NULL);
+    RPC2_GetBandwidth(sEntry->LocalHandle, NULL, NULL, &bw);
+
+    if (!rtt || !bw)
+	win = 2 * sEntry->SendAhead; /* no estimates yet */
+    else {
+	bdp = (uint64_t)bw * rtt / 1000000 / sEntry->PacketSize;
+	if (2 * bdp + sEntry->SendAhead < sEntry->WindowSize)
+	    win = 2 * bdp + sEntry->SendAhead;
+	else
+	    win = sEntry->WindowSize;
+    }
+    if (win > sEntry->WindowSize)
+	win = sEntry->WindowSize;
+
+    if (win < sEntry->CongWindow)
+	sEntry->WindowCuts++;
+    sEntry->CongWindow = win;
+    if (sEntry->CongWindow > sEntry->MaxCongWindow)
+	sEntry->MaxCongWindow = sEntry->CongWindow;
+}
+
+/* Called by the source at the beginning of each transfer */
+void sftp_StartWindow(struct SFTP_Entry *sEntry)
+{
+    sEntry->CongWindow = 0;
+    if (SFTP_AdaptiveWindow)
+	SizeWindow(sEntry);
+}
+
+/* Number of packets we may have outstanding. Never less than SendAhead,
+ * otherwise WinIsOpen would not let us send anything even when all
+ * packets have been acked. */
+static uint32_t SendWindow(struct SFTP_Entry *sEntry)
+{
+    uint32_t win = sEntry->WindowSize;
+
+    if (SFTP_AdaptiveWindow && sEntry->CongWindow < win)
+	win = sEntry->CongWindow;
+    if (win < sEntry->SendAhead)
+	win = sEntry->SendAhead;
+    return win;
+}
+
+/* Every ack has just updated the estimates, follow them */
+static void UpdateWindow(struct SFTP_Entry *sEntry)
+{
+    if (SFTP_AdaptiveWindow)
+	SizeWindow(sEntry);
+}
+
+
 #ifdef RPC2DEBUG
 void PrintDb(struct SFTP_Entry *se, RPC2_PacketBuffer *pb)
 {
@@ -1272,6 +1373,8 @@ void PrintDb(struct SFTP_Entry *se, RPC2_PacketBuffer *pb)
 	se->SendLastContig,	se->SendMostRecent, se->SendAckLimit, se->SendWorriedLimit, se->ReadAheadCount);
     fprintf(rpc2_tracefile, "\tRecvLastContig = %d   RecvMostRecent = %d\n",
 	se->RecvLastContig,	se->RecvMostRecent);
+    fprintf(rpc2_tracefile, "\tWindowSize = %d  CongWindow = %d  MaxCongWindow = %d  WindowCuts = %d\n",
+	se->WindowSize, se->CongWindow, se->MaxCongWindow, se->WindowCuts);
 
     if (!pb) return;
 
@@ -1384,6 +1487,20 @@ int sftp_vfwritefile(struct SFTP_Entry *se, char *buf, int nbytes)
 /* close any still open filedescriptor */
 void sftp_vfclose(struct SFTP_Entry *se)
 {
+    int i;
+
+    if (se->map_addr) {
+	/* packets that still refer to the mapping can't be sent anymore */
+	for (i = 0; i < MAXOPACKETS; i++)
+	    if (se->ThesePackets[i] && se->ThesePackets[i]->Prefix.BodyRef)
+		SFTP_FreeBuffer(&se->ThesePackets[i]);
+#ifdef HAVE_MMAP
+	munmap(se->map_addr, se->map_size);
+#endif
+	se->map_addr = NULL;
+	se->map_size = 0;
+    }
+
     if (se->openfd == -1)
     { /* we closed this fd when CheckSE fails, so this is not a problem. -JH */
 	say(10, SFTP_DebugLevel, "sftp_vfclose: fd was already closed.\n");
@@ -1442,6 +1559,58 @@ static int sftp_vfreadv(struct SFTP_Entry *se, struct iovec iovarray[], long how
 }
 
 
+/* Map the file we are about to send, so that packets can be sent from the
+ * page cache without first copying the data into the packet buffers.
+ * Files that fit in a single packet are not worth the trouble. */
+static void sftp_vfmap(struct SFTP_Entry *se)
+{
+#ifdef HAVE_MMAP
+    struct stat st;
+    void *addr;
+
+    if (fstat(se->openfd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	st.st_size - se->fd_offset <= (off_t)se->PacketSize ||
+	(off_t)(size_t)st.st_size != st.st_size)
+	return;
+
+    addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED,
+		se->openfd, 0);
+    if (addr == MAP_FAILED)
+	return;
+#ifdef MADV_SEQUENTIAL
+    (void)madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+    se->map_addr = (char *)addr;
+    se->map_size = (size_t)st.st_size;
+#endif
+}
+
+/* Like sftp_vfreadv, but points the iovecs at the mapped file instead of
+ * copying the data. Returns total number of bytes 'read'. */
+static int sftp_vfmapv(struct SFTP_Entry *se, struct iovec iovarray[], long howMany)
+{
+    size_t left, len;
+    long i;
+    int rc = 0;
+
+    left = (se->fd_offset < (off_t)se->map_size) ?
+	se->map_size - se->fd_offset : 0;
+
+    for (i = 0; i < howMany; i++) {
+	len = iovarray[i].iov_len;
+	if (len > left) len = left;
+
+	iovarray[i].iov_base = se->map_addr + se->fd_offset;
+	se->fd_offset += len;
+	left -= len;
+	rc += len;
+
+	if (len < iovarray[i].iov_len)
+	    break;
+    }
+    return rc;
+}
+
 static int sftp_vfwritev(struct SFTP_Entry *se, struct iovec *iovarray, long howMany)
     /*  Iterates through the array and returns the total number of
     bytes sent out.  */
@@ -89,6 +89,31 @@ int sftp_XmitPacket(struct SFTP_Entry *sEntry, RPC2_PacketBuffer *pb,
     return(RPC2_SUCCESS);
 }
 
+/* Transmit a run of data packets with as few system calls as possible */
+int sftp_XmitPackets(struct SFTP_Entry *sEntry, RPC2_PacketBuffer *pbs[],
+		     int count, int confirm)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+#ifdef RPC2DEBUG
+	struct TraceEntry *te;
+
+	te = (struct TraceEntry *)CBUF_NextSlot(TraceBuf);
+	te->tcode = SENT;
+	te->ph = pbs[i]->Header;	/* structure assignment */
+#endif
+	rpc2_Sent.Total--;
+	rpc2_Sent.Bytes -= pbs[i]->Prefix.LengthOfPacket;
+	sftp_Sent.Total++;
+	sftp_Sent.Bytes += pbs[i]->Prefix.LengthOfPacket;
+    }
+
+    rpc2_XmitPackets(pbs, count, sEntry->HostInfo->Addr, confirm);
+
+    return(RPC2_SUCCESS);
+}
+
 void sftp_TraceStatus(struct SFTP_Entry *sEntry, int filenum, int linenum)
     {
 #ifdef RPC2DEBUG
@@ -139,18 +139,33 @@ void B_Assign(unsigned int *dest, unsigned int *src)
 }
 
 
+/* The header has room for the first 64 bits, windows larger than that carry
+ * the rest of the bit string in the body of the ack. Only the header is
+ * converted by rpc2_htonp/rpc2_ntohp, so the body is kept in network order
+ * here. */
 void B_CopyToPacket(unsigned int *bMask, RPC2_PacketBuffer *whichPacket)
 {
-    assert(BITMASKWIDTH <= 2);	/* for now */
+    unsigned int i, *body = (unsigned int *)whichPacket->Body;
+
+    assert(BITMASKWIDTH >= 2);
     whichPacket->Header.BitMask0 = (unsigned) bMask[0];
     whichPacket->Header.BitMask1 = (unsigned) bMask[1];
+    for (i = 2; i < BITMASKWIDTH &&
+		i - 2 < whichPacket->Header.BodyLength / sizeof(int); i++)
+	body[i - 2] = htonl(bMask[i]);
 }
 
 void B_CopyFromPacket(RPC2_PacketBuffer *whichPacket, unsigned int *bMask)
 {
-    assert(BITMASKWIDTH <= 2);	/* for now */
+    unsigned int i, *body = (unsigned int *)whichPacket->Body;
+
+    assert(BITMASKWIDTH >= 2);
+    memset(bMask, 0, sizeof(int)*BITMASKWIDTH);
     bMask[0] = (unsigned) whichPacket->Header.BitMask0;
     bMask[1] = (unsigned) whichPacket->Header.BitMask1;
+    for (i = 2; i < BITMASKWIDTH &&
+		i - 2 < whichPacket->Header.BodyLength / sizeof(int); i++)
+	bMask[i] = ntohl(body[i - 2]);
 }
 
 
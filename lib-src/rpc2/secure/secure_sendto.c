@@ -15,6 +15,7 @@ Coda are listed in the file CREDITS.
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <stdint.h>
@@ -29,22 +30,40 @@ ssize_t secure_sendto(int s, const void *buf, size_t len, int flags,
 		      const struct sockaddr *to, socklen_t tolen,
 		      struct security_association *sa)
 {
-    uint8_t out[MAXPACKETSIZE];
-    size_t padded_size;
+    struct iovec iov;
+
+    iov.iov_base = (void *)buf;
+    iov.iov_len = len;
+    return secure_sendtov(s, &iov, 1, flags, to, tolen, sa);
+}
+
+/* Build the datagram for a packet gathered from several buffers, the first
+ * one has to hold at least the first two words of the packet. When the
+ * packet has to be encrypted or authenticated the result is written to out,
+ * which should be MAXPACKETSIZE bytes, otherwise the packet is only checked
+ * and can be sent as is. Returns the length of the datagram, or -1 and sets
+ * errno. */
+ssize_t secure_encodev(const struct iovec *iov, int iovcnt, uint8_t *out,
+		       struct security_association *sa)
+{
+    size_t padded_size, len = 0;
     ssize_t n;
     int i, pad_align, padding;
     uint8_t *aad, *iv, *payload, *icv;
 
+    for (i = 0; i < iovcnt; i++)
+	len += iov[i].iov_len;
+
     if (!sa || (!sa->encrypt && !sa->authenticate)) {
 	/* make sure the other side will not mistake this as encrypted */
 	if (len >= 2 * sizeof(uint32_t) &&
-	    ntohl(*((uint32_t *)buf)) >= 256)
+	    (iov[0].iov_len < 2 * sizeof(uint32_t) ||
+	     ntohl(*((uint32_t *)iov[0].iov_base)) >= 256))
 	{
 	    errno = EINVAL;
 	    return -1;
 	}
-	n = len;
-	goto send_packet;
+	return len;
     }
 
     /* check for sequence number overflow */
@@ -64,7 +83,7 @@ ssize_t secure_sendto(int s, const void *buf, size_t len, int flags,
     padding = padded_size - 2 * sizeof(uint8_t) - len;
 
     /* check if there is enough room */
-    if ((2 * sizeof(uint32_t) + sa->encrypt->iv_len + padded_size + sa->authenticate->icv_len) > sizeof(out))
+    if ((2 * sizeof(uint32_t) + sa->encrypt->iv_len + padded_size + sa->authenticate->icv_len) > MAXPACKETSIZE)
     {
 	errno = EMSGSIZE;
 	return -1;
@@ -87,7 +106,10 @@ ssize_t secure_sendto(int s, const void *buf, size_t len, int flags,
     payload = iv + sa->encrypt->iv_len;
 
     /* copy payload */
-    memcpy(payload, buf, len);
+    for (n = 0, i = 0; i < iovcnt; i++) {
+	memcpy(payload + n, iov[i].iov_base, iov[i].iov_len);
+	n += iov[i].iov_len;
+    }
 
     /* append padding */
     n = len;
@@ -114,14 +136,45 @@ ssize_t secure_sendto(int s, const void *buf, size_t len, int flags,
 	sa->authenticate->auth(sa->authenticate_context, out, n, icv);
 	n += sa->authenticate->icv_len;
     }
+    return n;
+}
+
+/* Like secure_sendto, but gathers the packet from several buffers, the
+ * first one has to hold at least the first two words of the packet */
+ssize_t secure_sendtov(int s, const struct iovec *iov, int iovcnt, int flags,
+		       const struct sockaddr *to, socklen_t tolen,
+		       struct security_association *sa)
+{
+    uint8_t out[MAXPACKETSIZE];
+    struct iovec outiov;
+    struct msghdr msg;
+    size_t len = 0;
+    ssize_t n, padding;
+    int i;
 
-    buf = out;
-    to = (struct sockaddr *)&sa->peer;
-    tolen = sa->peerlen;
+    for (i = 0; i < iovcnt; i++)
+	len += iov[i].iov_len;
+
+    n = secure_encodev(iov, iovcnt, out, sa);
+    if (n < 0)
+	return -1;
+
+    if (sa && (sa->encrypt || sa->authenticate)) {
+	outiov.iov_base = out;
+	outiov.iov_len = n;
+	iov = &outiov;
+	iovcnt = 1;
+	to = (struct sockaddr *)&sa->peer;
+	tolen = sa->peerlen;
+    }
 
-send_packet:
     padding = n - len;
-    n = sendto(s, buf, n, flags, to, tolen);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = (void *)to;
+    msg.msg_namelen = tolen;
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+    n = sendmsg(s, &msg, flags);
 #ifdef __linux__
     if (n == -1 && errno == ECONNREFUSED)
     {
@@ -132,7 +185,7 @@ send_packet:
 	 * We retry the send, because the failing host was possibly
 	 * not the one we tried to send to this time. --JH
 	 */
-	n = sendto(s, buf, n, 0, to, tolen);
+	n = sendmsg(s, &msg, 0);
     }
 #endif
     n -= padding;
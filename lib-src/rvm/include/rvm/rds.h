@@ -94,6 +94,9 @@ extern int rds_free(
 
 int rds_maxblock(unsigned long size);
 
+/* Chunks carved at once when a small size free list runs empty */
+extern unsigned long rds_refill_chunks;
+
 /*
  * Because a transaction may abort we don't actually want to free
  * objects until the end of the transaction. So fake_free records our intention
@@ -302,6 +302,9 @@ typedef struct
                                            is the wanted size */
     long            create_log_mode;    /* when creating a new log file, this
                                            is the wanted mode */
+    rvm_length_t    group_commit;       /* usec a flush commit waits for other
+                                           commits to share its log write,
+                                           0 ==> don't wait */
     }
 rvm_options_t;
 
@@ -313,6 +316,7 @@ rvm_options_t;
 #define FLUSH_BUF_LEN       (256*1024)  /* default flush buffer length */
 #define MIN_FLUSH_BUF_LEN    (64*1024)  /* minimum flush buffer length */
 #define MAX_READ_LEN        (512*1024)  /* default maximum single read length */
+#define GROUP_COMMIT        0           /* default group commit window (usec) */
 
 #define RVM_COALESCE_RANGES 1           /* coalesce adjacent or shadowed
                                            ranges within a transaction */
@@ -36,6 +36,14 @@ Coda are listed in the file CREDITS.
 #define flush_times_dist                /* timing distribution in millisecs */ \
     25,50,100,250,500,1000,2500,5000,10000 /* use as array initializer */
 
+#define commit_times_len        10      /* length of commit latency vectors */
+#define commit_times_dist               /* latency distribution in usec */ \
+    100,250,500,1000,2500,5000,10000,25000,100000
+
+#define group_sizes_len         8       /* length of group commit vectors */
+#define group_sizes_dist                /* transactions per log force */ \
+    1,2,4,8,16,32,64
+
 #define truncation_times_len    5       /* length of truncation timing vectors */
 #define truncation_times_dist           /* timing distribution in seconds */ \
     1,10,100,500
@@ -174,6 +182,15 @@ typedef struct
     rvm_length_t    tot_trans_overlaps[range_overlaps_len];
                                         /* transactions coalesced per flush  */
     rvm_length_t    tot_trans_coalesces[trans_coalesces_len];
+
+                                        /* group commit stats -- since
+                                           rvm_initialize, not kept in log */
+    rvm_length_t    n_piggyback_commit; /* flush commits forced by another
+                                           committer's log write */
+    rvm_length_t    commit_times[commit_times_len]; /* flush commit
+                                                       latency (usec) */
+    rvm_length_t    group_sizes[group_sizes_len]; /* transactions written
+                                                     per log force */
     }
 rvm_statistics_t;
 /* get RVM statistics */
@@ -0,0 +1,230 @@
+/* BLURB lgpl
+
+                           Coda File System
+                              Release 6
+
+          Copyright (c) 1987-2016 Carnegie Mellon University
+                  Additional copyrights listed below
+
+This  code  is  distributed "AS IS" without warranty of any kind under
+the  terms of the  GNU  Library General Public Licence  Version 2,  as
+shown in the file LICENSE. The technical and financial contributors to
+Coda are listed in the file CREDITS.
+
+                        Additional copyrights
+                           none currently
+
+#*/
+
+/*
+ * Allocation benchmark for the recoverable heap.
+ *
+ * Creates a scratch log and data segment, then runs a mixed size
+ * allocate/free workload that resembles venus' use of the heap (many small
+ * names and vnode sized objects, some larger blocks) once with one block at
+ * a time splitting and once with run refills. Each run happens in its own
+ * process because RVM can only be initialized once. Reports how often an
+ * allocation missed its free list and how fragmented the free space is at
+ * the end. The ops/s figure is dominated by transaction and log overhead,
+ * it varies more between runs than between the two modes, so compare the
+ * miss rates.
+ *
+ * usage: rds_bench [-d dir] [-n ops] [-l live objects]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "rds_private.h"
+
+#define HEAP_ADDR    ((char *)0x20000000)
+#define HEAP_LEN     (32 * 1024 * 1024)
+#define STATIC_LEN   (64 * 1024)
+#define DATA_HDR_LEN (64 * 1024)
+#define LOG_LEN      (16 * 1024 * 1024)
+#define OPS_PER_TID  16
+
+/* object sizes, weighted by how often they are allocated */
+static const unsigned long sizes[] = {
+    16, 24, 24, 32, 32, 32, 48, 64, 64, 100, 128, 200, 300, 600, 600, 1024,
+    2048, 4096
+};
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static char *dir = "/tmp";
+static long nops = 200000;
+static long nlive = 20000;
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+static void check(const char *what, int err)
+{
+    if (err == SUCCESS)
+	return;
+    fprintf(stderr, "%s failed, %s\n", what,
+	    err > 0 ? rvm_return((rvm_return_t)err) : "rds error");
+    exit(EXIT_FAILURE);
+}
+
+/* Walk all free lists, no other thread is touching the heap. */
+static void fragmentation(unsigned long *bytes, unsigned long *nblocks,
+			  unsigned long *largest)
+{
+    free_block_t *bp;
+    unsigned long i;
+
+    *bytes = *nblocks = *largest = 0;
+    for (i = 1; i <= RDS_NLISTS; i++)
+	for (bp = RDS_FREE_LIST[i].head; bp; bp = bp->next) {
+	    *bytes += bp->size * RDS_CHUNK_SIZE;
+	    (*nblocks)++;
+	    if (bp->size * RDS_CHUNK_SIZE > *largest)
+		*largest = bp->size * RDS_CHUNK_SIZE;
+	}
+}
+
+static void run(const char *name, unsigned long refill)
+{
+    char logdev[MAXPATHLEN], datadev[MAXPATHLEN];
+    rvm_options_t *options;
+    rvm_tid_t *tid;
+    rds_stats_t stats;
+    struct timeval start;
+    char **live, *statics;
+    unsigned long freebytes, nfree, largest;
+    double secs;
+    long i;
+    int err, fd;
+
+    snprintf(logdev, sizeof(logdev), "%s/rds_bench.log", dir);
+    snprintf(datadev, sizeof(datadev), "%s/rds_bench.data", dir);
+    unlink(logdev);
+    unlink(datadev);
+
+    fd = open(datadev, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1 || ftruncate(fd, HEAP_LEN + STATIC_LEN + DATA_HDR_LEN)) {
+	perror(datadev);
+	exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    rds_refill_chunks = refill;
+
+    options = rvm_malloc_options();
+    options->log_dev = logdev;
+    options->create_log_file = rvm_true;
+    options->create_log_size = RVM_MK_OFFSET(0, LOG_LEN);
+    options->create_log_mode = 0600;
+    options->truncate = 50;
+    check("rvm_initialize", RVM_INIT(options));
+
+    /* The Venus defaults, 64 byte chunks and 16 lists. */
+    rds_zap_heap(datadev, RVM_MK_OFFSET(0, HEAP_LEN + STATIC_LEN + DATA_HDR_LEN),
+		 HEAP_ADDR, STATIC_LEN, HEAP_LEN, 16, 64, &err);
+    check("rds_zap_heap", err);
+    rds_load_heap(datadev, RVM_MK_OFFSET(0, HEAP_LEN + STATIC_LEN + DATA_HDR_LEN),
+		  &statics, &err);
+    check("rds_load_heap", err);
+
+    live = calloc(nlive, sizeof(char *));
+    tid = rvm_malloc_tid();
+    srandom(1);
+    rds_clear_stats(&err);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nops; i++) {
+	long slot = random() % nlive;
+
+	if (i % OPS_PER_TID == 0)
+	    check("rvm_begin_transaction", rvm_begin_transaction(tid, restore));
+
+	if (live[slot]) {
+	    rds_free(live[slot], tid, &err);
+	    check("rds_free", err);
+	    live[slot] = NULL;
+	} else {
+	    live[slot] = rds_malloc(sizes[random() % NSIZES], tid, &err);
+	    check("rds_malloc", err);
+	}
+
+	if (i % OPS_PER_TID == OPS_PER_TID - 1 || i == nops - 1)
+	    check("rvm_end_transaction", rvm_end_transaction(tid, no_flush));
+    }
+    secs = elapsed(&start);
+
+    rds_get_stats(&stats);
+    fragmentation(&freebytes, &nfree, &largest);
+    printf("%-8s hits %u misses %u (%.2f%%) coalesce %u  "
+	   "free %lu bytes in %lu blocks, largest %lu  (%.0f ops/s)\n",
+	   name, stats.hits, stats.misses,
+	   stats.hits + stats.misses ?
+	   100.0 * stats.misses / (stats.hits + stats.misses) : 0.0,
+	   stats.coalesce, freebytes, nfree, largest, nops / secs);
+
+    rvm_terminate();
+    unlink(logdev);
+    unlink(datadev);
+}
+
+static void spawn(const char *name, unsigned long refill)
+{
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == -1) {
+	perror("fork");
+	exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+	run(name, refill);
+	exit(EXIT_SUCCESS);
+    }
+    if (waitpid(pid, &status, 0) == -1) {
+	perror("waitpid");
+	exit(EXIT_FAILURE);
+    }
+    if (WIFSIGNALED(status)) {
+	fprintf(stderr, "%s run killed by signal %d\n", name, WTERMSIG(status));
+	exit(EXIT_FAILURE);
+    }
+    if (WEXITSTATUS(status) != EXIT_SUCCESS)
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "d:n:l:")) != -1) {
+	switch (c) {
+	case 'd': dir = optarg; break;
+	case 'n': nops = atol(optarg); break;
+	case 'l': nlive = atol(optarg); break;
+	default:
+	    fprintf(stderr, "usage: %s [-d dir] [-n ops] [-l live objects]\n",
+		    argv[0]);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (nops <= 0 || nlive <= 0) {
+	fprintf(stderr, "ops and live objects have to be positive\n");
+	exit(EXIT_FAILURE);
+    }
+
+    spawn("single", 0);
+    spawn("refill", RDS_REFILL_CHUNKS);
+    return 0;
+}
@@ -119,6 +119,13 @@ typedef struct {
 
 #define HEAP_LIST_GROWSIZE 20		/* Number of blocks to prealloc */
 
+/* When the free list for a small size runs empty, split off enough space
+ * for several blocks of that size at once (up to RDS_REFILL_MAX blocks
+ * covering at most rds_refill_chunks chunks) and put the spare ones on the
+ * list. Set rds_refill_chunks to 0 to split one block at a time. */
+#define RDS_REFILL_CHUNKS  64
+#define RDS_REFILL_MAX     16
+
 #define RDS_HEAP_VERSION "Dynamic Allocator Using Rvm Release 0.1 1 Dec 1990"
 #define RDS_VERSION_MAX 80
 
@@ -170,6 +177,7 @@ extern int enqueue();
 extern free_block_t *dequeue();
 extern int print_heap();
 extern free_block_t *split();
+extern free_block_t *refill();
 extern free_block_t *get_block();
 extern int put_block();
 
@@ -168,3 +168,65 @@ retry:
     *err = SUCCESS;
     return newObject2;
 }
+
+unsigned long rds_refill_chunks = RDS_REFILL_CHUNKS;
+
+/* Get a block for a small size whose free list is empty. A run of blocks
+ * of that size is split off in one go, the first is returned and the rest
+ * are put on the list, lowest address first. Subsequent allocations of the
+ * size are then list hits, and objects of equal size end up next to each
+ * other. If no run of that length is available, fall back to split.
+ */
+free_block_t *
+refill(size, tid, err)
+     int 	  size;
+     rvm_tid_t	  *tid;
+     int	  *err;
+{
+    free_block_t *bp, *nbp;
+    rvm_return_t rvmerr;
+    int n, i;
+
+    n = rds_refill_chunks / size;
+    if (n > RDS_REFILL_MAX)
+	n = RDS_REFILL_MAX;
+    if (n < 2)
+	return split(size, tid, err);
+
+    bp = split(n * size, tid, err);
+    if (bp == NULL) {
+	if (*err != ENO_ROOM)
+	    return NULL;
+	return split(size, tid, err);
+    }
+
+    /* bp is free, on no list, and has its end guard at the end of the run */
+    rvmerr = rvm_set_range(tid, bp, sizeof(free_block_t));
+    if (rvmerr != RVM_SUCCESS) {
+	(*err) = (int) rvmerr;
+	return NULL;
+    }
+    bp->size = size;
+
+    for (i = n - 1; i > 0; i--) {
+	nbp = (free_block_t *)((char *)bp + i * size * RDS_CHUNK_SIZE);
+
+	/* The guard in front of this block ends the previous one. */
+	rvmerr = rvm_set_range(tid, (char *)nbp - sizeof(guard_t),
+			       sizeof(guard_t) + sizeof(free_block_t));
+	if (rvmerr != RVM_SUCCESS) {
+	    (*err) = (int) rvmerr;
+	    return NULL;
+	}
+	*((guard_t *)nbp - 1) = END_GUARD;
+	nbp->type = FREE_GUARD;
+	nbp->size = size;
+
+	put_block(nbp, tid, err);
+	if (*err != SUCCESS)
+	    return NULL;
+    }
+
+    *err = SUCCESS;
+    return bp;
+}
@@ -194,11 +194,12 @@ get_block(size, tid, err)
     if ((RDS_FREE_LIST[list].head == NULL) ||	   /* For smaller blocks */
 	(RDS_FREE_LIST[list].head->size != size)) { /* In case of large block */
 	/* A block isn't available so we need to split one. */
-	if (list < RDS_MAXLIST)
+	if (list < RDS_MAXLIST) {
 	    RDS_STATS.misses++;
-	else
-	    RDS_STATS.large_misses++;
-	
+	    return refill(size, tid, err);
+	}
+
+	RDS_STATS.large_misses++;
 	return split(size, tid, err);
     }
 
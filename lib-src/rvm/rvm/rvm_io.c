@@ -517,6 +517,24 @@ long gather_write_dev(dev,offset)
     return wrt_len;
     }
 /* sync file */
+/* ask the kernel to start reading part of a device ahead of use;
+   raw character devices bypass the buffer cache, so nothing to do */
+void readahead_dev(dev,offset,length)
+    device_t        *dev;               /* device descriptor */
+    rvm_offset_t    *offset;            /* device offset */
+    rvm_length_t    length;             /* length of region */
+    {
+#ifdef HAVE_POSIX_FADVISE
+    if ((dev->handle == 0) || (length == 0))
+        return;
+    if (dev->raw_io && (dev->type != S_IFBLK))
+        return;
+
+    (void)posix_fadvise((int)dev->handle,
+                        (off_t)RVM_OFFSET_TO_LENGTH(*offset),
+                        (off_t)length,POSIX_FADV_WILLNEED);
+#endif
+    }
 long sync_dev(dev)
     device_t        *dev;               /* device descriptor */
     {
@@ -22,6 +22,7 @@ Coda are listed in the file CREDITS.
 *
 */
 
+#include <time.h>
 #include <sys/time.h>
 #include <sys/uio.h>
 #include "rvm_private.h"
@@ -46,6 +47,12 @@ rvm_length_t        trans_elims_vec[trans_elims_len] =
                                         {trans_elims_dist};
 rvm_length_t        trans_coalesces_vec[trans_coalesces_len] =
                                         {trans_coalesces_dist};
+rvm_length_t        commit_times_vec[commit_times_len] =
+                                        {commit_times_dist};
+rvm_length_t        group_sizes_vec[group_sizes_len] =
+                                        {group_sizes_dist};
+rvm_length_t        rvm_group_commit = GROUP_COMMIT; /* group commit window
+                                                        (usec) */
 /* allocate variable sized log i/o vector */
 static rvm_return_t make_iov(log,length)
     log_t           *log;               /* log descriptor */
@@ -561,8 +568,8 @@ rvm_return_t flush_log_special(log)
 
     return retval;
     }
-/* internal log flush */
-rvm_return_t flush_log(log,count)
+/* flush all queued tid's -- flush_lock held by caller */
+static rvm_return_t flush_queued(log,count)
     log_t           *log;
     long            *count;              /* statistics counter */
     {
@@ -570,74 +577,146 @@ rvm_return_t flush_log(log,count)
     rvm_bool_t      break_sw;           /* break switch for loop termination */
     struct timeval  start_time;
     struct timeval  end_time;
+    struct timeval  last_commit;        /* last commit written by this flush */
+    long            n_tids = 0;         /* transactions written */
     long            kretval;
     rvm_return_t    retval = RVM_SUCCESS;
 
-    /* allow only one flush at a time to avoid commit ordering problems */
-    RW_CRITICAL(log->flush_lock,w,      /* begin flush_lock crit sec */
-        {
-        /* process statistics */
-        if (count != NULL) (*count)++;
-        kretval= gettimeofday(&start_time,(struct timezone *)NULL);
-        if (kretval != 0)
-            {
-            retval = RVM_EIO;
-            goto err_exit;
-            }
+    /* process statistics */
+    if (count != NULL) (*count)++;
+    kretval= gettimeofday(&start_time,(struct timezone *)NULL);
+    if (kretval != 0) return RVM_EIO;
 
-        /* establish flush mark so future commits won't be flushed
-           and cause extraordinarily long delay to this flush */
+    /* establish flush mark so future commits won't be flushed
+       and cause extraordinarily long delay to this flush */
+    CRITICAL(log->flush_list_lock,      /* begin flush_list_lock crit sec */
+        {
+        if (LIST_NOT_EMPTY(log->flush_list))
+            ((int_tid_t *)(log->flush_list.preventry))->flags
+                |= FLUSH_MARK;
+        });                             /* end flush_list_lock crit sec */
+    /* flush all queued tid's */
+    DO_FOREVER
+        {
+        /* do tid's one at a time to allow no_flush commits while flushing */
         CRITICAL(log->flush_list_lock,  /* begin flush_list_lock crit sec */
             {
             if (LIST_NOT_EMPTY(log->flush_list))
-                ((int_tid_t *)(log->flush_list.preventry))->flags
-                    |= FLUSH_MARK;
+                tid = (int_tid_t *)log->flush_list.nextentry;
+            else tid = NULL;
             });                         /* end flush_list_lock crit sec */
-        /* flush all queued tid's */
-        DO_FOREVER
-            {
-            /* do tid's one at a time to allow no_flush commits while flushing */
-            CRITICAL(log->flush_list_lock, /* begin flush_list_lock crit sec */
-                {
-                if (LIST_NOT_EMPTY(log->flush_list))
-                    tid = (int_tid_t *)log->flush_list.nextentry;
-                else tid = NULL;
-                });                     /* end flush_list_lock crit sec */
-            if (tid == NULL) break;
-
-            /* flush this tid */
-            break_sw = (rvm_bool_t)TID(FLUSH_MARK);
-            retval = log_tid(log,tid);
-            if ((retval != RVM_SUCCESS) || break_sw)
-                break;
-            }
-
-        /* force buffers to disk */
-        CRITICAL(log->dev_lock,
-            {
-            if (sync_dev(&log->dev) < 0)
-                retval = RVM_EIO;
-            });
-err_exit:;
-        });                             /* end flush_lock crit sec */
+        if (tid == NULL) break;
+
+        /* flush this tid */
+        break_sw = (rvm_bool_t)TID(FLUSH_MARK);
+        retval = log_tid(log,tid);
+        n_tids++;
+        if ((retval != RVM_SUCCESS) || break_sw)
+            break;
+        }
+
+    /* force buffers to disk */
+    CRITICAL(log->dev_lock,
+        {
+        if (sync_dev(&log->dev) < 0)
+            retval = RVM_EIO;
+        last_commit = log->status.last_commit;
+        });
+    if (retval != RVM_SUCCESS) return retval;
+
+    /* everything up to the last logged commit is now on disk */
+    log->synced_commit = last_commit;
+    if (n_tids != 0)
+        enter_histogram(n_tids,log->group_sizes,
+                        group_sizes_vec,group_sizes_len);
 
     /* terminate timing */
-    if (retval == RVM_SUCCESS)
-    {
-	kretval= gettimeofday(&end_time,(struct timezone *)NULL);
-	if (kretval != 0) return RVM_EIO;
-	end_time = sub_times(&end_time,&start_time);
-	log->status.flush_time = add_times(&log->status.flush_time,
-					&end_time);
-	end_time.tv_usec = end_time.tv_usec/1000;
-	end_time.tv_usec += end_time.tv_sec*1000;
-	log->status.last_flush_time = end_time.tv_usec;
-	enter_histogram(end_time.tv_usec,log->status.flush_times,
-			flush_times_vec,flush_times_len);
+    kretval= gettimeofday(&end_time,(struct timezone *)NULL);
+    if (kretval != 0) return RVM_EIO;
+    end_time = sub_times(&end_time,&start_time);
+    log->status.flush_time = add_times(&log->status.flush_time,
+                                       &end_time);
+    end_time.tv_usec = end_time.tv_usec/1000;
+    end_time.tv_usec += end_time.tv_sec*1000;
+    log->status.last_flush_time = end_time.tv_usec;
+    enter_histogram(end_time.tv_usec,log->status.flush_times,
+                    flush_times_vec,flush_times_len);
+
+    return RVM_SUCCESS;
     }
+/* internal log flush */
+rvm_return_t flush_log(log,count)
+    log_t           *log;
+    long            *count;              /* statistics counter */
+    {
+    rvm_return_t    retval;
+
+    /* allow only one flush at a time to avoid commit ordering problems */
+    RW_CRITICAL(log->flush_lock,w,      /* begin flush_lock crit sec */
+        {
+        retval = flush_queued(log,count);
+        });                             /* end flush_lock crit sec */
+
     return retval;
-}
-/* exported flush routine */
+    }
+/* wait for the group commit window so that other threads can queue
+   their commits behind ours */
+static void group_commit_wait(usec)
+    rvm_length_t    usec;
+    {
+#ifdef RVM_USELWP
+    struct timeval  tv;
+
+    tv.tv_sec = usec / 1000000;
+    tv.tv_usec = usec % 1000000;
+    (void)IOMGR_Select(0,NULL,NULL,NULL,&tv);
+#elif defined(RVM_USEPT)
+    struct timespec ts;
+
+    ts.tv_sec = usec / 1000000;
+    ts.tv_nsec = (usec % 1000000) * 1000;
+    (void)nanosleep(&ts,NULL);
+#endif /* without real threads there is nobody to wait for */
+    }
+/* flush mode commit: force the log up to and including commit_stamp.
+   Committers that queue while another flush is in progress wait on the
+   flush lock; the first one to get it writes and syncs everything that
+   has been queued since, and the others find their commit already on
+   disk and return without another write or sync.  A group commit
+   window delays every flush commit by that long before it tries to
+   write, to collect more commits per sync at the cost of latency. */
+rvm_return_t flush_commit(log,commit_stamp)
+    log_t           *log;
+    struct timeval  *commit_stamp;      /* stamp of the committing tid */
+    {
+    struct timeval  start_time;
+    struct timeval  end_time;
+    rvm_return_t    retval = RVM_SUCCESS;
+
+    if (gettimeofday(&start_time,(struct timezone *)NULL) != 0)
+        return RVM_EIO;
+
+    if (rvm_group_commit != 0)
+        group_commit_wait(rvm_group_commit);
+
+    RW_CRITICAL(log->flush_lock,w,      /* begin flush_lock crit sec */
+        {
+        if (TIME_GEQ(log->synced_commit,*commit_stamp))
+            log->n_piggyback++;
+        else
+            retval = flush_queued(log,&log->status.n_flush);
+        });                             /* end flush_lock crit sec */
+    if (retval != RVM_SUCCESS) return retval;
+
+    if (gettimeofday(&end_time,(struct timezone *)NULL) != 0)
+        return RVM_EIO;
+    end_time = sub_times(&end_time,&start_time);
+    enter_histogram(end_time.tv_sec*1000000+end_time.tv_usec,
+                    log->commit_times,commit_times_vec,commit_times_len);
+
+    return RVM_SUCCESS;
+    }
+/* exported flush routine */
 rvm_return_t rvm_flush()
     {
     rvm_return_t    retval;
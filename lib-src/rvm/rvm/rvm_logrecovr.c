@@ -71,6 +71,7 @@ static rvm_length_t     last_tree_build_time;
 static rvm_length_t     last_tree_apply_time;
 
 #define NODES_PER_YIELD 1000000
+#define LOG_READAHEAD   4               /* buffers to read ahead of a scan */
 static rvm_length_t num_nodes = NODES_PER_YIELD;
 /* test if modification range will change monitored addresses */
 static void monitor_vmaddr(nv_addr,nv_len,nv_data,nv_offset,rec_hdr,msg)
@@ -185,6 +186,7 @@ rvm_return_t init_buffer(log,offset,direction,synch)
     log_buf_t       *log_buf = &log->log_buf; /* log buffer descriptor */
     rvm_length_t    length;             /* length of buffer */
     rvm_offset_t    read_len;           /* read length calculation temp */
+    rvm_offset_t    ra_offset;          /* readahead offset */
     rvm_return_t    retval = RVM_SUCCESS; /* return value */
 
     assert(RVM_OFFSET_GEQ(*offset,log->status.log_start));
@@ -230,6 +232,26 @@ rvm_return_t init_buffer(log,offset,direction,synch)
             log_buf->ptr += (length-SECTOR_SIZE);
         }
 
+    /* start reading what the scan will need next, the tree build
+       scans the log backwards which defeats the kernel's readahead */
+    if (direction == REVERSE)
+        {
+        read_len = RVM_SUB_OFFSETS(log_buf->offset,log->status.log_start);
+        if (RVM_OFFSET_GTR(read_len,
+                           RVM_LENGTH_TO_OFFSET(LOG_READAHEAD*length)))
+            read_len = RVM_LENGTH_TO_OFFSET(LOG_READAHEAD*length);
+        ra_offset = RVM_SUB_OFFSETS(log_buf->offset,read_len);
+        }
+    else
+        {
+        ra_offset = RVM_ADD_LENGTH_TO_OFFSET(log_buf->offset,length);
+        read_len = RVM_SUB_OFFSETS(log->dev.num_bytes,ra_offset);
+        if (RVM_OFFSET_GTR(read_len,
+                           RVM_LENGTH_TO_OFFSET(LOG_READAHEAD*length)))
+            read_len = RVM_LENGTH_TO_OFFSET(LOG_READAHEAD*length);
+        }
+    readahead_dev(&log->dev,&ra_offset,RVM_OFFSET_TO_LENGTH(read_len));
+
     /* lock device & allow swap if necessary */
     if (synch)
         {
@@ -2203,8 +2225,10 @@ static rvm_return_t disk_merge(log,node,preload)
         assert(buf_ptr == log_buf->length);
         if ((rw_length=write_dev(log->cur_seg_dev,&log_buf->offset,
                                  log_buf->buf,log_buf->length,
-                                 SYNCH))
+                                 NO_SYNCH))
             < 0) return RVM_EIO;
+        log->trunc_seg_bytes =
+            RVM_ADD_LENGTH_TO_OFFSET(log->trunc_seg_bytes,rw_length);
         assert(log->trunc_thread == cthread_self());
         assert((status->trunc_state & RVM_TRUNC_PHASES) 
                == RVM_TRUNC_APPLY);
@@ -2371,13 +2395,15 @@ static rvm_return_t update_seg(log,seg_dict,seg_dev)
             if (node == last_node) break;
             }
 
-        /* update the segment on disk */
+        /* update the segment on disk, synced once the tree is done */
         if ((r_length=write_dev(seg_dev,&log_buf->offset,log_buf->buf,
-                                log_buf->r_length,rvm_true)) < 0)
+                                log_buf->r_length,NO_SYNCH)) < 0)
             {
             retval = RVM_EIO;
             goto err_exit;
             }
+        log->trunc_seg_bytes =
+            RVM_ADD_LENGTH_TO_OFFSET(log->trunc_seg_bytes,r_length);
         assert(log->trunc_thread == cthread_self());
         assert((status->trunc_state & RVM_TRUNC_PHASES) 
                == RVM_TRUNC_APPLY);
@@ -2398,6 +2424,12 @@ static rvm_return_t update_seg(log,seg_dict,seg_dev)
     assert(nodes_done == rvm_num_nodes);
     assert(seg_dict->mod_tree.n_nodes == 0);
 
+    /* force the segment before the log status can be updated; raw
+       devices were written through */
+    if (!seg_dev->raw_io && !(rvm_utlsw && rvm_no_update))
+        if (sync_dev(seg_dev) < 0)
+            retval = RVM_EIO;
+
 err_exit:
     if (!(log->in_recovery || rvm_utlsw)) /* end segment dev_lock crit sec */
         {
@@ -2623,6 +2655,10 @@ X(dev_lock)
                 }
             last_tree_build_time = 0;
             last_tree_apply_time = 0;
+            RVM_ZERO_OFFSET(log->trunc_log_bytes);
+            RVM_ZERO_OFFSET(log->trunc_seg_bytes);
+            ZERO_TIME(log->trunc_build_time);
+            ZERO_TIME(log->trunc_apply_time);
 X(in_recovery)
             /* phase 1: locate tail & start new epoch */
             if (log->in_recovery)
@@ -2643,6 +2679,7 @@ X(in_recovery)
                 status->log_empty = rvm_false;
                 do_truncation = rvm_true;
                 new_1st_rec_num = status->next_rec_num;
+                cur_log_length(log,&log->trunc_log_bytes);
 
                 /* switch epochs */
                 if ((retval=new_epoch(log,count)) != RVM_SUCCESS)
@@ -2685,6 +2722,7 @@ X(build_tree done)
             kretval= gettimeofday(&end_time,(struct timezone *)NULL);
             if (kretval != 0) assert(0); /* return RVM_EIO; */
             end_time = sub_times(&end_time,&tmp_time);
+            log->trunc_build_time = end_time;
             last_tree_build_time = round_time(&end_time);
             if (rvm_chk_sigint != NULL) /* test for interrupt */
                 if ((*rvm_chk_sigint)(NULL)) goto err_exit;
@@ -2702,6 +2740,7 @@ X(apply_mods end)
             kretval= gettimeofday(&end_time,(struct timezone *)NULL);
             if (kretval != 0) assert(0); /* return RVM_EIO; */
             end_time = sub_times(&end_time,&tmp_time);
+            log->trunc_apply_time = end_time;
             last_tree_apply_time = round_time(&end_time);
             if (rvm_chk_sigint != NULL) /* test for interrupt */
                 if ((*rvm_chk_sigint)(NULL)) goto err_exit;
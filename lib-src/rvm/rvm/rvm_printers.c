@@ -44,6 +44,10 @@ extern rvm_length_t trans_elims_vec[trans_elims_len]; /* ranges eliminated by tr
                                                          coalesce histogram defs */
 extern rvm_length_t trans_coalesces_vec[trans_coalesces_len]; /* transactions
                                                                  coalesed per flush */
+extern rvm_length_t commit_times_vec[commit_times_len]; /* commit latency
+                                                           histogram defs */
+extern rvm_length_t group_sizes_vec[group_sizes_len]; /* transactions per log
+                                                         force histogram defs */
 /* print rvm_offset_t */
 static int pr_offset(offset,stream)   
     rvm_offset_t    *offset;
@@ -265,9 +269,13 @@ static rvm_return_t pr_log_stats(stats,out_stream,n_trans,tot_trans)
                   len_temp1,len_temp2);
     if (err == EOF) return RVM_EIO;
     err = fprintf(out_stream,
-                  "  Last flush time (msec):         %10ld\n\n",
+                  "  Last flush time (msec):         %10ld\n",
                   stats->last_flush_time);
     if (err == EOF) return RVM_EIO;
+    err = fprintf(out_stream,
+                  "  Commits forced by other flushes:%10ld\n\n",
+                  stats->n_piggyback_commit);
+    if (err == EOF) return RVM_EIO;
     err = fprintf(out_stream,
                   "  rvm_truncate calls:                        %10ld\n",
             stats->tot_rvm_truncate);
@@ -369,6 +377,16 @@ static rvm_return_t pr_time_histos(stats,out_stream,n_trans,tot_trans)
     err = pr_histogram(out_stream,stats->tot_flush_times,flush_times_vec,
                        flush_times_len,6,2,rvm_true,rvm_true);
     if (err == EOF) return RVM_EIO;
+    err = fprintf(out_stream,"\n  Flush Commit Latency (usec):\n");
+    if (err == EOF) return RVM_EIO;
+    err = pr_histogram(out_stream,stats->commit_times,commit_times_vec,
+                       commit_times_len,7,2,rvm_true,rvm_true);
+    if (err == EOF) return RVM_EIO;
+    err = fprintf(out_stream,"\n  Transactions per Log Force:\n");
+    if (err == EOF) return RVM_EIO;
+    err = pr_histogram(out_stream,stats->group_sizes,group_sizes_vec,
+                       group_sizes_len,6,2,rvm_true,rvm_true);
+    if (err == EOF) return RVM_EIO;
 
     err=fprintf(out_stream,"\n\n  Truncation Timings for Tree Build (sec):\n");
     if (err == EOF) return RVM_EIO;
@@ -1015,6 +1015,23 @@ typedef struct
     cthread_t       trunc_thread;
     rvm_bool_t      in_recovery;        /* true if in recovery */
 
+                                        /* group commit state and statistics,
+                                           not kept in the status area */
+    struct timeval  synced_commit;      /* stamp of last commit forced to
+                                           disk (flush_lock protected) */
+    rvm_length_t    n_piggyback;        /* flush commits forced by another
+                                           committer's log write */
+    rvm_length_t    commit_times[commit_times_len]; /* flush commit
+                                                       latency (usec) */
+    rvm_length_t    group_sizes[group_sizes_len]; /* transactions written
+                                                     per log force */
+
+                                        /* last truncation or recovery */
+    rvm_offset_t    trunc_log_bytes;    /* log records processed */
+    rvm_offset_t    trunc_seg_bytes;    /* data written to segments */
+    struct timeval  trunc_build_time;   /* duration of tree build */
+    struct timeval  trunc_apply_time;   /* duration of tree apply */
+
     struct seg_dict_s
                     *seg_dict_vec;      /* recovery segment dictionary */
     long            seg_dict_len;       /* length of seg_dict_vec */
@@ -1345,6 +1362,11 @@ rvm_return_t flush_log();               /* [rvm_logflush.c] */
     long            *count;
 */
 extern
+rvm_return_t flush_commit();            /* [rvm_logflush.c] */
+/*  log_t           *log;
+    struct timeval  *commit_stamp;
+*/
+extern
 rvm_return_t locate_tail();             /* [rvm_logrecovr.c] */
 /*  log_t           *log; */
 
@@ -1538,6 +1560,13 @@ extern
 long sync_dev();                        /* [rvm_io.c] */
 /*  device_t        *dev; */
 
+extern
+void readahead_dev();                   /* [rvm_io.c] */
+/*  device_t        *dev;
+    rvm_offset_t    *offset;
+    rvm_length_t    length;
+*/
+
 extern
 long gather_write_dev();                /* [rvm_io.c] */
 /*  device_t        *dev;
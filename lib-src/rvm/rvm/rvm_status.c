@@ -28,6 +28,7 @@ extern log_t        *default_log;       /* default log descriptor ptr */
 extern rvm_bool_t   rvm_utlsw;          /* true if call by rvmutl */
 extern char         *rvm_errmsg;        /* internal error message buffer */
 extern rvm_length_t rvm_max_read_len;   /* maximum Mach read length */
+extern rvm_length_t rvm_group_commit;   /* group commit window (usec) */
 extern rvm_length_t flush_times_vec[flush_times_len]; /* flush timing histogram defs */
 extern rvm_length_t truncation_times_vec[truncation_times_len]; /* truncation timing 
                                                                    histogram defs */
@@ -134,6 +135,9 @@ rvm_return_t do_rvm_options(rvm_options)
 	
 	/* set mapping kind */
 	rvm_map_private = rvm_options->flags & RVM_MAP_PRIVATE;
+
+        /* set group commit window */
+        rvm_group_commit = rvm_options->group_commit;
         }
 
 
@@ -257,6 +261,7 @@ err_exit:;
     /* return non-log options */
     rvm_options->flags = rvm_optimizations | rvm_map_private;
     rvm_options->max_read_len = rvm_max_read_len;
+    rvm_options->group_commit = rvm_group_commit;
 
     return retval;
     }
@@ -371,6 +376,11 @@ rvm_return_t rvm_statistics(const char *version, rvm_statistics_t *rvm_statistic
             rvm_statistics->tot_trans_coalesces[i] =
                 status->tot_trans_coalesces[i];
             }
+        rvm_statistics->n_piggyback_commit = log->n_piggyback;
+        for (i=0; i < commit_times_len; i++)
+            rvm_statistics->commit_times[i] = log->commit_times[i];
+        for (i=0; i < group_sizes_len; i++)
+            rvm_statistics->group_sizes[i] = log->group_sizes[i];
         for (i=0; i < truncation_times_len; i++)
             {
             rvm_statistics->tot_tree_build_times[i] =
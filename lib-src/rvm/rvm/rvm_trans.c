@@ -838,6 +838,7 @@ static rvm_return_t queue_tid(tid)
     log_t           *log = tid->log;    /* log descriptor */
     int_tid_t       *q_tid;             /* ptr to last queued tid */
     rvm_bool_t      flush_flag;
+    struct timeval  commit_stamp;       /* tid may be freed once queued */
     rvm_return_t    retval;
 
     /* make sure transaction not too large for log */
@@ -852,6 +853,7 @@ static rvm_return_t queue_tid(tid)
     CRITICAL(log->flush_list_lock,      /* begin flush_list_lock crit sec */
         {
 	make_uname(&tid->commit_stamp);     /* record commit timestamp */
+	commit_stamp = tid->commit_stamp;
         /* test for transaction coalesce */
         if (TID(RVM_COALESCE_TRANS))
             {
@@ -895,7 +897,7 @@ exit:;
 
     /* flush log if commit requires */
     if (flush_flag)
-        retval = flush_log(log,&log->status.n_flush);
+        retval = flush_commit(log,&commit_stamp);
 
     return retval;
     }
@@ -673,6 +673,14 @@ log_t *make_log(log_dev_name,retval)
         log->seg_dict_vec = NULL;
         log->seg_dict_len = 0;
         log->in_recovery = rvm_false;
+        ZERO_TIME(log->synced_commit);
+        log->n_piggyback = 0;
+        BZERO(log->commit_times,sizeof(log->commit_times));
+        BZERO(log->group_sizes,sizeof(log->group_sizes));
+        RVM_ZERO_OFFSET(log->trunc_log_bytes);
+        RVM_ZERO_OFFSET(log->trunc_seg_bytes);
+        ZERO_TIME(log->trunc_build_time);
+        ZERO_TIME(log->trunc_apply_time);
         mutex_init(&log->truncation_lock);
         init_rw_lock(&log->flush_lock);
         log_buf->prev_rec_num = 0;
@@ -1065,6 +1073,7 @@ void rvm_free_options(rvm_options)
         rvm_options->create_log_file = rvm_false;
         RVM_ZERO_OFFSET(rvm_options->create_log_size);
         rvm_options->create_log_mode = 0600;
+        rvm_options->group_commit = GROUP_COMMIT;
         }
     }
 
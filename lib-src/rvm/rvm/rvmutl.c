@@ -4831,6 +4831,35 @@ static void clear_cut()
         }
     }
 /* log truncation/recovery support */
+/* print throughput of last recovery */
+static void pr_recovery_rate(out_stream)
+    FILE            *out_stream;
+    {
+    double          log_mb, seg_mb;
+    double          build_secs, apply_secs;
+
+    if (RVM_OFFSET_EQL_ZERO(log->trunc_log_bytes))
+        return;
+
+    log_mb = OFFSET_TO_FLOAT(log->trunc_log_bytes) / (1024 * 1024);
+    seg_mb = OFFSET_TO_FLOAT(log->trunc_seg_bytes) / (1024 * 1024);
+    build_secs = log->trunc_build_time.tv_sec
+                 + log->trunc_build_time.tv_usec / 1e6;
+    apply_secs = log->trunc_apply_time.tv_sec
+                 + log->trunc_apply_time.tv_usec / 1e6;
+
+    fprintf(out_stream,"Log scanned:       %10.1f MB in %8.3f sec",
+            log_mb,build_secs);
+    if (build_secs > 0)
+        fprintf(out_stream,", %8.1f MB/s",log_mb/build_secs);
+    fprintf(out_stream,"\nSegments updated:  %10.1f MB in %8.3f sec",
+            seg_mb,apply_secs);
+    if (apply_secs > 0)
+        fprintf(out_stream,", %8.1f MB/s",seg_mb/apply_secs);
+    fprintf(out_stream,"\nRecovery rate:     %10.1f MB/s of log\n",
+            (build_secs+apply_secs) > 0 ? log_mb/(build_secs+apply_secs)
+                                        : 0.0);
+    }
 #define MAX_RECOVER_KEYS   20           /* maximum number of key words */
 
 static str_name_entry_t recover_key_vec[MAX_RECOVER_KEYS] =
@@ -4920,6 +4949,7 @@ file_name:
         clear_cut();                    /* deallocate remaining change trees */
         goto sig_exit;
         }
+    pr_recovery_rate(stdout);
     goto exit;                          /* no */
 err_exit:
     bool_ret = rvm_false;